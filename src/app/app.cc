@@ -58,6 +58,7 @@ public:
         gboolean no_shell{false};
         gboolean object_notifications{false};
         gboolean reverse{false};
+        gboolean scrollback_dictionaries{false};
         gboolean test_mode{false};
         gboolean use_gregex{false};
         gboolean version{false};
@@ -88,6 +89,7 @@ public:
         GdkRGBA hl_fg_color{};
         int cjk_ambiguous_width{1};
         int extra_margin{-1};
+        int scrollback_cache_blocks{-1};
         int scrollback_lines{-1 /* infinite */};
         int transparency_percent{-1};
         int verbosity{0};
@@ -96,6 +98,7 @@ public:
         VteCursorBlinkMode cursor_blink_mode{VTE_CURSOR_BLINK_SYSTEM};
         VteCursorShape cursor_shape{VTE_CURSOR_SHAPE_BLOCK};
         VteTextBlinkMode text_blink_mode{VTE_TEXT_BLINK_ALWAYS};
+        int scrollback_codec{-1};
 
         ~Options() {
                 g_clear_object(&background_pixbuf);
@@ -272,6 +275,13 @@ private:
                 return that->parse_color(value, &that->hl_fg_color, &that->hl_fg_color_set, error);
         }
 
+        static gboolean
+        parse_scrollback_codec(char const* option, char const* value, void* data, GError** error)
+        {
+                Options* that = static_cast<Options*>(data);
+                return that->parse_enum(VTE_TYPE_SCROLLBACK_CODEC, value, that->scrollback_codec, error);
+        }
+
         static gboolean
         parse_text_blink(char const* option, char const* value, void* data, GError** error)
         {
@@ -405,6 +415,12 @@ public:
                           "Save terminal contents to file at exit", nullptr },
                         { "reverse", 0, 0, G_OPTION_ARG_NONE, &reverse,
                           "Reverse foreground/background colors", nullptr },
+                        { "scrollback-cache-blocks", 0, 0, G_OPTION_ARG_INT, &scrollback_cache_blocks,
+                          "Specify the number of scrollback blocks each stream caches", "1..16" },
+                        { "scrollback-codec", 0, 0, G_OPTION_ARG_CALLBACK, (void*)parse_scrollback_codec,
+                          "Scrollback compression codec (zlib|lz4|zstd)", "CODEC" },
+                        { "scrollback-dictionaries", 0, 0, G_OPTION_ARG_NONE, &scrollback_dictionaries,
+                          "Compress the scrollback with trained dictionaries (zstd only)", nullptr },
                         { "scrollback-lines", 'n', 0, G_OPTION_ARG_INT, &scrollback_lines,
                           "Specify the number of scrollback-lines (-1 for infinite)", nullptr },
                         { "transparent", 'T', 0, G_OPTION_ARG_INT, &transparency_percent,
@@ -2156,6 +2172,15 @@ main(int argc,
        }
 #endif
 
+       if (options.scrollback_cache_blocks > 0)
+               vte_set_scrollback_cache_size(options.scrollback_cache_blocks, 32 * 1024 * 1024);
+       if (options.scrollback_codec != -1 &&
+           !vte_set_scrollback_codec(VteScrollbackCodec(options.scrollback_codec), 0))
+               verbose_printerr("Scrollback codec not available\n");
+       if (options.scrollback_dictionaries &&
+           !vte_set_scrollback_dictionaries(true))
+               verbose_printerr("Scrollback dictionaries not available\n");
+
        auto app = vteapp_application_new();
        auto rv = g_application_run(app, 0, nullptr);
        g_object_unref(app);
@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ascii.hh"
+
+#include <cstring>
+
+#include <glib.h>
+
+using namespace vte::base;
+
+static size_t
+naive_ascii_run(uint8_t const* p,
+                uint8_t const* end)
+{
+        auto q = p;
+        while (q < end && *q < 0x80)
+                ++q;
+        return q - p;
+}
+
+static size_t
+naive_printable_ascii_run(uint8_t const* p,
+                          uint8_t const* end)
+{
+        auto q = p;
+        while (q < end && *q >= 0x20 && *q < 0x7f)
+                ++q;
+        return q - p;
+}
+
+/* Puts each byte value at each position of runs of various lengths
+ * and alignments, so that every vector and word path, and the tails,
+ * see a stop byte in every lane.
+ */
+static void
+test_runs(size_t (*func)(uint8_t const*, uint8_t const*),
+          size_t (*naive)(uint8_t const*, uint8_t const*))
+{
+        uint8_t buf[128 + 32];
+
+        for (auto offset = 0u; offset < 32; ++offset) {
+                auto const start = buf + offset;
+                for (auto len = 0u; len <= 96; ++len) {
+                        memset(buf, 'a', sizeof(buf));
+                        g_assert_cmpuint(func(start, start + len), ==, len);
+
+                        for (auto pos = 0u; pos < len; ++pos) {
+                                for (auto c = 0u; c < 256; ++c) {
+                                        start[pos] = c;
+                                        g_assert_cmpuint(func(start, start + len), ==, naive(start, start + len));
+                                }
+                                start[pos] = 'a';
+                        }
+                }
+        }
+}
+
+static void
+test_ascii_run(void)
+{
+        test_runs(ascii_run, naive_ascii_run);
+}
+
+static void
+test_printable_ascii_run(void)
+{
+        test_runs(printable_ascii_run, naive_printable_ascii_run);
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/ascii/run", test_ascii_run);
+        g_test_add_func("/vte/ascii/printable-run", test_printable_ascii_run);
+
+        return g_test_run();
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ascii.hh"
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/* The word-at-a-time fallbacks find the first matching byte by counting
+ * trailing zeros, which needs the first byte to be the lowest one.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define VTE_ASCII_SWAR 1
+#endif
+
+namespace vte {
+
+namespace base {
+
+#ifdef VTE_ASCII_SWAR
+static constexpr uint64_t const k_ones = UINT64_C(0x0101010101010101);
+static constexpr uint64_t const k_highs = UINT64_C(0x8080808080808080);
+#endif
+
+size_t
+ascii_run(uint8_t const* p,
+          uint8_t const* end) noexcept
+{
+        auto const start = p;
+
+#if defined(__AVX2__)
+        while (end - p >= 32) {
+                auto const mask = uint32_t(_mm256_movemask_epi8(_mm256_loadu_si256((__m256i const*)p)));
+                if (mask != 0)
+                        return p - start + __builtin_ctz(mask);
+                p += 32;
+        }
+#endif
+#if defined(__SSE2__)
+        while (end - p >= 16) {
+                auto const mask = _mm_movemask_epi8(_mm_loadu_si128((__m128i const*)p));
+                if (mask != 0)
+                        return p - start + __builtin_ctz(mask);
+                p += 16;
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        while (end - p >= 16) {
+                if (vmaxvq_u8(vld1q_u8(p)) >= 0x80)
+                        break;
+                p += 16;
+        }
+#endif
+
+#ifdef VTE_ASCII_SWAR
+        while (end - p >= 8) {
+                uint64_t word;
+                memcpy(&word, p, sizeof(word));
+                auto const high = word & k_highs;
+                if (high != 0)
+                        return p - start + (__builtin_ctzll(high) >> 3);
+                p += 8;
+        }
+#endif
+
+        while (p < end && *p < 0x80)
+                ++p;
+
+        return p - start;
+}
+
+size_t
+printable_ascii_run(uint8_t const* p,
+                    uint8_t const* end) noexcept
+{
+        auto const start = p;
+
+#if defined(__AVX2__)
+        {
+                /* Signed compare: 0x20..0x7f are greater than 0x1f, 0x80..0xff aren't */
+                auto const space = _mm256_set1_epi8(0x1f);
+                auto const del = _mm256_set1_epi8(0x7f);
+                while (end - p >= 32) {
+                        auto const v = _mm256_loadu_si256((__m256i const*)p);
+                        auto const printable = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, del),
+                                                                   _mm256_cmpgt_epi8(v, space));
+                        auto const mask = ~uint32_t(_mm256_movemask_epi8(printable));
+                        if (mask != 0)
+                                return p - start + __builtin_ctz(mask);
+                        p += 32;
+                }
+        }
+#endif
+#if defined(__SSE2__)
+        {
+                auto const space = _mm_set1_epi8(0x1f);
+                auto const del = _mm_set1_epi8(0x7f);
+                while (end - p >= 16) {
+                        auto const v = _mm_loadu_si128((__m128i const*)p);
+                        auto const printable = _mm_andnot_si128(_mm_cmpeq_epi8(v, del),
+                                                                _mm_cmpgt_epi8(v, space));
+                        auto const mask = ~uint32_t(_mm_movemask_epi8(printable)) & 0xffffu;
+                        if (mask != 0)
+                                return p - start + __builtin_ctz(mask);
+                        p += 16;
+                }
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        {
+                /* Unsigned compare after the subtraction: 0x20..0x7e become 0x00..0x5e */
+                auto const space = vdupq_n_u8(0x20);
+                auto const limit = vdupq_n_u8(0x5f);
+                while (end - p >= 16) {
+                        auto const printable = vcltq_u8(vsubq_u8(vld1q_u8(p), space), limit);
+                        /* Narrow to 4 bits per byte, since there's no movemask */
+                        auto const mask = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(printable), 4)), 0);
+                        if (mask != 0)
+                                return p - start + (__builtin_ctzll(mask) >> 2);
+                        p += 16;
+                }
+        }
+#endif
+
+#ifdef VTE_ASCII_SWAR
+        while (end - p >= 8) {
+                uint64_t word;
+                memcpy(&word, p, sizeof(word));
+                /* The high bit is set in bytes < 0x20, and in bytes > 0x7e.
+                 * Borrows and carries only ever reach bytes after one that's
+                 * already flagged, so the first flagged byte is exact.
+                 */
+                auto const below = (word - k_ones * 0x20) & ~word;
+                auto const above = (word + k_ones * (0x7f - 0x7e)) | word;
+                auto const flags = (below | above) & k_highs;
+                if (flags != 0)
+                        return p - start + (__builtin_ctzll(flags) >> 3);
+                p += 8;
+        }
+#endif
+
+        while (p < end && *p >= 0x20 && *p < 0x7f)
+                ++p;
+
+        return p - start;
+}
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,41 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vte {
+
+namespace base {
+
+/* Returns the length of the run of ASCII (0x00..0x7f) at the start of
+ * [@p, @end).
+ */
+size_t ascii_run(uint8_t const* p,
+                 uint8_t const* end) noexcept;
+
+/* Returns the length of the run of printable ASCII (0x20..0x7e) at the
+ * start of [@p, @end).
+ */
+size_t printable_ascii_run(uint8_t const* p,
+                           uint8_t const* end) noexcept;
+
+} // namespace base
+
+} // namespace vte
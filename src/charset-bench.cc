@@ -0,0 +1,226 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Converts text in legacy charsets to UTF-8 chunk by chunk, like
+ * Terminal::convert_incoming(), and reports the rate for each charset:
+ * with the decoder as the terminal uses it (by table for single-byte
+ * charsets), with iconv only, and by flattening all the chunks into
+ * one buffer and converting that, like before the decoder streamed.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "charsetdecoder.hh"
+#include "chunk.hh"
+
+using namespace vte::base;
+
+/* Mostly ASCII, like terminal output, with some of everything */
+static char const k_sample[] =
+        "drwxr-xr-x  2 user user  4096 Jan  1 12:00 Documents\r\n"
+        "-rw-r--r--  1 user user 12288 Jan  1 12:00 résumé-naïve-café.txt\r\n"
+        "Größe: 10 €, Äpfel, Öl, Übung, ß; ¡Olé! ¿Qué? «ça» — “quotes”\r\n"
+        "Привет, мир! Съешь же ещё этих мягких французских булок.\r\n"
+        "日本語のテキスト、ひらがなとカタカナ。漢字も少し。\r\n"
+        "中文文本测试，繁體中文測試。\r\n"
+        "\033[1;32mok\033[0m make[1]: Entering directory '/home/user/src'\r\n";
+
+static constexpr size_t const k_input_size = 16 * 1024 * 1024;
+
+static std::vector<Chunk::unique_type>
+make_input(char const* charset)
+{
+        gsize len = 0;
+        auto converted = g_convert_with_fallback(k_sample, -1,
+                                                 charset, "UTF-8",
+                                                 "?", nullptr, &len, nullptr);
+        if (converted == nullptr)
+                return {};
+
+        std::string text;
+        while (text.size() < k_input_size)
+                text.append(converted, len);
+        g_free(converted);
+
+        std::vector<Chunk::unique_type> chunks;
+        for (size_t i = 0; i < text.size(); ) {
+                auto chunk = Chunk::get();
+                chunk->len = std::min(chunk->capacity(), text.size() - i);
+                memcpy(chunk->data, text.data() + i, chunk->len);
+                i += chunk->len;
+                chunks.push_back(std::move(chunk));
+        }
+
+        return chunks;
+}
+
+static size_t
+convert_streaming(CharsetDecoder& decoder,
+                  std::vector<Chunk::unique_type> const& input)
+{
+        size_t total = 0;
+        auto out = Chunk::get();
+        for (auto const& chunk : input) {
+                uint8_t const* inbuf = chunk->data;
+                auto const inbuf_end = inbuf + chunk->len;
+                while (inbuf < inbuf_end) {
+                        auto outbuf = out->data;
+                        decoder.convert(inbuf, inbuf_end,
+                                        outbuf, out->data + out->capacity());
+                        total += outbuf - out->data;
+                }
+        }
+
+        return total;
+}
+
+static size_t
+convert_flattened(GIConv conv,
+                  std::vector<Chunk::unique_type> const& input)
+{
+        std::vector<char> buf;
+        for (auto const& chunk : input)
+                buf.insert(buf.end(), chunk->data, chunk->data + chunk->len);
+
+        std::vector<char> unibuf(buf.size() * 4);
+        auto inbuf = buf.data();
+        gsize inbytes = buf.size();
+        auto outbuf = unibuf.data();
+        gsize outbytes = unibuf.size();
+        while (inbytes > 0) {
+                if (g_iconv(conv, &inbuf, &inbytes, &outbuf, &outbytes) != gsize(-1) ||
+                    errno != EILSEQ)
+                        break;
+                ++inbuf;
+                --inbytes;
+        }
+
+        size_t total = 0;
+        for (auto p = unibuf.data(); p < outbuf; ) {
+                auto chunk = Chunk::get();
+                auto const len = std::min(chunk->capacity(), size_t(outbuf - p));
+                memcpy(chunk->data, p, len);
+                p += len;
+                total += len;
+        }
+
+        return total;
+}
+
+template<typename F>
+static double
+measure(size_t bytes,
+        unsigned int repeat,
+        F&& func)
+{
+        auto best = G_MAXDOUBLE;
+        for (auto i = 0u; i < repeat; ++i) {
+                auto const start = std::chrono::steady_clock::now();
+                func();
+                auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                best = std::min(best, elapsed);
+        }
+
+        return bytes / (1024. * 1024.) / best;
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        char** charsets = nullptr;
+        int repeat = 5;
+        GOptionEntry const entries[] = {
+                { "charset", 'c', 0, G_OPTION_ARG_STRING_ARRAY, &charsets,
+                  "Charset to convert from (default: a selection)", "CHARSET" },
+                { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+                  "Number of runs, of which the best counts", "N" },
+                { nullptr }
+        };
+
+        auto context = g_option_context_new("— legacy charset conversion benchmark");
+        g_option_context_add_main_entries(context, entries, nullptr);
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        std::vector<std::string> list;
+        if (charsets != nullptr) {
+                for (auto p = charsets; *p != nullptr; ++p)
+                        list.push_back(*p);
+                g_strfreev(charsets);
+        } else
+                list = {"ISO-8859-1", "ISO-8859-15", "CP1252", "KOI8-R",
+                        "GB18030", "SHIFT_JIS", "EUC-JP", "BIG5"};
+
+        for (auto const& charset : list) {
+                auto const input = make_input(charset.c_str());
+                CharsetDecoder decoder;
+                if (input.empty() || !decoder.open(charset.c_str())) {
+                        g_printerr("%s: not supported\n", charset.c_str());
+                        continue;
+                }
+
+                size_t bytes = 0;
+                for (auto const& chunk : input)
+                        bytes += chunk->len;
+
+                size_t out_bytes = 0;
+                auto const decoder_rate = measure(bytes, repeat, [&] {
+                                out_bytes = convert_streaming(decoder, input);
+                        });
+                auto const uses_table = decoder.uses_table();
+
+                decoder.open(charset.c_str(), false);
+                auto const iconv_rate = measure(bytes, repeat, [&] {
+                                convert_streaming(decoder, input);
+                        });
+
+                auto conv = g_iconv_open("UTF-8", charset.c_str());
+                auto const flattened_rate = measure(bytes, repeat, [&] {
+                                g_iconv(conv, nullptr, nullptr, nullptr, nullptr);
+                                convert_flattened(conv, input);
+                        });
+                g_iconv_close(conv);
+
+                g_print("%-12s %-5s %8.1f MB/s  iconv %8.1f MB/s  flattened %8.1f MB/s  (%.2f bytes out per byte in)\n",
+                        charset.c_str(),
+                        uses_table ? "table" : "iconv",
+                        decoder_rate,
+                        iconv_rate,
+                        flattened_rate,
+                        double(out_bytes) / bytes);
+        }
+
+        return EXIT_SUCCESS;
+}
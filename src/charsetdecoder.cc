@@ -0,0 +1,277 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "charsetdecoder.hh"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <string.h>
+
+#include "ascii.hh"
+#include "debug.h"
+
+namespace vte {
+
+namespace base {
+
+CharsetDecoder::~CharsetDecoder() noexcept
+{
+        close();
+}
+
+bool
+CharsetDecoder::open(char const* codeset,
+                     bool use_table) noexcept
+{
+        auto conv = g_iconv_open("UTF-8", codeset);
+        if (conv == GIConv(-1))
+                return false;
+
+        close();
+        m_conv = conv;
+        m_use_table = use_table && build_table();
+
+        _vte_debug_print(VTE_DEBUG_IO, "Converting from %s %s\n",
+                         codeset, m_use_table ? "by table" : "with iconv");
+        return true;
+}
+
+void
+CharsetDecoder::close() noexcept
+{
+        if (m_conv != GIConv(-1))
+                g_iconv_close(m_conv);
+
+        m_conv = GIConv(-1);
+        m_use_table = false;
+        m_n_pending = 0;
+}
+
+void
+CharsetDecoder::reset() noexcept
+{
+        if (m_conv != GIConv(-1))
+                g_iconv(m_conv, nullptr, nullptr, nullptr, nullptr);
+
+        m_n_pending = 0;
+}
+
+/* Finds out whether the charset is a stateless single-byte one, by
+ * converting each byte on its own: for a multibyte charset, lead bytes
+ * are incomplete, and stateful or composing converters don't produce
+ * output for a lone byte. If so, records what each byte converts to.
+ */
+bool
+CharsetDecoder::build_table() noexcept
+{
+        auto valid = true;
+        for (auto c = 0u; c < 256 && valid; ++c) {
+                g_iconv(m_conv, nullptr, nullptr, nullptr, nullptr);
+
+                auto byte = char(c);
+                auto inbuf = &byte;
+                gsize inbytes = 1;
+                char buf[8];
+                auto outbuf = buf;
+                gsize outbytes = sizeof(buf);
+                if (g_iconv(m_conv, &inbuf, &inbytes, &outbuf, &outbytes) == gsize(-1)) {
+                        if (errno != EILSEQ) {
+                                valid = false;
+                                break;
+                        }
+
+                        /* Like munge() does */
+                        auto p = (uint8_t const*)&byte;
+                        auto q = m_table[c];
+                        munge(p, q);
+                        m_table_len[c] = q - m_table[c];
+                        continue;
+                }
+
+                auto const len = sizeof(buf) - outbytes;
+                valid = len > 0 && len <= sizeof(m_table[c]) &&
+                        g_utf8_get_char_validated(buf, len) != gunichar(-1) &&
+                        g_utf8_next_char(buf) == buf + len;
+                if (valid) {
+                        memcpy(m_table[c], buf, len);
+                        m_table_len[c] = len;
+                }
+        }
+
+        g_iconv(m_conv, nullptr, nullptr, nullptr, nullptr);
+        if (!valid)
+                return false;
+
+        m_ascii_superset = true;
+        for (auto c = 0u; c < 0x80; ++c) {
+                if (m_table_len[c] != 1 || m_table[c][0] != c) {
+                        m_ascii_superset = false;
+                        break;
+                }
+        }
+
+        return true;
+}
+
+/* Replaces the byte at @in with U+FFFD, except NUL which is passed through */
+void
+CharsetDecoder::munge(uint8_t const*& in,
+                      uint8_t*& out) noexcept
+{
+        if (*in == 0)
+                *out++ = 0;
+        else
+                out += g_unichar_to_utf8(0xfffdU, (char*)out);
+        ++in;
+}
+
+void
+CharsetDecoder::convert_table(uint8_t const*& in,
+                              uint8_t const* in_end,
+                              uint8_t*& out,
+                              uint8_t* out_end) noexcept
+{
+        auto p = in;
+        auto q = out;
+        while (p < in_end) {
+                if (m_ascii_superset) {
+                        auto const n = std::min(ascii_run(p, in_end), size_t(out_end - q));
+                        memcpy(q, p, n);
+                        p += n;
+                        q += n;
+                        if (p == in_end)
+                                break;
+                }
+
+                /* Always copy the whole entry, it's quicker */
+                if (out_end - q < 4)
+                        break;
+
+                auto const c = *p++;
+                memcpy(q, m_table[c], 4);
+                q += m_table_len[c];
+        }
+
+        in = p;
+        out = q;
+}
+
+CharsetDecoder::Result
+CharsetDecoder::convert_iconv(uint8_t const*& in,
+                              uint8_t const* in_end,
+                              uint8_t*& out,
+                              uint8_t* out_end) noexcept
+{
+        while (in < in_end) {
+                auto inbuf = (char*)in;
+                gsize inbytes = in_end - in;
+                auto outbuf = (char*)out;
+                gsize outbytes = out_end - out;
+                auto const ret = g_iconv(m_conv, &inbuf, &inbytes, &outbuf, &outbytes);
+                auto const errsv = errno;
+                in = (uint8_t const*)inbuf;
+                out = (uint8_t*)outbuf;
+                if (ret != gsize(-1))
+                        break;
+
+                switch (errsv) {
+                case EINVAL:
+                        /* Incomplete at the end */
+                        return Result::eIncomplete;
+                case E2BIG:
+                        return Result::eOutputFull;
+                case EILSEQ:
+                default:
+                        if (out_end - out < 3)
+                                return Result::eOutputFull;
+                        munge(in, out);
+                        break;
+                }
+        }
+
+        return Result::eDone;
+}
+
+void
+CharsetDecoder::convert(uint8_t const*& in,
+                        uint8_t const* in_end,
+                        uint8_t*& out,
+                        uint8_t* out_end) noexcept
+{
+        g_assert(is_open());
+
+        if (m_use_table) {
+                convert_table(in, in_end, out, out_end);
+                return;
+        }
+
+        /* Complete the character left over from last time, taking
+         * one byte at a time from the new input, so as to know how
+         * much of it was used.
+         */
+        while (m_n_pending > 0) {
+                if (in == in_end ||
+                    size_t(out_end - out) < k_min_output)
+                        return;
+
+                m_pending[m_n_pending++] = *in++;
+
+                uint8_t const* p = m_pending;
+                auto const result = convert_iconv(p, m_pending + m_n_pending, out, out_end);
+                auto const consumed = size_t(p - m_pending);
+                m_n_pending -= consumed;
+                memmove(m_pending, p, m_n_pending);
+
+                if (result == Result::eOutputFull)
+                        return;
+
+                /* Can't be incomplete anymore */
+                if (result == Result::eIncomplete &&
+                    m_n_pending == sizeof(m_pending)) {
+                        p = m_pending;
+                        munge(p, out);
+                        m_n_pending -= 1;
+                        memmove(m_pending, p, m_n_pending);
+                }
+        }
+
+        for (;;) {
+                auto const result = convert_iconv(in, in_end, out, out_end);
+                if (result != Result::eIncomplete)
+                        break;
+
+                auto const rest = size_t(in_end - in);
+                if (rest < sizeof(m_pending)) {
+                        memcpy(m_pending, in, rest);
+                        m_n_pending = rest;
+                        in = in_end;
+                        break;
+                }
+
+                /* Too long to be incomplete */
+                if (size_t(out_end - out) < k_min_output)
+                        break;
+                munge(in, out);
+        }
+}
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glib.h>
+
+namespace vte {
+
+namespace base {
+
+/*
+ * CharsetDecoder:
+ *
+ * Converts a legacy charset to UTF-8 in a streaming fashion, so that
+ * the input can be converted chunk by chunk: a character that's
+ * incomplete at the end of one input buffer is kept, and completed
+ * with the start of the next one.
+ *
+ * Invalid input is replaced with U+FFFD, except for NUL bytes which
+ * are passed through.
+ *
+ * For single-byte charsets (ISO-8859-x, CP125x, KOI8-R, ...), iconv
+ * is only used to build a byte → UTF-8 table when opening, and the
+ * conversion itself is a table lookup, with runs of ASCII copied
+ * straight through if the charset is an ASCII superset.
+ */
+class CharsetDecoder {
+public:
+        /* The output space that convert() needs to make progress */
+        static constexpr size_t const k_min_output = 8;
+
+        CharsetDecoder() noexcept = default;
+        ~CharsetDecoder() noexcept;
+
+        CharsetDecoder(CharsetDecoder const&) = delete;
+        CharsetDecoder(CharsetDecoder&&) = delete;
+        CharsetDecoder& operator= (CharsetDecoder const&) = delete;
+        CharsetDecoder& operator= (CharsetDecoder&&) = delete;
+
+        /* On failure, the decoder is left unchanged. @use_table is
+         * only there for benchmarking.
+         */
+        bool open(char const* codeset,
+                  bool use_table = true) noexcept;
+        void close() noexcept;
+        void reset() noexcept;
+
+        inline bool is_open() const noexcept { return m_conv != GIConv(-1); }
+        inline constexpr bool uses_table() const noexcept { return m_use_table; }
+
+        /* Converts from @in to @out, advancing both, until all of the
+         * input is used up, or the output is full; in the latter case,
+         * the caller should provide more output space and call again.
+         */
+        void convert(uint8_t const*& in,
+                     uint8_t const* in_end,
+                     uint8_t*& out,
+                     uint8_t* out_end) noexcept;
+
+private:
+        /* Longer than the longest character of any charset */
+        static constexpr size_t const k_max_sequence = 16;
+
+        enum class Result {
+                eDone,
+                eIncomplete,
+                eOutputFull,
+        };
+
+        bool build_table() noexcept;
+        void convert_table(uint8_t const*& in,
+                           uint8_t const* in_end,
+                           uint8_t*& out,
+                           uint8_t* out_end) noexcept;
+        Result convert_iconv(uint8_t const*& in,
+                             uint8_t const* in_end,
+                             uint8_t*& out,
+                             uint8_t* out_end) noexcept;
+        void munge(uint8_t const*& in,
+                   uint8_t*& out) noexcept;
+
+        GIConv m_conv{GIConv(-1)};
+
+        /* The UTF-8 for each byte, and its length */
+        bool m_use_table{false};
+        bool m_ascii_superset{false};
+        uint8_t m_table[256][4];
+        uint8_t m_table_len[256];
+
+        /* An incomplete character at the end of the previous input */
+        uint8_t m_pending[k_max_sequence];
+        size_t m_n_pending{0};
+};
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,509 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string>
+#include <string_view>
+
+#include <glib.h>
+
+#include "emulation.hh"
+#include "vteunistr.h"
+
+using namespace std::literals;
+
+using vte::terminal::Emulation;
+
+/* Absolute rows, as the emulation reports them */
+class RecordingSink : public Emulation::Sink {
+public:
+        long top{G_MAXLONG};
+        long bottom{-1};
+        int n_invalidate_all{0};
+        int n_scrolled{0};
+
+        void invalidate_rows(vte::grid::row_t start,
+                             vte::grid::row_t end) override
+        {
+                top = std::min(top, start);
+                bottom = std::max(bottom, end);
+        }
+
+        void invalidate_all() override { ++n_invalidate_all; }
+
+        void scroll_delta_changed() override { ++n_scrolled; }
+
+        void clear() noexcept
+        {
+                top = G_MAXLONG;
+                bottom = -1;
+                n_invalidate_all = 0;
+                n_scrolled = 0;
+        }
+};
+
+/* Like the widget does it, see Terminal::feed() and Terminal::process_incoming() */
+static void
+feed(Emulation& emulation,
+     std::string_view const& data)
+{
+        emulation.feed(data.data(), data.size());
+        emulation.process_incoming();
+}
+
+static void
+feed(Emulation& emulation,
+     std::string const& data)
+{
+        feed(emulation, std::string_view{data});
+}
+
+/* Rows are relative to the top of the screen, negative ones are in the scrollback */
+static VteCell const*
+cell(Emulation const& emulation,
+     vte::grid::row_t row,
+     vte::grid::column_t column)
+{
+        auto const position = emulation.m_screen->insert_delta + row;
+        if (position < 0)
+                return nullptr;
+
+        return emulation.find_charcell(column, position);
+}
+
+static std::string
+row_text(Emulation const& emulation,
+         vte::grid::row_t row)
+{
+        auto const position = emulation.m_screen->insert_delta + row;
+        auto const rowdata = emulation.find_row_data(position);
+        if (position < 0 || rowdata == nullptr)
+                return {};
+
+        auto const len = std::min(vte::grid::column_t(_vte_row_data_length(rowdata)),
+                                  emulation.m_column_count);
+        auto gs = g_string_sized_new(len);
+        for (vte::grid::column_t col = 0; col < len; ++col) {
+                auto const c = _vte_row_data_get(rowdata, col);
+                if (c->attr.fragment())
+                        continue;
+                if (c->c == 0)
+                        g_string_append_c(gs, ' ');
+                else
+                        _vte_unistr_append_to_string(c->c, gs);
+        }
+
+        /* Trailing blanks aren't text */
+        while (gs->len > 0 && gs->str[gs->len - 1] == ' ')
+                g_string_truncate(gs, gs->len - 1);
+
+        auto text = std::string{gs->str, gs->len};
+        g_string_free(gs, true);
+        return text;
+}
+
+static void
+assert_row_text(Emulation const& emulation,
+                vte::grid::row_t row,
+                char const* expected)
+{
+        auto const text = row_text(emulation, row);
+        g_assert_cmpstr(text.c_str(), ==, expected);
+}
+
+static long
+cursor_row(Emulation const& emulation)
+{
+        return emulation.m_screen->cursor.row - emulation.m_screen->insert_delta;
+}
+
+static long
+cursor_column(Emulation const& emulation)
+{
+        return emulation.m_screen->cursor.col;
+}
+
+static long
+scrollback_row_count(Emulation const& emulation)
+{
+        return emulation.m_screen->insert_delta - _vte_ring_delta(emulation.m_screen->row_data);
+}
+
+static void
+test_core_text(void)
+{
+        Emulation emulation;
+        emulation.set_size(10, 3);
+
+        feed(emulation, "Hello\r\nworld"sv);
+        assert_row_text(emulation, 0, "Hello");
+        assert_row_text(emulation, 1, "world");
+        assert_row_text(emulation, 2, "");
+        g_assert_cmpint(cursor_row(emulation), ==, 1);
+        g_assert_cmpint(cursor_column(emulation), ==, 5);
+
+        auto const c = cell(emulation, 0, 1);
+        g_assert_nonnull(c);
+        g_assert_cmpuint(c->c, ==, 'e');
+        g_assert_null(cell(emulation, 0, 7));
+        g_assert_null(cell(emulation, 2, 0));
+
+        /* Split across feeds, also within a UTF-8 sequence */
+        feed(emulation, "\r\n\xc3"sv);
+        feed(emulation, "\xa9t\xc3\xa9"sv);
+        assert_row_text(emulation, 2, "été");
+}
+
+static void
+test_core_wrap(void)
+{
+        Emulation emulation;
+        emulation.set_size(4, 3);
+
+        feed(emulation, "abcdefghij"sv);
+        assert_row_text(emulation, 0, "abcd");
+        assert_row_text(emulation, 1, "efgh");
+        assert_row_text(emulation, 2, "ij");
+
+        /* Scrolls the first row into the scrollback */
+        feed(emulation, "klmnop"sv);
+        g_assert_cmpint(scrollback_row_count(emulation), ==, 1);
+        assert_row_text(emulation, -1, "abcd");
+        assert_row_text(emulation, 0, "efgh");
+        assert_row_text(emulation, 2, "mnop");
+
+        /* No autowrap */
+        feed(emulation, "\033[?7l\033[H1234567"sv);
+        assert_row_text(emulation, 0, "1237");
+        g_assert_cmpint(cursor_column(emulation), ==, 4);
+}
+
+static void
+test_core_wide(void)
+{
+        Emulation emulation;
+        emulation.set_size(5, 2);
+
+        /* The third doesn't fit and wraps */
+        feed(emulation, "日本語"sv);
+        assert_row_text(emulation, 0, "日本");
+        assert_row_text(emulation, 1, "語");
+
+        auto const c = cell(emulation, 0, 1);
+        g_assert_nonnull(c);
+        g_assert_true(c->attr.fragment());
+        g_assert_cmpuint(cell(emulation, 0, 0)->attr.columns(), ==, 2);
+
+        /* Combining mark */
+        feed(emulation, "e\xcc\x81"sv);
+        assert_row_text(emulation, 1, "語e\xcc\x81");
+        g_assert_cmpint(cursor_column(emulation), ==, 3);
+
+        /* Overwriting half of a wide character cleans up the other half */
+        feed(emulation, "\033[1;2Hx"sv);
+        assert_row_text(emulation, 0, " x本");
+}
+
+static void
+test_core_erase(void)
+{
+        Emulation emulation;
+        emulation.set_size(6, 3);
+
+        feed(emulation, "abcdef\r\nghijkl\r\nmnopqr"sv);
+        feed(emulation, "\033[2;3H\033[K"sv);
+        assert_row_text(emulation, 1, "gh");
+        feed(emulation, "\033[1K"sv);
+        assert_row_text(emulation, 1, "");
+        feed(emulation, "\033[1;2H\033[2P"sv);
+        assert_row_text(emulation, 0, "adef");
+        feed(emulation, "\033[2@"sv);
+        assert_row_text(emulation, 0, "a  def");
+        feed(emulation, "\033[3X"sv);
+        assert_row_text(emulation, 0, "a   ef");
+        feed(emulation, "\033[J"sv);
+        assert_row_text(emulation, 0, "a");
+        assert_row_text(emulation, 2, "");
+
+        /* Erasing beyond the end of the row also fills up to it */
+        feed(emulation, "\033[1;5H\033[44m\033[2X\033[0m"sv);
+        for (auto col = 1; col < 6; ++col)
+                g_assert_cmpuint(cell(emulation, 0, col)->attr.back(), ==, VTE_LEGACY_COLORS_OFFSET + 4);
+        feed(emulation, "\033[1;2H\033[1K"sv);
+        g_assert_cmpuint(cell(emulation, 0, 0)->attr.back(), ==, VTE_DEFAULT_BG);
+        g_assert_cmpuint(cell(emulation, 0, 1)->attr.back(), ==, VTE_DEFAULT_BG);
+        g_assert_cmpuint(cell(emulation, 0, 2)->attr.back(), ==, VTE_LEGACY_COLORS_OFFSET + 4);
+        assert_row_text(emulation, 0, "");
+
+        /* A count far past the right margin still erases up to it */
+        feed(emulation, "\033[2;1Hab\033[2;2H\033[42m\033[65535X\033[0m"sv);
+        assert_row_text(emulation, 1, "a");
+        g_assert_cmpuint(cell(emulation, 1, 0)->attr.back(), ==, VTE_DEFAULT_BG);
+        for (auto col = 1; col < 6; ++col)
+                g_assert_cmpuint(cell(emulation, 1, col)->attr.back(), ==, VTE_LEGACY_COLORS_OFFSET + 2);
+        g_assert_null(cell(emulation, 1, 6));
+        feed(emulation, "\033[2K"sv);
+
+        feed(emulation, "\033[3;1Hxyz\033[2J"sv);
+        for (auto row = 0; row < 3; ++row)
+                assert_row_text(emulation, row, "");
+        g_assert_cmpint(cursor_row(emulation), ==, 2);
+        g_assert_cmpint(cursor_column(emulation), ==, 3);
+}
+
+static void
+test_core_scroll_region(void)
+{
+        Emulation emulation;
+        emulation.set_size(4, 4);
+
+        feed(emulation, "1\r\n2\r\n3\r\n4"sv);
+        feed(emulation, "\033[2;3r"sv);
+        g_assert_cmpint(cursor_row(emulation), ==, 0);
+
+        /* Scrolls only the region, and nothing into the scrollback */
+        feed(emulation, "\033[3;1H\n"sv);
+        assert_row_text(emulation, 0, "1");
+        assert_row_text(emulation, 1, "3");
+        assert_row_text(emulation, 2, "");
+        assert_row_text(emulation, 3, "4");
+        g_assert_cmpint(scrollback_row_count(emulation), ==, 0);
+
+        feed(emulation, "\033[2;1H\033M"sv);
+        assert_row_text(emulation, 1, "");
+        assert_row_text(emulation, 2, "3");
+
+        feed(emulation, "\033[r\033[2;1H\033[L"sv);
+        assert_row_text(emulation, 1, "");
+        assert_row_text(emulation, 3, "3");
+        feed(emulation, "\033[2M"sv);
+        assert_row_text(emulation, 1, "3");
+
+        /* Scrolling the region by several rows at once, after enough
+         * output that the rows wrap around the ring's writable array.
+         */
+        Emulation other;
+        other.set_size(4, 5);
+        for (auto i = 0; i < 100; ++i)
+                feed(other, "x\r\n"sv);
+        feed(other, "1\r\n2\r\n3\r\n4\r\n5"sv);
+        feed(other, "\033[2;4r\033[2S"sv);
+        assert_row_text(other, 0, "1");
+        assert_row_text(other, 1, "4");
+        assert_row_text(other, 2, "");
+        assert_row_text(other, 3, "");
+        assert_row_text(other, 4, "5");
+        feed(other, "\033[44m\033[T\033[0m"sv);
+        assert_row_text(other, 1, "");
+        assert_row_text(other, 2, "4");
+        assert_row_text(other, 3, "");
+        g_assert_cmpuint(cell(other, 1, 0)->attr.back(), ==, VTE_LEGACY_COLORS_OFFSET + 4);
+        g_assert_cmpuint(cell(other, 1, 3)->attr.back(), ==, VTE_LEGACY_COLORS_OFFSET + 4);
+        feed(other, "\033[9T"sv);
+        for (auto row = 1; row < 4; ++row)
+                assert_row_text(other, row, "");
+        assert_row_text(other, 4, "5");
+}
+
+static void
+test_core_sgr(void)
+{
+        Emulation emulation;
+        emulation.set_size(10, 2);
+
+        feed(emulation, "a\033[1;31mb\033[38;2;1;2;3mc\033[0md"sv);
+        g_assert_false(cell(emulation, 0, 0)->attr.bold());
+        g_assert_true(cell(emulation, 0, 1)->attr.bold());
+        g_assert_cmpuint(cell(emulation, 0, 1)->attr.fore(), ==, VTE_LEGACY_COLORS_OFFSET + 1);
+        g_assert_true(cell(emulation, 0, 2)->attr.bold());
+        g_assert_cmpuint(cell(emulation, 0, 2)->attr.fore(), ==, VTE_RGB_COLOR(8, 8, 8, 1, 2, 3));
+        g_assert_false(cell(emulation, 0, 3)->attr.bold());
+        g_assert_cmpuint(cell(emulation, 0, 3)->attr.fore(), ==, VTE_DEFAULT_FG);
+
+        /* Background colour erase */
+        feed(emulation, "\033[44m\033[K"sv);
+        g_assert_cmpuint(cell(emulation, 0, 9)->attr.back(), ==, VTE_LEGACY_COLORS_OFFSET + 4);
+}
+
+static void
+test_core_alternate_screen(void)
+{
+        Emulation emulation;
+        emulation.set_size(10, 2);
+
+        feed(emulation, "normal"sv);
+        feed(emulation, "\033[?1049halt"sv);
+        g_assert_true((emulation.m_screen == &emulation.m_alternate_screen));
+        assert_row_text(emulation, 0, "alt");
+        feed(emulation, "\033[?1049l"sv);
+        g_assert_false((emulation.m_screen == &emulation.m_alternate_screen));
+        assert_row_text(emulation, 0, "normal");
+        g_assert_cmpint(cursor_column(emulation), ==, 6);
+}
+
+static void
+test_core_tabs(void)
+{
+        Emulation emulation;
+        emulation.set_size(20, 2);
+
+        feed(emulation, "a\tb\033[1;18H\tc\033[Zd"sv);
+        assert_row_text(emulation, 0, "a\tb       d\tc");
+        g_assert_cmpint(cell(emulation, 0, 1)->attr.columns(), ==, 7);
+}
+
+static void
+test_core_damage(void)
+{
+        RecordingSink sink;
+        Emulation emulation{&sink};
+        emulation.set_size(10, 3);
+        emulation.set_scrollback_lines(100);
+
+        sink.clear();
+        feed(emulation, "a\r\nb"sv);
+        g_assert_cmpint(sink.top, ==, 0);
+        g_assert_cmpint(sink.bottom, ==, 1);
+        g_assert_cmpint(sink.n_scrolled, ==, 0);
+
+        sink.clear();
+        feed(emulation, "\033[3;5Hc"sv);
+        g_assert_cmpint(sink.top, ==, 2);
+        g_assert_cmpint(sink.bottom, ==, 2);
+
+        /* Scrolls the view along with the output */
+        sink.clear();
+        feed(emulation, "\r\n\r\nd"sv);
+        g_assert_cmpint(sink.n_scrolled, ==, 1);
+        g_assert_cmpfloat(emulation.m_screen->scroll_delta, ==, 2.);
+        g_assert_cmpint(sink.top, ==, 4);
+        g_assert_cmpint(sink.bottom, ==, 4);
+        g_assert_cmpint(cursor_row(emulation), ==, 2);
+
+        /* Only moving the cursor doesn't damage rows */
+        sink.clear();
+        feed(emulation, "\033[H"sv);
+        g_assert_cmpint(sink.bottom, ==, -1);
+        g_assert_cmpint(cursor_row(emulation), ==, 0);
+        g_assert_cmpint(cursor_column(emulation), ==, 0);
+
+        /* The widget emits these as signals */
+        feed(emulation, "\007\033]2;title\007"sv);
+        g_assert_true(emulation.m_bell_pending);
+        g_assert_true(emulation.m_window_title_changed);
+        g_assert_cmpstr(emulation.m_window_title_pending.c_str(), ==, "title");
+
+        sink.clear();
+        feed(emulation, "\033c"sv);
+        g_assert_cmpint(sink.n_invalidate_all, ==, 1);
+}
+
+static void
+test_core_resize(void)
+{
+        Emulation emulation;
+        emulation.set_size(10, 3);
+
+        feed(emulation, "0123456789abc\r\nx"sv);
+        assert_row_text(emulation, 0, "0123456789");
+        assert_row_text(emulation, 1, "abc");
+
+        /* Rewraps, keeping the cursor after the x */
+        emulation.set_size(5, 3);
+        g_assert_cmpint(emulation.m_column_count, ==, 5);
+        assert_row_text(emulation, -1, "01234");
+        assert_row_text(emulation, 0, "56789");
+        assert_row_text(emulation, 1, "abc");
+        assert_row_text(emulation, 2, "x");
+        g_assert_cmpint(cursor_row(emulation), ==, 2);
+        g_assert_cmpint(cursor_column(emulation), ==, 1);
+
+        emulation.set_size(20, 3);
+        assert_row_text(emulation, 0, "0123456789abc");
+        assert_row_text(emulation, 1, "x");
+        g_assert_cmpint(cursor_row(emulation), ==, 1);
+}
+
+static void
+test_core_scrollback_in_memory(void)
+{
+        Emulation emulation;
+        emulation.set_size(80, 3);
+        emulation.set_scrollback_lines(10000);
+        auto const padding = std::string(60, '.');
+
+        /* Enough to fill several stream blocks */
+        for (auto i = 0; i < 4000; ++i)
+                feed(emulation, "row " + std::to_string(i) + padding + "\r\n");
+        g_assert_cmpint(scrollback_row_count(emulation), ==, 3998);
+
+        /* Moving the scrollback to memory keeps it */
+        emulation.set_scrollback_in_memory(true);
+        g_assert_true(emulation.m_scrollback_in_memory);
+        assert_row_text(emulation, -3998, ("row 0" + padding).c_str());
+        assert_row_text(emulation, -50, ("row 3948" + padding).c_str());
+
+        for (auto i = 4000; i < 8000; ++i)
+                feed(emulation, "row " + std::to_string(i) + padding + "\r\n");
+        assert_row_text(emulation, -7998, ("row 0" + padding).c_str());
+        assert_row_text(emulation, -50, ("row 7948" + padding).c_str());
+
+        /* and so does moving it back */
+        emulation.set_scrollback_in_memory(false);
+        g_assert_false(emulation.m_scrollback_in_memory);
+        assert_row_text(emulation, -7998, ("row 0" + padding).c_str());
+        assert_row_text(emulation, -4000, ("row 3998" + padding).c_str());
+        assert_row_text(emulation, -2, ("row 7996" + padding).c_str());
+}
+
+static void
+test_core_reset(void)
+{
+        Emulation emulation;
+        emulation.set_size(10, 3);
+
+        feed(emulation, "\033[1mabc\r\n\n\n\n\033c"sv);
+        g_assert_cmpint(scrollback_row_count(emulation), ==, 0);
+        g_assert_cmpint(cursor_row(emulation), ==, 0);
+        g_assert_cmpint(cursor_column(emulation), ==, 0);
+        assert_row_text(emulation, 0, "");
+        feed(emulation, "d"sv);
+        g_assert_false(cell(emulation, 0, 0)->attr.bold());
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/core/text", test_core_text);
+        g_test_add_func("/vte/core/wrap", test_core_wrap);
+        g_test_add_func("/vte/core/wide", test_core_wide);
+        g_test_add_func("/vte/core/erase", test_core_erase);
+        g_test_add_func("/vte/core/scroll-region", test_core_scroll_region);
+        g_test_add_func("/vte/core/sgr", test_core_sgr);
+        g_test_add_func("/vte/core/alternate-screen", test_core_alternate_screen);
+        g_test_add_func("/vte/core/tabs", test_core_tabs);
+        g_test_add_func("/vte/core/damage", test_core_damage);
+        g_test_add_func("/vte/core/resize", test_core_resize);
+        g_test_add_func("/vte/core/scrollback-in-memory", test_core_scrollback_in_memory);
+        g_test_add_func("/vte/core/reset", test_core_reset);
+
+        return g_test_run();
+}
@@ -57,12 +57,18 @@ _vte_debug_init(void)
     { "hyperlink",    VTE_DEBUG_HYPERLINK    },
     { "modes",        VTE_DEBUG_MODES        },
     { "emulation",    VTE_DEBUG_EMULATION    },
+    { "dispatch",     VTE_DEBUG_DISPATCH     },
   };
+#else
+  /* Profiling the sequence handlers is useful in release builds too */
+  const GDebugKey keys[] = {
+    { "dispatch",     VTE_DEBUG_DISPATCH     },
+  };
+#endif /* VTE_DEBUG */
 
   _vte_debug_flags = g_parse_debug_string (g_getenv("VTE_DEBUG"),
                                            keys, G_N_ELEMENTS (keys));
   _vte_debug_print(0xFFFFFFFF, "VTE debug flags = %x\n", _vte_debug_flags);
-#endif /* VTE_DEBUG */
 }
 
 const char *
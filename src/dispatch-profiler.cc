@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <glib.h>
+
+#include "dispatch-profiler.hh"
+
+namespace vte {
+
+namespace terminal {
+
+static char const*
+command_name(unsigned int command) noexcept
+{
+        switch (command) {
+#define _VTE_CMD(cmd) case VTE_CMD_##cmd: return #cmd;
+#define _VTE_NOP(cmd) case VTE_CMD_##cmd: return #cmd;
+#include "parser-cmd.hh"
+#undef _VTE_CMD
+#undef _VTE_NOP
+        default:
+                return "(unknown)";
+        }
+}
+
+void
+DispatchProfiler::reset() noexcept
+{
+        m_commands.fill(Entry{});
+        m_graphic_bytes = 0;
+}
+
+void
+DispatchProfiler::dump(char const* title) const noexcept
+{
+        struct Line {
+                char const* name;
+                Entry entry;
+        };
+
+        auto lines = std::vector<Line>{};
+        auto total_ticks = ticks_t{0};
+        for (unsigned int command = 0; command < m_commands.size(); ++command) {
+                auto const& entry = m_commands[command];
+                if (entry.count == 0)
+                        continue;
+
+                lines.push_back({command_name(command), entry});
+                total_ticks += entry.ticks;
+        }
+
+        std::sort(std::begin(lines), std::end(lines),
+                  [](Line const& a, Line const& b) { return a.entry.ticks > b.entry.ticks; });
+
+        g_printerr("Dispatch profile%s%s:\n"
+                   "%-12s %12s %16s %10s %7s\n",
+                   title ? " of " : "", title ? title : "",
+                   "command", "count", "ticks", "ticks/call", "%");
+        for (auto const& line : lines) {
+                g_printerr("%-12s %12" G_GUINT64_FORMAT " %16" G_GUINT64_FORMAT " %10.1f %6.2f%%\n",
+                           line.name, line.entry.count, line.entry.ticks,
+                           double(line.entry.ticks) / line.entry.count,
+                           total_ticks ? 100. * line.entry.ticks / total_ticks : 0.);
+        }
+        if (m_commands[VTE_CMD_GRAPHIC].count > 0)
+                g_printerr("GRAPHIC: %" G_GUINT64_FORMAT " characters from %" G_GUINT64_FORMAT " bytes\n",
+                           m_commands[VTE_CMD_GRAPHIC].count, m_graphic_bytes);
+}
+
+} // namespace terminal
+
+} // namespace vte
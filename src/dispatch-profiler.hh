@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "parser.hh"
+
+namespace vte {
+
+namespace terminal {
+
+/*
+ * DispatchProfiler:
+ *
+ * Counts the invocations of the sequence handlers and the time spent in
+ * them, per VTE_CMD_*, and the graphic characters inserted.
+ *
+ * The terminals only have one when VTE_DEBUG contains "dispatch", and
+ * test for it before reading the clock, so that it costs a predicted
+ * branch per sequence otherwise. They dump it when destroyed, and on
+ * RIS, see Emulation::dump_dispatch_profile().
+ */
+class DispatchProfiler {
+public:
+        /* The TSC where there is one, nanoseconds otherwise */
+        using ticks_t = uint64_t;
+
+        DispatchProfiler() noexcept = default;
+        ~DispatchProfiler() noexcept = default;
+
+        DispatchProfiler(DispatchProfiler const&) = delete;
+        DispatchProfiler(DispatchProfiler&&) = delete;
+        DispatchProfiler& operator=(DispatchProfiler const&) = delete;
+        DispatchProfiler& operator=(DispatchProfiler&&) = delete;
+
+        static inline ticks_t now() noexcept
+        {
+#if defined(__x86_64__) || defined(__i386__)
+                return __rdtsc();
+#else
+                return std::chrono::duration_cast<std::chrono::nanoseconds>
+                        (std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+        /* Records one invocation of the handler for @command, started at @start */
+        inline void record(unsigned int command,
+                           ticks_t start) noexcept
+        {
+                auto& entry = m_commands[command < VTE_CMD_N ? command : VTE_CMD_NONE];
+                ++entry.count;
+                entry.ticks += now() - start;
+        }
+
+        /* Records the insertion of @n_chars graphic characters from
+         * @n_bytes bytes of input, started at @start.
+         */
+        inline void record_graphic(size_t n_chars,
+                                   size_t n_bytes,
+                                   ticks_t start) noexcept
+        {
+                auto& entry = m_commands[VTE_CMD_GRAPHIC];
+                entry.count += n_chars;
+                entry.ticks += now() - start;
+                m_graphic_bytes += n_bytes;
+        }
+
+        void reset() noexcept;
+
+        /* Prints the histogram to stderr, most expensive first */
+        void dump(char const* title) const noexcept;
+
+private:
+        struct Entry {
+                uint64_t count{0};
+                ticks_t ticks{0};
+        };
+
+        /* GRAPHIC counts characters, not invocations */
+        std::array<Entry, VTE_CMD_N> m_commands{};
+        uint64_t m_graphic_bytes{0};
+};
+
+} // namespace terminal
+
+} // namespace vte
@@ -0,0 +1,2085 @@
+/*
+ * Copyright (C) 2001-2004,2009,2010 Red Hat, Inc.
+ * Copyright © 2008, 2009, 2010 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <math.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "emulation.hh"
+#include "ascii.hh"
+#include "debug.h"
+#include "unicode-width.hh"
+
+#include <algorithm>
+
+uint64_t g_test_flags = 0;
+
+namespace vte {
+namespace terminal {
+
+/* What the emulation reports to until it has its sink, and without one */
+static Emulation::Sink s_null_sink{};
+
+Emulation::Emulation(Sink* sink) :
+        m_sink(&s_null_sink),
+        m_normal_screen(VTE_SCROLLBACK_INIT, true),
+        m_alternate_screen(VTE_ROWS, false),
+        m_screen(&m_normal_screen)
+{
+        if (G_UNLIKELY(_vte_debug_on(VTE_DEBUG_DISPATCH)))
+                m_dispatch_profiler = std::make_unique<vte::terminal::DispatchProfiler>();
+
+        reset_default_attributes(true);
+
+        /* Initialize charset modes. */
+        m_character_replacements[0] = VTE_CHARACTER_REPLACEMENT_NONE;
+        m_character_replacements[1] = VTE_CHARACTER_REPLACEMENT_NONE;
+        m_character_replacement = &m_character_replacements[0];
+
+	/* Set up the desired palette. */
+	set_colors_default();
+	for (auto i = 0; i < VTE_PALETTE_SIZE; i++)
+		m_palette[i].sources[VTE_COLOR_SOURCE_ESCAPE].is_set = FALSE;
+
+        /* Initialize the saved cursor. */
+        save_cursor(&m_normal_screen);
+        save_cursor(&m_alternate_screen);
+
+        m_scrollback_lines = -1; /* force update in set_scrollback_lines */
+	set_scrollback_lines(VTE_SCROLLBACK_INIT);
+
+        /* Not before now: while we're constructing, the sink may still be
+         * under construction too, like when it's the Terminal deriving from us.
+         */
+        set_sink(sink);
+}
+
+Emulation::~Emulation() = default;
+
+void
+Emulation::set_sink(Sink* sink) noexcept
+{
+        m_sink = sink ? sink : &s_null_sink;
+}
+
+// FIXMEchpe replace this with a method on VteRing
+VteRowData*
+Emulation::ring_insert(vte::grid::row_t position,
+                                bool fill)
+{
+	VteRowData *row;
+	VteRing *ring = m_screen->row_data;
+        bool const not_default_bg = (m_fill_defaults.attr.back() != VTE_DEFAULT_BG);
+
+	while (G_UNLIKELY (_vte_ring_next (ring) < position)) {
+		row = _vte_ring_append (ring);
+                if (not_default_bg)
+                        _vte_row_data_fill (row, &m_fill_defaults, m_column_count);
+	}
+	row = _vte_ring_insert (ring, position);
+        if (fill && not_default_bg)
+                _vte_row_data_fill (row, &m_fill_defaults, m_column_count);
+	return row;
+}
+
+// FIXMEchpe replace this with a method on VteRing
+VteRowData*
+Emulation::ring_append(bool fill)
+{
+	return ring_insert(_vte_ring_next(m_screen->row_data), fill);
+}
+
+// FIXMEchpe replace this with a method on VteRing
+void
+Emulation::ring_remove(vte::grid::row_t position)
+{
+	_vte_ring_remove(m_screen->row_data, position);
+}
+
+/* Scrolls the rows from @start to @end (inclusive) by @count, down if
+ * positive; the rows scrolled in are blank, like with ring_insert(..., true).
+ */
+void
+Emulation::ring_rotate(vte::grid::row_t start,
+                      vte::grid::row_t end,
+                      vte::grid::row_t count)
+{
+	VteRing *ring = m_screen->row_data;
+
+        while (_vte_ring_next(ring) <= end)
+                ring_append(false);
+
+        _vte_ring_rotate(ring, start, end, count);
+
+        if (m_fill_defaults.attr.back() != VTE_DEFAULT_BG) {
+                auto const n = MIN(ABS(count), end - start + 1);
+                auto const first = count > 0 ? start : end + 1 - n;
+                for (auto i = first; i < first + n; i++)
+                        _vte_row_data_fill(_vte_ring_index_writable(ring, i),
+                                           &m_fill_defaults, m_column_count);
+        }
+}
+
+/* Reset defaults for character insertion. */
+void
+Emulation::reset_default_attributes(bool reset_hyperlink)
+{
+        auto const hyperlink_idx_save = m_defaults.attr.hyperlink_idx;
+        m_defaults = m_color_defaults = m_fill_defaults = basic_cell;
+        if (!reset_hyperlink)
+                m_defaults.attr.hyperlink_idx = hyperlink_idx_save;
+}
+
+/* Find the row in the given position in the backscroll buffer.
+ * Note that calling this method may invalidate the return value of
+ * a previous find_row_data() call. */
+// FIXMEchpe replace this with a method on VteRing
+VteRowData const*
+Emulation::find_row_data(vte::grid::row_t row) const
+{
+	VteRowData const* rowdata = nullptr;
+
+	if (G_LIKELY(_vte_ring_contains(m_screen->row_data, row))) {
+		rowdata = _vte_ring_index(m_screen->row_data, row);
+	}
+	return rowdata;
+}
+
+/* Find the row in the given position in the backscroll buffer. */
+// FIXMEchpe replace this with a method on VteRing
+VteRowData*
+Emulation::find_row_data_writable(vte::grid::row_t row) const
+{
+	VteRowData *rowdata = nullptr;
+
+	if (G_LIKELY (_vte_ring_contains(m_screen->row_data, row))) {
+		rowdata = _vte_ring_index_writable(m_screen->row_data, row);
+	}
+	return rowdata;
+}
+
+/* Find the character an the given position in the backscroll buffer.
+ * Note that calling this method may invalidate the return value of
+ * a previous find_row_data() call. */
+// FIXMEchpe replace this with a method on VteRing
+VteCell const*
+Emulation::find_charcell(vte::grid::column_t col,
+                                  vte::grid::row_t row) const
+{
+	VteRowData const* rowdata;
+	VteCell const* ret = nullptr;
+
+	if (_vte_ring_contains(m_screen->row_data, row)) {
+		rowdata = _vte_ring_index(m_screen->row_data, row);
+		ret = _vte_row_data_get (rowdata, col);
+	}
+	return ret;
+}
+
+// FIXMEchpe replace this with a method on VteRing
+vte::grid::column_t
+Emulation::find_start_column(vte::grid::column_t col,
+                                      vte::grid::row_t row) const
+{
+	VteRowData const* row_data = find_row_data(row);
+	if (G_UNLIKELY (col < 0))
+		return col;
+	if (row_data != nullptr) {
+		const VteCell *cell = _vte_row_data_get (row_data, col);
+		while (col > 0 && cell != NULL && cell->attr.fragment()) {
+			cell = _vte_row_data_get (row_data, --col);
+		}
+	}
+	return MAX(col, 0);
+}
+
+// FIXMEchpe replace this with a method on VteRing
+vte::grid::column_t
+Emulation::find_end_column(vte::grid::column_t col,
+                                    vte::grid::row_t row) const
+{
+	VteRowData const* row_data = find_row_data(row);
+	gint columns = 0;
+	if (G_UNLIKELY (col < 0))
+		return col;
+	if (row_data != NULL) {
+		const VteCell *cell = _vte_row_data_get (row_data, col);
+		while (col > 0 && cell != NULL && cell->attr.fragment()) {
+			cell = _vte_row_data_get (row_data, --col);
+		}
+		if (cell) {
+			columns = cell->attr.columns() - 1;
+		}
+	}
+        // FIXMEchp m__column_count - 1 ?
+	return MIN(col + columns, m_column_count);
+}
+
+/* Scrolls the view, which is up to the sink to show */
+void
+Emulation::set_scroll_delta(double v)
+{
+	if (_vte_double_equal(v, m_screen->scroll_delta))
+                return;
+
+        m_screen->scroll_delta = v;
+        m_sink->scroll_delta_changed();
+}
+
+void
+Emulation::adjust_adjustments()
+{
+	g_assert(m_screen != nullptr);
+	g_assert(m_screen->row_data != nullptr);
+
+	m_sink->queue_adjustment_changed();
+
+	/* The lower value should be the first row in the buffer. */
+	long delta = _vte_ring_delta(m_screen->row_data);
+	/* Snap the insert delta and the cursor position to be in the visible
+	 * area.  Leave the scrolling delta alone because it will be updated
+	 * when the adjustment changes. */
+	m_screen->insert_delta = MAX(m_screen->insert_delta, delta);
+        m_screen->cursor.row = MAX(m_screen->cursor.row,
+                                   m_screen->insert_delta);
+
+	if (m_screen->scroll_delta > m_screen->insert_delta) {
+		set_scroll_delta(m_screen->insert_delta);
+	}
+}
+
+/* Update the adjustment field of the widget.  This function should be called
+ * whenever we add rows to or remove rows from the history or switch screens. */
+void
+Emulation::adjust_adjustments_full()
+{
+	g_assert(m_screen != NULL);
+	g_assert(m_screen->row_data != NULL);
+
+	adjust_adjustments();
+	m_sink->queue_adjustment_changed();
+}
+
+bool
+Emulation::set_cjk_ambiguous_width(int width)
+{
+        g_assert(width == 1 || width == 2);
+
+        if (m_utf8_ambiguous_width == width)
+                return false;
+
+        m_utf8_ambiguous_width = width;
+        return true;
+}
+
+/* Make sure we have enough rows and columns to hold data at the current
+ * cursor position. */
+VteRowData *
+Emulation::ensure_row()
+{
+	VteRowData *row;
+
+	/* Figure out how many rows we need to add. */
+        //FIXMEchpe use long, not int
+	int delta = m_screen->cursor.row - _vte_ring_next(m_screen->row_data) + 1;
+	if (delta > 0) {
+		row = insert_rows(delta);
+		adjust_adjustments();
+	} else {
+		/* Find the row the cursor is in. */
+		row = _vte_ring_index_writable(m_screen->row_data, m_screen->cursor.row);
+	}
+	g_assert(row != NULL);
+
+	return row;
+}
+
+VteRowData *
+Emulation::ensure_cursor()
+{
+	VteRowData *row = ensure_row();
+        _vte_row_data_fill(row, &basic_cell, m_screen->cursor.col);
+
+	return row;
+}
+
+/* Update the insert delta so that the screen which includes it also
+ * includes the end of the buffer. */
+void
+Emulation::update_insert_delta()
+{
+	/* The total number of lines.  Add one to the cursor offset
+	 * because it's zero-based. */
+	auto rows = _vte_ring_next(m_screen->row_data);
+        auto delta = m_screen->cursor.row - rows + 1;
+	if (G_UNLIKELY (delta > 0)) {
+		insert_rows(delta);
+		rows = _vte_ring_next(m_screen->row_data);
+	}
+
+	/* Make sure that the bottom row is visible, and that it's in
+	 * the buffer (even if it's empty).  This usually causes the
+	 * top row to become a history-only row. */
+	delta = m_screen->insert_delta;
+	delta = MIN(delta, rows - m_row_count);
+	delta = MAX(delta,
+                    m_screen->cursor.row - (m_row_count - 1));
+	delta = MAX(delta, _vte_ring_delta(m_screen->row_data));
+
+	/* Adjust the insert delta and scroll if needed. */
+	if (delta != m_screen->insert_delta) {
+		m_screen->insert_delta = delta;
+		adjust_adjustments();
+	}
+}
+
+/*
+ * Get the actually used color from the palette.
+ * The return value can be NULL only if entry is one of VTE_CURSOR_BG,
+ * VTE_CURSOR_FG, VTE_HIGHLIGHT_BG or VTE_HIGHLIGHT_FG.
+ */
+vte::color::rgb const*
+Emulation::get_color(int entry) const
+{
+	VtePaletteColor const* palette_color = &m_palette[entry];
+	guint source;
+	for (source = 0; source < G_N_ELEMENTS(palette_color->sources); source++)
+		if (palette_color->sources[source].is_set)
+			return &palette_color->sources[source].color;
+	return nullptr;
+}
+
+/* Set up a palette entry with a more-or-less match for the requested color. */
+void
+Emulation::set_color(int entry,
+                              int source,
+                              vte::color::rgb const& proposed)
+{
+        g_assert(entry >= 0 && entry < VTE_PALETTE_SIZE);
+
+	VtePaletteColor *palette_color = &m_palette[entry];
+
+        _vte_debug_print(VTE_DEBUG_MISC,
+                         "Set %s color[%d] to (%04x,%04x,%04x).\n",
+                         source == VTE_COLOR_SOURCE_ESCAPE ? "escape" : "API",
+                         entry, proposed.red, proposed.green, proposed.blue);
+
+        if (palette_color->sources[source].is_set &&
+            palette_color->sources[source].color == proposed) {
+                return;
+        }
+        palette_color->sources[source].is_set = TRUE;
+        palette_color->sources[source].color = proposed;
+
+	/* and redraw */
+	if (entry == VTE_CURSOR_BG || entry == VTE_CURSOR_FG)
+		m_sink->invalidate_cursor_once();
+	else
+		m_sink->invalidate_all();
+}
+
+void
+Emulation::reset_color(int entry,
+                                int source)
+{
+        g_assert(entry >= 0 && entry < VTE_PALETTE_SIZE);
+
+	VtePaletteColor *palette_color = &m_palette[entry];
+
+        _vte_debug_print(VTE_DEBUG_MISC,
+                         "Reset %s color[%d].\n",
+                         source == VTE_COLOR_SOURCE_ESCAPE ? "escape" : "API",
+                         entry);
+
+        if (!palette_color->sources[source].is_set) {
+                return;
+        }
+        palette_color->sources[source].is_set = FALSE;
+
+	/* and redraw */
+	if (entry == VTE_CURSOR_BG || entry == VTE_CURSOR_FG)
+		m_sink->invalidate_cursor_once();
+	else
+		m_sink->invalidate_all();
+}
+
+void
+Emulation::set_colors_default()
+{
+        set_colors(nullptr, nullptr, nullptr, 0);
+}
+
+/*
+ * Emulation::set_colors:
+ * @terminal: a #VteTerminal
+ * @foreground: (allow-none): the new foreground color, or %NULL
+ * @background: (allow-none): the new background color, or %NULL
+ * @palette: (array length=palette_size zero-terminated=0): the color palette
+ * @palette_size: the number of entries in @palette
+ *
+ * @palette specifies the new values for the 256 palette colors: 8 standard colors,
+ * their 8 bright counterparts, 6x6x6 color cube, and 24 grayscale colors.
+ * Omitted entries will default to a hardcoded value.
+ *
+ * @palette_size must be 0, 8, 16, 232 or 256.
+ *
+ * If @foreground is %NULL and @palette_size is greater than 0, the new foreground
+ * color is taken from @palette[7].  If @background is %NULL and @palette_size is
+ * greater than 0, the new background color is taken from @palette[0].
+ */
+void
+Emulation::set_colors(vte::color::rgb const* foreground,
+                               vte::color::rgb const* background,
+                               vte::color::rgb const* new_palette,
+                               gsize palette_size)
+{
+	_vte_debug_print(VTE_DEBUG_MISC,
+			"Set color palette [%" G_GSIZE_FORMAT " elements].\n",
+			palette_size);
+
+	/* Accept NULL as the default foreground and background colors if we
+	 * got a palette. */
+	if ((foreground == NULL) && (palette_size >= 8)) {
+		foreground = &new_palette[7];
+	}
+	if ((background == NULL) && (palette_size >= 8)) {
+		background = &new_palette[0];
+	}
+
+	/* Initialize each item in the palette if we got any entries to work
+	 * with. */
+	for (gsize i = 0; i < G_N_ELEMENTS(m_palette); i++) {
+                vte::color::rgb color;
+		bool unset = false;
+
+		if (i < 16) {
+			color.blue = (i & 4) ? 0xc000 : 0;
+			color.green = (i & 2) ? 0xc000 : 0;
+			color.red = (i & 1) ? 0xc000 : 0;
+			if (i > 7) {
+				color.blue += 0x3fff;
+				color.green += 0x3fff;
+				color.red += 0x3fff;
+			}
+		}
+		else if (i < 232) {
+			int j = i - 16;
+			int r = j / 36, g = (j / 6) % 6, b = j % 6;
+			int red =   (r == 0) ? 0 : r * 40 + 55;
+			int green = (g == 0) ? 0 : g * 40 + 55;
+			int blue =  (b == 0) ? 0 : b * 40 + 55;
+			color.red   = red | red << 8  ;
+			color.green = green | green << 8;
+			color.blue  = blue | blue << 8;
+		} else if (i < 256) {
+			int shade = 8 + (i - 232) * 10;
+			color.red = color.green = color.blue = shade | shade << 8;
+		}
+		else switch (i) {
+			case VTE_DEFAULT_BG:
+				if (background) {
+					color = *background;
+				} else {
+					color.red = 0;
+					color.blue = 0;
+					color.green = 0;
+				}
+				break;
+			case VTE_DEFAULT_FG:
+				if (foreground) {
+					color = *foreground;
+				} else {
+					color.red = 0xc000;
+					color.blue = 0xc000;
+					color.green = 0xc000;
+				}
+				break;
+			case VTE_BOLD_FG:
+                                unset = true;
+                                break;
+			case VTE_HIGHLIGHT_BG:
+				unset = true;
+				break;
+			case VTE_HIGHLIGHT_FG:
+				unset = true;
+				break;
+			case VTE_CURSOR_BG:
+				unset = true;
+				break;
+			case VTE_CURSOR_FG:
+				unset = true;
+				break;
+			}
+
+		/* Override from the supplied palette if there is one. */
+		if (i < palette_size) {
+			color = new_palette[i];
+		}
+
+		/* Set up the color entry. */
+                if (unset)
+                        reset_color(i, VTE_COLOR_SOURCE_API);
+                else
+                        set_color(i, VTE_COLOR_SOURCE_API, color);
+	}
+}
+
+/*
+ * Emulation::cleanup_fragments:
+ * @start: the starting column, inclusive
+ * @end: the end column, exclusive
+ *
+ * Needs to be called before modifying the contents in the cursor's row,
+ * between the two given columns.  Cleans up TAB and CJK fragments to the
+ * left of @start and to the right of @end.  If a CJK is split in half,
+ * the remaining half is replaced by a space.  If a TAB at @start is split,
+ * it is replaced by spaces.  If a TAB at @end is split, it is replaced by
+ * a shorter TAB.  @start and @end can be equal if characters will be
+ * inserted at the location rather than overwritten.
+ *
+ * The area between @start and @end is not cleaned up, hence the whole row
+ * can be left in an inconsistent state.  It is expected that the caller
+ * will fill up that range afterwards, resulting in a consistent row again.
+ *
+ * Invalidates the cells that visually change outside of the range,
+ * because the caller can't reasonably be expected to take care of this.
+ */
+void
+Emulation::cleanup_fragments(long start,
+                                      long end)
+{
+        VteRowData *row = ensure_row();
+        const VteCell *cell_start;
+        VteCell *cell_end, *cell_col;
+        gboolean cell_start_is_fragment;
+        long col;
+
+        g_assert(end >= start);
+
+        /* Remember whether the cell at start is a fragment.  We'll need to know it when
+         * handling the left hand side, but handling the right hand side first might
+         * overwrite it if start == end (inserting to the middle of a character). */
+        cell_start = _vte_row_data_get (row, start);
+        cell_start_is_fragment = cell_start != NULL && cell_start->attr.fragment();
+
+        /* On the right hand side, try to replace a TAB by a shorter TAB if we can.
+         * This requires that the TAB on the left (which might be the same TAB) is
+         * not yet converted to spaces, so start on the right hand side. */
+        cell_end = _vte_row_data_get_writable (row, end);
+        if (G_UNLIKELY (cell_end != NULL && cell_end->attr.fragment())) {
+                col = end;
+                do {
+                        col--;
+                        g_assert(col >= 0);  /* The first cell can't be a fragment. */
+                        cell_col = _vte_row_data_get_writable (row, col);
+                } while (cell_col->attr.fragment());
+                if (cell_col->c == '\t') {
+                        _vte_debug_print(VTE_DEBUG_MISC,
+                                         "Replacing right part of TAB with a shorter one at %ld (%ld cells) => %ld (%ld cells)\n",
+                                         col, (long) cell_col->attr.columns(), end, (long) cell_col->attr.columns() - (end - col));
+                        cell_end->c = '\t';
+                        cell_end->attr.set_fragment(false);
+                        g_assert(cell_col->attr.columns() > end - col);
+                        cell_end->attr.set_columns(cell_col->attr.columns() - (end - col));
+                } else {
+                        _vte_debug_print(VTE_DEBUG_MISC,
+                                         "Cleaning CJK right half at %ld\n",
+                                         end);
+                        g_assert(end - col == 1 && cell_col->attr.columns() == 2);
+                        cell_end->c = ' ';
+                        cell_end->attr.set_fragment(false);
+                        cell_end->attr.set_columns(1);
+                        m_sink->invalidate_row(m_screen->cursor.row);
+                }
+        }
+
+        /* Handle the left hand side.  Converting longer TABs to shorter ones probably
+         * wouldn't make that much sense here, so instead convert to spaces. */
+        if (G_UNLIKELY (cell_start_is_fragment)) {
+                gboolean keep_going = TRUE;
+                col = start;
+                do {
+                        col--;
+                        g_assert(col >= 0);  /* The first cell can't be a fragment. */
+                        cell_col = _vte_row_data_get_writable (row, col);
+                        if (!cell_col->attr.fragment()) {
+                                if (cell_col->c == '\t') {
+                                        _vte_debug_print(VTE_DEBUG_MISC,
+                                                         "Replacing left part of TAB with spaces at %ld (%ld => %ld cells)\n",
+                                                         col, (long)cell_col->attr.columns(), start - col);
+                                        /* nothing to do here */
+                                } else {
+                                        _vte_debug_print(VTE_DEBUG_MISC,
+                                                         "Cleaning CJK left half at %ld\n",
+                                                         col);
+                                        g_assert(start - col == 1);
+                                        m_sink->invalidate_row(m_screen->cursor.row);
+                                }
+                                keep_going = FALSE;
+                        }
+                        cell_col->c = ' ';
+                        cell_col->attr.set_fragment(false);
+                        cell_col->attr.set_columns(1);
+                } while (keep_going);
+        }
+}
+
+/* Cursor down, with scrolling. */
+void
+Emulation::cursor_down(bool explicit_sequence)
+{
+	long start, end;
+
+        if (m_scrolling_restricted) {
+                start = m_screen->insert_delta + m_scrolling_region.start;
+                end = m_screen->insert_delta + m_scrolling_region.end;
+	} else {
+		start = m_screen->insert_delta;
+		end = start + m_row_count - 1;
+	}
+        if (m_screen->cursor.row == end) {
+                if (m_scrolling_restricted) {
+			if (start == m_screen->insert_delta) {
+				/* Scroll this line into the scrollback
+				 * buffer by inserting a line at the next
+				 * line and scrolling the area up. */
+				m_screen->insert_delta++;
+                                m_screen->cursor.row++;
+				/* update start and end, as they are relative
+				 * to insert_delta. */
+				start++;
+				end++;
+                                ring_insert(m_screen->cursor.row, false);
+				/* Force the areas below the region to be
+				 * redrawn -- they've moved. */
+                                m_sink->invalidate_rows(start, end);
+				/* Force scroll. */
+				adjust_adjustments();
+			} else {
+				/* If we're at the bottom of the scrolling
+				 * region, add a line at the top to scroll the
+				 * bottom off. */
+				ring_rotate(start, end, -1);
+				/* Update the display. */
+                                m_sink->invalidate_rows(start, end);
+			}
+		} else {
+			/* Scroll up with history. */
+                        m_screen->cursor.row++;
+			update_insert_delta();
+		}
+
+                /* Handle bce (background color erase), however, diverge from xterm:
+                 * only fill the new row with the background color if scrolling
+                 * happens due to an explicit escape sequence, not due to autowrapping.
+                 * See bug 754596 for details. */
+                bool const not_default_bg = (m_fill_defaults.attr.back() != VTE_DEFAULT_BG);
+
+                if (explicit_sequence && not_default_bg) {
+			VteRowData *rowdata = ensure_row();
+                        _vte_row_data_fill (rowdata, &m_fill_defaults, m_column_count);
+		}
+	} else {
+		/* Otherwise, just move the cursor down. */
+                m_screen->cursor.row++;
+	}
+}
+
+/* Drop the scrollback. */
+void
+Emulation::drop_scrollback()
+{
+        /* Only for normal screen; alternate screen doesn't have a scrollback. */
+        _vte_ring_drop_scrollback (m_normal_screen.row_data,
+                                   m_normal_screen.insert_delta);
+
+        if (m_screen == &m_normal_screen) {
+                set_scroll_delta(m_normal_screen.insert_delta);
+                adjust_adjustments_full();
+        }
+}
+
+/* Restore cursor on a screen. */
+void
+Emulation::restore_cursor(VteScreen *screen__)
+{
+        screen__->cursor.col = screen__->saved.cursor.col;
+        screen__->cursor.row = screen__->insert_delta + CLAMP(screen__->saved.cursor.row,
+                                                              0, m_row_count - 1);
+
+        m_modes_ecma.set_modes(screen__->saved.modes_ecma);
+
+        m_modes_private.set_DEC_REVERSE_IMAGE(screen__->saved.reverse_mode);
+        m_modes_private.set_DEC_ORIGIN(screen__->saved.origin_mode);
+
+        m_defaults = screen__->saved.defaults;
+        m_color_defaults = screen__->saved.color_defaults;
+        m_fill_defaults = screen__->saved.fill_defaults;
+        m_character_replacements[0] = screen__->saved.character_replacements[0];
+        m_character_replacements[1] = screen__->saved.character_replacements[1];
+        m_character_replacement = screen__->saved.character_replacement;
+}
+
+/* Save cursor on a screen__. */
+void
+Emulation::save_cursor(VteScreen *screen__)
+{
+        screen__->saved.cursor.col = screen__->cursor.col;
+        screen__->saved.cursor.row = screen__->cursor.row - screen__->insert_delta;
+
+        screen__->saved.modes_ecma = m_modes_ecma.get_modes();
+
+        screen__->saved.reverse_mode = m_modes_private.DEC_REVERSE_IMAGE();
+        screen__->saved.origin_mode = m_modes_private.DEC_ORIGIN();
+
+        screen__->saved.defaults = m_defaults;
+        screen__->saved.color_defaults = m_color_defaults;
+        screen__->saved.fill_defaults = m_fill_defaults;
+        screen__->saved.character_replacements[0] = m_character_replacements[0];
+        screen__->saved.character_replacements[1] = m_character_replacements[1];
+        screen__->saved.character_replacement = m_character_replacement;
+}
+
+/* DEC Special Character and Line Drawing Set.  VT100 and higher (per XTerm docs). */
+static gunichar const line_drawing_map[31] = {
+        0x25c6,  /* ` => diamond */
+        0x2592,  /* a => checkerboard */
+        0x2409,  /* b => HT symbol */
+        0x240c,  /* c => FF symbol */
+        0x240d,  /* d => CR symbol */
+        0x240a,  /* e => LF symbol */
+        0x00b0,  /* f => degree */
+        0x00b1,  /* g => plus/minus */
+        0x2424,  /* h => NL symbol */
+        0x240b,  /* i => VT symbol */
+        0x2518,  /* j => downright corner */
+        0x2510,  /* k => upright corner */
+        0x250c,  /* l => upleft corner */
+        0x2514,  /* m => downleft corner */
+        0x253c,  /* n => cross */
+        0x23ba,  /* o => scan line 1/9 */
+        0x23bb,  /* p => scan line 3/9 */
+        0x2500,  /* q => horizontal line (also scan line 5/9) */
+        0x23bc,  /* r => scan line 7/9 */
+        0x23bd,  /* s => scan line 9/9 */
+        0x251c,  /* t => left t */
+        0x2524,  /* u => right t */
+        0x2534,  /* v => bottom t */
+        0x252c,  /* w => top t */
+        0x2502,  /* x => vertical line */
+        0x2264,  /* y => <= */
+        0x2265,  /* z => >= */
+        0x03c0,  /* { => pi */
+        0x2260,  /* | => not equal */
+        0x00a3,  /* } => pound currency sign */
+        0x00b7,  /* ~ => bullet */
+};
+
+/* If we've enabled the special drawing set, map the characters to
+ * Unicode. */
+inline gunichar
+Emulation::map_graphic_character(gunichar c) const noexcept
+{
+        if (G_UNLIKELY (*m_character_replacement == VTE_CHARACTER_REPLACEMENT_LINE_DRAWING)) {
+                if (c >= 96 && c <= 126)
+                        c = line_drawing_map[c - 96];
+        } else if (G_UNLIKELY (*m_character_replacement == VTE_CHARACTER_REPLACEMENT_BRITISH)) {
+                if (G_UNLIKELY (c == '#'))
+                        c = 0x00a3;  /* pound sign */
+        }
+
+        return c;
+}
+
+/* Insert a single character into the stored data array. */
+void
+Emulation::insert_char(gunichar c,
+                                bool insert,
+                                bool invalidate_now)
+{
+        insert_chars(&c, 1, insert, invalidate_now);
+}
+
+/* Combine a mark with the previous character. */
+void
+Emulation::insert_combining_mark(gunichar c)
+{
+	VteRowData *row;
+	long row_num;
+	long col;
+	VteCell *cell;
+	int columns, i;
+
+	_vte_debug_print(VTE_DEBUG_PARSER, "combining U+%04X", c);
+
+        col = m_screen->cursor.col;
+        row_num = m_screen->cursor.row;
+	row = NULL;
+	if (G_UNLIKELY (col == 0)) {
+		/* We are at first column.  See if the previous line softwrapped.
+		 * If it did, move there.  Otherwise skip inserting. */
+
+		if (G_LIKELY (row_num > 0)) {
+			row_num--;
+			row = find_row_data_writable(row_num);
+
+			if (row) {
+				if (!row->attr.soft_wrapped)
+					row = NULL;
+				else
+					col = _vte_row_data_length (row);
+			}
+		}
+	} else {
+		row = find_row_data_writable(row_num);
+	}
+
+	if (G_UNLIKELY (!row || !col))
+		return;
+
+	/* Combine it on the previous cell */
+
+	col--;
+	cell = _vte_row_data_get_writable (row, col);
+
+	if (G_UNLIKELY (!cell))
+		return;
+
+	/* Find the previous cell */
+	while (cell && cell->attr.fragment() && col > 0)
+		cell = _vte_row_data_get_writable (row, --col);
+	if (G_UNLIKELY (!cell || cell->c == '\t'))
+		return;
+
+	/* Combine the new character on top of the cell string */
+	c = _vte_unistr_append_unichar (cell->c, c);
+
+	/* And set it */
+	columns = cell->attr.columns();
+	for (i = 0; i < columns; i++) {
+		cell = _vte_row_data_get_writable (row, col++);
+		cell->c = c;
+	}
+
+	/* Always invalidate since we put the mark on the *previous* cell
+	 * and the higher level code doesn't know this. */
+        // FIXMEegmont could this be cleaned up now that we invalidate rows?
+        m_sink->invalidate_row(row_num);
+
+	/* We added text, so make a note of it. */
+	m_text_inserted_flag = TRUE;
+}
+
+/*
+ * Emulation::insert_chars:
+ * @chars: the characters to insert
+ * @n_chars: the number of characters, at least 1
+ * @insert: whether to shift the row's contents right, rather than overwrite them
+ * @invalidate_now: whether to invalidate the row right away
+ *
+ * Inserts a run of characters at the cursor, as many of them as fit
+ * into the cursor's row, autowrapping first if the cursor is past the
+ * end of the row. The characters are mapped and their widths classified
+ * up front, and then the row's fragments are cleaned up once and its
+ * cells filled in one go.
+ *
+ * A combining mark or NUL ends the run; if it's the first character,
+ * it's handled on its own.
+ *
+ * Call again with the rest of the characters until all are consumed;
+ * in between, check m_line_wrapped to update the invalidation bbox.
+ *
+ * Returns: the number of characters consumed
+ */
+template<typename T>
+size_t
+Emulation::insert_chars(T const* chars,
+                       size_t n_chars,
+                       bool insert,
+                       bool invalidate_now)
+{
+        g_assert(n_chars > 0);
+
+        insert |= m_modes_ecma.IRM();
+	invalidate_now |= insert;
+
+        gunichar mapped[k_insert_chars_max];
+        uint8_t widths[k_insert_chars_max];
+
+        auto n = std::min(n_chars, k_insert_chars_max);
+        for (size_t i = 0; i < n; ++i)
+                mapped[i] = map_graphic_character(chars[i]);
+        vte::base::unichar_widths(mapped, n, m_utf8_ambiguous_width, widths);
+
+        size_t i;
+        for (i = 0; i < n; ++i) {
+                if (G_UNLIKELY(widths[i] == 0 || mapped[i] == 0))
+                        break;
+        }
+
+        if (G_UNLIKELY(i == 0)) {
+                //FIXMEchpe
+                if (chars[0] != 0)
+                        insert_combining_mark(map_graphic_character(chars[0]));
+
+                m_line_wrapped = false;
+                return 1;
+        }
+        n = i;
+
+	bool line_wrapped = false; /* cursor moved before chars inserted */
+
+	/* If we're autowrapping here, do it. */
+        long col = m_screen->cursor.col;
+	if (G_UNLIKELY (col + widths[0] > m_column_count)) {
+		if (m_modes_private.DEC_AUTOWRAP()) {
+			_vte_debug_print(VTE_DEBUG_ADJ,
+					"Autowrapping before character\n");
+			/* Wrap. */
+			/* XXX clear to the end of line */
+                        col = m_screen->cursor.col = 0;
+			/* Mark this line as soft-wrapped. */
+			auto row = ensure_row();
+			row->attr.soft_wrapped = 1;
+                        cursor_down(false);
+		} else {
+			/* Don't wrap, stay at the rightmost column. */
+                        col = m_screen->cursor.col =
+				m_column_count - widths[0];
+                        n = 1;
+		}
+		line_wrapped = true;
+	}
+
+        /* How many fit into the row; at least one, as before the
+         * wrapping, even if it's wider than the row.
+         */
+        long columns = widths[0];
+        for (i = 1; i < n && col + columns + widths[i] <= m_column_count; ++i)
+                columns += widths[i];
+        n = i;
+
+	_vte_debug_print(VTE_DEBUG_PARSER,
+			"Inserting %zu characters U+%04X... (colors %" G_GUINT64_FORMAT ") (%ld+%ld, %ld), delta = %ld; ",
+                         n, (unsigned int)mapped[0],
+                         m_color_defaults.attr.colors(),
+                         col, columns, (long)m_screen->cursor.row,
+                         (long)m_screen->insert_delta);
+
+        m_last_graphic_character = chars[n - 1];
+
+	/* Make sure we have enough rows to hold this data. */
+	auto row = ensure_cursor();
+	g_assert(row != NULL);
+
+	if (insert) {
+                cleanup_fragments(col, col);
+                _vte_row_data_insert_n(row, col, &m_color_defaults, columns);
+	} else {
+                cleanup_fragments(col, col + columns);
+		_vte_row_data_fill (row, &basic_cell, col + columns);
+	}
+
+        auto attr = m_defaults.attr;
+        attr.copy_colors(m_color_defaults.attr);
+
+        auto cell = _vte_row_data_get_writable(row, col);
+        g_assert(cell != nullptr);
+        for (i = 0; i < n; ++i) {
+                auto const c = mapped[i];
+                auto const w = widths[i];
+
+                attr.set_columns(w);
+                attr.set_fragment(false);
+                cell->c = c;
+                cell->attr = attr;
+                ++cell;
+
+                /* insert wide-char fragments */
+                if (G_UNLIKELY(w > 1)) {
+                        attr.set_fragment(true);
+                        for (auto j = 1; j < w; ++j) {
+                                cell->c = c;
+                                cell->attr = attr;
+                                ++cell;
+                        }
+                }
+        }
+        col += columns;
+
+	if (_vte_row_data_length (row) > m_column_count)
+		cleanup_fragments(m_column_count, _vte_row_data_length (row));
+	_vte_row_data_shrink (row, m_column_count);
+
+	/* Signal that this part of the window needs drawing. */
+	if (G_UNLIKELY (invalidate_now)) {
+                m_sink->invalidate_row(m_screen->cursor.row);
+	}
+
+        m_screen->cursor.col = col;
+
+	/* We added text, so make a note of it. */
+	m_text_inserted_flag = TRUE;
+
+	_vte_debug_print(VTE_DEBUG_ADJ|VTE_DEBUG_PARSER,
+			"insertion delta => %ld.\n",
+			(long)m_screen->insert_delta);
+
+        m_line_wrapped = line_wrapped;
+
+        return n;
+}
+
+template size_t Emulation::insert_chars<uint8_t>(uint8_t const*, size_t, bool, bool);
+template size_t Emulation::insert_chars<gunichar>(gunichar const*, size_t, bool, bool);
+
+#ifdef WITH_ICONV
+
+void
+Emulation::convert_incoming() noexcept
+{
+        /* Convert chunk by chunk into new chunks; the decoder keeps
+         * any character split between two chunks until the next one.
+         */
+        decltype(m_incoming_queue) input;
+        input.swap(m_incoming_queue);
+        m_incoming_bytes = 0;
+
+        vte::base::Chunk* outchunk = nullptr;
+        while (!input.empty()) {
+                auto chunk = std::move(input.front());
+                input.pop();
+
+                _VTE_DEBUG_IF(VTE_DEBUG_IO) {
+                        _vte_debug_hexdump("Incoming buffer before conversion to UTF-8",
+                                           chunk->data, chunk->len);
+                }
+
+                uint8_t const* inbuf = chunk->data;
+                auto const inbuf_end = inbuf + chunk->len;
+                while (inbuf < inbuf_end) {
+                        if (outchunk == nullptr ||
+                            outchunk->remaining_capacity() < vte::base::CharsetDecoder::k_min_output) {
+                                m_incoming_queue.push(vte::base::Chunk::get());
+                                outchunk = m_incoming_queue.back().get();
+                        }
+
+                        auto const outbuf_start = outchunk->data + outchunk->len;
+                        auto outbuf = outbuf_start;
+                        m_incoming_decoder.convert(inbuf, inbuf_end,
+                                                   outbuf, outchunk->data + outchunk->capacity());
+
+                        auto const len = size_t(outbuf - outbuf_start);
+                        outchunk->len += len;
+                        m_incoming_bytes += len;
+
+                        /* Output chunk full? */
+                        if (inbuf < inbuf_end)
+                                outchunk = nullptr;
+                }
+        }
+}
+
+#endif /* WITH_ICONV */
+
+/*
+ * Emulation::process_incoming:
+ *
+ * Processes all the queued data, and reports the rows it changed to the
+ * sink, unless fast-forwarding.
+ *
+ * Returns: whether anything was processed that may have changed the screen
+ */
+bool
+Emulation::process_incoming()
+{
+        vte::grid::row_t bbox_top, bbox_bottom;
+	gboolean modified, bottom;
+	gboolean invalidated_text;
+	gboolean in_scroll_region;
+
+	_vte_debug_print(VTE_DEBUG_IO,
+                         "Handler processing %" G_GSIZE_FORMAT " bytes over %" G_GSIZE_FORMAT " chunks.\n",
+                         m_incoming_bytes,
+                         m_incoming_queue.size());
+	_vte_debug_print (VTE_DEBUG_WORK, "(");
+
+        bottom = m_screen->insert_delta == (long)m_screen->scroll_delta;
+
+        in_scroll_region = m_scrolling_restricted
+            && (m_screen->cursor.row >= (m_screen->insert_delta + m_scrolling_region.start))
+            && (m_screen->cursor.row <= (m_screen->insert_delta + m_scrolling_region.end));
+
+	/* We should only be called when there's data to process. */
+	g_assert(!m_incoming_queue.empty());
+
+#ifdef WITH_ICONV
+        /* If we're using a legacy encoding for I/O, we need to
+         * convert the input to UTF-8 now.
+         */
+        if (G_UNLIKELY(!m_using_utf8))
+                convert_incoming();
+#endif
+
+	modified = FALSE;
+	invalidated_text = FALSE;
+
+        bbox_bottom = -G_MAXINT;
+        bbox_top = G_MAXINT;
+
+        vte::parser::Sequence seq{m_parser};
+
+        m_line_wrapped = false;
+
+        /* See update_fast_forward() */
+        auto const fast_forward = m_fast_forward;
+
+        /* See dump_dispatch_profile() */
+        auto const profiler = m_dispatch_profiler.get();
+
+        size_t bytes_processed = 0;
+
+        /* Updates the bbox after inserting graphic characters */
+        auto graphic_inserted = [&]() {
+                if (m_line_wrapped) {
+                        m_line_wrapped = false;
+                        /* line wrapped, correct bbox */
+                        if (invalidated_text &&
+                            (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
+                             m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK)) {
+                                m_sink->invalidate_rows(bbox_top, bbox_bottom);
+                                bbox_bottom = -G_MAXINT;
+                                bbox_top = G_MAXINT;
+
+                        }
+                        bbox_top = std::min(bbox_top,
+                                            m_screen->cursor.row);
+                }
+                /* Add the cells over which we have moved to the region
+                 * which we need to refresh for the user. */
+                bbox_bottom = std::max(bbox_bottom,
+                                       m_screen->cursor.row);
+                invalidated_text = TRUE;
+
+                /* We *don't* emit flush pending signals here. */
+                modified = TRUE;
+        };
+
+        /* Inserts a run of graphic characters, a row at a time */
+        auto insert_graphic = [&](auto const* chars,
+                                  size_t n_chars) {
+                while (n_chars > 0) {
+                        if (G_UNLIKELY(fast_forward)) {
+                                /* Nothing to invalidate */
+                                auto const n = insert_chars(chars, n_chars, false, false);
+                                chars += n;
+                                n_chars -= n;
+                                m_line_wrapped = false;
+                                modified = TRUE;
+                                continue;
+                        }
+
+                        bbox_top = std::min(bbox_top,
+                                            m_screen->cursor.row);
+                        auto const n = insert_chars(chars, n_chars, false, false);
+                        chars += n;
+                        n_chars -= n;
+                        graphic_inserted();
+                }
+        };
+
+        gunichar graphic[k_insert_chars_max];
+        size_t n_graphic = 0;
+        auto flush_graphic = [&]() {
+                if (n_graphic == 0)
+                        return;
+
+                if (G_UNLIKELY(profiler != nullptr)) {
+                        auto n_bytes = size_t{0};
+                        for (size_t i = 0; i < n_graphic; ++i)
+                                n_bytes += g_unichar_to_utf8(graphic[i], nullptr);
+
+                        auto const start = profiler->now();
+                        insert_graphic(graphic, n_graphic);
+                        profiler->record_graphic(n_graphic, n_bytes, start);
+                } else {
+                        insert_graphic(graphic, n_graphic);
+                }
+                n_graphic = 0;
+        };
+
+        /* Dispatches a control sequence to its handler */
+        auto dispatch_sequence = [&](vte::parser::Sequence const& seq) {
+                switch (seq.command()) {
+#define _VTE_CMD(cmd)   case VTE_CMD_##cmd: cmd(seq); break;
+#define _VTE_NOP(cmd)
+#include "parser-cmd.hh"
+#undef _VTE_CMD
+#undef _VTE_NOP
+                default:
+                        _vte_debug_print(VTE_DEBUG_PARSER,
+                                         "Unknown parser command %d\n", seq.command());
+                        break;
+                }
+        };
+
+        /* Updates the bbox after dispatching a control sequence */
+        auto sequence_dispatched = [&]() {
+                m_last_graphic_character = 0;
+
+                modified = TRUE;
+
+                if (G_UNLIKELY(fast_forward))
+                        return;
+
+                // FIXME m_screen may be != previous_screen, check for that!
+
+                gboolean new_in_scroll_region = m_scrolling_restricted
+                        && (m_screen->cursor.row >= (m_screen->insert_delta + m_scrolling_region.start))
+                        && (m_screen->cursor.row <= (m_screen->insert_delta + m_scrolling_region.end));
+
+                /* if we have moved greatly during the sequence handler, or moved
+                 * into a scroll_region from outside it, restart the bbox.
+                 */
+                if (invalidated_text &&
+                    ((new_in_scroll_region && !in_scroll_region) ||
+                     (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
+                      m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK))) {
+                        m_sink->invalidate_rows(bbox_top, bbox_bottom);
+
+                        invalidated_text = FALSE;
+                        bbox_bottom = -G_MAXINT;
+                        bbox_top = G_MAXINT;
+                }
+
+                in_scroll_region = new_in_scroll_region;
+        };
+
+        while (!m_incoming_queue.empty()) {
+                auto chunk = std::move(m_incoming_queue.front());
+                m_incoming_queue.pop();
+
+                g_assert_nonnull(chunk.get());
+                m_incoming_bytes -= chunk->len;
+
+                _VTE_DEBUG_IF(VTE_DEBUG_IO) {
+                        _vte_debug_hexdump("Incoming buffer", chunk->data, chunk->len);
+                }
+
+                bytes_processed += chunk->len;
+
+                auto const* ip = chunk->data;
+                auto const* iend = chunk->data + chunk->len;
+
+                for ( ; ip < iend; ++ip) {
+
+                        /* Fast path for runs of printable ASCII in ground
+                         * state, which is what most output consists of:
+                         * insert them without going through the parser,
+                         * a row at a time.
+                         */
+                        if (*ip >= 0x20 && *ip < 0x7f &&
+                            m_parser.is_ground() &&
+                            !m_utf8_decoder.in_sequence()) {
+                                flush_graphic();
+
+                                auto const run_length = vte::base::printable_ascii_run(ip, iend);
+                                if (G_UNLIKELY(profiler != nullptr)) {
+                                        auto const start = profiler->now();
+                                        insert_graphic(ip, run_length);
+                                        profiler->record_graphic(run_length, run_length, start);
+                                } else {
+                                        insert_graphic(ip, run_length);
+                                }
+
+                                /* The loop steps over the last one */
+                                ip += run_length - 1;
+                                continue;
+                        }
+
+                        /* Fast path for the most common control sequences,
+                         * which the parser can take in one go when they're
+                         * complete in this chunk; see vte_parser_feed_csi().
+                         */
+                        if (*ip == 0x1b &&
+                            m_parser.is_ground() &&
+                            !m_utf8_decoder.in_sequence()) {
+                                auto const n = m_parser.feed_csi(ip, iend);
+                                if (n > 0) {
+                                        flush_graphic();
+
+                                        _VTE_DEBUG_IF(VTE_DEBUG_PARSER) {
+                                                seq.print();
+                                        }
+
+                                        auto const cmd = seq.command();
+                                        auto const start = G_UNLIKELY(profiler != nullptr) ? profiler->now() : 0;
+
+                                        switch (cmd) {
+                                        case VTE_CMD_CUP: CUP(seq); break;
+                                        case VTE_CMD_ED:  ED(seq);  break;
+                                        case VTE_CMD_EL:  EL(seq);  break;
+                                        case VTE_CMD_SGR: SGR(seq); break;
+                                        default:
+                                                g_assert_not_reached();
+                                        }
+
+                                        if (G_UNLIKELY(profiler != nullptr))
+                                                profiler->record(cmd, start);
+
+                                        sequence_dispatched();
+
+                                        ip += n - 1;
+                                        continue;
+                                }
+                        }
+
+                        switch (m_utf8_decoder.decode(*ip)) {
+                        case vte::base::UTF8Decoder::REJECT_REWIND:
+                                /* Rewind the stream.
+                                 * Note that this will never lead to a loop, since in the
+                                 * next round this byte *will* be consumed.
+                                 */
+                                --ip;
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::REJECT:
+                                m_utf8_decoder.reset();
+                                /* Fall through to insert the U+FFFD replacement character. */
+                                [[fallthrough]];
+                        case vte::base::UTF8Decoder::ACCEPT: {
+                                /* In ground state, these would all be GRAPHIC;
+                                 * collect them to insert them in runs.
+                                 */
+                                auto const c = m_utf8_decoder.codepoint();
+                                if (m_parser.is_ground() &&
+                                    ((c >= 0x20 && c < 0x7f) || c >= 0xa0)) {
+                                        if (n_graphic == G_N_ELEMENTS(graphic))
+                                                flush_graphic();
+                                        graphic[n_graphic++] = c;
+                                        break;
+                                }
+
+                                flush_graphic();
+
+                                auto rv = m_parser.feed(c);
+                                if (G_UNLIKELY(rv < 0)) {
+                                        char c_buf[7];
+                                        g_snprintf(c_buf, sizeof(c_buf), "%lc", c);
+                                        char const* wp_str = g_unichar_isprint(c) ? c_buf : _vte_debug_sequence_to_string(c_buf, -1);
+                                        _vte_debug_print(VTE_DEBUG_PARSER, "Parser error on U+%04X [%s]!\n",
+                                                         c, wp_str);
+                                        break;
+                                }
+
+#ifdef VTE_DEBUG
+                                if (rv != VTE_SEQ_NONE)
+                                        g_assert((bool)seq);
+#endif
+
+                                _VTE_DEBUG_IF(VTE_DEBUG_PARSER) {
+                                        if (rv != VTE_SEQ_NONE) {
+                                                seq.print();
+                                        }
+                                }
+
+                                // FIXMEchpe this assumes that the only handler inserting
+                                // a character is GRAPHIC, which isn't true (at least ICH, REP, SUB
+                                // also do, and invalidate directly for now)...
+
+                                switch (rv) {
+                                case VTE_SEQ_GRAPHIC: {
+
+                                        if (G_UNLIKELY(fast_forward)) {
+                                                /* Nothing to invalidate */
+                                                GRAPHIC(seq);
+                                                m_line_wrapped = false;
+                                                modified = TRUE;
+                                                break;
+                                        }
+
+                                        bbox_top = std::min(bbox_top,
+                                                            m_screen->cursor.row);
+
+                                        // does insert_char(c, false, false)
+                                        GRAPHIC(seq);
+                                        _vte_debug_print(VTE_DEBUG_PARSER,
+                                                         "Last graphic is now U+%04X %lc\n",
+                                                         m_last_graphic_character,
+                                                         g_unichar_isprint(m_last_graphic_character) ? m_last_graphic_character : 0xfffd);
+
+                                        graphic_inserted();
+                                        break;
+                                }
+
+                                case VTE_SEQ_NONE:
+                                case VTE_SEQ_IGNORE:
+                                        break;
+
+                                default: {
+                                        if (G_UNLIKELY(profiler != nullptr)) {
+                                                /* The handler may reset the parser (RIS) */
+                                                auto const cmd = seq.command();
+                                                auto const start = profiler->now();
+                                                dispatch_sequence(seq);
+                                                profiler->record(cmd, start);
+                                        } else {
+                                                dispatch_sequence(seq);
+                                        }
+
+                                        sequence_dispatched();
+                                        break;
+                                }
+                                }
+                                break;
+                        }
+                        }
+                }
+
+                flush_graphic();
+        }
+
+#ifdef VTE_DEBUG
+		/* Some safety checks: ensure the visible parts of the buffer
+		 * are all in the buffer. */
+		g_assert_cmpint(m_screen->insert_delta, >=, _vte_ring_delta(m_screen->row_data));
+
+		/* The cursor shouldn't be above or below the addressable
+		 * part of the display buffer. */
+                g_assert_cmpint(m_screen->cursor.row, >=, m_screen->insert_delta);
+#endif
+
+	if (modified) {
+		/* Keep the cursor on-screen if we scroll on output, or if
+		 * we're currently at the bottom of the buffer. */
+		update_insert_delta();
+		if (m_scroll_on_output || bottom) {
+			set_scroll_delta(m_screen->insert_delta);
+		}
+	}
+
+        if (invalidated_text && !fast_forward) {
+                m_sink->invalidate_rows(bbox_top, bbox_bottom);
+        }
+
+        /* After processing some data, do a hyperlink GC. The multiplier is totally arbitrary, feel free to fine tune. */
+        _vte_ring_hyperlink_maybe_gc(m_screen->row_data, bytes_processed * 8);
+
+	_vte_debug_print (VTE_DEBUG_WORK, ")");
+	_vte_debug_print (VTE_DEBUG_IO,
+                          "%" G_GSIZE_FORMAT " bytes in %" G_GSIZE_FORMAT " chunks left to process.\n",
+                          m_incoming_bytes,
+                          m_incoming_queue.size());
+
+        return modified;
+}
+
+/*
+ * Emulation::feed:
+ * @data: (array length=length) (element-type guint8): a string in the terminal's current encoding
+ * @length: the length of the string, or -1 to use the full length or a nul-terminated string
+ *
+ * Queues @data as if it were data received from a child process, for
+ * process_incoming() to interpret.
+ */
+void
+Emulation::feed(char const* data,
+                gssize length_)
+{
+        g_assert(length_ == 0 || data != nullptr);
+
+        size_t length;
+	if (length_ == -1)
+		length = strlen(data);
+        else
+                length = size_t(length_);
+
+	if (length == 0)
+                return;
+
+        vte::base::Chunk* chunk = nullptr;
+        if (!m_incoming_queue.empty()) {
+                auto& achunk = m_incoming_queue.back();
+                if (length < achunk->remaining_capacity())
+                        chunk = achunk.get();
+        }
+        if (chunk == nullptr) {
+                m_incoming_queue.push(vte::base::Chunk::get());
+                chunk = m_incoming_queue.back().get();
+        }
+
+        /* Break the incoming data into chunks. */
+        do {
+                auto rem = chunk->remaining_capacity();
+                auto len = std::min(length, rem);
+                memcpy (chunk->data + chunk->len, data, len);
+                chunk->len += len;
+                m_incoming_bytes += len;
+                length -= len;
+                if (length == 0)
+                        break;
+
+                data += len;
+
+                /* Get another chunk for the remaining data */
+                m_incoming_queue.push(vte::base::Chunk::get());
+                chunk = m_incoming_queue.back().get();
+        } while (true);
+}
+
+void
+Emulation::send(vte::parser::u8SequenceBuilder const& builder,
+                         bool c1,
+                         vte::parser::u8SequenceBuilder::Introducer introducer,
+                         vte::parser::u8SequenceBuilder::ST st) noexcept
+{
+        std::string str;
+        builder.to_string(str, c1, -1, introducer, st);
+        m_sink->feed_child(str.data(), str.size());
+}
+
+void
+Emulation::send(vte::parser::Sequence const& seq,
+               vte::parser::u8SequenceBuilder const& builder) noexcept
+{
+        // FIXMEchpe always take c1 & ST from @seq?
+        if (seq.type() == VTE_SEQ_OSC &&
+            builder.type() == VTE_SEQ_OSC) {
+                /* If we reply to a BEL-terminated OSC, reply with BEL-terminated OSC
+                 * as well, see https://bugzilla.gnome.org/show_bug.cgi?id=722446 and
+                 * https://gitlab.gnome.org/GNOME/vte/issues/65 .
+                 */
+                send(builder, false,
+                     vte::parser::u8SequenceBuilder::Introducer::DEFAULT,
+                     seq.terminator() == 0x7 ? vte::parser::u8SequenceBuilder::ST::BEL
+                     : vte::parser::u8SequenceBuilder::ST::DEFAULT);
+        } else {
+                send(builder, false);
+        }
+}
+
+void
+Emulation::send(unsigned int type,
+                         std::initializer_list<int> params) noexcept
+{
+        // FIXMEchpe take c1 & ST from @seq
+        send(vte::parser::ReplyBuilder{type, params}, false);
+}
+
+void
+Emulation::reply(vte::parser::Sequence const& seq,
+                          unsigned int type,
+                          std::initializer_list<int> params) noexcept
+{
+        send(seq, vte::parser::ReplyBuilder{type, params});
+}
+
+#if 0
+void
+Emulation::reply(vte::parser::Sequence const& seq,
+                          unsigned int type,
+                          std::initializer_list<int> params,
+                          std::string const& str) noexcept
+{
+        vte::parser::ReplyBuilder reply_builder{type, params};
+        reply_builder.set_string(str);
+        send(seq, reply_builder);
+}
+#endif
+
+void
+Emulation::reply(vte::parser::Sequence const& seq,
+                          unsigned int type,
+                          std::initializer_list<int> params,
+                          vte::parser::ReplyBuilder const& builder) noexcept
+{
+        std::string str;
+        builder.to_string(str, true, -1,
+                          vte::parser::ReplyBuilder::Introducer::NONE,
+                          vte::parser::ReplyBuilder::ST::NONE);
+
+        vte::parser::ReplyBuilder reply_builder{type, params};
+        reply_builder.set_string(std::move(str));
+        send(seq, reply_builder);
+}
+
+#ifdef VTE_DEBUG
+/* Sums the characters in the block from @start_row, @start_col to @end_row
+ * (inclusive), @end_col (exclusive), counting empty cells as spaces. */
+unsigned int
+Emulation::checksum_area(vte::grid::row_t start_row,
+                                  vte::grid::column_t start_col,
+                                  vte::grid::row_t end_row,
+                                  vte::grid::column_t end_col)
+{
+        unsigned int checksum = 0;
+
+        if (start_col < 0)
+                start_col = 0;
+
+        auto text = g_string_new(nullptr);
+        for (auto row = start_row; row <= end_row; row++) {
+                auto const row_data = find_row_data(row);
+                if (row_data == nullptr)
+                        continue;
+
+                VteCell const* cell;
+                for (auto col = start_col;
+                     col < end_col && (cell = _vte_row_data_get(row_data, col));
+                     col++) {
+                        if (cell->attr.fragment())
+                                continue;
+
+                        if (cell->c == 0) {
+                                checksum += ' ';
+                                continue;
+                        }
+
+                        g_string_truncate(text, 0);
+                        _vte_unistr_append_to_string(cell->c, text);
+                        char const* end = text->str + text->len;
+                        for (char const *p = text->str; p < end; p = g_utf8_next_char(p))
+                                checksum += g_utf8_get_char(p);
+                }
+        }
+        g_string_free(text, true);
+
+        return checksum & 0xffff;
+}
+#endif /* VTE_DEBUG */
+
+/* Resize the given screen (normal or alternate) of the terminal,
+ * moving the @selection along with the text, if there is one. */
+void
+Emulation::screen_set_size(VteScreen *screen_,
+                                    long old_columns,
+                                    long old_rows,
+                                    bool do_rewrap,
+                                    vte::grid::span* selection)
+{
+	VteRing *ring = screen_->row_data;
+	VteVisualPosition cursor_saved_absolute;
+	VteVisualPosition below_viewport;
+	VteVisualPosition below_current_paragraph;
+        VteVisualPosition selection_start, selection_end;
+	VteVisualPosition *markers[7];
+        gboolean was_scrolled_to_top = ((long) ceil(screen_->scroll_delta) == _vte_ring_delta(ring));
+        gboolean was_scrolled_to_bottom = ((long) screen_->scroll_delta == screen_->insert_delta);
+	glong old_top_lines;
+	double new_scroll_delta;
+
+	_vte_debug_print(VTE_DEBUG_RESIZE,
+			"Resizing %s screen_\n"
+			"Old  insert_delta=%ld  scroll_delta=%f\n"
+                        "     cursor (absolute)  row=%ld  col=%ld\n"
+			"     cursor_saved (relative to insert_delta)  row=%ld  col=%ld\n",
+			screen_ == &m_normal_screen ? "normal" : "alternate",
+			screen_->insert_delta, screen_->scroll_delta,
+                        screen_->cursor.row, screen_->cursor.col,
+                        screen_->saved.cursor.row, screen_->saved.cursor.col);
+
+        cursor_saved_absolute.row = screen_->saved.cursor.row + screen_->insert_delta;
+        cursor_saved_absolute.col = screen_->saved.cursor.col;
+	below_viewport.row = screen_->scroll_delta + old_rows;
+	below_viewport.col = 0;
+        below_current_paragraph.row = screen_->cursor.row + 1;
+	while (below_current_paragraph.row < _vte_ring_next(ring)
+	    && _vte_ring_index(ring, below_current_paragraph.row - 1)->attr.soft_wrapped) {
+		below_current_paragraph.row++;
+	}
+	below_current_paragraph.col = 0;
+        memset(&markers, 0, sizeof(markers));
+        markers[0] = &cursor_saved_absolute;
+        markers[1] = &below_viewport;
+        markers[2] = &below_current_paragraph;
+        markers[3] = &screen_->cursor;
+        if (selection != nullptr && !selection->empty()) {
+                selection_start.row = selection->start_row();
+                selection_start.col = selection->start_column();
+                selection_end.row = selection->end_row();
+                selection_end.col = selection->end_column();
+                markers[4] = &selection_start;
+                markers[5] = &selection_end;
+	}
+
+	old_top_lines = below_current_paragraph.row - screen_->insert_delta;
+
+	if (do_rewrap && old_columns != m_column_count)
+		_vte_ring_rewrap(ring, m_column_count, markers);
+
+	if (_vte_ring_length(ring) > m_row_count) {
+		/* The content won't fit without scrollbars. Before figuring out the position, we might need to
+		   drop some lines from the ring if the cursor is not at the bottom, as XTerm does. See bug 708213.
+		   This code is really tricky, see ../doc/rewrap.txt for details! */
+		glong new_top_lines, drop1, drop2, drop3, drop;
+		screen_->insert_delta = _vte_ring_next(ring) - m_row_count;
+		new_top_lines = below_current_paragraph.row - screen_->insert_delta;
+		drop1 = _vte_ring_length(ring) - m_row_count;
+		drop2 = _vte_ring_next(ring) - below_current_paragraph.row;
+		drop3 = old_top_lines - new_top_lines;
+		drop = MIN(MIN(drop1, drop2), drop3);
+		if (drop > 0) {
+			int new_ring_next = screen_->insert_delta + m_row_count - drop;
+			_vte_debug_print(VTE_DEBUG_RESIZE,
+					"Dropping %ld [== MIN(%ld, %ld, %ld)] rows at the bottom\n",
+					drop, drop1, drop2, drop3);
+			_vte_ring_shrink(ring, new_ring_next - _vte_ring_delta(ring));
+		}
+	}
+
+        if (selection != nullptr && !selection->empty()) {
+                selection->set ({ selection_start.row, selection_start.col },
+                                { selection_end.row, selection_end.col });
+	}
+
+	/* Figure out new insert and scroll deltas */
+	if (_vte_ring_length(ring) <= m_row_count) {
+		/* Everything fits without scrollbars. Align at top. */
+		screen_->insert_delta = _vte_ring_delta(ring);
+		new_scroll_delta = screen_->insert_delta;
+		_vte_debug_print(VTE_DEBUG_RESIZE,
+				"Everything fits without scrollbars\n");
+	} else {
+		/* Scrollbar required. Can't afford unused lines at bottom. */
+		screen_->insert_delta = _vte_ring_next(ring) - m_row_count;
+		if (was_scrolled_to_bottom) {
+			/* Was scrolled to bottom, keep this way. */
+			new_scroll_delta = screen_->insert_delta;
+			_vte_debug_print(VTE_DEBUG_RESIZE,
+					"Scroll to bottom\n");
+		} else if (was_scrolled_to_top) {
+			/* Was scrolled to top, keep this way. Not sure if this special case is worth it. */
+			new_scroll_delta = _vte_ring_delta(ring);
+			_vte_debug_print(VTE_DEBUG_RESIZE,
+					"Scroll to top\n");
+		} else {
+			/* Try to scroll so that the bottom visible row stays.
+			   More precisely, the character below the bottom left corner stays in that
+			   (invisible) row.
+			   So if the bottom of the screen_ was at a hard line break then that hard
+			   line break will stay there.
+			   TODO: What would be the best behavior if the bottom of the screen_ is a
+			   soft line break, i.e. only a partial line is visible at the bottom? */
+			new_scroll_delta = below_viewport.row - m_row_count;
+			/* Keep the old fractional part. */
+			new_scroll_delta += screen_->scroll_delta - floor(screen_->scroll_delta);
+			_vte_debug_print(VTE_DEBUG_RESIZE,
+					"Scroll so bottom row stays\n");
+		}
+	}
+
+	/* Don't clamp, they'll be clamped when restored. Until then remember off-screen_ values
+	   since they might become on-screen_ again on subsequent resizes. */
+        screen_->saved.cursor.row = cursor_saved_absolute.row - screen_->insert_delta;
+        screen_->saved.cursor.col = cursor_saved_absolute.col;
+
+	_vte_debug_print(VTE_DEBUG_RESIZE,
+			"New  insert_delta=%ld  scroll_delta=%f\n"
+                        "     cursor (absolute)  row=%ld  col=%ld\n"
+			"     cursor_saved (relative to insert_delta)  row=%ld  col=%ld\n\n",
+			screen_->insert_delta, new_scroll_delta,
+                        screen_->cursor.row, screen_->cursor.col,
+                        screen_->saved.cursor.row, screen_->saved.cursor.col);
+
+	if (screen_ == m_screen)
+		set_scroll_delta(new_scroll_delta);
+	else
+		screen_->scroll_delta = new_scroll_delta;
+}
+
+/* Resizes the screens to the new m_row_count and m_column_count, which were
+ * @old_columns and @old_rows, moving the @selection along with the text. */
+void
+Emulation::resize_screens(long old_columns,
+                          long old_rows,
+                          vte::grid::span* selection)
+{
+        m_scrolling_restricted = FALSE;
+
+        _vte_ring_set_visible_rows(m_normal_screen.row_data, m_row_count);
+        _vte_ring_set_visible_rows(m_alternate_screen.row_data, m_row_count);
+
+        /* Resize the normal screen and (if rewrapping is enabled) rewrap it even if the alternate screen is visible: bug 415277 */
+        screen_set_size(&m_normal_screen, old_columns, old_rows, m_rewrap_on_resize, selection);
+        /* Resize the alternate screen if it's the current one, but never rewrap it: bug 336238 comment 60 */
+        if (m_screen == &m_alternate_screen)
+                screen_set_size(&m_alternate_screen, old_columns, old_rows, false, selection);
+
+        /* Ensure scrollback buffers cover the screen. */
+        set_scrollback_lines(m_scrollback_lines);
+
+        /* Ensure the cursor is valid */
+        m_screen->cursor.row = CLAMP (m_screen->cursor.row,
+                                      _vte_ring_delta (m_screen->row_data),
+                                      MAX (_vte_ring_delta (m_screen->row_data),
+                                           _vte_ring_next (m_screen->row_data) - 1));
+
+        adjust_adjustments_full();
+}
+
+void
+Emulation::set_size(long columns,
+                    long rows)
+{
+	glong old_columns, old_rows;
+
+	_vte_debug_print(VTE_DEBUG_RESIZE,
+			"Setting size to %ldx%ld.\n",
+			columns, rows);
+
+	old_rows = m_row_count;
+	old_columns = m_column_count;
+
+        m_row_count = rows;
+        m_column_count = columns;
+        m_tabstops.resize(columns);
+
+	if (old_rows != m_row_count || old_columns != m_column_count)
+                resize_screens(old_columns, old_rows);
+}
+
+/* DECSCUSR set cursor style */
+bool
+Emulation::set_cursor_style(VteCursorStyle style)
+{
+        if (m_cursor_style == style)
+                return false;
+
+        m_cursor_style = style;
+        m_sink->cursor_style_changed();
+
+        return true;
+}
+
+bool
+Emulation::set_scrollback_lines(long lines)
+{
+        glong low, high, next;
+        double scroll_delta;
+	VteScreen *scrn;
+
+	if (lines < 0)
+		lines = G_MAXLONG;
+
+#if 0
+        /* FIXME: this breaks the scrollbar range, bug #562511 */
+        if (lines == m_scrollback_lines)
+                return false;
+#endif
+
+	_vte_debug_print (VTE_DEBUG_MISC,
+			"Setting scrollback lines to %ld\n", lines);
+
+	m_scrollback_lines = lines;
+
+        /* The main screen gets the full scrollback buffer. */
+        scrn = &m_normal_screen;
+        lines = MAX (lines, m_row_count);
+        next = MAX (m_screen->cursor.row + 1,
+                    _vte_ring_next (scrn->row_data));
+        _vte_ring_resize (scrn->row_data, lines);
+        low = _vte_ring_delta (scrn->row_data);
+        high = lines + MIN (G_MAXLONG - lines, low - m_row_count + 1);
+        scrn->insert_delta = CLAMP (scrn->insert_delta, low, high);
+        scrn->scroll_delta = CLAMP (scrn->scroll_delta, low, scrn->insert_delta);
+        next = MIN (next, scrn->insert_delta + m_row_count);
+        if (_vte_ring_next (scrn->row_data) > next){
+                _vte_ring_shrink (scrn->row_data, next - low);
+        }
+
+        /* The alternate scrn isn't allowed to scroll at all. */
+        scrn = &m_alternate_screen;
+        _vte_ring_resize (scrn->row_data, m_row_count);
+        scrn->scroll_delta = _vte_ring_delta (scrn->row_data);
+        scrn->insert_delta = _vte_ring_delta (scrn->row_data);
+        if (_vte_ring_next (scrn->row_data) > scrn->insert_delta + m_row_count){
+                _vte_ring_shrink (scrn->row_data, m_row_count);
+        }
+
+	/* Adjust the scrollbar to the new location. */
+	/* Hack: force a change in scroll_delta even if the value remains, so that
+	   vte_term_q_adj_val_changed() doesn't shortcut to no-op, see bug 676075. */
+        scroll_delta = m_screen->scroll_delta;
+	m_screen->scroll_delta = -1;
+	set_scroll_delta(scroll_delta);
+	adjust_adjustments_full();
+
+        return true;
+}
+
+bool
+Emulation::set_scrollback_in_memory(bool in_memory)
+{
+        if (in_memory == m_scrollback_in_memory)
+                return false;
+
+        m_scrollback_in_memory = in_memory;
+
+        /* The alternate screen has no scrollback to keep */
+        _vte_ring_set_streams_in_memory(m_normal_screen.row_data, in_memory);
+
+        return true;
+}
+
+/*
+ * Emulation::reset:
+ * @clear_tabstops: whether to reset tabstops
+ * @clear_history: whether to empty the terminal's scrollback buffer
+ *
+ * Resets as much of the terminal's internal state as possible, discarding any
+ * unprocessed input data, resetting character attributes, cursor state,
+ * national character set state, status line, terminal modes (insert/delete),
+ * and encoding; then lets the sink reset its own.
+ *
+ */
+void
+Emulation::reset(bool clear_tabstops,
+                 bool clear_history)
+{
+        m_bell_pending = false;
+
+	/* Reset charset substitution state. */
+
+        m_utf8_decoder.reset();
+
+#ifdef WITH_ICONV
+        /* Reset the converter state */
+        m_incoming_decoder.reset();
+#endif
+
+        /* Reset parser */
+        m_parser.reset();
+        m_last_graphic_character = 0;
+
+        /* Reset modes */
+        m_modes_ecma.reset();
+        m_modes_private.clear_saved();
+        m_modes_private.reset();
+
+        /* Reset tabstops */
+        if (clear_tabstops) {
+                m_tabstops.reset();
+        }
+
+        /* Window title stack */
+        if (clear_history) {
+                m_window_title_stack.clear();
+        }
+
+        update_mouse_protocol();
+
+	/* Reset the color palette. Only the 256 indexed colors, not the special ones, as per xterm. */
+	for (int i = 0; i < 256; i++)
+		m_palette[i].sources[VTE_COLOR_SOURCE_ESCAPE].is_set = FALSE;
+	/* Reset the default attributes.  Reset the alternate attribute because
+	 * it's not a real attribute, but we need to treat it as one here. */
+        reset_default_attributes(true);
+        /* Reset charset modes. */
+        m_character_replacements[0] = VTE_CHARACTER_REPLACEMENT_NONE;
+        m_character_replacements[1] = VTE_CHARACTER_REPLACEMENT_NONE;
+        m_character_replacement = &m_character_replacements[0];
+	/* Clear the scrollback buffers and reset the cursors. Switch to normal screen. */
+	if (clear_history) {
+                m_screen = &m_normal_screen;
+                m_normal_screen.scroll_delta = m_normal_screen.insert_delta =
+                        _vte_ring_reset(m_normal_screen.row_data);
+                m_normal_screen.cursor.row = m_normal_screen.insert_delta;
+                m_normal_screen.cursor.col = 0;
+                m_alternate_screen.scroll_delta = m_alternate_screen.insert_delta =
+                        _vte_ring_reset(m_alternate_screen.row_data);
+                m_alternate_screen.cursor.row = m_alternate_screen.insert_delta;
+                m_alternate_screen.cursor.col = 0;
+                /* Adjust the scrollbar to the new location. */
+                /* Hack: force a change in scroll_delta even if the value remains, so that
+                   vte_term_q_adj_val_changed() doesn't shortcut to no-op, see bug 730599. */
+                m_screen->scroll_delta = -1;
+                set_scroll_delta(m_screen->insert_delta);
+		adjust_adjustments_full();
+	}
+        /* DECSCUSR cursor style */
+        set_cursor_style(VTE_CURSOR_STYLE_TERMINAL_DEFAULT);
+	/* Reset restricted scrolling regions, leave insert mode, make
+	 * the cursor visible again. */
+        m_scrolling_restricted = FALSE;
+        /* Reset the saved cursor. */
+        save_cursor(&m_normal_screen);
+        save_cursor(&m_alternate_screen);
+
+        m_sink->emulation_reset(clear_history);
+
+	/* Cause everything to be redrawn (or cleared). */
+	m_sink->invalidate_all();
+}
+
+/*
+ * Emulation::dump_dispatch_profile:
+ *
+ * Prints how often each sequence handler was called from
+ * process_incoming() and the time spent in it, when VTE_DEBUG
+ * contains "dispatch". This happens when the terminal is destroyed,
+ * but can be called at any time, e.g. from a debugger.
+ *
+ * To profile something in particular in a running terminal, reset it
+ * before and after, e.g. with "printf '\ec'": RIS prints the profile
+ * so far, and starts over.
+ */
+void
+Emulation::dump_dispatch_profile() const
+{
+        if (m_dispatch_profiler)
+                m_dispatch_profiler->dump(nullptr);
+}
+
+void
+Emulation::reply(vte::parser::Sequence const& seq,
+                          unsigned int type,
+                          std::initializer_list<int> params,
+                          char const* format,
+                          ...) noexcept
+{
+        char buf[128];
+        va_list vargs;
+        va_start(vargs, format);
+        auto len = g_vsnprintf(buf, sizeof(buf), format, vargs);
+        va_end(vargs);
+        g_assert_cmpint(len, <, sizeof(buf));
+
+        vte::parser::ReplyBuilder builder{type, params};
+        builder.set_string(std::string{buf});
+
+        send(seq, builder);
+}
+
+// FIXMEchpe replace this with a method on VteRing
+VteRowData *
+Emulation::insert_rows (guint cnt)
+{
+	VteRowData *row;
+	do {
+		row = ring_append(false);
+	} while(--cnt);
+	return row;
+}
+
+
+} // namespace terminal
+} // namespace vte
@@ -0,0 +1,576 @@
+/*
+ * Copyright (C) 2001-2004 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * The terminal emulation without the widget: the screens, the parser
+ * and the sequence handlers (vteseq.cc), which report what needs to be
+ * redrawn, and what else the widget needs to know about, to a Sink.
+ *
+ * vte::terminal::Terminal is the widget's Emulation, and its own Sink.
+ * Without a widget, this is what libvte-core provides, for running the
+ * emulation where there's no display, like when recording sessions,
+ * scraping screens, or benchmarking the emulation on its own.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "vtedefines.hh"
+#include "vtetypes.hh"
+#include "ring.hh"
+#include "parser.hh"
+#include "parser-glue.hh"
+#include "modes.hh"
+#include "sgr.hh"
+#include "tabstops.hh"
+
+#include "charsetdecoder.hh"
+#include "chunk.hh"
+#include "dispatch-profiler.hh"
+#include "utf8.hh"
+
+#include <list>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+/* The order is important */
+typedef enum {
+	MOUSE_TRACKING_NONE,
+	MOUSE_TRACKING_SEND_XY_ON_CLICK,
+	MOUSE_TRACKING_SEND_XY_ON_BUTTON,
+	MOUSE_TRACKING_HILITE_TRACKING,
+	MOUSE_TRACKING_CELL_MOTION_TRACKING,
+	MOUSE_TRACKING_ALL_MOTION_TRACKING
+} MouseTrackingMode;
+
+enum {
+        VTE_XTERM_WM_RESTORE_WINDOW = 1,
+        VTE_XTERM_WM_MINIMIZE_WINDOW = 2,
+        VTE_XTERM_WM_SET_WINDOW_POSITION = 3,
+        VTE_XTERM_WM_SET_WINDOW_SIZE_PIXELS = 4,
+        VTE_XTERM_WM_RAISE_WINDOW = 5,
+        VTE_XTERM_WM_LOWER_WINDOW = 6,
+        VTE_XTERM_WM_REFRESH_WINDOW = 7,
+        VTE_XTERM_WM_SET_WINDOW_SIZE_CELLS = 8,
+        VTE_XTERM_WM_MAXIMIZE_WINDOW = 9,
+        VTE_XTERM_WM_FULLSCREEN_WINDOW = 10,
+        VTE_XTERM_WM_GET_WINDOW_STATE = 11,
+        VTE_XTERM_WM_GET_WINDOW_POSITION = 13,
+        VTE_XTERM_WM_GET_WINDOW_SIZE_PIXELS = 14,
+        VTE_XTERM_WM_GET_WINDOW_SIZE_CELLS = 18,
+        VTE_XTERM_WM_GET_SCREEN_SIZE_CELLS = 19,
+        VTE_XTERM_WM_GET_ICON_TITLE = 20,
+        VTE_XTERM_WM_GET_WINDOW_TITLE = 21,
+        VTE_XTERM_WM_TITLE_STACK_PUSH = 22,
+        VTE_XTERM_WM_TITLE_STACK_POP = 23,
+};
+
+typedef enum _VteCharacterReplacement {
+        VTE_CHARACTER_REPLACEMENT_NONE,
+        VTE_CHARACTER_REPLACEMENT_LINE_DRAWING,
+        VTE_CHARACTER_REPLACEMENT_BRITISH
+} VteCharacterReplacement;
+
+typedef struct _VtePaletteColor {
+	struct {
+		vte::color::rgb color;
+		gboolean is_set;
+	} sources[2];
+} VtePaletteColor;
+
+/* These correspond to the parameters for DECSCUSR (Set cursor style). */
+typedef enum _VteCursorStyle {
+        /* We treat 0 and 1 differently, assuming that the VT510 does so too.
+         *
+         * See, according to the "VT510 Video Terminal Programmer Information",
+         * from vt100.net, paragraph "2.5.7 Cursor Display", there was a menu
+         * item in the "Terminal Set-Up" to set the cursor's style. It looks
+         * like that defaulted to blinking block. So it makes sense for 0 to
+         * mean "set cursor style to default (set by Set-Up)" and 1 to mean
+         * "set cursor style to blinking block", since that default need not be
+         * blinking block. Access to a VT510 is needed to test this theory,
+         * but it seems plausible. And, anyhow, we can even decide we know
+         * better than the VT510 designers! */
+        VTE_CURSOR_STYLE_TERMINAL_DEFAULT = 0,
+        VTE_CURSOR_STYLE_BLINK_BLOCK      = 1,
+        VTE_CURSOR_STYLE_STEADY_BLOCK     = 2,
+        VTE_CURSOR_STYLE_BLINK_UNDERLINE  = 3,
+        VTE_CURSOR_STYLE_STEADY_UNDERLINE = 4,
+        /* *_IBEAM are xterm extensions */
+        VTE_CURSOR_STYLE_BLINK_IBEAM      = 5,
+        VTE_CURSOR_STYLE_STEADY_IBEAM     = 6
+} VteCursorStyle;
+
+struct VteScreen {
+public:
+        VteScreen(gulong max_rows,
+                  bool has_streams) :
+                m_ring{max_rows, has_streams},
+                row_data(&m_ring),
+                cursor{0,0}
+        {
+        }
+
+        vte::base::Ring m_ring; /* buffer contents */
+        VteRing* row_data;
+        VteVisualPosition cursor;  /* absolute value, from the beginning of the terminal history */
+        double scroll_delta{0.0}; /* scroll offset */
+        long insert_delta{0}; /* insertion offset */
+
+        /* Stuff saved along with the cursor */
+        struct {
+                VteVisualPosition cursor;  /* onscreen coordinate, that is, relative to insert_delta */
+                uint8_t modes_ecma;
+                bool reverse_mode;
+                bool origin_mode;
+                VteCell defaults;
+                VteCell color_defaults;
+                VteCell fill_defaults;
+                VteCharacterReplacement character_replacements[2];
+                VteCharacterReplacement *character_replacement;
+        } saved;
+};
+
+static inline bool
+_vte_double_equal(double a,
+                  double b)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+        return a == b;
+#pragma GCC diagnostic pop
+}
+
+struct vte_scrolling_region {
+        int start, end;
+};
+
+namespace vte {
+
+namespace terminal {
+
+class Emulation {
+public:
+        /*
+         * Sink:
+         *
+         * Receives what the emulation can't do on its own: redrawing,
+         * scrolling the view, signals, and the replies to the child.
+         * Everything defaults to doing nothing, which is what's right
+         * without a widget; see vte::terminal::Terminal for what the
+         * widget does.
+         */
+        class Sink {
+        public:
+                virtual ~Sink() = default;
+
+                /* Rows are absolute, @end is inclusive */
+                virtual void invalidate_rows(vte::grid::row_t start,
+                                             vte::grid::row_t end) { }
+                void invalidate_row(vte::grid::row_t row) { invalidate_rows(row, row); }
+                virtual void invalidate_all() { }
+                virtual void invalidate_cursor_once(bool periodic = false) { }
+
+                virtual void queue_adjustment_changed() { }
+                /* After m_screen->scroll_delta changed, see set_scroll_delta() */
+                virtual void scroll_delta_changed() { }
+                virtual void queue_contents_changed() { }
+
+                /* After switching between the normal and alternate screen */
+                virtual void screen_switched() { }
+                virtual void hyperlink_hover_cleared() { }
+
+                virtual void cursor_style_changed() { }
+                virtual void mouse_protocol_changed() { }
+                virtual void emulation_reset(bool clear_history) { }
+
+                /* Replies to the child */
+                virtual void feed_child(char const* text,
+                                        gssize length) { }
+                virtual void feed_focus_event_initial() { }
+
+                /* XTERM_WM */
+                virtual void emit_deiconify_window() { }
+                virtual void emit_iconify_window() { }
+                virtual void emit_raise_window() { }
+                virtual void emit_lower_window() { }
+                virtual void emit_maximize_window() { }
+                virtual void emit_refresh_window() { }
+                virtual void emit_restore_window() { }
+                virtual void emit_move_window(guint x,
+                                              guint y) { }
+                virtual void emit_resize_window(guint columns,
+                                                guint rows) { }
+
+                virtual bool is_mapped() const { return true; }
+                /* In pixels, including the padding */
+                virtual void get_window_origin(int* x,
+                                               int* y) { *x = *y = 0; }
+                virtual void get_screen_size(int* width,
+                                             int* height) { *width = *height = 0; }
+                virtual long get_cell_width() { return 1; }
+                virtual long get_cell_height() { return 1; }
+        };
+
+        Emulation(Sink* sink = nullptr);
+        ~Emulation();
+
+        Emulation(Emulation const&) = delete;
+        Emulation& operator=(Emulation const&) = delete;
+
+        void set_sink(Sink* sink) noexcept;
+
+public:
+        Sink* m_sink;
+
+        /* Metric and sizing data: dimensions of the window */
+        vte::grid::row_t m_row_count{VTE_ROWS};
+        vte::grid::column_t m_column_count{VTE_COLUMNS};
+
+        vte::terminal::Tabstops m_tabstops{};
+
+        vte::parser::Parser m_parser; /* control sequence state machine */
+
+        vte::terminal::modes::ECMA m_modes_ecma{};
+        vte::terminal::modes::Private m_modes_private{};
+
+	/* Queue of chunks of data read from the PTY.
+         * Chunks are inserted at the back, and processed from the front.
+         */
+        std::queue<vte::base::Chunk::unique_type, std::list<vte::base::Chunk::unique_type>> m_incoming_queue;
+        /* Total size of the chunks in m_incoming_queue */
+        gsize m_incoming_bytes{0};
+
+        /* Only with VTE_DEBUG=dispatch; see process_incoming() */
+        std::unique_ptr<vte::terminal::DispatchProfiler> m_dispatch_profiler{};
+
+        vte::base::UTF8Decoder m_utf8_decoder;
+        bool m_using_utf8{true};
+        int m_utf8_ambiguous_width{VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH};
+        gunichar m_last_graphic_character{0}; /* for REP */
+
+#ifdef WITH_ICONV
+        /* Legacy charset support */
+        vte::base::CharsetDecoder m_incoming_decoder;
+
+        void convert_incoming() noexcept;
+#endif
+
+	/* Screen data.  We support the normal screen, and an alternate
+	 * screen, which seems to be a DEC-specific feature. */
+        VteScreen m_normal_screen;
+        VteScreen m_alternate_screen;
+        VteScreen *m_screen; /* points to either m_normal_screen or m_alternate_screen */
+
+        VteCell m_defaults;       /* default characteristics
+                                     for insertion of any new
+                                     characters */
+        VteCell m_color_defaults; /* original defaults
+                                     plus the current
+                                     fore/back */
+        VteCell m_fill_defaults;  /* original defaults
+                                     plus the current
+                                     fore/back with no
+                                     character data */
+        VteCharacterReplacement m_character_replacements[2];  /* charsets in the G0 and G1 slots */
+        VteCharacterReplacement *m_character_replacement;     /* pointer to the active one */
+
+        /* Changes since the widget last looked; see emit_pending_signals() */
+        gboolean m_text_modified_flag{FALSE};
+        gboolean m_text_inserted_flag{FALSE};
+        gboolean m_text_deleted_flag{FALSE};
+        gboolean m_rewrap_on_resize{TRUE};
+
+	/* Scrolling options. */
+        gboolean m_scroll_on_output{FALSE};
+        vte::grid::row_t m_scrollback_lines{-1};
+        bool m_scrollback_in_memory{false};
+
+        /* Restricted scrolling */
+        struct vte_scrolling_region m_scrolling_region{0, 0};     /* the region we scroll in */
+        gboolean m_scrolling_restricted{FALSE};
+
+        /* DECSCUSR cursor style (shape and blinking possibly overridden
+         * via escape sequence) */
+        VteCursorStyle m_cursor_style{VTE_CURSOR_STYLE_TERMINAL_DEFAULT};
+
+        MouseTrackingMode m_mouse_tracking_mode{MOUSE_TRACKING_NONE};
+
+        VtePaletteColor m_palette[VTE_PALETTE_SIZE]{};
+
+        /* Fast-forward: while the widget isn't visible, the incoming data
+         * is processed without invalidating anything; see
+         * Terminal::update_fast_forward().
+         */
+        bool m_fast_forward{false};
+
+        std::string m_window_title{};
+        std::string m_current_directory_uri{};
+        std::string m_current_file_uri{};
+        std::string m_window_title_pending{};
+        std::string m_current_directory_uri_pending{};
+        std::string m_current_file_uri_pending{};
+        bool m_window_title_changed{false};
+        bool m_current_directory_uri_changed{false};
+        bool m_current_file_uri_changed{false};
+
+        std::vector<std::string> m_window_title_stack{};
+
+        /* Bell */
+        bool m_bell_pending{false};
+
+        /* Hyperlinks */
+        gboolean m_allow_hyperlink{FALSE};
+        long m_hyperlink_auto_id{0};
+
+public:
+
+        // FIXMEchpe inline!
+        /* inline */ VteRowData* ring_insert(vte::grid::row_t position,
+                                       bool fill);
+        /* inline */ VteRowData* ring_append(bool fill);
+        /* inline */ void ring_remove(vte::grid::row_t position);
+        void ring_rotate(vte::grid::row_t start,
+                         vte::grid::row_t end,
+                         vte::grid::row_t count);
+        VteRowData const* find_row_data(vte::grid::row_t row) const;
+        VteRowData* find_row_data_writable(vte::grid::row_t row) const;
+        VteCell const* find_charcell(vte::grid::column_t col,
+                                     vte::grid::row_t row) const;
+        vte::grid::column_t find_start_column(vte::grid::column_t col,
+                                              vte::grid::row_t row) const;
+        vte::grid::column_t find_end_column(vte::grid::column_t col,
+                                            vte::grid::row_t row) const;
+
+        inline VteRowData *insert_rows (guint cnt);
+        VteRowData *ensure_row();
+        VteRowData *ensure_cursor();
+        void update_insert_delta();
+
+        void cleanup_fragments(long start,
+                               long end);
+
+        void cursor_down(bool explicit_sequence);
+        void drop_scrollback();
+
+        void restore_cursor(VteScreen *screen__);
+        void save_cursor(VteScreen *screen__);
+
+        /* The most characters insert_chars() does in one go */
+        static constexpr size_t const k_insert_chars_max = 256;
+
+        inline gunichar map_graphic_character(gunichar c) const noexcept;
+        void insert_char(gunichar c,
+                         bool insert,
+                         bool invalidate_now);
+        template<typename T>
+        size_t insert_chars(T const* chars,
+                            size_t n_chars,
+                            bool insert,
+                            bool invalidate_now);
+        void insert_combining_mark(gunichar c);
+
+        bool process_incoming();
+        void dump_dispatch_profile() const;
+
+        void reset(bool clear_tabstops,
+                   bool clear_history);
+
+        void feed(char const* data,
+                  gssize length);
+
+        void reset_default_attributes(bool reset_hyperlink);
+
+        void screen_set_size(VteScreen *screen_,
+                             long old_columns,
+                             long old_rows,
+                             bool do_rewrap,
+                             vte::grid::span* selection = nullptr);
+        void resize_screens(long old_columns,
+                            long old_rows,
+                            vte::grid::span* selection = nullptr);
+        void set_size(long columns,
+                      long rows);
+
+        void set_scroll_delta(double v);
+        void adjust_adjustments();
+        void adjust_adjustments_full();
+
+        vte::color::rgb const* get_color(int entry) const;
+        void set_color(int entry,
+                       int source,
+                       vte::color::rgb const& proposed);
+        void reset_color(int entry,
+                         int source);
+        void set_colors(vte::color::rgb const *foreground,
+                        vte::color::rgb const *background,
+                        vte::color::rgb const *palette,
+                        gsize palette_size);
+        void set_colors_default();
+
+        bool set_cjk_ambiguous_width(int width);
+        bool set_cursor_style(VteCursorStyle style);
+        bool set_scrollback_lines(long lines);
+        bool set_scrollback_in_memory(bool in_memory);
+
+        inline void ensure_cursor_is_onscreen();
+        inline void home_cursor();
+        inline void clear_screen();
+        inline void clear_current_line();
+        inline void clear_above_current();
+        inline void scroll_text(vte::grid::row_t scroll_amount);
+        inline void switch_screen(VteScreen *new_screen);
+        inline void switch_normal_screen();
+        inline void switch_alternate_screen();
+        inline void save_cursor();
+        inline void restore_cursor();
+
+        inline void set_mode_ecma(vte::parser::Sequence const& seq,
+                                  bool set) noexcept;
+        inline void set_mode_private(vte::parser::Sequence const& seq,
+                                     bool set) noexcept;
+        inline void set_mode_private(int mode,
+                                     bool set) noexcept;
+        inline void save_mode_private(vte::parser::Sequence const& seq,
+                                      bool save) noexcept;
+        void update_mouse_protocol() noexcept;
+
+        inline void set_character_replacements(unsigned slot,
+                                               VteCharacterReplacement replacement);
+        inline void set_character_replacement(unsigned slot);
+        inline void clear_to_bol();
+        inline void clear_below_current();
+        inline void clear_to_eol();
+        inline void delete_character();
+        inline void set_cursor_column(vte::grid::column_t col);
+        inline void set_cursor_column1(vte::grid::column_t col); /* 1-based */
+        inline int get_cursor_column() const noexcept { return CLAMP(m_screen->cursor.col, 0, m_column_count - 1); }
+        inline int get_cursor_column1() const noexcept { return get_cursor_column() + 1; }
+        inline void set_cursor_row(vte::grid::row_t row /* relative to scrolling region */);
+        inline void set_cursor_row1(vte::grid::row_t row /* relative to scrolling region */); /* 1-based */
+        inline int get_cursor_row() const noexcept { return CLAMP(m_screen->cursor.row, 0, m_row_count - 1); }
+        inline int get_cursor_row1() const noexcept { return get_cursor_row() + 1; }
+        inline void set_cursor_coords(vte::grid::row_t row /* relative to scrolling region */,
+                                      vte::grid::column_t column);
+        inline void set_cursor_coords1(vte::grid::row_t row /* relative to scrolling region */,
+                                       vte::grid::column_t column); /* 1-based */
+        inline vte::grid::row_t get_cursor_row_unclamped() const;
+        inline vte::grid::column_t get_cursor_column_unclamped() const;
+        inline void move_cursor_up(vte::grid::row_t rows);
+        inline void move_cursor_down(vte::grid::row_t rows);
+        inline void erase_characters(long count);
+
+        inline void move_cursor_backward(vte::grid::column_t columns);
+        inline void move_cursor_forward(vte::grid::column_t columns);
+        inline void move_cursor_tab_backward(int count = 1);
+        inline void move_cursor_tab_forward(int count = 1);
+        inline void line_feed();
+        inline void erase_in_display(vte::parser::Sequence const& seq);
+        inline void erase_in_line(vte::parser::Sequence const& seq);
+        inline void insert_lines(vte::grid::row_t param);
+        inline void delete_lines(vte::grid::row_t param);
+
+        unsigned int checksum_area(vte::grid::row_t start_row,
+                                   vte::grid::column_t start_col,
+                                   vte::grid::row_t end_row,
+                                   vte::grid::column_t end_col);
+
+        void send(vte::parser::u8SequenceBuilder const& builder,
+                  bool c1 = true,
+                  vte::parser::u8SequenceBuilder::Introducer introducer = vte::parser::u8SequenceBuilder::Introducer::DEFAULT,
+                  vte::parser::u8SequenceBuilder::ST st = vte::parser::u8SequenceBuilder::ST::DEFAULT) noexcept;
+        void send(vte::parser::Sequence const& seq,
+                  vte::parser::u8SequenceBuilder const& builder) noexcept;
+        void send(unsigned int type,
+                  std::initializer_list<int> params) noexcept;
+        void reply(vte::parser::Sequence const& seq,
+                   unsigned int type,
+                   std::initializer_list<int> params) noexcept;
+        void reply(vte::parser::Sequence const& seq,
+                   unsigned int type,
+                   std::initializer_list<int> params,
+                   vte::parser::ReplyBuilder const& builder) noexcept;
+        #if 0
+        void reply(vte::parser::Sequence const& seq,
+                   unsigned int type,
+                   std::initializer_list<int> params,
+                   std::string const& str) noexcept;
+        #endif
+        void reply(vte::parser::Sequence const& seq,
+                   unsigned int type,
+                   std::initializer_list<int> params,
+                   char const* format,
+                   ...) noexcept G_GNUC_PRINTF(5, 6);
+
+        /* OSC handler helpers */
+        bool get_osc_color_index(int osc,
+                                 int value,
+                                 int& index) const noexcept;
+        void set_color_index(vte::parser::Sequence const& seq,
+                             vte::parser::StringTokeniser::const_iterator& token,
+                             vte::parser::StringTokeniser::const_iterator const& endtoken,
+                             int number,
+                             int index,
+                             int index_fallback,
+                             int osc) noexcept;
+
+        /* OSC handlers */
+        void set_color(vte::parser::Sequence const& seq,
+                       vte::parser::StringTokeniser::const_iterator& token,
+                       vte::parser::StringTokeniser::const_iterator const& endtoken,
+                       int osc) noexcept;
+        void set_special_color(vte::parser::Sequence const& seq,
+                               vte::parser::StringTokeniser::const_iterator& token,
+                               vte::parser::StringTokeniser::const_iterator const& endtoken,
+                               int index,
+                               int index_fallback,
+                               int osc) noexcept;
+        void reset_color(vte::parser::Sequence const& seq,
+                         vte::parser::StringTokeniser::const_iterator& token,
+                         vte::parser::StringTokeniser::const_iterator const& endtoken,
+                         int osc) noexcept;
+        void set_current_directory_uri(vte::parser::Sequence const& seq,
+                                       vte::parser::StringTokeniser::const_iterator& token,
+                                       vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
+        void set_current_file_uri(vte::parser::Sequence const& seq,
+                                  vte::parser::StringTokeniser::const_iterator& token,
+                                  vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
+        void set_current_hyperlink(vte::parser::Sequence const& seq,
+                                   vte::parser::StringTokeniser::const_iterator& token,
+                                   vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
+
+        /* Sequence handlers */
+        bool m_line_wrapped{false}; // signals line wrapped from character insertion
+        // Note: inlining the handlers seems to worsen the performance, so we don't do that
+#define _VTE_CMD(cmd) \
+	/* inline */ void cmd (vte::parser::Sequence const& seq);
+#define _VTE_NOP(cmd) G_GNUC_UNUSED _VTE_CMD(cmd)
+#include "parser-cmd.hh"
+#undef _VTE_CMD
+#undef _VTE_NOP
+};
+
+} // namespace terminal
+} // namespace vte
+
+#define VTE_TEST_FLAG_DECRQCRA (G_GUINT64_CONSTANT(1) << 0)
+
+extern uint64_t g_test_flags;
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Feeds text of various scripts to a terminal and reports how fast it
+ * gets processed: plain ASCII like a build log, CJK, emoji (including
+ * ZWJ sequences and variation selectors, which combine), and a mix of
+ * them with SGR sequences in between.
+ *
+ * The terminal isn't shown, so this measures the processing of the
+ * input, not the drawing. Each stream ends in setting the window
+ * title, to tell when it's been processed.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+#include <gtk/gtk.h>
+#include <vte/vte.h>
+
+static constexpr size_t const k_stream_size = 8 * 1024 * 1024;
+
+struct Stream {
+        char const* name;
+        std::vector<char const*> lines;
+};
+
+static Stream const k_streams[] = {
+        { "ascii", {
+                        "make[2]: Entering directory '/home/user/src/vte/src'\r\n",
+                        "  CXX      libvte_2_91_la-vte.lo\r\n",
+                        "Jan  1 12:00:00 host systemd[1]: Started Session 1 of user user.\r\n",
+                        "drwxr-xr-x  2 user user  4096 Jan  1 12:00 Documents\r\n",
+                } },
+        { "cjk", {
+                        "日本語のテキスト、ひらがなとカタカナと漢字。\r\n",
+                        "中文文本测试，繁體中文測試，还有一些更长的句子用于换行。\r\n",
+                        "한국어 텍스트 테스트입니다. 줄 바꿈을 위한 긴 문장입니다.\r\n",
+                } },
+        { "emoji", {
+                        "😀😃😄😁😆😅🤣😂🙂🙃😉😊😇🥰😍🤩😘😗☺️😚😙\r\n",
+                        "👨‍👩‍👧‍👦 👩‍💻 🏳️‍🌈 👍🏽 ❤️ ✨🎉🎊🚀🌍\r\n",
+                } },
+        { "mixed", {
+                        "\033[1;32mPASS\033[0m test_utf8 — ok ✓ 日本語 😀\r\n",
+                        "\033[31merror:\033[0m résumé café naïve — 中文 👍🏽\r\n",
+                        "  CXX      libvte_2_91_la-vteseq.lo\r\n",
+                } },
+};
+
+static std::string
+make_stream(Stream const& stream)
+{
+        std::string data;
+        while (data.size() < k_stream_size)
+                for (auto line : stream.lines)
+                        data.append(line);
+
+        return data;
+}
+
+static void
+window_title_changed_cb(VteTerminal* terminal,
+                        gpointer data)
+{
+        auto done = reinterpret_cast<bool*>(data);
+        auto const title = vte_terminal_get_window_title(terminal);
+        *done = title != nullptr && g_str_equal(title, "done");
+}
+
+static double
+run(VteTerminal* terminal,
+    std::string const& data)
+{
+        /* Start from a clean slate */
+        vte_terminal_reset(terminal, true, true);
+
+        bool done = false;
+        auto const id = g_signal_connect(terminal, "window-title-changed",
+                                         G_CALLBACK(window_title_changed_cb), &done);
+
+        auto const start = g_get_monotonic_time();
+        vte_terminal_feed(terminal, data.data(), data.size());
+        vte_terminal_feed(terminal, "\033]2;done\007", -1);
+        while (!done)
+                g_main_context_iteration(nullptr, true);
+        auto const elapsed = g_get_monotonic_time() - start;
+
+        g_signal_handler_disconnect(terminal, id);
+        vte_terminal_feed(terminal, "\033]2;\007", -1);
+
+        return data.size() / (1024. * 1024.) / (elapsed / double(G_USEC_PER_SEC));
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        int columns = 80;
+        int rows = 24;
+        int scrollback = 512;
+        int repeat = 3;
+        GOptionEntry const entries[] = {
+                { "columns", 'c', 0, G_OPTION_ARG_INT, &columns,
+                  "Number of columns", "COLUMNS" },
+                { "rows", 'r', 0, G_OPTION_ARG_INT, &rows,
+                  "Number of rows", "ROWS" },
+                { "scrollback", 's', 0, G_OPTION_ARG_INT, &scrollback,
+                  "Number of scrollback lines", "LINES" },
+                { "repeat", 'n', 0, G_OPTION_ARG_INT, &repeat,
+                  "Number of runs, of which the best counts", "N" },
+                { nullptr }
+        };
+
+        GError* error = nullptr;
+        if (!gtk_init_with_args(&argc, &argv, "— text insertion benchmark",
+                                entries, nullptr, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
+
+        auto terminal = VTE_TERMINAL(g_object_ref_sink(vte_terminal_new()));
+        vte_terminal_set_size(terminal, columns, rows);
+        vte_terminal_set_scrollback_lines(terminal, scrollback);
+
+        for (auto const& stream : k_streams) {
+                auto const data = make_stream(stream);
+
+                auto best = 0.;
+                for (auto i = 0; i < repeat; ++i)
+                        best = std::max(best, run(terminal, data));
+
+                g_print("%-8s %8.1f MB/s\n", stream.name, best);
+        }
+
+        g_object_unref(terminal);
+        return EXIT_SUCCESS;
+}
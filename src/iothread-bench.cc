@@ -0,0 +1,255 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures main loop wakeups and read() syscalls for many busy PTYs,
+ * once with a main loop source per PTY reading on the main thread
+ * (like Terminal::pty_io_read()), and once with the shared I/O thread.
+ * With the io_uring backend, reads/MB only counts the syscalls of PTYs
+ * that fell back to polling; completions/MB counts the reads the kernel
+ * did on its own.
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <termios.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "chunk.hh"
+#include "iothread.hh"
+#include "ptyreader.hh"
+
+using namespace vte::base;
+
+struct Pair {
+        int master{-1};
+        int slave{-1};
+        std::thread writer{};
+        std::unique_ptr<PtyReader> reader{};
+};
+
+static std::atomic<bool> g_stop_writers{false};
+static uint64_t g_n_main_reads = 0;
+static uint64_t g_n_bytes = 0;
+
+static bool
+open_pair(Pair& pair)
+{
+        pair.master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (pair.master == -1 ||
+            grantpt(pair.master) != 0 ||
+            unlockpt(pair.master) != 0)
+                return false;
+
+        pair.slave = open(ptsname(pair.master), O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (pair.slave == -1)
+                return false;
+
+        /* No output processing, so the byte counts match */
+        struct termios tios;
+        tcgetattr(pair.slave, &tios);
+        cfmakeraw(&tios);
+        tcsetattr(pair.slave, TCSANOW, &tios);
+
+        /* Like VtePty does */
+        int one = 1;
+        ioctl(pair.master, TIOCPKT, &one);
+
+        return true;
+}
+
+static void
+run_writer(int fd)
+{
+        char buf[4096];
+        for (size_t i = 0; i < sizeof(buf); ++i)
+                buf[i] = 'a' + i % 26;
+
+        while (!g_stop_writers.load(std::memory_order_relaxed)) {
+                if (write(fd, buf, sizeof(buf)) == -1 && errno != EINTR)
+                        break;
+        }
+}
+
+static gboolean
+direct_read_cb(int fd,
+               GIOCondition condition,
+               gpointer data)
+{
+        /* One chunk per dispatch, like pty_io_read() does */
+        char buf[Chunk::k_chunk_size];
+        auto ret = read(fd, buf, sizeof(buf));
+        ++g_n_main_reads;
+        if (ret > 1)
+                g_n_bytes += ret - 1;
+
+        return ret != 0;
+}
+
+static bool
+reader_cb(void* data)
+{
+        auto reader = reinterpret_cast<Pair*>(data)->reader.get();
+        while (auto chunk = reader->pop())
+                g_n_bytes += chunk->len;
+        reader->refill_free_chunks();
+
+        return true;
+}
+
+static void
+run(bool use_iothread,
+    unsigned int n_terminals,
+    double seconds)
+{
+        std::vector<Pair> pairs(n_terminals);
+        for (auto& pair : pairs) {
+                if (!open_pair(pair)) {
+                        g_printerr("Failed to open PTY: %s\n", g_strerror(errno));
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        std::vector<guint> sources;
+        for (auto& pair : pairs) {
+                if (use_iothread) {
+                        pair.reader = std::make_unique<PtyReader>(pair.master, reader_cb, &pair);
+                        if (!pair.reader->start()) {
+                                g_printerr("Failed to start I/O thread\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        pair.reader->connect();
+                } else {
+                        sources.push_back(g_unix_fd_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                                             pair.master,
+                                                             (GIOCondition)(G_IO_IN | G_IO_PRI),
+                                                             direct_read_cb,
+                                                             nullptr, nullptr));
+                }
+        }
+
+        g_stop_writers = false;
+        g_n_main_reads = g_n_bytes = 0;
+        auto const stats_before = IOThread::stats();
+
+        for (auto& pair : pairs)
+                pair.writer = std::thread(run_writer, pair.slave);
+
+        auto context = g_main_context_default();
+        uint64_t n_wakeups = 0;
+        auto timer = g_timer_new();
+        while (g_timer_elapsed(timer, nullptr) < seconds) {
+                g_main_context_iteration(context, TRUE);
+                ++n_wakeups;
+        }
+        auto const elapsed = g_timer_elapsed(timer, nullptr);
+        g_timer_destroy(timer);
+
+        auto const stats_after = IOThread::stats();
+        /* Only known while the I/O thread exists */
+        auto const backend = IOThread::backend_name();
+
+        /* Closing the masters makes the blocked writers fail */
+        g_stop_writers = true;
+        for (auto& pair : pairs)
+                pair.reader.reset();
+        for (auto tag : sources)
+                g_source_remove(tag);
+        for (auto& pair : pairs)
+                close(pair.master);
+        for (auto& pair : pairs) {
+                pair.writer.join();
+                close(pair.slave);
+        }
+
+        auto n_reads = g_n_main_reads + (stats_after.n_reads - stats_before.n_reads);
+        auto const mb = g_n_bytes / (1024. * 1024.);
+
+        auto const n_completions = stats_after.n_completions - stats_before.n_completions;
+
+        g_print("%-8s terminals %4u: %8.1f MB/s %10.0f wakeups/s %8.1f reads/MB %8.1f completions/MB\n",
+                use_iothread ? backend : "direct",
+                n_terminals,
+                mb / elapsed,
+                n_wakeups / elapsed,
+                mb > 0 ? n_reads / mb : 0.,
+                mb > 0 ? n_completions / mb : 0.);
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        int n_terminals = 0;
+        double seconds = 2.;
+        char* mode = nullptr;
+        GOptionEntry const entries[] = {
+                { "terminals", 'n', 0, G_OPTION_ARG_INT, &n_terminals,
+                  "Number of busy terminals (default: 1, 50 and 500)", "N" },
+                { "seconds", 's', 0, G_OPTION_ARG_DOUBLE, &seconds,
+                  "Seconds to run each configuration", "SECONDS" },
+                { "mode", 'm', 0, G_OPTION_ARG_STRING, &mode,
+                  "Only run one mode (direct or iothread)", "MODE" },
+                { nullptr }
+        };
+
+        auto context = g_option_context_new("— PTY I/O benchmark");
+        g_option_context_add_main_entries(context, entries, nullptr);
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        /* Two fds per terminal, plus some */
+        struct rlimit rlim;
+        if (getrlimit(RLIMIT_NOFILE, &rlim) == 0) {
+                rlim.rlim_cur = rlim.rlim_max;
+                setrlimit(RLIMIT_NOFILE, &rlim);
+        }
+
+        std::vector<unsigned int> counts;
+        if (n_terminals > 0)
+                counts.push_back(n_terminals);
+        else
+                counts = {1, 50, 500};
+
+        for (auto n : counts) {
+                if (mode == nullptr || g_str_equal(mode, "direct"))
+                        run(false, n, seconds);
+                if (mode == nullptr || g_str_equal(mode, "iothread"))
+                        run(true, n, seconds);
+        }
+
+        g_free(mode);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,875 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "iothread.hh"
+#include "ptyreader.hh"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_SYS_TERMIOS_H
+#include <sys/termios.h>
+#endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef WITH_IO_URING
+#include <liburing.h>
+#endif
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "debug.h"
+#include "vtedefines.hh"
+
+namespace vte {
+
+namespace base {
+
+IOThread* IOThread::s_instance = nullptr;
+
+std::atomic<uint64_t> IOThread::s_n_wakeups{0};
+std::atomic<uint64_t> IOThread::s_n_batches{0};
+std::atomic<uint64_t> IOThread::s_n_reads{0};
+std::atomic<uint64_t> IOThread::s_n_completions{0};
+std::atomic<uint64_t> IOThread::s_n_bytes{0};
+
+#ifdef WITH_IO_URING
+
+/*
+ * IOThread::IOUring:
+ *
+ * The io_uring backend. All PTYs share one buffer ring, whose buffers
+ * are Chunks; each buffer starts at the chunk's dataminusone byte, so
+ * that the TIOCPKT header byte lands there and the data in data[]. A
+ * completed read hands its chunk to the reader's queue as-is, and a
+ * fresh chunk takes its place in the ring.
+ *
+ * All of this runs on the I/O thread, except for the constructor and
+ * destructor.
+ */
+class IOThread::IOUring {
+public:
+        IOUring(IOThread* iothread) noexcept :
+                m_iothread{iothread}
+        {
+        }
+
+        ~IOUring() noexcept;
+
+        IOUring(IOUring const&) = delete;
+        IOUring(IOUring&&) = delete;
+        IOUring& operator= (IOUring const&) = delete;
+        IOUring& operator= (IOUring&&) = delete;
+
+        bool init() noexcept;
+        void run() noexcept;
+
+private:
+        static constexpr unsigned int const k_ring_entries = 256;
+        static constexpr unsigned int const k_n_buffers = 64; /* must be a power of 2 */
+        static constexpr int const k_buffer_group = 0;
+
+        /* user_data for requests whose completions are ignored; ID 0 is the control pipe */
+        static constexpr uint64_t const k_ignore_data = UINT64_MAX;
+
+        struct io_uring_sqe* get_sqe() noexcept;
+        void arm(PtyReader* reader) noexcept;
+        void cancel(uint64_t id) noexcept;
+        void arm_control() noexcept;
+        void provide_buffer(unsigned int bid,
+                            Chunk* chunk) noexcept;
+        void complete(struct io_uring_cqe const* cqe,
+                      uint64_t& n_reads,
+                      uint64_t& n_completions,
+                      uint64_t& n_bytes,
+                      bool& notify) noexcept;
+        void update(PtyReader* reader) noexcept;
+        void process_requests(bool& notify) noexcept;
+
+        IOThread* m_iothread;
+        struct io_uring m_ring;
+        bool m_ring_inited{false};
+        struct io_uring_buf_ring* m_buf_ring{nullptr};
+        Chunk* m_chunks[k_n_buffers]{};
+        unsigned int m_n_provided{0};
+};
+
+IOThread::IOUring::~IOUring() noexcept
+{
+        /* This also cancels all outstanding requests */
+        if (m_buf_ring != nullptr)
+                io_uring_free_buf_ring(&m_ring, m_buf_ring, k_n_buffers, k_buffer_group);
+        if (m_ring_inited)
+                io_uring_queue_exit(&m_ring);
+
+        for (auto chunk : m_chunks)
+                delete chunk;
+}
+
+bool
+IOThread::IOUring::init() noexcept
+{
+        auto ret = io_uring_queue_init(k_ring_entries, &m_ring, 0);
+        if (ret < 0) {
+                _vte_debug_print(VTE_DEBUG_IO, "io_uring not available: %s\n", g_strerror(-ret));
+                return false;
+        }
+        m_ring_inited = true;
+
+        auto probe = io_uring_get_probe_ring(&m_ring);
+        auto const supported = probe != nullptr &&
+                io_uring_opcode_supported(probe, IORING_OP_READ_MULTISHOT) &&
+                io_uring_opcode_supported(probe, IORING_OP_POLL_ADD) &&
+                io_uring_opcode_supported(probe, IORING_OP_ASYNC_CANCEL);
+        if (probe != nullptr)
+                io_uring_free_probe(probe);
+        if (!supported) {
+                _vte_debug_print(VTE_DEBUG_IO, "io_uring lacks multishot reads\n");
+                return false;
+        }
+
+        m_buf_ring = io_uring_setup_buf_ring(&m_ring, k_n_buffers, k_buffer_group, 0, &ret);
+        if (m_buf_ring == nullptr) {
+                _vte_debug_print(VTE_DEBUG_IO, "Failed to register buffer ring: %s\n", g_strerror(-ret));
+                return false;
+        }
+
+        for (auto bid = 0u; bid < k_n_buffers; ++bid)
+                provide_buffer(bid, Chunk::get().release());
+        io_uring_buf_ring_advance(m_buf_ring, m_n_provided);
+        m_n_provided = 0;
+
+        arm_control();
+        return true;
+}
+
+struct io_uring_sqe*
+IOThread::IOUring::get_sqe() noexcept
+{
+        auto sqe = io_uring_get_sqe(&m_ring);
+        if (G_UNLIKELY(sqe == nullptr)) {
+                /* Submission queue full; make room */
+                io_uring_submit(&m_ring);
+                sqe = io_uring_get_sqe(&m_ring);
+        }
+
+        g_assert(sqe != nullptr);
+        return sqe;
+}
+
+void
+IOThread::IOUring::arm(PtyReader* reader) noexcept
+{
+        auto sqe = get_sqe();
+        if (reader->m_poll_mode)
+                io_uring_prep_poll_add(sqe, reader->fd(), POLLIN | POLLPRI);
+        else
+                io_uring_prep_read_multishot(sqe, reader->fd(), 0, 0, k_buffer_group);
+        io_uring_sqe_set_data64(sqe, reader->m_id);
+
+        reader->m_armed = true;
+}
+
+void
+IOThread::IOUring::cancel(uint64_t id) noexcept
+{
+        auto sqe = get_sqe();
+        io_uring_prep_cancel64(sqe, id, 0);
+        io_uring_sqe_set_data64(sqe, k_ignore_data);
+}
+
+void
+IOThread::IOUring::arm_control() noexcept
+{
+        auto sqe = get_sqe();
+        io_uring_prep_poll_multishot(sqe, m_iothread->m_control_pipe[0], POLLIN);
+        io_uring_sqe_set_data64(sqe, 0);
+}
+
+/* The kernel only sees the buffers once the ring is advanced, which
+ * happens once per batch of completions.
+ */
+void
+IOThread::IOUring::provide_buffer(unsigned int bid,
+                                  Chunk* chunk) noexcept
+{
+        m_chunks[bid] = chunk;
+        io_uring_buf_ring_add(m_buf_ring,
+                              &chunk->dataminusone,
+                              chunk->capacity() + 1,
+                              bid,
+                              io_uring_buf_ring_mask(k_n_buffers),
+                              m_n_provided++);
+}
+
+/* Re-arms or cancels @reader's request according to its queue state.
+ * Called with the lock held.
+ */
+void
+IOThread::IOUring::update(PtyReader* reader) noexcept
+{
+        if (reader->eof() || reader->eof_pending())
+                return;
+
+        if (m_iothread->check_blocked(reader)) {
+                /* Reads that complete before the cancellation go to the
+                 * overflow list.
+                 */
+                if (reader->m_armed)
+                        cancel(reader->m_id);
+        } else if (!reader->m_armed) {
+                arm(reader);
+        }
+}
+
+/* Called with the lock held */
+void
+IOThread::IOUring::complete(struct io_uring_cqe const* cqe,
+                            uint64_t& n_reads,
+                            uint64_t& n_completions,
+                            uint64_t& n_bytes,
+                            bool& notify) noexcept
+{
+        auto const id = io_uring_cqe_get_data64(cqe);
+        auto const res = cqe->res;
+
+        if (id == 0) {
+                char buf[64];
+                while (read(m_iothread->m_control_pipe[0], buf, sizeof(buf)) > 0)
+                        ;
+                if (!(cqe->flags & IORING_CQE_F_MORE))
+                        arm_control();
+                return;
+        }
+        if (id == k_ignore_data)
+                return;
+
+        auto it = m_iothread->m_readers.find(id);
+        auto reader = it != m_iothread->m_readers.end() ? it->second : nullptr;
+        bool is_new = false;
+
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+                auto const bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                auto chunk = m_chunks[bid];
+                auto replacement = chunk;
+
+                if (reader != nullptr && res > 0) {
+                        auto const pkt_header = chunk->dataminusone;
+                        unsigned int events = 0;
+                        if (pkt_header & TIOCPKT_IOCTL)
+                                events |= PtyReader::ePacketIoctl;
+                        if (pkt_header & TIOCPKT_STOP)
+                                events |= PtyReader::ePacketStop;
+                        else if (pkt_header & TIOCPKT_START)
+                                events |= PtyReader::ePacketStart;
+                        if (events != 0) {
+                                reader->m_packet_events.fetch_or(events);
+                                is_new = true;
+                        }
+
+                        chunk->len = res - 1;
+                        if (chunk->len > 0) {
+                                reader->queue_chunk(chunk);
+                                replacement = reader->get_free_chunk();
+                                n_bytes += chunk->len;
+                                is_new = true;
+                        }
+                        ++n_completions;
+                }
+
+                replacement->reset();
+                provide_buffer(bid, replacement);
+        }
+
+        if (reader == nullptr)
+                return;
+
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+                reader->m_armed = false;
+
+        if (reader->m_poll_mode && res > 0) {
+                is_new |= reader->read_batch(k_max_chunks_per_read, n_reads, n_bytes);
+        } else if (res == 0 ||
+                   (res < 0 &&
+                    res != -ENOBUFS && /* ran out of buffers; re-armed below */
+                    res != -ECANCELED &&
+                    res != -EAGAIN &&
+                    res != -EINTR)) {
+                if (!reader->m_poll_mode &&
+                    (res == -EINVAL || res == -EOPNOTSUPP || res == -EBADFD)) {
+                        /* This fd doesn't do multishot reads */
+                        _vte_debug_print(VTE_DEBUG_IO, "Multishot read on fd %d failed, polling instead\n",
+                                         reader->fd());
+                        reader->m_poll_mode = true;
+                } else {
+                        /* EIO is how a hung-up PTY shows up; fake an EOF */
+                        if (res < 0 && res != -EIO)
+                                reader->m_errno.store(-res, std::memory_order_release);
+                        reader->set_eof();
+                        is_new = true;
+                }
+        }
+
+        if (is_new)
+                m_iothread->mark_ready(reader, notify);
+
+        update(reader);
+}
+
+/* Handles requests from the main thread. Called with the lock held. */
+void
+IOThread::IOUring::process_requests(bool& notify) noexcept
+{
+        for (auto const id : m_iothread->m_cancel_requests)
+                cancel(id);
+        m_iothread->m_cancel_requests.clear();
+
+        for (auto const id : m_iothread->m_arm_requests) {
+                auto it = m_iothread->m_readers.find(id);
+                if (it == m_iothread->m_readers.end())
+                        continue;
+
+                auto reader = it->second;
+                auto const had_overflow = !reader->m_overflow.empty();
+                reader->flush_overflow();
+                if (had_overflow)
+                        m_iothread->mark_ready(reader, notify);
+
+                update(reader);
+        }
+        m_iothread->m_arm_requests.clear();
+}
+
+void
+IOThread::IOUring::run() noexcept
+{
+        while (!m_iothread->m_stop.load(std::memory_order_acquire)) {
+                auto ret = io_uring_submit_and_wait(&m_ring, 1);
+                if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+                        g_warning("io_uring_submit_and_wait failed: %s", g_strerror(-ret));
+                        break;
+                }
+
+                uint64_t n_reads = 0, n_completions = 0, n_bytes = 0;
+                bool notify = false;
+
+                {
+                        std::lock_guard<std::mutex> lock{m_iothread->m_lock};
+
+                        struct io_uring_cqe* cqe;
+                        unsigned int head, n_cqes = 0;
+                        io_uring_for_each_cqe(&m_ring, head, cqe) {
+                                complete(cqe, n_reads, n_completions, n_bytes, notify);
+                                ++n_cqes;
+                        }
+                        io_uring_cq_advance(&m_ring, n_cqes);
+
+                        process_requests(notify);
+
+                        if (m_n_provided > 0) {
+                                io_uring_buf_ring_advance(m_buf_ring, m_n_provided);
+                                m_n_provided = 0;
+                        }
+                }
+
+                s_n_batches.fetch_add(1, std::memory_order_relaxed);
+                s_n_reads.fetch_add(n_reads, std::memory_order_relaxed);
+                s_n_completions.fetch_add(n_completions, std::memory_order_relaxed);
+                s_n_bytes.fetch_add(n_bytes, std::memory_order_relaxed);
+
+                /* One wakeup for the whole batch */
+                if (notify)
+                        m_iothread->notify_main();
+        }
+}
+
+#endif /* WITH_IO_URING */
+
+IOThread*
+IOThread::ref() noexcept
+{
+        if (s_instance == nullptr) {
+                auto iothread = new IOThread{};
+                if (!iothread->start()) {
+                        delete iothread;
+                        return nullptr;
+                }
+
+                s_instance = iothread;
+        }
+
+        ++s_instance->m_refcount;
+        return s_instance;
+}
+
+void
+IOThread::unref() noexcept
+{
+        g_assert(m_refcount > 0);
+        if (--m_refcount > 0)
+                return;
+
+        if (s_instance == this)
+                s_instance = nullptr;
+        delete this;
+}
+
+IOThread::Stats
+IOThread::stats() noexcept
+{
+        return Stats{s_n_wakeups.load(),
+                     s_n_batches.load(),
+                     s_n_reads.load(),
+                     s_n_completions.load(),
+                     s_n_bytes.load()};
+}
+
+char const*
+IOThread::backend_name() noexcept
+{
+        if (s_instance == nullptr)
+                return "none";
+
+        return s_instance->m_backend == Backend::eIOUring ? "io_uring" : "epoll";
+}
+
+IOThread::~IOThread() noexcept
+{
+        if (m_thread.joinable()) {
+                m_stop.store(true, std::memory_order_release);
+                signal_thread();
+                m_thread.join();
+                _vte_debug_print(VTE_DEBUG_IO, "Stopped I/O thread\n");
+        }
+
+#ifdef WITH_IO_URING
+        delete m_uring;
+#endif
+
+        if (m_source != 0)
+                g_source_remove(m_source);
+
+        for (auto fd : {m_epoll_fd,
+                        m_wakeup_pipe[0], m_wakeup_pipe[1],
+                        m_control_pipe[0], m_control_pipe[1]}) {
+                if (fd != -1)
+                        close(fd);
+        }
+}
+
+bool
+IOThread::start() noexcept
+{
+        if (!g_unix_open_pipe(m_wakeup_pipe, FD_CLOEXEC, nullptr) ||
+            !g_unix_open_pipe(m_control_pipe, FD_CLOEXEC, nullptr))
+                return false;
+
+        for (auto fd : {m_wakeup_pipe[0], m_wakeup_pipe[1],
+                        m_control_pipe[0], m_control_pipe[1]})
+                g_unix_set_fd_nonblocking(fd, true, nullptr);
+
+#ifdef WITH_IO_URING
+        m_uring = new IOUring{this};
+        if (m_uring->init()) {
+                m_backend = Backend::eIOUring;
+        } else {
+                delete m_uring;
+                m_uring = nullptr;
+        }
+#endif
+
+        if (m_backend == Backend::eEpoll && !start_epoll())
+                return false;
+
+        m_source = g_unix_fd_add_full(VTE_CHILD_INPUT_PRIORITY,
+                                      m_wakeup_pipe[0],
+                                      G_IO_IN,
+                                      (GUnixFDSourceFunc)dispatch_cb,
+                                      this,
+                                      nullptr);
+
+        m_thread = std::thread(&IOThread::run, this);
+
+        _vte_debug_print(VTE_DEBUG_IO, "Started I/O thread using %s\n",
+                         m_backend == Backend::eIOUring ? "io_uring" : "epoll");
+        return true;
+}
+
+bool
+IOThread::start_epoll() noexcept
+{
+#ifdef HAVE_SYS_EPOLL_H
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epoll_fd == -1) {
+                g_warning("Failed to create epoll instance: %s", g_strerror(errno));
+                return false;
+        }
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = 0;
+        return epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_control_pipe[0], &event) == 0;
+#else
+        return false;
+#endif
+}
+
+bool
+IOThread::add(PtyReader* reader) noexcept
+{
+        {
+                std::lock_guard<std::mutex> lock{m_lock};
+
+                reader->m_id = m_next_id++;
+                m_readers.emplace(reader->m_id, reader);
+
+#ifdef WITH_IO_URING
+                if (m_backend == Backend::eIOUring)
+                        m_arm_requests.push_back(reader->m_id);
+                else
+#endif
+                if (!watch(reader)) {
+                        g_warning("Failed to watch fd %d: %s", reader->fd(), g_strerror(errno));
+                        m_readers.erase(reader->m_id);
+                        return false;
+                }
+        }
+
+        if (m_backend == Backend::eIOUring)
+                signal_thread();
+
+        return true;
+}
+
+void
+IOThread::remove(PtyReader* reader) noexcept
+{
+        {
+                std::lock_guard<std::mutex> lock{m_lock};
+
+#ifdef WITH_IO_URING
+                if (m_backend == Backend::eIOUring) {
+                        /* Completions for unknown IDs only recycle their buffer */
+                        m_arm_requests.erase(std::remove(m_arm_requests.begin(), m_arm_requests.end(), reader->m_id),
+                                             m_arm_requests.end());
+                        if (reader->m_armed)
+                                m_cancel_requests.push_back(reader->m_id);
+                } else
+#endif
+                unwatch(reader);
+
+                m_readers.erase(reader->m_id);
+                m_ready.erase(std::remove(m_ready.begin(), m_ready.end(), reader->m_id),
+                              m_ready.end());
+                reader->m_ready.store(false);
+        }
+
+        if (m_backend == Backend::eIOUring)
+                signal_thread();
+}
+
+void
+IOThread::rearm(PtyReader* reader) noexcept
+{
+        {
+                std::lock_guard<std::mutex> lock{m_lock};
+
+                if (m_readers.find(reader->m_id) == m_readers.end() ||
+                    reader->eof())
+                        return;
+
+#ifdef WITH_IO_URING
+                /* The I/O thread flushes the overflow list and re-arms */
+                if (m_backend == Backend::eIOUring)
+                        m_arm_requests.push_back(reader->m_id);
+                else
+#endif
+                if (!watch(reader) && errno != EEXIST)
+                        g_warning("Failed to watch fd %d: %s", reader->fd(), g_strerror(errno));
+        }
+
+        if (m_backend == Backend::eIOUring)
+                signal_thread();
+}
+
+void
+IOThread::queue_ready(PtyReader* reader) noexcept
+{
+        {
+                std::lock_guard<std::mutex> lock{m_lock};
+
+                if (m_readers.find(reader->m_id) == m_readers.end() ||
+                    reader->m_ready.exchange(true))
+                        return;
+
+                m_ready.push_back(reader->m_id);
+        }
+
+        notify_main();
+}
+
+/* Called with the lock held */
+bool
+IOThread::watch(PtyReader* reader) noexcept
+{
+#ifdef HAVE_SYS_EPOLL_H
+        /* Level-triggered, so that a PTY that still has data after its
+         * share of this round is simply reported again next round.
+         * EPOLLPRI is how TIOCPKT events show up.
+         */
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLPRI;
+        event.data.u64 = reader->m_id;
+        return epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, reader->fd(), &event) == 0;
+#else
+        return false;
+#endif
+}
+
+/* Called with the lock held */
+void
+IOThread::unwatch(PtyReader* reader) noexcept
+{
+#ifdef HAVE_SYS_EPOLL_H
+        /* Removing the fd altogether, instead of just clearing the
+         * events, since EPOLLHUP is always reported.
+         */
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, reader->fd(), nullptr);
+#endif
+}
+
+/* Returns whether @reader's queue is full, in which case it must not
+ * be read from until the main thread has popped a chunk (see
+ * PtyReader::pop()).
+ * This runs on the I/O thread, with the lock held.
+ */
+bool
+IOThread::check_blocked(PtyReader* reader) noexcept
+{
+        while (reader->flush_overflow()) {
+                if (!reader->queue_full())
+                        return false;
+
+                reader->m_blocked.store(true);
+                /* Pairs with the fence in PtyReader::pop() */
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (reader->queue_full())
+                        return true;
+
+                reader->m_blocked.store(false);
+        }
+
+        /* Still overflowing, so the queue is full */
+        reader->m_blocked.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (reader->queue_full())
+                return true;
+
+        /* The main thread popped in the meantime, try again */
+        reader->m_blocked.store(false);
+        return check_blocked(reader);
+}
+
+/* Called with the lock held */
+void
+IOThread::mark_ready(PtyReader* reader,
+                     bool& notify) noexcept
+{
+        if (reader->m_ready.exchange(true))
+                return;
+
+        m_ready.push_back(reader->m_id);
+        notify = true;
+}
+
+void
+IOThread::signal_thread() noexcept
+{
+        char c = 0;
+        if (write(m_control_pipe[1], &c, 1) == -1 && errno != EAGAIN)
+                g_warning("Failed to signal the I/O thread: %s", g_strerror(errno));
+}
+
+void
+IOThread::notify_main() noexcept
+{
+        if (m_wakeup_pending.exchange(true))
+                return;
+
+        char c = 0;
+        if (write(m_wakeup_pipe[1], &c, 1) == -1 && errno != EAGAIN)
+                g_warning("Failed to wake up the main loop: %s", g_strerror(errno));
+}
+
+/* This runs on the I/O thread, with the lock held */
+void
+IOThread::read_ready(PtyReader* reader,
+                     uint64_t& n_reads,
+                     uint64_t& n_bytes,
+                     bool& notify) noexcept
+{
+        if (reader->read_batch(k_max_chunks_per_read, n_reads, n_bytes))
+                mark_ready(reader, notify);
+
+        if (reader->eof()) {
+                unwatch(reader);
+                return;
+        }
+
+        /* Stop polling the PTY while the queue is full, so that the
+         * kernel buffer fills up and the child gets blocked.
+         */
+        if (check_blocked(reader))
+                unwatch(reader);
+}
+
+/* This runs on the I/O thread */
+void
+IOThread::run() noexcept
+{
+#ifdef WITH_IO_URING
+        if (m_backend == Backend::eIOUring) {
+                m_uring->run();
+                return;
+        }
+#endif
+
+        run_epoll();
+}
+
+void
+IOThread::run_epoll() noexcept
+{
+#ifdef HAVE_SYS_EPOLL_H
+        struct epoll_event events[k_max_events];
+
+        while (!m_stop.load(std::memory_order_acquire)) {
+                auto n_events = epoll_wait(m_epoll_fd, events, G_N_ELEMENTS(events), -1);
+                if (n_events == -1) {
+                        if (errno == EINTR)
+                                continue;
+
+                        g_warning("epoll_wait failed: %s", g_strerror(errno));
+                        break;
+                }
+
+                uint64_t n_reads = 0, n_bytes = 0;
+                bool notify = false;
+
+                {
+                        std::lock_guard<std::mutex> lock{m_lock};
+
+                        for (auto i = 0; i < n_events; ++i) {
+                                auto const id = events[i].data.u64;
+                                if (id == 0) {
+                                        char buf[64];
+                                        while (read(m_control_pipe[0], buf, sizeof(buf)) > 0)
+                                                ;
+                                        continue;
+                                }
+
+                                auto it = m_readers.find(id);
+                                if (it == m_readers.end())
+                                        continue;
+
+                                read_ready(it->second, n_reads, n_bytes, notify);
+                        }
+                }
+
+                s_n_batches.fetch_add(1, std::memory_order_relaxed);
+                s_n_reads.fetch_add(n_reads, std::memory_order_relaxed);
+                s_n_bytes.fetch_add(n_bytes, std::memory_order_relaxed);
+
+                /* One wakeup for the whole batch */
+                if (notify)
+                        notify_main();
+        }
+#endif
+}
+
+void
+IOThread::dispatch() noexcept
+{
+        char buf[64];
+        while (read(m_wakeup_pipe[0], buf, sizeof(buf)) > 0)
+                ;
+
+        /* Clear this before taking the ready list, so that anything
+         * queued from now on triggers a new wakeup.
+         */
+        m_wakeup_pending.store(false, std::memory_order_seq_cst);
+        s_n_wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        std::vector<uint64_t> ready;
+        {
+                std::lock_guard<std::mutex> lock{m_lock};
+                ready.swap(m_ready);
+        }
+
+        for (auto const id : ready) {
+                /* Callbacks may remove any reader, including their own */
+                PtyReader* reader;
+                {
+                        std::lock_guard<std::mutex> lock{m_lock};
+                        auto it = m_readers.find(id);
+                        if (it == m_readers.end())
+                                continue;
+                        reader = it->second;
+                }
+
+                /* Clear this before the callback collects the data, so
+                 * that anything read from now on queues the reader again.
+                 */
+                reader->m_ready.store(false);
+                if (!reader->m_connected)
+                        continue;
+
+                if (reader->m_callback(reader->m_callback_data))
+                        continue;
+
+                std::lock_guard<std::mutex> lock{m_lock};
+                auto it = m_readers.find(id);
+                if (it != m_readers.end())
+                        it->second->m_connected = false;
+        }
+}
+
+gboolean
+IOThread::dispatch_cb(int fd,
+                      GIOCondition condition,
+                      gpointer data) noexcept
+{
+        auto that = reinterpret_cast<IOThread*>(data);
+
+        /* The last reader may go away during the dispatch */
+        ++that->m_refcount;
+        that->dispatch();
+        that->unref();
+
+        return G_SOURCE_CONTINUE;
+}
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,160 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+
+namespace vte {
+
+namespace base {
+
+class PtyReader;
+
+/*
+ * IOThread:
+ *
+ * A single process-wide thread that polls the PTY masters of all
+ * PtyReaders with epoll, and reads the readable ones in batches.
+ *
+ * When built with io_uring support and the kernel supports it, the
+ * thread instead keeps a multishot read posted for each PTY, reading
+ * into a ring of Chunks registered with the kernel, so that the data
+ * lands directly in chunks without a syscall per read. If that isn't
+ * available, it falls back to epoll.
+ *
+ * The main loop has a single source watching a wakeup pipe, which
+ * the I/O thread writes to at most once per batch, no matter how
+ * many PTYs had data; the main thread then dispatches all the
+ * readers that became ready.
+ *
+ * The instance is reference counted by the PtyReaders using it, and
+ * only exists (and only has a thread running) while there are any.
+ * Apart from the read callbacks, everything here is main-thread only.
+ */
+class IOThread {
+public:
+        /* Process-wide counters, for benchmarking */
+        struct Stats {
+                uint64_t n_wakeups;  /* main loop wakeups */
+                uint64_t n_batches;  /* I/O thread rounds */
+                uint64_t n_reads;    /* read() syscalls */
+                uint64_t n_completions; /* io_uring read completions */
+                uint64_t n_bytes;    /* bytes read */
+        };
+
+        enum class Backend {
+                eEpoll,
+                eIOUring,
+        };
+
+        static IOThread* ref() noexcept;
+        void unref() noexcept;
+
+        bool add(PtyReader* reader) noexcept;
+        void remove(PtyReader* reader) noexcept;
+        void rearm(PtyReader* reader) noexcept;
+        void queue_ready(PtyReader* reader) noexcept;
+
+        static Stats stats() noexcept;
+        static char const* backend_name() noexcept;
+
+private:
+        /* Limit the amount read from one PTY per round, so as to
+         * maintain fairness between the PTYs.
+         */
+        static constexpr size_t const k_max_chunks_per_read = 4;
+        static constexpr size_t const k_max_events = 64;
+
+#ifdef WITH_IO_URING
+        class IOUring;
+#endif
+
+        IOThread() noexcept = default;
+        ~IOThread() noexcept;
+
+        IOThread(IOThread const&) = delete;
+        IOThread(IOThread&&) = delete;
+        IOThread& operator= (IOThread const&) = delete;
+        IOThread& operator= (IOThread&&) = delete;
+
+        bool start() noexcept;
+        bool start_epoll() noexcept;
+        void run() noexcept;
+        void run_epoll() noexcept;
+        void read_ready(PtyReader* reader,
+                        uint64_t& n_reads,
+                        uint64_t& n_bytes,
+                        bool& notify) noexcept;
+        bool watch(PtyReader* reader) noexcept;
+        void unwatch(PtyReader* reader) noexcept;
+        bool check_blocked(PtyReader* reader) noexcept;
+        void mark_ready(PtyReader* reader,
+                        bool& notify) noexcept;
+        void signal_thread() noexcept;
+        void notify_main() noexcept;
+        void dispatch() noexcept;
+
+        static gboolean dispatch_cb(int fd,
+                                    GIOCondition condition,
+                                    gpointer data) noexcept;
+
+        static IOThread* s_instance;
+
+        unsigned int m_refcount{0};
+        std::thread m_thread{};
+
+        Backend m_backend{Backend::eEpoll};
+#ifdef WITH_IO_URING
+        IOUring* m_uring{nullptr};
+        std::vector<uint64_t> m_arm_requests{};
+        std::vector<uint64_t> m_cancel_requests{};
+#endif
+        int m_epoll_fd{-1};
+        int m_wakeup_pipe[2]{-1, -1};  /* I/O thread → main */
+        int m_control_pipe[2]{-1, -1}; /* main → I/O thread */
+        guint m_source{0};
+
+        /* Readers are referred to by ID, so that stale epoll events and
+         * ready list entries for removed readers can be detected.
+         * ID 0 is the control pipe.
+         */
+        std::mutex m_lock{};
+        uint64_t m_next_id{1};
+        std::unordered_map<uint64_t, PtyReader*> m_readers{};
+        std::vector<uint64_t> m_ready{};
+
+        std::atomic<bool> m_stop{false};
+        std::atomic<bool> m_wakeup_pending{false};
+
+        static std::atomic<uint64_t> s_n_wakeups;
+        static std::atomic<uint64_t> s_n_batches;
+        static std::atomic<uint64_t> s_n_reads;
+        static std::atomic<uint64_t> s_n_completions;
+        static std::atomic<uint64_t> s_n_bytes;
+};
+
+} // namespace base
+
+} // namespace vte
@@ -239,14 +239,10 @@ private:
         {
                 size_t len;
                 auto buf = vte_seq_string_get(&seq->arg_str, &len);
-                long u8len;
-                auto u8str = g_ucs4_to_utf8(buf, len, nullptr, &u8len, nullptr);
 
                 m_str.push_back('\"');
-                m_str.append(u8str, size_t(u8len));
+                m_str.append(buf, len);
                 m_str.push_back('\"');
-
-                g_free(u8str);
         }
 
         void
@@ -424,6 +420,7 @@ private:
         gsize m_seq_stats[VTE_SEQ_N];
         gsize m_cmd_stats[VTE_CMD_N];
         GArray* m_bench_times;
+        bool m_switch{false};
 
         template<class Functor>
         void
@@ -469,7 +466,9 @@ private:
                                         /* Fall through to insert the U+FFFD replacement character. */
                                         [[fallthrough]];
                                 case vte::base::UTF8Decoder::ACCEPT: {
-                                        auto ret = vte_parser_feed(&parser, decoder.codepoint());
+                                        auto ret = m_switch ?
+                                                vte_parser_feed_switch(&parser, decoder.codepoint()) :
+                                                vte_parser_feed(&parser, decoder.codepoint());
                                         if (G_UNLIKELY(ret < 0)) {
                                                 g_printerr("Parser error!\n");
                                                 goto out;
@@ -523,7 +522,8 @@ private:
 
 public:
 
-        Processor() noexcept
+        Processor(bool use_switch = false) noexcept :
+                m_switch{use_switch}
         {
                 memset(&m_seq_stats, 0, sizeof(m_seq_stats));
                 memset(&m_cmd_stats, 0, sizeof(m_cmd_stats));
@@ -620,6 +620,7 @@ private:
         bool m_plain{false};
         bool m_quiet{false};
         bool m_statistics{false};
+        bool m_switch{false};
         int m_repeat{1};
         char** m_filenames{nullptr};
 
@@ -656,6 +657,7 @@ public:
         inline constexpr bool plain()      const noexcept { return m_plain;      }
         inline constexpr bool quiet()      const noexcept { return m_quiet;      }
         inline constexpr bool statistics() const noexcept { return m_statistics; }
+        inline constexpr bool use_switch() const noexcept { return m_switch;     }
         inline constexpr int  repeat()     const noexcept { return m_repeat;     }
         inline constexpr char const* const* filenames() const noexcept { return m_filenames; }
 
@@ -669,6 +671,7 @@ public:
                 BoolArg plain{&m_plain, false};
                 BoolArg quiet{&m_quiet, false};
                 BoolArg statistics{&m_statistics, false};
+                BoolArg use_switch{&m_switch, false};
                 IntArg repeat{&m_repeat, 1};
                 StrvArg filenames{&m_filenames, nullptr};
                 GOptionEntry const entries[] = {
@@ -686,6 +689,8 @@ public:
                           "Repeat each file COUNT times", "COUNT" },
                         { "statistics", 's', 0, G_OPTION_ARG_NONE, statistics.ptr(),
                           "Output statistics", nullptr },
+                        { "switch", 0, 0, G_OPTION_ARG_NONE, use_switch.ptr(),
+                          "Parse with the switch instead of the state tables, to compare", nullptr },
                         { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, filenames.ptr(),
                           nullptr, nullptr },
                         { nullptr },
@@ -717,7 +722,7 @@ main(int argc,
         }
 
         bool rv;
-        Processor proc{};
+        Processor proc{options.use_switch()};
         if (options.lint()) {
                 Linter linter{};
                 rv = proc.process_files(options.filenames(), 1, linter);
@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include <glib.h>
+
+#include "parser-glue.hh"
+#include "debug.h"
+#include "vtedefines.hh"
+
+void
+vte::parser::Sequence::print() const noexcept
+{
+#ifdef VTE_DEBUG
+        auto c = m_seq != nullptr ? terminator() : 0;
+        char c_buf[7];
+        g_snprintf(c_buf, sizeof(c_buf), "%lc", c);
+        g_printerr("%s:%s [%s]", type_string(), command_string(),
+                   g_unichar_isprint(c) ? c_buf : _vte_debug_sequence_to_string(c_buf, -1));
+        if (m_seq != nullptr && m_seq->n_args > 0) {
+                g_printerr("[ ");
+                for (unsigned int i = 0; i < m_seq->n_args; i++) {
+                        if (i > 0)
+                                g_print(", ");
+                        g_printerr("%d", vte_seq_arg_value(m_seq->args[i]));
+                }
+                g_printerr(" ]");
+        }
+        if (m_seq->type == VTE_SEQ_OSC) {
+                char* str = string_param();
+                g_printerr(" \"%s\"", str);
+                g_free(str);
+        }
+        g_printerr("\n");
+#endif
+}
+
+char const*
+vte::parser::Sequence::type_string() const
+{
+        if (G_UNLIKELY(m_seq == nullptr))
+                return "(nil)";
+
+        switch (type()) {
+        case VTE_SEQ_NONE:    return "NONE";
+        case VTE_SEQ_IGNORE:  return "IGNORE";
+        case VTE_SEQ_GRAPHIC: return "GRAPHIC";
+        case VTE_SEQ_CONTROL: return "CONTROL";
+        case VTE_SEQ_ESCAPE:  return "ESCAPE";
+        case VTE_SEQ_CSI:     return "CSI";
+        case VTE_SEQ_DCS:     return "DCS";
+        case VTE_SEQ_OSC:     return "OSC";
+        default:
+                g_assert(false);
+                return nullptr;
+        }
+}
+
+char const*
+vte::parser::Sequence::command_string() const
+{
+        if (G_UNLIKELY(m_seq == nullptr))
+                return "(nil)";
+
+        switch (command()) {
+#define _VTE_CMD(cmd) case VTE_CMD_##cmd: return #cmd;
+#define _VTE_NOP(cmd)
+#include "parser-cmd.hh"
+#undef _VTE_CMD
+#undef _VTE_NOP
+        default:
+                static char buf[32];
+                snprintf(buf, sizeof(buf), "NOP OR UNKOWN(%u)", command());
+                return buf;
+        }
+}
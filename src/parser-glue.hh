@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <algorithm>
 #include <string>
+#include <string_view>
 
 #include "parser.hh"
 
@@ -53,11 +54,22 @@ public:
                 return vte_parser_feed(&m_parser, raw);
         }
 
+        inline size_t feed_csi(uint8_t const* data,
+                               uint8_t const* end) noexcept
+        {
+                return vte_parser_feed_csi(&m_parser, data, end);
+        }
+
         inline void reset() noexcept
         {
                 vte_parser_reset(&m_parser);
         }
 
+        inline bool is_ground() const noexcept
+        {
+                return vte_parser_is_ground(&m_parser);
+        }
+
 protected:
         struct vte_parser m_parser;
 }; // class Parser
@@ -77,9 +89,6 @@ public:
 
         typedef int number;
 
-        char* ucs4_to_utf8(gunichar const* str,
-                           ssize_t len = -1) const noexcept;
-
         void print() const noexcept;
 
         /* type:
@@ -162,51 +171,51 @@ public:
                 return (introducer() & 0x80) != 0;
         }
 
-        // FIXMEchpe: upgrade to C++17 and use the u32string_view version below, instead
         /*
-         * string:
+         * string_utf8_view:
          *
-         * This is the string argument of a DCS or OSC sequence.
+         * This is the string argument of a DCS or OSC sequence, in UTF-8.
          *
-         * Returns: the string argument
+         * Returns: the string argument; only valid until the parser
+         *   is fed again
          */
-        inline std::u32string string() const noexcept
+        inline std::string_view string_utf8_view() const noexcept
         {
-                size_t len;
+                size_t len = 0;
                 auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-                return std::u32string(reinterpret_cast<char32_t*>(buf), len);
+                return std::string_view(buf, len);
         }
 
-        #if 0
         /*
-         * string:
-         *
-         * This is the string argument of a DCS or OSC sequence.
+         * string_utf8:
          *
-         * Returns: the string argument
+         * Returns: a copy of the string argument of a DCS or OSC sequence
          */
-        inline constexpr std::u32string_view string() const noexcept
+        inline std::string string_utf8() const noexcept
         {
-                size_t len = 0;
-                auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-                return std::u32string_view(buf, len);
+                return std::string{string_utf8_view()};
         }
-        #endif
 
         /*
          * string:
          *
-         * This is the string argument of a DCS or OSC sequence.
-         *
-         * Returns: the string argument
+         * Returns: the string argument of a DCS or OSC sequence, decoded
          */
-        std::string string_utf8() const noexcept;
+        inline std::u32string string() const noexcept
+        {
+                auto const str = string_utf8_view();
+
+                std::u32string ustr;
+                for (auto p = str.data(), end = str.data() + str.size(); p < end; p = g_utf8_next_char(p))
+                        ustr.push_back(g_utf8_get_char(p));
+
+                return ustr;
+        }
 
         inline char* string_param() const noexcept
         {
-                size_t len = 0;
-                auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-                return ucs4_to_utf8(buf, len);
+                auto const str = string_utf8_view();
+                return g_strndup(str.data(), str.size());
         }
 
         /* size:
@@ -273,6 +282,18 @@ public:
                 return std::clamp(v, min_v, max_v);
         }
 
+        /* param_raw:
+         * @idx:
+         *
+         * Returns: the parameter at @idx as the parser stored it, including
+         *   whether it is default or nonfinal; for comparing parameters
+         *   without interpreting them. @idx must be less than size().
+         */
+        inline constexpr vte_seq_arg_t param_raw(unsigned int idx) const noexcept
+        {
+                return m_seq->args[idx];
+        }
+
         /* param_nonfinal:
          * @idx:
          *
@@ -783,24 +804,24 @@ public:
 
 }; // class ReplyBuilder
 
+/*
+ * StringTokeniser:
+ *
+ * Splits a string at a separator, without copying it; only the tokens
+ * are copied out. The string must outlive the tokeniser and its iterators.
+ */
 class StringTokeniser {
 public:
         using string_type = std::string;
+        using string_view_type = std::string_view;
         using char_type = std::string::value_type;
 
 private:
-        string_type const& m_string;
+        string_view_type m_string;
         char_type m_separator{';'};
 
 public:
-        StringTokeniser(string_type& s,
-                        char_type separator = ';')
-                : m_string{s},
-                  m_separator{separator}
-        {
-        }
-
-        StringTokeniser(string_type&& s,
+        StringTokeniser(string_view_type s,
                         char_type separator = ';')
                 : m_string{s},
                   m_separator{separator}
@@ -826,31 +847,31 @@ public:
                 using pointer = string_type;
                 using reference = string_type;
                 using iterator_category = std::input_iterator_tag;
-                using size_type = string_type::size_type;
+                using size_type = string_view_type::size_type;
 
         private:
-                string_type const* m_string;
+                string_view_type m_string;
                 char_type m_separator{';'};
-                string_type::size_type m_position;
-                string_type::size_type m_next_separator;
+                size_type m_position;
+                size_type m_next_separator;
 
         public:
-                const_iterator(string_type const* str,
+                const_iterator(string_view_type str,
                                char_type separator,
                                size_type position)
                         : m_string{str},
                           m_separator{separator},
                           m_position{position},
-                          m_next_separator{m_string->find(m_separator, m_position)}
+                          m_next_separator{m_string.find(m_separator, m_position)}
                 {
                 }
 
-                const_iterator(string_type const* str,
+                const_iterator(string_view_type str,
                                char_type separator)
                         : m_string{str},
                           m_separator{separator},
-                          m_position{string_type::npos},
-                          m_next_separator{string_type::npos}
+                          m_position{string_view_type::npos},
+                          m_next_separator{string_view_type::npos}
                 {
                 }
 
@@ -876,7 +897,7 @@ public:
 
                 const_iterator& operator=(const_iterator&& o)
                 {
-                        m_string = std::move(o.m_string);
+                        m_string = o.m_string;
                         m_separator = o.m_separator;
                         m_position = o.m_position;
                         m_next_separator = o.m_next_separator;
@@ -895,11 +916,11 @@ public:
 
                 inline const_iterator& operator++() noexcept
                 {
-                        if (m_next_separator != string_type::npos) {
+                        if (m_next_separator != string_view_type::npos) {
                                 m_position = ++m_next_separator;
-                                m_next_separator = m_string->find(m_separator, m_position);
+                                m_next_separator = m_string.find(m_separator, m_position);
                         } else
-                                m_position = string_type::npos;
+                                m_position = string_view_type::npos;
 
                         return *this;
                 }
@@ -924,7 +945,7 @@ public:
                         v = 0;
                         size_type i;
                         for (i = 0; i < s; ++i) {
-                                char_type c = (*m_string)[m_position + i];
+                                char_type c = m_string[m_position + i];
                                 if (c < '0' || c > '9')
                                         return false;
 
@@ -939,20 +960,20 @@ public:
 
                 inline size_type size() const noexcept
                 {
-                        if (m_next_separator != string_type::npos)
+                        if (m_next_separator != string_view_type::npos)
                                 return m_next_separator - m_position;
                         else
-                                return m_string->size() - m_position;
+                                return m_string.size() - m_position;
                 }
 
                 inline size_type size_remaining() const noexcept
                 {
-                        return m_string->size() - m_position;
+                        return m_string.size() - m_position;
                 }
 
                 inline string_type operator*() const noexcept
                 {
-                        return m_string->substr(m_position, size());
+                        return string_type{m_string.substr(m_position, size())};
                 }
 
                 /*
@@ -962,29 +983,29 @@ public:
                  */
                 inline string_type string_remaining() const noexcept
                 {
-                        return m_string->substr(m_position);
+                        return string_type{m_string.substr(m_position)};
                 }
 
                 inline void append(string_type& str) const noexcept
                 {
-                        str.append(m_string->substr(m_position, size()));
+                        str.append(m_string.substr(m_position, size()));
                 }
 
                 inline void append_remaining(string_type& str) const noexcept
                 {
-                        str.append(m_string->substr(m_position));
+                        str.append(m_string.substr(m_position));
                 }
 
         }; // class const_iterator
 
         inline const_iterator cbegin(char_type c = ';') const noexcept
         {
-                return const_iterator(&m_string, m_separator, 0);
+                return const_iterator(m_string, m_separator, 0);
         }
 
         inline const_iterator cend() const noexcept
         {
-                return const_iterator(&m_string, m_separator);
+                return const_iterator(m_string, m_separator);
         }
 
         inline const_iterator begin(char_type c = ';') const noexcept
@@ -25,16 +25,21 @@
 /*
  * vte_seq_string_t:
  *
- * A type to hold the argument string of a DSC or OSC sequence.
+ * A type to hold the argument string of a DSC or OSC sequence, in UTF-8.
+ *
+ * The buffer is kept from one sequence to the next and only grows, up to
+ * the maximum length, so that once it has grown, collecting strings does
+ * no more allocations. A string exceeding the maximum length is dropped
+ * as soon as that's known, instead of being buffered in full.
  */
 typedef struct vte_seq_string_t {
         uint32_t capacity;
         uint32_t len;
-        uint32_t* buf;
+        char* buf;
 } vte_seq_string_t;
 
 #define VTE_SEQ_STRING_DEFAULT_CAPACITY (1 << 7) /* must be power of two */
-#define VTE_SEQ_STRING_MAX_CAPACITY     (1 << 12)
+#define VTE_SEQ_STRING_MAX_CAPACITY     (1 << 12) /* the maximum length, in bytes */
 
 /*
  * vte_seq_string_init:
@@ -45,7 +50,7 @@ static inline void vte_seq_string_init(vte_seq_string_t* str) noexcept
 {
         str->capacity = VTE_SEQ_STRING_DEFAULT_CAPACITY;
         str->len = 0;
-        str->buf = (uint32_t*)g_malloc0_n(str->capacity, sizeof(uint32_t));
+        str->buf = (char*)g_malloc0(str->capacity);
 }
 
 /*
@@ -62,21 +67,28 @@ static inline void vte_seq_string_free(vte_seq_string_t* str) noexcept
 /*
  * vte_seq_string_ensure_capacity:
  * @string:
+ * @n: the number of bytes to add
  *
- * If @string's length is at capacity, and capacity is not maximal,
- * expands the string's capacity.
+ * If @string doesn't have room for @n more bytes, and the maximum
+ * length allows for them, expands the string's capacity. The capacity
+ * never exceeds the maximum length.
  *
- * Returns: %true if the string has capacity for at least one more character
+ * Returns: %true if the string has capacity for at least @n more bytes
  */
-static inline bool vte_seq_string_ensure_capacity(vte_seq_string_t* str) noexcept
+static inline bool vte_seq_string_ensure_capacity(vte_seq_string_t* str,
+                                                  uint32_t n) noexcept
 {
-        if (str->len < str->capacity)
+        if (G_LIKELY(str->len + n <= str->capacity))
                 return true;
-        if (str->capacity >= VTE_SEQ_STRING_MAX_CAPACITY)
+        if (str->len + n > VTE_SEQ_STRING_MAX_CAPACITY)
                 return false;
 
-        str->capacity *= 2;
-        str->buf = (uint32_t*)g_realloc_n(str->buf, str->capacity, sizeof(uint32_t));
+        auto capacity = str->capacity;
+        do {
+                capacity *= 2;
+        } while (capacity < str->len + n);
+        str->capacity = MIN(capacity, uint32_t(VTE_SEQ_STRING_MAX_CAPACITY));
+        str->buf = (char*)g_realloc(str->buf, str->capacity);
         return true;
 }
 
@@ -85,18 +97,37 @@ static inline bool vte_seq_string_ensure_capacity(vte_seq_string_t* str) noexcep
  * @string:
  * @c: a character
  *
- * Appends @c to @str, or iff @str already has maximum length, does nothing.
+ * Appends @c to @str in UTF-8. If that would exceed the maximum length,
+ * instead drops the string collected so far.
  *
  * Returns: %true if the character was appended
  */
 static inline bool vte_seq_string_push(vte_seq_string_t* str,
                                        uint32_t c) noexcept
 {
-        if (!vte_seq_string_ensure_capacity(str))
-                return false;
+        if (G_LIKELY(c < 0x80)) {
+                if (G_UNLIKELY(!vte_seq_string_ensure_capacity(str, 1)))
+                        goto overflow;
 
-        str->buf[str->len++] = c;
-        return true;
+                str->buf[str->len++] = char(c);
+                return true;
+        }
+
+        {
+                /* g_unichar_to_utf8() also encodes the values beyond U+10FFFF
+                 * that the parser lets through, in up to 6 bytes.
+                 */
+                uint32_t const n = c < 0x800 ? 2 : c < 0x10000 ? 3 : c < 0x200000 ? 4 : c < 0x4000000 ? 5 : 6;
+                if (G_UNLIKELY(!vte_seq_string_ensure_capacity(str, n)))
+                        goto overflow;
+
+                str->len += g_unichar_to_utf8(c, str->buf + str->len);
+                return true;
+        }
+
+ overflow:
+        str->len = 0;
+        return false;
 }
 
 /*
@@ -125,12 +156,13 @@ static inline void vte_seq_string_reset(vte_seq_string_t* str) noexcept
 /*
  * vte_seq_string_get:
  * @string:
- * @len: location to store the buffer length in code units
+ * @len: location to store the buffer length in bytes
  *
- * Returns: the string's buffer as an array of uint32_t code units
+ * Returns: the string's buffer, in UTF-8 and not NUL-terminated;
+ *   only valid until the next vte_seq_string_push()
  */
-static constexpr inline uint32_t* vte_seq_string_get(vte_seq_string_t const* str,
-                                                     size_t* len) noexcept
+static constexpr inline char const* vte_seq_string_get(vte_seq_string_t const* str,
+                                                       size_t* len) noexcept
 {
         assert(len != nullptr);
         *len = str->len;
@@ -261,21 +261,42 @@ test_seq_string(void)
         auto buf = vte_seq_string_get(&str, &len);
         g_assert_cmpuint(len, ==, 0);
 
+        /* Stored as UTF-8 */
+        g_assert_true(vte_seq_string_push(&str, 0xfffdU));
+        buf = vte_seq_string_get(&str, &len);
+        g_assert_cmpuint(len, ==, 3);
+        g_assert_cmpint(memcmp(buf, "\xef\xbf\xbd", 3), ==, 0);
+
+        vte_seq_string_reset(&str);
         for (unsigned int i = 0; i < VTE_SEQ_STRING_MAX_CAPACITY; ++i) {
-                auto rv = vte_seq_string_push(&str, 0xfffdU);
+                auto rv = vte_seq_string_push(&str, 'a');
                 g_assert_true(rv);
 
                 buf = vte_seq_string_get(&str, &len);
                 g_assert_cmpuint(len, ==, i + 1);
         }
 
-        /* Try one more */
-        auto rv = vte_seq_string_push(&str, 0xfffdU);
+        for (unsigned int i = 0; i < len; i++)
+                g_assert_cmpuint(buf[i], ==, 'a');
+
+        /* Try one more, which drops the string */
+        auto rv = vte_seq_string_push(&str, 'a');
         g_assert_false(rv);
 
         buf = vte_seq_string_get(&str, &len);
-        for (unsigned int i = 0; i < len; i++)
-                g_assert_cmpuint(buf[i], ==, 0xfffdU);
+        g_assert_cmpuint(len, ==, 0);
+
+        /* A character that doesn't fit whole isn't stored in part */
+        for (unsigned int i = 0; i < VTE_SEQ_STRING_MAX_CAPACITY - 2; ++i)
+                g_assert_true(vte_seq_string_push(&str, 'a'));
+        g_assert_false(vte_seq_string_push(&str, 0xfffdU));
+        buf = vte_seq_string_get(&str, &len);
+        g_assert_cmpuint(len, ==, 0);
+        for (unsigned int i = 0; i < VTE_SEQ_STRING_MAX_CAPACITY - 4; ++i)
+                g_assert_true(vte_seq_string_push(&str, 'a'));
+        g_assert_true(vte_seq_string_push(&str, 0x10000U));
+        buf = vte_seq_string_get(&str, &len);
+        g_assert_cmpuint(len, ==, VTE_SEQ_STRING_MAX_CAPACITY);
 
         vte_seq_string_reset(&str);
         buf = vte_seq_string_get(&str, &len);
@@ -1297,12 +1318,15 @@ test_seq_osc(void)
         test_seq_osc(U""s);
         test_seq_osc(U"TEST"s);
 
-        /* String of any supported length */
-        for (unsigned int len = 0; len < VTE_SEQ_STRING_MAX_CAPACITY; ++len)
+        /* String of any supported length; the maximum is in bytes of UTF-8 */
+        for (unsigned int len = 0; len <= VTE_SEQ_STRING_MAX_CAPACITY; ++len)
+                test_seq_osc(std::u32string(len, U'a'));
+        for (unsigned int len = 0; len <= VTE_SEQ_STRING_MAX_CAPACITY / 4; ++len)
                 test_seq_osc(std::u32string(len, 0x10000+len));
 
         /* Length exceeded */
-        test_seq_osc(std::u32string(VTE_SEQ_STRING_MAX_CAPACITY + 1, 0x100000), VTE_SEQ_IGNORE);
+        test_seq_osc(std::u32string(VTE_SEQ_STRING_MAX_CAPACITY + 1, U'a'), VTE_SEQ_IGNORE);
+        test_seq_osc(std::u32string(VTE_SEQ_STRING_MAX_CAPACITY / 4 + 1, 0x100000), VTE_SEQ_IGNORE);
 
         /* Test all introducer/ST combinations */
         for (auto introducer : { u32SequenceBuilder::Introducer::DEFAULT,
@@ -1452,6 +1476,242 @@ test_seq_glue_reply_builder(void)
          */
 }
 
+static void
+assert_parsers_equal(struct vte_parser const* parser_a,
+                     struct vte_parser const* parser_b)
+{
+        auto const& a = parser_a->seq;
+        auto const& b = parser_b->seq;
+
+        g_assert_cmpuint(parser_a->state, ==, parser_b->state);
+        g_assert_cmpuint(a.type, ==, b.type);
+        g_assert_cmpuint(a.command, ==, b.command);
+        g_assert_cmpuint(a.terminator, ==, b.terminator);
+        g_assert_cmpuint(a.intermediates, ==, b.intermediates);
+        g_assert_cmpuint(a.n_intermediates, ==, b.n_intermediates);
+        g_assert_cmpuint(a.charset, ==, b.charset);
+        g_assert_cmpuint(a.n_args, ==, b.n_args);
+        g_assert_cmpuint(a.n_final_args, ==, b.n_final_args);
+        g_assert_cmpint(memcmp(a.args, b.args, sizeof(a.args)), ==, 0);
+        g_assert_cmpuint(a.introducer, ==, b.introducer);
+        g_assert_cmpuint(a.arg_str.len, ==, b.arg_str.len);
+        g_assert_cmpint(memcmp(a.arg_str.buf, b.arg_str.buf, a.arg_str.len * sizeof(a.arg_str.buf[0])), ==, 0);
+}
+
+/* Checks that vte_parser_feed_csi() on @str either consumes a whole
+ * sequence, and leaves the parser in the same state as feeding that
+ * to vte_parser_feed() does, or consumes nothing and leaves the parser
+ * alone. @before is fed to both parsers first.
+ *
+ * Returns: the number of bytes consumed
+ */
+static size_t
+test_seq_csi_fast(std::string const& str,
+                  std::string const& before = ""s)
+{
+        struct vte_parser fast, slow;
+        vte_parser_init(&fast);
+        vte_parser_init(&slow);
+
+        for (auto c : before) {
+                vte_parser_feed(&fast, uint8_t(c));
+                vte_parser_feed(&slow, uint8_t(c));
+        }
+        g_assert_true(vte_parser_is_ground(&fast));
+
+        auto const data = reinterpret_cast<uint8_t const*>(str.data());
+        auto const n = vte_parser_feed_csi(&fast, data, data + str.size());
+        g_assert_cmpuint(n, <=, str.size());
+
+        if (n > 0) {
+                auto rv = int{VTE_SEQ_NONE};
+                for (size_t i = 0; i < n; ++i) {
+                        g_assert_cmpint(rv, ==, VTE_SEQ_NONE);
+                        rv = vte_parser_feed(&slow, data[i]);
+                }
+                g_assert_cmpint(rv, ==, VTE_SEQ_CSI);
+        }
+        assert_parsers_equal(&fast, &slow);
+
+        vte_parser_deinit(&fast);
+        vte_parser_deinit(&slow);
+
+        return n;
+}
+
+static void
+test_seq_csi_fast(void)
+{
+        /* The fast path should take these */
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[H"s), ==, 3);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[12;40Hx"s), ==, 8);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[m\x1b[1m"s), ==, 3);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[0;1;38;5;208m"s), ==, 15);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[38:2::10:20:30m"s), ==, 17);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[K"s), ==, 3);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[2J"s), ==, 4);
+
+        /* and leave these to the parser */
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[?25h"s), ==, 0);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[?1J"s), ==, 0);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[12;40f"s), ==, 0);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[1 m"s), ==, 0);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b[1;2"s), ==, 0);
+        g_assert_cmpuint(test_seq_csi_fast("\x1b]0;title\x07"s), ==, 0);
+        g_assert_cmpuint(test_seq_csi_fast("x\x1b[H"s), ==, 0);
+
+        /* Check all combinations, and all their truncations, after
+         * sequences with fewer and more parameters.
+         */
+        std::string params[] = {
+                ""s, "0"s, "1"s, "12"s, "65535"s, "65536"s, "999999999"s,
+                ";"s, ";;5"s, "1;"s, "1;2"s, "1:2"s, "38:2::1:2:3"s, "38;5;208"s,
+                "?25"s, ">1"s, "1 "s, "1$"s, "1<"s, "1\x1b"s, "1\n"s, "1\x7f"s,
+        };
+        std::vector<std::string> all_params{std::begin(params), std::end(params)};
+        for (auto n : {VTE_PARSER_ARG_MAX - 3, VTE_PARSER_ARG_MAX - 2, VTE_PARSER_ARG_MAX - 1,
+                       VTE_PARSER_ARG_MAX, VTE_PARSER_ARG_MAX + 1}) {
+                std::string many;
+                for (auto i = 0; i < n; ++i)
+                        many.append(i > 0 ? ";1" : "1");
+                all_params.push_back(many);
+                all_params.push_back(many + ";");
+        }
+
+        for (auto const& before : {""s, "\x1b[1;2;3;4;5;6;7;8;9;10;11;12m"s, "\x1b[?1049h"s, "\x1b]0;title\x07"s}) {
+                for (auto const& param : all_params) {
+                        for (auto final_char : "HJKmf@hx~"s) {
+                                auto const str = "\x1b["s + param + final_char + "\x1b[m"s;
+                                for (size_t len = 0; len <= str.size(); ++len)
+                                        test_seq_csi_fast(str.substr(0, len), before);
+                        }
+                }
+        }
+
+        /* And random sequences */
+        static char const k_alphabet[] = "0123456789;:;:?> $HJKmf\x1b[";
+        for (auto i = 0; i < 100000; ++i) {
+                std::string str{"\x1b["s};
+                auto const len = g_test_rand_int_range(0, 48);
+                for (auto j = 0; j < len; ++j)
+                        str.push_back(k_alphabet[g_test_rand_int_range(0, sizeof(k_alphabet) - 1)]);
+
+                test_seq_csi_fast(str);
+        }
+}
+
+/* Feeds the same input to vte_parser_feed() and vte_parser_feed_switch(),
+ * and checks that the resulting state is the same after each character.
+ */
+class ParserPair {
+public:
+        ParserPair() noexcept
+        {
+                vte_parser_init(&m_table);
+                vte_parser_init(&m_switch);
+        }
+
+        ~ParserPair() noexcept
+        {
+                vte_parser_deinit(&m_table);
+                vte_parser_deinit(&m_switch);
+        }
+
+        void feed(uint32_t raw) noexcept
+        {
+                auto const rv_table = vte_parser_feed(&m_table, raw);
+                auto const rv_switch = vte_parser_feed_switch(&m_switch, raw);
+                g_assert_cmpint(rv_table, ==, rv_switch);
+                assert_parsers_equal(&m_table, &m_switch);
+        }
+
+        void feed(std::u32string const& str) noexcept
+        {
+                for (auto c : str)
+                        feed(c);
+        }
+
+        void reset() noexcept
+        {
+                vte_parser_reset(&m_table);
+                vte_parser_reset(&m_switch);
+                assert_parsers_equal(&m_table, &m_switch);
+        }
+
+private:
+        struct vte_parser m_table;
+        struct vte_parser m_switch;
+};
+
+static void
+test_seq_tables(void)
+{
+        /* Get into every state, including overflowing the parameters
+         * and the string, and try every character there.
+         */
+        std::u32string const prefixes[] = {
+                U""s,
+                U"\x1b"s, U"\x1b "s, U"\x1b#("s,
+                U"\x1b["s, U"\x9b"s, U"\x1b[1"s, U"\x1b[1;2:3"s, U"\x1b[?"s, U"\x1b[>1 "s, U"\x1b[1<"s,
+                U"\x1bP"s, U"\x90"s, U"\x1bP1"s, U"\x1bP?1;2"s, U"\x1bP1$"s, U"\x1bP1<"s,
+                U"\x1bPq"s, U"\x1bP1$qdata"s, U"\x1bPqdata\x1b"s,
+                U"\x1b]"s, U"\x9d"s, U"\x1b]0;title"s, U"\x1b]0;title\x1b"s,
+                U"\x1bX"s, U"\x1b^"s, U"\x1b_"s, U"\x98"s, U"\x9e"s, U"\x9f"s,
+                U"\x1bZ"s, U"\x9a"s,
+        };
+
+        std::vector<std::u32string> inputs{std::begin(prefixes), std::end(prefixes)};
+
+        std::u32string params{U"\x1b["s};
+        for (auto i = 0; i < VTE_PARSER_ARG_MAX + 8; ++i)
+                params.append(U"1;"s);
+        inputs.push_back(params);
+
+        std::u32string osc{U"\x1b]2;"s};
+        osc.append(VTE_SEQ_STRING_MAX_CAPACITY + 8, U'a');
+        inputs.push_back(osc);
+
+        std::u32string dcs{U"\x1bPq"s};
+        dcs.append(VTE_SEQ_STRING_MAX_CAPACITY + 8, U'a');
+        inputs.push_back(dcs);
+
+        std::vector<uint32_t> chars;
+        for (uint32_t c = 0; c < 0x100; ++c)
+                chars.push_back(c);
+        for (auto c : {0x2028u, 0xfffdu, 0x10ffffu, 0x7fffffffu})
+                chars.push_back(c);
+
+        ParserPair pair;
+        for (auto const& prefix : inputs) {
+                for (auto c : chars) {
+                        pair.reset();
+                        pair.feed(prefix);
+                        pair.feed(c);
+                        pair.feed(U"1;2m\x1b\\x"s);
+                }
+        }
+
+        /* And random input, biased towards sequences */
+        static char32_t const k_specials[] = U"\x1b[]PXZ\\;:0123456789<=>? !\"#$%m\x07\x9b\x9c\x9d";
+        pair.reset();
+        for (auto i = 0; i < 1000000; ++i) {
+                uint32_t c;
+                auto const r = g_test_rand_int_range(0, 100);
+                if (r < 40)
+                        c = k_specials[g_test_rand_int_range(0, G_N_ELEMENTS(k_specials) - 1)];
+                else if (r < 50)
+                        c = g_test_rand_int_range(0, 0x20);
+                else if (r < 55)
+                        c = g_test_rand_int_range(0x80, 0xa0);
+                else if (r < 95)
+                        c = g_test_rand_int_range(0x20, 0x80);
+                else
+                        c = g_test_rand_int_range(0xa0, 0x110000);
+
+                pair.feed(c);
+        }
+}
+
 int
 main(int argc,
      char* argv[])
@@ -1481,10 +1741,12 @@ main(int argc,
         g_test_add_func("/vte/parser/sequences/csi/parameters", test_seq_csi_param);
         g_test_add_func("/vte/parser/sequences/csi/clear", test_seq_csi_clear);
         g_test_add_func("/vte/parser/sequences/csi/max", test_seq_csi_max);
+        g_test_add_func("/vte/parser/sequences/csi/fast", test_seq_csi_fast);
         g_test_add_func("/vte/parser/sequences/sci", test_seq_sci);
         g_test_add_func("/vte/parser/sequences/dcs", test_seq_dcs);
         g_test_add_func("/vte/parser/sequences/dcs/known", test_seq_dcs_known);
         g_test_add_func("/vte/parser/sequences/osc", test_seq_osc);
+        g_test_add_func("/vte/parser/tables", test_seq_tables);
 
         return g_test_run();
 }
@@ -474,6 +474,8 @@ enum parser_state {
         STATE_N,
 };
 
+static_assert(STATE_GROUND == 0, "vte_parser_is_ground() needs updating");
+
 /* Parser state transitioning */
 
 typedef int (* parser_action_func)(struct vte_parser *parser, uint32_t raw);
@@ -1291,8 +1293,17 @@ static int parser_feed_to_state(struct vte_parser *parser, uint32_t raw)
         return -EINVAL;
 }
 
-int vte_parser_feed(struct vte_parser *parser,
-                    uint32_t raw)
+/**
+ * vte_parser_feed_switch() - Feed a character to the parser
+ * @parser: the struct vte_parser
+ * @raw: the character
+ *
+ * The original implementation of vte_parser_feed(), from which the
+ * tables below are derived; it's kept as the reference for testing
+ * and benchmarking them.
+ */
+int vte_parser_feed_switch(struct vte_parser *parser,
+                           uint32_t raw)
 {
         /*
          * Notes:
@@ -1339,6 +1350,486 @@ int vte_parser_feed(struct vte_parser *parser,
         }
 }
 
+/*
+ * State tables
+ * vte_parser_feed() does the same as vte_parser_feed_switch() above,
+ * but looks up the action and next state in a table indexed by state
+ * and character, which is generated at compile time from the rules
+ * below. These mirror the switches above; test-parser checks that both
+ * agree. All characters from 0xa0 up are handled alike, so the table
+ * only needs to distinguish 0x00..0xa0.
+ */
+
+enum parser_table_action {
+        PARSER_ACTION_NONE,
+        PARSER_ACTION_CLEAR,
+        PARSER_ACTION_CLEAR_INT,
+        PARSER_ACTION_CLEAR_INT_AND_PARAMS,
+        PARSER_ACTION_CLEAR_PARAMS_ONLY,
+        PARSER_ACTION_IGNORE,
+        PARSER_ACTION_PRINT,
+        PARSER_ACTION_EXECUTE,
+        PARSER_ACTION_COLLECT_ESC,
+        PARSER_ACTION_COLLECT_CSI,
+        PARSER_ACTION_COLLECT_PARAMETER,
+        PARSER_ACTION_PARAM,
+        PARSER_ACTION_FINISH_PARAM,
+        PARSER_ACTION_FINISH_SUBPARAM,
+        PARSER_ACTION_ESC_DISPATCH,
+        PARSER_ACTION_CSI_DISPATCH,
+        PARSER_ACTION_DCS_START,
+        PARSER_ACTION_DCS_CONSUME,
+        PARSER_ACTION_DCS_COLLECT,
+        PARSER_ACTION_DCS_DISPATCH,
+        PARSER_ACTION_OSC_START,
+        PARSER_ACTION_OSC_COLLECT,
+        PARSER_ACTION_OSC_DISPATCH,
+        PARSER_ACTION_SCI_DISPATCH,
+
+        PARSER_ACTION_N,
+
+        /* Do the deferred ACTION_CLEAR_INT of an ESC after a DCS or
+         * OSC string that didn't turn out to be ST, before the action.
+         */
+        PARSER_ACTION_FLAG_CLEAR_INT = 0x80,
+};
+
+static_assert(PARSER_ACTION_N <= PARSER_ACTION_FLAG_CLEAR_INT, "Too many parser actions");
+static_assert(STATE_N <= 0xff, "Too many parser states");
+
+#define PARSER_TABLE_N_CHARS (0xa1)
+
+struct parser_table_entry {
+        uint8_t action;
+        uint8_t state;
+};
+
+static constexpr parser_table_entry
+parser_table_transition(unsigned int state,
+                        unsigned int action = PARSER_ACTION_NONE)
+{
+        return parser_table_entry{uint8_t(action), uint8_t(state)};
+}
+
+static constexpr parser_table_entry
+parser_table_rule(unsigned int state,
+                  uint32_t raw)
+{
+        /* See vte_parser_feed_switch() */
+        switch (raw) {
+        case 0x18:                /* CAN */
+                return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+        case 0x1a:                /* SUB */
+                return parser_table_transition(STATE_GROUND, PARSER_ACTION_EXECUTE);
+        case 0x7f:                 /* DEL */
+                return parser_table_transition(state);
+        case 0x80 ... 0x8f:        /* C1 \ {DCS, SOS, SCI, CSI, ST, OSC, PM, APC} */
+        case 0x91 ... 0x97:
+        case 0x99:
+                return parser_table_transition(STATE_GROUND, PARSER_ACTION_EXECUTE);
+        case 0x98:                /* SOS */
+        case 0x9e:                /* PM */
+        case 0x9f:                /* APC */
+                return parser_table_transition(STATE_ST_IGNORE);
+        case 0x90:                /* DCS */
+                return parser_table_transition(STATE_DCS_ENTRY, PARSER_ACTION_DCS_START);
+        case 0x9a:                /* SCI */
+                return parser_table_transition(STATE_SCI, PARSER_ACTION_CLEAR);
+        case 0x9d:                /* OSC */
+                return parser_table_transition(STATE_OSC_STRING, PARSER_ACTION_OSC_START);
+        case 0x9b:                /* CSI */
+                return parser_table_transition(STATE_CSI_ENTRY, PARSER_ACTION_CLEAR_INT_AND_PARAMS);
+        }
+
+        /* See parser_feed_to_state() */
+        switch (state) {
+        case STATE_GROUND:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                case 0x80 ... 0x9f:        /* C1 */
+                        return parser_table_transition(state, PARSER_ACTION_EXECUTE);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                }
+
+                return parser_table_transition(state, PARSER_ACTION_PRINT);
+
+        case STATE_DCS_PASS_ESC:
+        case STATE_OSC_STRING_ESC: {
+                if (raw == 0x5c /* '\' */)
+                        return parser_table_transition(STATE_GROUND,
+                                                       state == STATE_DCS_PASS_ESC ?
+                                                       PARSER_ACTION_DCS_DISPATCH :
+                                                       PARSER_ACTION_OSC_DISPATCH);
+
+                auto entry = parser_table_rule(STATE_ESC, raw);
+                entry.action |= PARSER_ACTION_FLAG_CLEAR_INT;
+                return entry;
+        }
+        case STATE_ESC:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return parser_table_transition(state, PARSER_ACTION_EXECUTE);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return parser_table_transition(STATE_ESC_INT, PARSER_ACTION_COLLECT_ESC);
+                case 0x30 ... 0x4f:        /* ['0' - '~'] \ */
+                case 0x51 ... 0x57:        /* { 'P', 'X', 'Z' '[', ']', '^', '_' } */
+                case 0x59:
+                case 0x5c:
+                case 0x60 ... 0x7e:
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_ESC_DISPATCH);
+                case 0x50:                /* 'P' */
+                        return parser_table_transition(STATE_DCS_ENTRY, PARSER_ACTION_DCS_START);
+                case 0x5a:                /* 'Z' */
+                        return parser_table_transition(STATE_SCI, PARSER_ACTION_CLEAR);
+                case 0x5b:                /* '[' */
+                        return parser_table_transition(STATE_CSI_ENTRY, PARSER_ACTION_CLEAR_PARAMS_ONLY);
+                case 0x5d:                /* ']' */
+                        return parser_table_transition(STATE_OSC_STRING, PARSER_ACTION_OSC_START);
+                case 0x58:                /* 'X' */
+                case 0x5e:                /* '^' */
+                case 0x5f:                /* '_' */
+                        return parser_table_transition(STATE_ST_IGNORE);
+                }
+
+                return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+        case STATE_ESC_INT:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return parser_table_transition(state, PARSER_ACTION_EXECUTE);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return parser_table_transition(state, PARSER_ACTION_COLLECT_ESC);
+                case 0x30 ... 0x7e:        /* ['0' - '~'] */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_ESC_DISPATCH);
+                }
+
+                return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+        case STATE_CSI_ENTRY:
+        case STATE_DCS_ENTRY: {
+                auto const is_csi = state == STATE_CSI_ENTRY;
+                auto const param_state = is_csi ? STATE_CSI_PARAM : STATE_DCS_PARAM;
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return parser_table_transition(state,
+                                                       is_csi ? PARSER_ACTION_EXECUTE : PARSER_ACTION_IGNORE);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return parser_table_transition(is_csi ? STATE_CSI_INT : STATE_DCS_INT,
+                                                       PARSER_ACTION_COLLECT_CSI);
+                case 0x30 ... 0x39:        /* ['0' - '9'] */
+                        return parser_table_transition(param_state, PARSER_ACTION_PARAM);
+                case 0x3a:                 /* ':' */
+                        return parser_table_transition(param_state, PARSER_ACTION_FINISH_SUBPARAM);
+                case 0x3b:                 /* ';' */
+                        return parser_table_transition(param_state, PARSER_ACTION_FINISH_PARAM);
+                case 0x3c ... 0x3f:        /* ['<' - '?'] */
+                        return parser_table_transition(param_state, PARSER_ACTION_COLLECT_PARAMETER);
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return is_csi ?
+                                parser_table_transition(STATE_GROUND, PARSER_ACTION_CSI_DISPATCH) :
+                                parser_table_transition(STATE_DCS_PASS, PARSER_ACTION_DCS_CONSUME);
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+                }
+
+                return is_csi ?
+                        parser_table_transition(STATE_CSI_IGNORE) :
+                        parser_table_transition(STATE_DCS_PASS, PARSER_ACTION_DCS_CONSUME);
+        }
+        case STATE_CSI_PARAM:
+        case STATE_DCS_PARAM: {
+                auto const is_csi = state == STATE_CSI_PARAM;
+                auto const ignore_state = is_csi ? STATE_CSI_IGNORE : STATE_DCS_IGNORE;
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return parser_table_transition(state,
+                                                       is_csi ? PARSER_ACTION_EXECUTE : PARSER_ACTION_IGNORE);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return parser_table_transition(is_csi ? STATE_CSI_INT : STATE_DCS_INT,
+                                                       PARSER_ACTION_COLLECT_CSI);
+                case 0x30 ... 0x39:        /* ['0' - '9'] */
+                        return parser_table_transition(state, PARSER_ACTION_PARAM);
+                case 0x3a:                 /* ':' */
+                        return parser_table_transition(state, PARSER_ACTION_FINISH_SUBPARAM);
+                case 0x3b:                 /* ';' */
+                        return parser_table_transition(state, PARSER_ACTION_FINISH_PARAM);
+                case 0x3c ... 0x3f:        /* ['<' - '?'] */
+                        return parser_table_transition(ignore_state);
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return is_csi ?
+                                parser_table_transition(STATE_GROUND, PARSER_ACTION_CSI_DISPATCH) :
+                                parser_table_transition(STATE_DCS_PASS, PARSER_ACTION_DCS_CONSUME);
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+                }
+
+                return is_csi ?
+                        parser_table_transition(STATE_CSI_IGNORE) :
+                        parser_table_transition(STATE_DCS_PASS, PARSER_ACTION_DCS_CONSUME);
+        }
+        case STATE_CSI_INT:
+        case STATE_DCS_INT: {
+                auto const is_csi = state == STATE_CSI_INT;
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return parser_table_transition(state,
+                                                       is_csi ? PARSER_ACTION_EXECUTE : PARSER_ACTION_IGNORE);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return parser_table_transition(state, PARSER_ACTION_COLLECT_CSI);
+                case 0x30 ... 0x3f:        /* ['0' - '?'] */
+                        return parser_table_transition(is_csi ? STATE_CSI_IGNORE : STATE_DCS_IGNORE);
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return is_csi ?
+                                parser_table_transition(STATE_GROUND, PARSER_ACTION_CSI_DISPATCH) :
+                                parser_table_transition(STATE_DCS_PASS, PARSER_ACTION_DCS_CONSUME);
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+                }
+
+                return is_csi ?
+                        parser_table_transition(STATE_CSI_IGNORE) :
+                        parser_table_transition(STATE_DCS_PASS, PARSER_ACTION_DCS_CONSUME);
+        }
+        case STATE_CSI_IGNORE:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return parser_table_transition(state, PARSER_ACTION_EXECUTE);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return parser_table_transition(STATE_GROUND);
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+                }
+
+                return parser_table_transition(state);
+        case STATE_DCS_PASS:
+                switch (raw) {
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_DCS_PASS_ESC);
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_DCS_DISPATCH);
+                }
+
+                return parser_table_transition(state, PARSER_ACTION_DCS_COLLECT);
+        case STATE_DCS_IGNORE:
+                switch (raw) {
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND);
+                }
+
+                return parser_table_transition(state);
+        case STATE_OSC_STRING:
+                switch (raw) {
+                case 0x00 ... 0x06:        /* C0 \ { BEL, ESC } */
+                case 0x08 ... 0x1a:
+                case 0x1c ... 0x1f:
+                        return parser_table_transition(state);
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_OSC_STRING_ESC);
+                case 0x07:                /* BEL */
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_OSC_DISPATCH);
+                }
+
+                return parser_table_transition(state, PARSER_ACTION_OSC_COLLECT);
+        case STATE_ST_IGNORE:
+                switch (raw) {
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x9c:                /* ST */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+                }
+
+                return parser_table_transition(state);
+        case STATE_SCI:
+                switch (raw) {
+                case 0x1b:                /* ESC */
+                        return parser_table_transition(STATE_ESC, PARSER_ACTION_CLEAR_INT);
+                case 0x08 ... 0x0d:        /* BS, HT, LF, VT, FF, CR */
+                case 0x20 ... 0x7e:        /* [' ' - '~'] */
+                        return parser_table_transition(STATE_GROUND, PARSER_ACTION_SCI_DISPATCH);
+                }
+
+                return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+        }
+
+        return parser_table_transition(STATE_GROUND, PARSER_ACTION_IGNORE);
+}
+
+struct parser_table {
+        parser_table_entry entries[STATE_N][PARSER_TABLE_N_CHARS];
+};
+
+static constexpr parser_table
+parser_table_generate()
+{
+        parser_table table{};
+        for (unsigned int state = 0; state < STATE_N; ++state)
+                for (uint32_t raw = 0; raw < PARSER_TABLE_N_CHARS; ++raw)
+                        table.entries[state][raw] = parser_table_rule(state, raw);
+
+        return table;
+}
+
+static constexpr parser_table const parser_tables = parser_table_generate();
+
+/* Spot checks; test-parser compares the whole thing with the switch */
+static_assert(parser_tables.entries[STATE_GROUND]['a'].action == PARSER_ACTION_PRINT, "");
+static_assert(parser_tables.entries[STATE_GROUND][0xa0].action == PARSER_ACTION_PRINT, "");
+static_assert(parser_tables.entries[STATE_CSI_PARAM]['m'].state == STATE_GROUND, "");
+static_assert(parser_tables.entries[STATE_OSC_STRING_ESC]['['].action ==
+              (PARSER_ACTION_CLEAR_PARAMS_ONLY | PARSER_ACTION_FLAG_CLEAR_INT), "");
+
+/**
+ * vte_parser_feed() - Feed a character to the parser
+ * @parser: the struct vte_parser
+ * @raw: the character
+ *
+ * Returns: the type of the sequence completed by @raw, or VTE_SEQ_NONE
+ */
+int vte_parser_feed(struct vte_parser *parser,
+                    uint32_t raw)
+{
+        auto const entry = parser_tables.entries[parser->state][raw < PARSER_TABLE_N_CHARS ? raw : PARSER_TABLE_N_CHARS - 1];
+
+        if (G_UNLIKELY(entry.action & PARSER_ACTION_FLAG_CLEAR_INT))
+                parser_clear_int(parser, 0x1b /* ESC */);
+
+        parser->state = entry.state;
+
+        switch (entry.action & ~PARSER_ACTION_FLAG_CLEAR_INT) {
+        case PARSER_ACTION_NONE:                 return VTE_SEQ_NONE;
+        case PARSER_ACTION_CLEAR:                return ACTION_CLEAR(parser, raw);
+        case PARSER_ACTION_CLEAR_INT:            return ACTION_CLEAR_INT(parser, raw);
+        case PARSER_ACTION_CLEAR_INT_AND_PARAMS: return ACTION_CLEAR_INT_AND_PARAMS(parser, raw);
+        case PARSER_ACTION_CLEAR_PARAMS_ONLY:    return ACTION_CLEAR_PARAMS_ONLY(parser, raw);
+        case PARSER_ACTION_IGNORE:               return ACTION_IGNORE(parser, raw);
+        case PARSER_ACTION_PRINT:                return ACTION_PRINT(parser, raw);
+        case PARSER_ACTION_EXECUTE:              return ACTION_EXECUTE(parser, raw);
+        case PARSER_ACTION_COLLECT_ESC:          return ACTION_COLLECT_ESC(parser, raw);
+        case PARSER_ACTION_COLLECT_CSI:          return ACTION_COLLECT_CSI(parser, raw);
+        case PARSER_ACTION_COLLECT_PARAMETER:    return ACTION_COLLECT_PARAMETER(parser, raw);
+        case PARSER_ACTION_PARAM:                return ACTION_PARAM(parser, raw);
+        case PARSER_ACTION_FINISH_PARAM:         return ACTION_FINISH_PARAM(parser, raw);
+        case PARSER_ACTION_FINISH_SUBPARAM:      return ACTION_FINISH_SUBPARAM(parser, raw);
+        case PARSER_ACTION_ESC_DISPATCH:         return ACTION_ESC_DISPATCH(parser, raw);
+        case PARSER_ACTION_CSI_DISPATCH:         return ACTION_CSI_DISPATCH(parser, raw);
+        case PARSER_ACTION_DCS_START:            return ACTION_DCS_START(parser, raw);
+        case PARSER_ACTION_DCS_CONSUME:          return ACTION_DCS_CONSUME(parser, raw);
+        case PARSER_ACTION_DCS_COLLECT:          return ACTION_DCS_COLLECT(parser, raw);
+        case PARSER_ACTION_DCS_DISPATCH:         return ACTION_DCS_DISPATCH(parser, raw);
+        case PARSER_ACTION_OSC_START:            return ACTION_OSC_START(parser, raw);
+        case PARSER_ACTION_OSC_COLLECT:          return ACTION_OSC_COLLECT(parser, raw);
+        case PARSER_ACTION_OSC_DISPATCH:         return ACTION_OSC_DISPATCH(parser, raw);
+        case PARSER_ACTION_SCI_DISPATCH:         return ACTION_SCI_DISPATCH(parser, raw);
+        }
+
+        g_warning("bad vte-parser action");
+        return -EINVAL;
+}
+
+/**
+ * vte_parser_feed_csi() - Parse a common CSI sequence in one go
+ * @parser: the struct vte_parser
+ * @data: the input
+ * @end: the end of the input
+ *
+ * Most control sequences in terminal output are SGR, CUP, EL and ED,
+ * with only decimal parameters. If @data starts with a complete one of
+ * those, this parses it like feeding it to vte_parser_feed() character
+ * by character would, leaving @parser in the same state, without going
+ * through the state machine for each character.
+ *
+ * @parser must be in ground state. Anything else, including sequences
+ * that are incomplete at @end, is left to vte_parser_feed().
+ *
+ * Returns: the number of bytes consumed, or 0 if @data doesn't start
+ *   with such a sequence, in which case @parser is unchanged
+ */
+size_t vte_parser_feed_csi(struct vte_parser *parser,
+                           uint8_t const* data,
+                           uint8_t const* end)
+{
+        assert(parser->state == STATE_GROUND);
+
+        if (end - data < 3 ||
+            data[0] != 0x1b /* ESC */ ||
+            data[1] != 0x5b /* '[' */)
+                return 0;
+
+        /* Check that the whole sequence is there, and that it
+         * can't overflow the parameters.
+         */
+        auto p = data + 2;
+        auto n_separators = 0u;
+        for ( ; p < end; ++p) {
+                auto const c = *p;
+                if (c >= 0x30 && c <= 0x39) /* ['0' - '9'] */
+                        continue;
+                if (c != 0x3a /* ':' */ && c != 0x3b /* ';' */)
+                        break;
+                if (++n_separators >= VTE_PARSER_ARG_MAX - 1)
+                        return 0;
+        }
+        if (p == end)
+                return 0;
+
+        switch (*p) {
+        case 0x48: /* 'H' */
+        case 0x4a: /* 'J' */
+        case 0x4b: /* 'K' */
+        case 0x6d: /* 'm' */
+                break;
+        default:
+                return 0;
+        }
+
+        /* Now do what vte_parser_feed() would do for each character */
+        parser_clear_int(parser, 0x1b /* ESC */);
+        parser_clear_params(parser, 0x5b /* '[' */);
+
+        auto const final_char = p;
+        for (p = data + 2; p < final_char; ++p) {
+                switch (*p) {
+                case 0x3a: /* ':' */
+                        vte_seq_arg_finish(&parser->seq.args[parser->seq.n_args], true);
+                        ++parser->seq.n_args;
+                        break;
+                case 0x3b: /* ';' */
+                        vte_seq_arg_finish(&parser->seq.args[parser->seq.n_args], false);
+                        ++parser->seq.n_args;
+                        ++parser->seq.n_final_args;
+                        break;
+                default:
+                        vte_seq_arg_push(&parser->seq.args[parser->seq.n_args], *p);
+                        break;
+                }
+        }
+
+        parser_csi(parser, *final_char);
+
+        return final_char + 1 - data;
+}
+
 void vte_parser_reset(struct vte_parser *parser)
 {
         parser_transition(parser, 0, STATE_GROUND, ACTION_IGNORE);
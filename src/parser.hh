@@ -190,4 +190,18 @@ void vte_parser_init(struct vte_parser *parser);
 void vte_parser_deinit(struct vte_parser *parser);
 int vte_parser_feed(struct vte_parser *parser,
                     uint32_t raw);
+/* The switch-based implementation that the tables are derived from,
+ * for testing and benchmarking only
+ */
+int vte_parser_feed_switch(struct vte_parser *parser,
+                           uint32_t raw);
+size_t vte_parser_feed_csi(struct vte_parser *parser,
+                           uint8_t const* data,
+                           uint8_t const* end);
 void vte_parser_reset(struct vte_parser *parser);
+
+/* Whether the parser is not in the middle of a sequence */
+static inline bool vte_parser_is_ground(struct vte_parser const* parser)
+{
+        return parser->state == 0 /* STATE_GROUND */;
+}
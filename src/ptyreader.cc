@@ -0,0 +1,290 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ptyreader.hh"
+#include "iothread.hh"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_SYS_TERMIOS_H
+#include <sys/termios.h>
+#endif
+
+#include <glib.h>
+
+#include "debug.h"
+
+namespace vte {
+
+namespace base {
+
+PtyReader::PtyReader(int fd,
+                     callback_type callback,
+                     void* callback_data) noexcept :
+        m_fd{fd},
+        m_callback{callback},
+        m_callback_data{callback_data}
+{
+}
+
+PtyReader::~PtyReader() noexcept
+{
+        stop();
+
+        delete m_chunk;
+        for (auto chunk : m_overflow)
+                delete chunk;
+
+        Chunk* chunk;
+        while (m_queue.pop(chunk))
+                delete chunk;
+        while (m_free_queue.pop(chunk))
+                delete chunk;
+}
+
+bool
+PtyReader::start() noexcept
+{
+        g_assert(m_iothread == nullptr);
+
+        refill_free_chunks();
+
+        auto iothread = IOThread::ref();
+        if (iothread == nullptr)
+                return false;
+
+        if (!iothread->add(this)) {
+                iothread->unref();
+                return false;
+        }
+
+        m_iothread = iothread;
+        _vte_debug_print(VTE_DEBUG_IO, "Reading fd %d on the I/O thread\n", m_fd);
+        return true;
+}
+
+void
+PtyReader::stop() noexcept
+{
+        if (m_iothread == nullptr)
+                return;
+
+        /* Once this returns, the I/O thread won't touch us anymore */
+        m_iothread->remove(this);
+        m_iothread->unref();
+        m_iothread = nullptr;
+
+        _vte_debug_print(VTE_DEBUG_IO, "Stopped reading fd %d on the I/O thread\n", m_fd);
+}
+
+void
+PtyReader::connect() noexcept
+{
+        m_connected = true;
+
+        /* Anything that arrived while disconnected needs a new dispatch */
+        if (m_iothread != nullptr &&
+            (has_data() || eof() || m_packet_events.load() != 0))
+                m_iothread->queue_ready(this);
+}
+
+Chunk::unique_type
+PtyReader::pop() noexcept
+{
+        Chunk* chunk;
+        if (!m_queue.pop(chunk))
+                return {};
+
+        /* Pairs with the fence in IOThread::check_blocked() */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_blocked.exchange(false) && m_iothread != nullptr)
+                m_iothread->rearm(this);
+
+        return Chunk::unique_type(chunk);
+}
+
+void
+PtyReader::refill_free_chunks() noexcept
+{
+        while (m_free_queue.size() < m_free_queue.capacity()) {
+                auto chunk = Chunk::get();
+                if (!m_free_queue.push(chunk.get()))
+                        break;
+                chunk.release();
+        }
+}
+
+Chunk*
+PtyReader::get_free_chunk() noexcept
+{
+        Chunk* chunk;
+        if (m_free_queue.pop(chunk))
+                chunk->reset();
+        else
+                chunk = new Chunk();
+
+        return chunk;
+}
+
+bool
+PtyReader::push(Chunk* chunk) noexcept
+{
+        return m_queue.push(chunk);
+}
+
+/* Queues @chunk, keeping it in the overflow list if the queue is full.
+ * This runs on the I/O thread.
+ */
+void
+PtyReader::queue_chunk(Chunk* chunk) noexcept
+{
+        if (!flush_overflow() || !m_queue.push(chunk))
+                m_overflow.push_back(chunk);
+}
+
+/* Moves as much of the overflow list into the queue as fits.
+ * Returns whether the overflow list is now empty.
+ * This runs on the I/O thread.
+ */
+bool
+PtyReader::flush_overflow() noexcept
+{
+        auto it = m_overflow.begin();
+        for ( ; it != m_overflow.end(); ++it) {
+                if (!m_queue.push(*it))
+                        break;
+        }
+        m_overflow.erase(m_overflow.begin(), it);
+
+        if (!m_overflow.empty())
+                return false;
+
+        if (m_eof_pending) {
+                m_eof_pending = false;
+                m_eof.store(true, std::memory_order_release);
+        }
+        return true;
+}
+
+/* The main thread takes EOF to mean there's no more data coming, so
+ * it can only be signalled once the overflow list has been queued.
+ * This runs on the I/O thread.
+ */
+void
+PtyReader::set_eof() noexcept
+{
+        if (m_overflow.empty())
+                m_eof.store(true, std::memory_order_release);
+        else
+                m_eof_pending = true;
+}
+
+/* This runs on the I/O thread */
+bool
+PtyReader::read_batch(size_t max_chunks,
+                      uint64_t& n_reads,
+                      uint64_t& n_bytes) noexcept
+{
+        unsigned int events = 0;
+        bool pushed = false;
+        bool done = false;
+
+        size_t n_chunks = 0;
+        while (n_chunks < max_chunks && m_overflow.empty() && !m_queue.full()) {
+                if (m_chunk == nullptr)
+                        m_chunk = get_free_chunk();
+
+                /* See Terminal::pty_io_read() for the TIOCPKT handling;
+                 * there's an extra byte in front of the data that we need
+                 * to look at, but not store.
+                 */
+                auto const rem = m_chunk->remaining_capacity();
+                auto bp = m_chunk->data + m_chunk->len;
+                auto const save = bp[-1];
+                auto ret = read(m_fd, bp - 1, rem + 1);
+                auto const pkt_header = bp[-1];
+                bp[-1] = save;
+                ++n_reads;
+
+                if (ret == -1) {
+                        auto const errsv = errno;
+                        if (errsv == EAGAIN || errsv == EBUSY || errsv == EINTR)
+                                break;
+
+                        /* EIO is how a hung-up PTY shows up; fake an EOF */
+                        if (errsv != EIO)
+                                m_errno.store(errsv, std::memory_order_release);
+                        done = true;
+                        break;
+                }
+                if (ret == 0) {
+                        done = true;
+                        break;
+                }
+
+                if (pkt_header & TIOCPKT_IOCTL)
+                        events |= ePacketIoctl;
+                if (pkt_header & TIOCPKT_STOP)
+                        events |= ePacketStop;
+                else if (pkt_header & TIOCPKT_START)
+                        events |= ePacketStart;
+
+                auto const len = size_t(ret - 1);
+                m_chunk->len += len;
+                n_bytes += len;
+
+                /* Chunk at least ¾ full? Hand it off */
+                if (m_chunk->len >= 3 * m_chunk->capacity() / 4) {
+                        push(m_chunk);
+                        m_chunk = nullptr;
+                        pushed = true;
+                        ++n_chunks;
+                        continue;
+                }
+
+                /* A short read means the kernel buffer is drained; don't
+                 * waste a syscall to find out it's now empty. If more data
+                 * arrives in the meantime, epoll will tell us again.
+                 */
+                if (len < rem)
+                        break;
+        }
+
+        if (events != 0)
+                m_packet_events.fetch_or(events);
+
+        /* Don't sit on partial chunks; the main thread wants to see
+         * the data as soon as possible. An empty chunk is kept for
+         * the next round.
+         */
+        if (m_chunk != nullptr && m_chunk->len > 0 && push(m_chunk)) {
+                m_chunk = nullptr;
+                pushed = true;
+        }
+
+        if (done)
+                set_eof();
+
+        return pushed || events != 0 || done;
+}
+
+} // namespace base
+
+} // namespace vte
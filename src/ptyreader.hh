@@ -0,0 +1,149 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "chunk.hh"
+#include "spscqueue.hh"
+
+namespace vte {
+
+namespace base {
+
+class IOThread;
+
+/*
+ * PtyReader:
+ *
+ * Reads a PTY master on the process-wide I/O thread (see iothread.hh)
+ * into Chunks, and hands them to the main thread through a lock-free
+ * queue.
+ *
+ * Only read() and the chunk hand-off happen on the I/O thread;
+ * everything else (parsing, TIOCPKT event handling, EOF handling)
+ * is left to the main thread, which gets the callback invoked
+ * once there is something to collect.
+ *
+ * When the queue is full the I/O thread stops polling the PTY,
+ * so the kernel applies backpressure to the child just as if the
+ * main loop wasn't reading.
+ */
+class PtyReader {
+        friend class IOThread;
+
+public:
+        /* Bits for take_packet_events() */
+        enum {
+                ePacketIoctl = 1u << 0,
+                ePacketStop  = 1u << 1,
+                ePacketStart = 1u << 2,
+        };
+
+        /* Called on the main thread when there is data to collect;
+         * returning false disconnects the reader, see disconnect().
+         */
+        using callback_type = bool (*)(void* data);
+
+        PtyReader(int fd,
+                  callback_type callback,
+                  void* callback_data) noexcept;
+        ~PtyReader() noexcept;
+
+        PtyReader(PtyReader const&) = delete;
+        PtyReader(PtyReader&&) = delete;
+        PtyReader& operator= (PtyReader const&) = delete;
+        PtyReader& operator= (PtyReader&&) = delete;
+
+        bool start() noexcept;
+        void stop() noexcept;
+
+        /* The following are only to be called from the main thread */
+
+        inline constexpr int fd() const noexcept { return m_fd; }
+
+        /* While disconnected, the callback isn't invoked; reading
+         * continues until the queue is full.
+         */
+        void connect() noexcept;
+        inline void disconnect() noexcept { m_connected = false; }
+        inline constexpr bool is_connected() const noexcept { return m_connected; }
+
+        Chunk::unique_type pop() noexcept;
+        void refill_free_chunks() noexcept;
+
+        unsigned int take_packet_events() noexcept { return m_packet_events.exchange(0); }
+        inline bool eof() const noexcept { return m_eof.load(std::memory_order_acquire); }
+        inline int error() const noexcept { return m_errno.load(std::memory_order_acquire); }
+        inline bool has_data() const noexcept { return !m_queue.empty(); }
+
+private:
+        static constexpr size_t const k_queue_size = 64;
+        static constexpr size_t const k_free_queue_size = 16;
+
+        /* Called on the I/O thread, with the I/O thread lock held.
+         * Returns whether there is anything new for the main thread.
+         */
+        bool read_batch(size_t max_chunks,
+                        uint64_t& n_reads,
+                        uint64_t& n_bytes) noexcept;
+
+        /* Used by the io_uring backend, where completed reads may
+         * still arrive after the queue has filled up.
+         */
+        void queue_chunk(Chunk* chunk) noexcept;
+        bool flush_overflow() noexcept;
+        void set_eof() noexcept;
+        inline constexpr bool eof_pending() const noexcept { return m_eof_pending; }
+
+        inline bool queue_full() const noexcept { return m_queue.full(); }
+        Chunk* get_free_chunk() noexcept;
+        bool push(Chunk* chunk) noexcept;
+
+        int m_fd;
+        callback_type m_callback;
+        void* m_callback_data;
+
+        IOThread* m_iothread{nullptr};
+        uint64_t m_id{0};
+        bool m_connected{false};
+
+        /* Only used on the I/O thread */
+        Chunk* m_chunk{nullptr};           /* the chunk being filled */
+        std::vector<Chunk*> m_overflow{};  /* read while the queue was full */
+        bool m_eof_pending{false};         /* EOF seen, but overflow not yet queued */
+        bool m_armed{false};               /* io_uring request outstanding */
+        bool m_poll_mode{false};           /* io_uring poll+read() instead of multishot read */
+
+        /* Read chunks, I/O thread → main */
+        SPSCQueue<Chunk*, k_queue_size> m_queue{};
+        /* Recycled chunks, main → I/O thread */
+        SPSCQueue<Chunk*, k_free_queue_size> m_free_queue{};
+
+        std::atomic<bool> m_ready{false};   /* on the I/O thread's ready list */
+        std::atomic<bool> m_blocked{false}; /* not polled since the queue is full */
+        std::atomic<bool> m_eof{false};
+        std::atomic<int> m_errno{0};
+        std::atomic<unsigned int> m_packet_events{0};
+};
+
+} // namespace base
+
+} // namespace vte
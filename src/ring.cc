@@ -26,6 +26,8 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 /*
  * Copy the common attributes from VteCellAttr to VteStreamCellAttr or vice versa.
  */
@@ -71,9 +73,9 @@ Ring::Ring(row_t max_rows,
 	m_array = (VteRowData* ) g_malloc0 (sizeof (m_array[0]) * (m_mask + 1));
 
 	if (has_streams) {
-		m_attr_stream = _vte_file_stream_new ();
-		m_text_stream = _vte_file_stream_new ();
-		m_row_stream = _vte_file_stream_new ();
+		m_attr_stream = new_stream ();
+		m_text_stream = new_stream ();
+		m_row_stream = new_stream ();
 	} else {
 		m_attr_stream = m_text_stream = m_row_stream = nullptr;
 	}
@@ -907,6 +909,62 @@ Ring::remove(row_t position)
 }
 
 
+/* Reverses the order of the writable rows from @start up to @end */
+void
+Ring::reverse(row_t start,
+              row_t end)
+{
+        while (start + 1 < end) {
+                std::swap(*get_writable_index(start), *get_writable_index(end - 1));
+                start++;
+                end--;
+        }
+}
+
+/**
+ * Ring::rotate:
+ * @start: the first row of the region
+ * @end: the last row of the region
+ * @count: the number of rows to move by, towards @end if positive
+ *
+ * Moves the rows from @start to @end (inclusive) by @count rows; the rows
+ * moved out at one end of the region come back, cleared, at the other.
+ * This is @count pairs of remove() and insert() at the ends of the region,
+ * but only moves the rows of the region, and each only once.
+ */
+void
+Ring::rotate(row_t start,
+             row_t end,
+             long count)
+{
+	_vte_debug_print(VTE_DEBUG_RING, "Rotating %lu to %lu by %ld.\n", start, end, count);
+        validate();
+
+	if (G_UNLIKELY(start > end || count == 0))
+		return;
+
+	ensure_writable(start);
+
+	g_assert_cmpuint (start, >=, m_writable);
+	g_assert_cmpuint (end, <, m_end);
+
+        auto const n = end - start + 1;
+        auto const k = row_t(std::min(count < 0 ? -count : count, long(n)));
+
+        /* Rotate by reversing both parts, then the whole */
+        auto const split = count > 0 ? end + 1 - k : start + k;
+        reverse(start, split);
+        reverse(split, end + 1);
+        reverse(start, end + 1);
+
+        auto const first = count > 0 ? start : end + 1 - k;
+        for (auto i = first; i < first + k; i++)
+                _vte_row_data_clear(get_writable_index(i));
+
+        validate();
+}
+
+
 /**
  * Ring::append:
  * @data: the new item
@@ -953,6 +1011,57 @@ Ring::set_visible_rows(row_t rows)
         m_visible_rows = rows;
 }
 
+VteStream*
+Ring::new_stream() const
+{
+        return m_streams_in_memory ? _vte_memory_stream_new() : _vte_file_stream_new();
+}
+
+/* Copy the contents of @stream to a new stream, at the same offsets, and drop @stream */
+VteStream*
+Ring::move_stream(VteStream* stream) const
+{
+        char buf[4096];
+        auto const new_stream = this->new_stream();
+        auto offset = _vte_stream_tail(stream);
+        auto const head = _vte_stream_head(stream);
+
+        _vte_stream_reset(new_stream, offset);
+        while (offset < head) {
+                auto const len = MIN(sizeof(buf), head - offset);
+                /* Keep the offsets in step even if a block can't be read back */
+                if (!_vte_stream_read(stream, offset, buf, len))
+                        memset(buf, 0, len);
+                _vte_stream_append(new_stream, buf, len);
+                offset += len;
+        }
+
+        g_object_unref(stream);
+        return new_stream;
+}
+
+/*
+ * Whether to keep the scrollback in memory streams, which hold the compressed
+ * blocks in memory, rather than in file streams, which write them to temporary
+ * files. The contents of the scrollback are moved over.
+ */
+void
+Ring::set_streams_in_memory(bool in_memory)
+{
+        if (in_memory == m_streams_in_memory)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_RING, "Moving the streams %s memory.\n", in_memory ? "to" : "out of");
+
+        m_streams_in_memory = in_memory;
+        if (!m_has_streams)
+                return;
+
+        m_attr_stream = move_stream(m_attr_stream);
+        m_text_stream = move_stream(m_text_stream);
+        m_row_stream = move_stream(m_row_stream);
+}
+
 
 /* Convert a (row,col) into a CellTextOffset.
  * Requires the row to be frozen, or be outsize the range covered by the ring.
@@ -1139,7 +1248,7 @@ Ring::rewrap(column_t columns,
 		return;
 	_vte_debug_print(VTE_DEBUG_RING, "Ring before rewrapping:\n");
         validate();
-	new_row_stream = _vte_file_stream_new();
+	new_row_stream = new_stream();
 
 	/* Freeze everything, because rewrapping is really complicated and we don't want to
 	   duplicate the code for frozen and thawed rows. */
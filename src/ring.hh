@@ -23,7 +23,7 @@
 #pragma once
 
 #include <gio/gio.h>
-#include <vte/vte.h>
+#include <vte/vteenums.h>
 
 #include "vterowdata.hh"
 #include "vtestream.h"
@@ -88,8 +88,13 @@ public:
         VteRowData* insert(row_t position);
         VteRowData* append();
         void remove(row_t position);
+        void rotate(row_t start,
+                    row_t end,
+                    long count);
         void drop_scrollback(row_t position);
         void set_visible_rows(row_t rows);
+        void set_streams_in_memory(bool in_memory);
+        inline bool streams_in_memory() const { return m_streams_in_memory; }
         void rewrap(column_t columns,
                     VteVisualPosition** markers);
         bool write_contents(GOutputStream* stream,
@@ -106,6 +111,8 @@ private:
         inline GString* hyperlink_get(hyperlink_idx_t idx) const { return (GString*)g_ptr_array_index(m_hyperlinks, idx); }
 
         inline VteRowData* get_writable_index(row_t position) const { return &m_array[position & m_mask]; }
+        void reverse(row_t start,
+                     row_t end);
 
         void hyperlink_gc();
         hyperlink_idx_t get_hyperlink_idx_no_update_current(char const* hyperlink);
@@ -180,6 +187,8 @@ private:
                       int hyperlink_column,
                       char const** hyperlink);
         void reset_streams(row_t position);
+        VteStream* new_stream() const;
+        VteStream* move_stream(VteStream* stream) const;
 
 	row_t m_max;
 	row_t m_start{0};
@@ -205,6 +214,7 @@ private:
          *  - 2 bytes repeating attr.hyperlink_length so that we can walk backwards.
          */
 	bool m_has_streams;
+        bool m_streams_in_memory{false};  /* memory streams rather than file streams */
 	VteStream *m_attr_stream, *m_text_stream, *m_row_stream;
 	size_t m_last_attr_text_start_offset{0};
 	VteCellAttr m_last_attr;
@@ -251,8 +261,10 @@ static inline void _vte_ring_shrink (VteRing *ring, gulong max_len) { ring->shri
 static inline VteRowData *_vte_ring_insert (VteRing *ring, gulong position) { return ring->insert(position); }
 static inline VteRowData *_vte_ring_append (VteRing *ring) { return ring->append(); }
 static inline void _vte_ring_remove (VteRing *ring, gulong position) { ring->remove(position); }
+static inline void _vte_ring_rotate (VteRing *ring, gulong start, gulong end, glong count) { ring->rotate(start, end, count); }
 static inline void _vte_ring_drop_scrollback (VteRing *ring, gulong position) { ring->drop_scrollback(position); }
 static inline void _vte_ring_set_visible_rows (VteRing *ring, gulong rows) { ring->set_visible_rows(rows); }
+static inline void _vte_ring_set_streams_in_memory (VteRing *ring, bool in_memory) { ring->set_streams_in_memory(in_memory); }
 static inline void _vte_ring_rewrap (VteRing *ring, glong columns, VteVisualPosition **markers) { ring->rewrap(columns, markers); }
 static inline gboolean _vte_ring_write_contents (VteRing *ring,
                                                  GOutputStream *stream,
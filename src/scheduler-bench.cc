@@ -0,0 +1,261 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs the terminal scheduler with simulated terminals, whose
+ * processing costs a fixed time per byte.
+ *
+ * The throughput run has all terminals flooded with output, the first
+ * one focused, and reports the total rate, how evenly it was shared
+ * between the unfocused terminals (Jain's fairness index, 1.0 being
+ * perfectly fair), and how much more the focused one got.
+ *
+ * The latency run has the focused terminal echo a keystroke every
+ * 10ms while all the others are flooded, and reports how long the
+ * echoes took to get processed.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "scheduler.hh"
+
+using namespace vte::base;
+
+/* Like VTE_MAX_INPUT_READ and VTE_MAX_PROCESS_TIME */
+static constexpr gsize const k_initial_round_bytes = 0x1000;
+static constexpr double const k_max_process_time = 100.; /* ms */
+/* Each read gets at least about one chunk, like pty_io_read() */
+static constexpr gsize const k_min_read = 0x2000;
+static constexpr gsize const k_echo_size = 64;
+
+static double g_cost = 2.; /* ns per byte */
+
+struct Load {
+        Load(bool interactive_) :
+                interactive{interactive_}
+        {
+        }
+
+        Scheduler::Client client{dispatch_cb, this};
+        bool interactive;
+        gsize max_bytes{k_initial_round_bytes};
+        std::deque<int64_t> echoes{}; /* arrival times, µs */
+        std::vector<int64_t> latencies{};
+
+        static bool dispatch_cb(void* data,
+                                bool update) noexcept;
+};
+
+static void
+spin(double ns)
+{
+        auto const until = std::chrono::steady_clock::now() +
+                std::chrono::nanoseconds(int64_t(ns));
+        while (std::chrono::steady_clock::now() < until)
+                ;
+}
+
+bool
+Load::dispatch_cb(void* data,
+                  bool update) noexcept
+{
+        auto load = reinterpret_cast<Load*>(data);
+
+        auto const budget = std::max(load->client.budget(load->max_bytes), k_min_read);
+        auto used = budget;
+        if (load->interactive)
+                used = std::min(budget, load->echoes.size() * k_echo_size);
+
+        load->client.charge(used, load->max_bytes);
+        if (used == 0)
+                return false;
+
+        /* Adapts the round size like Terminal::time_process_incoming() */
+        auto const start = std::chrono::steady_clock::now();
+        spin(used * g_cost);
+        auto const elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        auto const target = gsize(k_max_process_time / elapsed * used);
+        load->max_bytes = (load->max_bytes + target) / 2;
+
+        if (load->interactive) {
+                auto const now = g_get_monotonic_time();
+                for (auto n = used / k_echo_size; n > 0; --n) {
+                        load->latencies.push_back(now - load->echoes.front());
+                        load->echoes.pop_front();
+                }
+        }
+
+        /* Like invalidating the changed cells */
+        Scheduler::get().schedule_update(load->client);
+
+        return !load->interactive || !load->echoes.empty();
+}
+
+static gboolean
+echo_cb(gpointer data)
+{
+        auto load = reinterpret_cast<Load*>(data);
+        load->echoes.push_back(g_get_monotonic_time());
+        Scheduler::get().schedule_process(load->client);
+
+        return true;
+}
+
+static void
+run_main_loop(double seconds)
+{
+        auto context = g_main_context_default();
+        auto timer = g_timer_new();
+        while (g_timer_elapsed(timer, nullptr) < seconds)
+                g_main_context_iteration(context, TRUE);
+        g_timer_destroy(timer);
+}
+
+static void
+run_throughput(unsigned int n_terminals,
+               double seconds)
+{
+        std::vector<std::unique_ptr<Load>> loads;
+        for (auto i = 0u; i < n_terminals; ++i) {
+                loads.push_back(std::make_unique<Load>(false));
+                if (i == 0)
+                        Scheduler::get().set_weight(loads.back()->client,
+                                                    Scheduler::Client::k_weight_focused);
+                Scheduler::get().schedule_process(loads.back()->client);
+        }
+
+        run_main_loop(seconds);
+
+        uint64_t total = 0;
+        double sum = 0., sum_sq = 0.;
+        int64_t min_time = G_MAXINT64, max_time = 0;
+        for (auto i = 0u; i < n_terminals; ++i) {
+                auto const& client = loads[i]->client;
+                total += client.n_bytes();
+                if (i == 0)
+                        continue;
+
+                auto const x = double(client.n_bytes());
+                sum += x;
+                sum_sq += x * x;
+                min_time = std::min(min_time, client.processing_time());
+                max_time = std::max(max_time, client.processing_time());
+        }
+
+        auto const n_unfocused = n_terminals - 1;
+        auto const fairness = sum_sq > 0. ? sum * sum / (n_unfocused * sum_sq) : 1.;
+        auto const mean = n_unfocused > 0 ? sum / n_unfocused : 0.;
+
+        g_print("throughput terminals %4u: %8.1f MB/s fairness %.3f focused ×%-6.2f processing %.0f–%.0f ms\n",
+                n_terminals,
+                total / (1024. * 1024.) / seconds,
+                fairness,
+                mean > 0. ? loads[0]->client.n_bytes() / mean : 0.,
+                n_unfocused > 0 ? min_time / 1000. : 0.,
+                n_unfocused > 0 ? max_time / 1000. : 0.);
+
+        /* Unqueues them */
+        loads.clear();
+}
+
+static void
+run_latency(unsigned int n_terminals,
+            double seconds)
+{
+        std::vector<std::unique_ptr<Load>> loads;
+        loads.push_back(std::make_unique<Load>(true));
+        auto interactive = loads.back().get();
+        Scheduler::get().set_weight(interactive->client,
+                                    Scheduler::Client::k_weight_focused);
+
+        for (auto i = 1u; i < n_terminals; ++i) {
+                loads.push_back(std::make_unique<Load>(false));
+                Scheduler::get().schedule_process(loads.back()->client);
+        }
+
+        auto const tag = g_timeout_add(10, echo_cb, interactive);
+        run_main_loop(seconds);
+        g_source_remove(tag);
+
+        auto& latencies = interactive->latencies;
+        std::sort(latencies.begin(), latencies.end());
+        auto const n = latencies.size();
+        double avg = 0.;
+        for (auto l : latencies)
+                avg += l;
+        if (n > 0)
+                avg /= n;
+
+        g_print("latency    terminals %4u: %8.1f ms avg %8.1f ms p99 %8.1f ms max (%zu echoes)\n",
+                n_terminals,
+                avg / 1000.,
+                n > 0 ? latencies[std::min(n - 1, n * 99 / 100)] / 1000. : 0.,
+                n > 0 ? latencies.back() / 1000. : 0.,
+                n);
+
+        loads.clear();
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        int n_terminals = 0;
+        double seconds = 2.;
+        GOptionEntry const entries[] = {
+                { "terminals", 'n', 0, G_OPTION_ARG_INT, &n_terminals,
+                  "Number of terminals (default: 2, 10 and 100)", "N" },
+                { "seconds", 's', 0, G_OPTION_ARG_DOUBLE, &seconds,
+                  "Seconds to run each configuration", "SECONDS" },
+                { "cost", 'c', 0, G_OPTION_ARG_DOUBLE, &g_cost,
+                  "Processing cost per byte (default: 2)", "NS" },
+                { nullptr }
+        };
+
+        auto context = g_option_context_new("— terminal scheduler benchmark");
+        g_option_context_add_main_entries(context, entries, nullptr);
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        std::vector<unsigned int> counts;
+        if (n_terminals > 0)
+                counts.push_back(n_terminals);
+        else
+                counts = {2, 10, 100};
+
+        for (auto n : counts) {
+                run_throughput(n, seconds);
+                run_latency(n, seconds);
+        }
+
+        return EXIT_SUCCESS;
+}
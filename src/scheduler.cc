@@ -0,0 +1,453 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "scheduler.hh"
+
+#include <algorithm>
+
+#include "chunk.hh"
+#include "debug.h"
+#include "vtedefines.hh"
+
+/* Same as GDK_PRIORITY_REDRAW, without depending on gdk */
+#define VTE_SCHEDULER_PRIORITY_REDRAW (G_PRIORITY_HIGH_IDLE + 20)
+
+namespace vte {
+
+namespace base {
+
+Scheduler::Client::Client(callback_type callback,
+                          void* callback_data) noexcept :
+        m_callback{callback},
+        m_callback_data{callback_data}
+{
+}
+
+Scheduler::Client::~Client() noexcept
+{
+        Scheduler::get().unschedule(*this);
+}
+
+gsize
+Scheduler::Client::share(gsize bytes) const noexcept
+{
+        auto const& scheduler = Scheduler::get();
+        if (!m_queued || scheduler.m_total_weight <= m_weight)
+                return bytes;
+
+        return std::max(bytes * m_weight / scheduler.m_total_weight, k_min_share);
+}
+
+gsize
+Scheduler::Client::budget(gsize bytes) const noexcept
+{
+        auto const credit = gssize(share(bytes)) + m_credit;
+        return credit > 0 ? gsize(credit) : 0;
+}
+
+void
+Scheduler::Client::charge(gsize used,
+                          gsize bytes) noexcept
+{
+        m_n_bytes += used;
+
+        /* Unused credit isn't carried over, only debt; and no more
+         * debt than a whole round's worth, which can happen when a
+         * single read overshoots a small share.
+         */
+        auto const credit = gssize(share(bytes)) + m_credit - gssize(used);
+        m_credit = std::clamp(credit, -gssize(bytes), gssize(0));
+}
+
+Scheduler&
+Scheduler::get() noexcept
+{
+        static Scheduler s_scheduler;
+        return s_scheduler;
+}
+
+void
+Scheduler::enqueue(Client& client) noexcept
+{
+        if (client.m_queued)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_TIMEOUT, "Adding terminal to run queue\n");
+
+        /* Queued during a round? Then wait for the next one */
+        client.m_round = m_round;
+        client.m_queued = true;
+
+        /* Higher weight clients go first */
+        if (client.m_weight > Client::k_weight_default) {
+                client.m_prev = nullptr;
+                client.m_next = m_head;
+                if (m_head != nullptr)
+                        m_head->m_prev = &client;
+                else
+                        m_tail = &client;
+                m_head = &client;
+        } else {
+                client.m_prev = m_tail;
+                client.m_next = nullptr;
+                if (m_tail != nullptr)
+                        m_tail->m_next = &client;
+                else
+                        m_head = &client;
+                m_tail = &client;
+        }
+
+        ++m_n_queued;
+        if (!client.m_frame_driven)
+                ++m_n_timed;
+        m_total_weight += client.m_weight;
+}
+
+void
+Scheduler::unschedule(Client& client) noexcept
+{
+        if (!client.m_queued)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing terminal from run queue\n");
+
+        /* Don't touch it anymore in the current round */
+        if (m_current == &client)
+                m_current = nullptr;
+        if (m_next == &client)
+                m_next = client.m_next;
+
+        if (client.m_prev != nullptr)
+                client.m_prev->m_next = client.m_next;
+        else
+                m_head = client.m_next;
+        if (client.m_next != nullptr)
+                client.m_next->m_prev = client.m_prev;
+        else
+                m_tail = client.m_prev;
+
+        client.m_prev = client.m_next = nullptr;
+        client.m_queued = false;
+        /* Like in DRR, an idle client forfeits its debt */
+        client.m_credit = 0;
+
+        --m_n_queued;
+        if (!client.m_frame_driven)
+                --m_n_timed;
+        m_total_weight -= client.m_weight;
+
+        /* While dispatching, the timeout handler cleans up */
+        if (m_n_timed == 0 && !m_dispatching)
+                stop_timeout();
+}
+
+void
+Scheduler::set_weight(Client& client,
+                      unsigned int weight) noexcept
+{
+        if (weight == client.m_weight)
+                return;
+
+        if (client.m_queued) {
+                m_total_weight = m_total_weight - client.m_weight + weight;
+
+                /* Move it to the front now, unless that would
+                 * upset the current round.
+                 */
+                if (weight > Client::k_weight_default &&
+                    m_head != &client &&
+                    !m_dispatching) {
+                        auto const credit = client.m_credit;
+                        client.m_weight = weight;
+                        unschedule(client);
+                        enqueue(client);
+                        client.m_credit = credit;
+                        return;
+                }
+        }
+
+        client.m_weight = weight;
+}
+
+/* A client becoming timed while queued needs to schedule itself again,
+ * with schedule_update() if it has redraws pending.
+ */
+void
+Scheduler::set_frame_driven(Client& client,
+                            bool frame_driven) noexcept
+{
+        if (frame_driven == client.m_frame_driven)
+                return;
+
+        client.m_frame_driven = frame_driven;
+        if (!client.m_queued)
+                return;
+
+        if (frame_driven) {
+                --m_n_timed;
+                if (m_n_timed == 0 && !m_dispatching)
+                        stop_timeout();
+        } else
+                ++m_n_timed;
+}
+
+void
+Scheduler::schedule_process(Client& client) noexcept
+{
+        enqueue(client);
+
+        if (client.m_frame_driven)
+                return;
+
+        if (m_state == State::eIdle)
+                start_timeout(State::eProcess);
+}
+
+void
+Scheduler::schedule_update(Client& client) noexcept
+{
+        enqueue(client);
+
+        if (client.m_frame_driven)
+                return;
+
+        switch (m_state) {
+        case State::eProcess:
+                /* Returning false from the process timeout removes it */
+                if (!m_dispatching)
+                        stop_timeout();
+                [[fallthrough]];
+        case State::eIdle:
+                start_timeout(State::eUpdate);
+                break;
+        case State::eUpdate:
+        case State::eRepeat:
+                break;
+        }
+}
+
+void
+Scheduler::start_timeout(State state) noexcept
+{
+        switch (state) {
+        case State::eProcess:
+                _vte_debug_print(VTE_DEBUG_TIMEOUT, "Starting process timeout\n");
+                m_source = g_timeout_add(VTE_DISPLAY_TIMEOUT,
+                                         process_timeout_cb, this);
+                break;
+        case State::eUpdate:
+                _vte_debug_print(VTE_DEBUG_TIMEOUT, "Starting update timeout\n");
+                m_source = g_timeout_add_full(VTE_SCHEDULER_PRIORITY_REDRAW,
+                                              VTE_UPDATE_TIMEOUT,
+                                              update_timeout_cb, this,
+                                              nullptr);
+                break;
+        case State::eRepeat:
+                m_source = g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                              VTE_UPDATE_REPEAT_TIMEOUT,
+                                              update_timeout_cb, this,
+                                              nullptr);
+                break;
+        case State::eIdle:
+                g_assert_not_reached();
+                break;
+        }
+
+        m_state = state;
+}
+
+void
+Scheduler::stop_timeout() noexcept
+{
+        if (m_source != 0) {
+                _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing timeout\n");
+                g_source_remove(m_source);
+                m_source = 0;
+        }
+
+        m_state = State::eIdle;
+}
+
+/* Returns whether @client is still queued */
+bool
+Scheduler::run_client(Client& client,
+                      bool update) noexcept
+{
+        m_current = &client;
+        auto const start = g_get_monotonic_time();
+        auto const again = client.m_callback(client.m_callback_data, update);
+
+        /* Unqueued, or even destroyed, by the callback? */
+        if (m_current == nullptr)
+                return false;
+        m_current = nullptr;
+
+        client.m_processing_time += g_get_monotonic_time() - start;
+        ++client.m_n_dispatches;
+
+        if (!again) {
+                unschedule(client);
+                return false;
+        }
+
+        return true;
+}
+
+bool
+Scheduler::dispatch(Client& client,
+                    bool update) noexcept
+{
+        g_assert(client.m_frame_driven);
+
+        if (!client.m_queued)
+                return false;
+
+        /* From a nested main loop in a round; try again next frame */
+        if (m_dispatching)
+                return true;
+
+        return run_client(client, update);
+}
+
+void
+Scheduler::run_round(bool update) noexcept
+{
+        ++m_round;
+
+        m_next = m_head;
+        while (m_next != nullptr) {
+                auto client = m_next;
+                m_next = client->m_next;
+
+                /* Frame-driven clients dispatch themselves */
+                if (client->m_round == m_round ||
+                    client->m_frame_driven)
+                        continue;
+                client->m_round = m_round;
+
+                if (client != m_head) {
+                        _vte_debug_print(VTE_DEBUG_WORK, "T");
+                }
+
+                run_client(*client, update);
+        }
+}
+
+/* This function is called after DISPLAY_TIMEOUT ms.
+ * It makes sure initial output is never delayed by more than DISPLAY_TIMEOUT
+ */
+gboolean
+Scheduler::process_timeout() noexcept
+{
+        m_dispatching = true;
+
+        _vte_debug_print(VTE_DEBUG_WORK, "<");
+        _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                         "Process timeout:  %u active\n",
+                         m_n_queued);
+
+        run_round(false);
+
+        _vte_debug_print(VTE_DEBUG_WORK, ">");
+
+        m_dispatching = false;
+
+        /* Was an update requested in the meantime? Then there's
+         * already another timeout.
+         */
+        if (m_state != State::eProcess)
+                return false;
+
+        if (m_n_timed == 0) {
+                _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                                 "Stopping process timeout\n");
+                m_source = 0;
+                m_state = State::eIdle;
+
+                /* Free up memory used to capture incoming data */
+                Chunk::prune();
+                return false;
+        }
+
+        /* Force us to relinquish the CPU as the child is running
+         * at full tilt and making us run to keep up...
+         */
+        g_usleep(0);
+        return true;
+}
+
+gboolean
+Scheduler::update_timeout() noexcept
+{
+        m_dispatching = true;
+
+        _vte_debug_print(VTE_DEBUG_WORK, m_state == State::eRepeat ? "[" : "{");
+        _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                         "%s timeout:  %u active\n",
+                         m_state == State::eRepeat ? "Repeat" : "Update",
+                         m_n_queued);
+
+        run_round(true);
+
+        _vte_debug_print(VTE_DEBUG_WORK, m_state == State::eRepeat ? "]" : "}");
+
+        m_dispatching = false;
+
+        /* We only stop the timer if no update request was received in this
+         * past cycle.  Technically, always stop this timer object and maybe
+         * reinstall a new one because we need to delay by the amount of time
+         * it took to repaint the screen: bug 730732.
+         */
+        m_source = 0;
+        if (m_n_timed == 0) {
+                _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                                 "Stopping update timeout\n");
+                m_state = State::eIdle;
+
+                /* Free up memory used to capture incoming data */
+                Chunk::prune();
+                return false;
+        }
+
+        /* Set a timer such that we do not invalidate for a while. */
+        /* This limits the number of times we draw to ~40fps. */
+        start_timeout(State::eRepeat);
+
+        /* Force us to relinquish the CPU as the child is running
+         * at full tilt and making us run to keep up...
+         */
+        g_usleep(0);
+        return false;
+}
+
+gboolean
+Scheduler::process_timeout_cb(gpointer data) noexcept
+{
+        return reinterpret_cast<Scheduler*>(data)->process_timeout();
+}
+
+gboolean
+Scheduler::update_timeout_cb(gpointer data) noexcept
+{
+        return reinterpret_cast<Scheduler*>(data)->update_timeout();
+}
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,190 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <glib.h>
+
+namespace vte {
+
+namespace base {
+
+/*
+ * Scheduler:
+ *
+ * Drives the processing of input and the redrawing of all terminals
+ * from a single main loop timeout.
+ *
+ * Clients with work to do are kept on an intrusive run queue, so
+ * queueing and unqueueing is O(1), and each round dispatches every
+ * queued client once. Until the first redraw is requested, rounds
+ * run every VTE_DISPLAY_TIMEOUT ms, so that initial output isn't
+ * delayed; after that, every VTE_UPDATE_TIMEOUT ms for the first
+ * redraw, and every VTE_UPDATE_REPEAT_TIMEOUT ms while busy.
+ *
+ * A client can instead be driven by its own frame clock, dispatching
+ * itself once per frame with dispatch(); it still takes part in the
+ * sharing out of input, but the rounds skip it, and as long as all
+ * queued clients are frame-driven, there's no timeout at all.
+ *
+ * The input read between two dispatches is shared out in proportion
+ * to the clients' weights (deficit round robin): a client gets credit
+ * for its share of the bytes each round, and a client that read more
+ * than its share pays it back in later rounds. The focused terminal
+ * gets a higher weight, and is dispatched first.
+ *
+ * Main-thread only.
+ */
+class Scheduler {
+public:
+        /* Called with @update false in rounds that only process input,
+         * and true in rounds that also redraw. Returns whether the
+         * client still has work to do; if not, it's unqueued.
+         */
+        using callback_type = bool (*)(void* data,
+                                       bool update);
+
+        class Client {
+                friend class Scheduler;
+
+        public:
+                static constexpr unsigned int const k_weight_default = 1;
+                static constexpr unsigned int const k_weight_focused = 4;
+
+                Client(callback_type callback,
+                       void* callback_data) noexcept;
+                ~Client() noexcept;
+
+                Client(Client const&) = delete;
+                Client(Client&&) = delete;
+                Client& operator= (Client const&) = delete;
+                Client& operator= (Client&&) = delete;
+
+                inline constexpr bool is_queued() const noexcept { return m_queued; }
+                inline constexpr bool is_frame_driven() const noexcept { return m_frame_driven; }
+                inline constexpr unsigned int weight() const noexcept { return m_weight; }
+
+                /* How many bytes of input the client may read until its
+                 * next dispatch, out of @bytes for all queued clients.
+                 */
+                gsize budget(gsize bytes) const noexcept;
+                /* Settles the credit for having read @used bytes of @bytes */
+                void charge(gsize used,
+                            gsize bytes) noexcept;
+
+                /* Accounting */
+                inline constexpr int64_t processing_time() const noexcept { return m_processing_time; }
+                inline constexpr uint64_t n_dispatches() const noexcept { return m_n_dispatches; }
+                inline constexpr uint64_t n_bytes() const noexcept { return m_n_bytes; }
+
+        private:
+                gsize share(gsize bytes) const noexcept;
+
+                callback_type m_callback;
+                void* m_callback_data;
+
+                Client* m_prev{nullptr};
+                Client* m_next{nullptr};
+                bool m_queued{false};
+                bool m_frame_driven{false};
+                uint64_t m_round{0};  /* last round dispatched in, or queued in */
+
+                unsigned int m_weight{k_weight_default};
+                gssize m_credit{0};   /* bytes; only ever negative */
+
+                int64_t m_processing_time{0}; /* µs */
+                uint64_t m_n_dispatches{0};
+                uint64_t m_n_bytes{0};
+        };
+
+        static Scheduler& get() noexcept;
+
+        /* Queues @client to have its input processed */
+        void schedule_process(Client& client) noexcept;
+        /* Queues @client to be redrawn */
+        void schedule_update(Client& client) noexcept;
+        void unschedule(Client& client) noexcept;
+
+        void set_weight(Client& client,
+                        unsigned int weight) noexcept;
+        void set_frame_driven(Client& client,
+                              bool frame_driven) noexcept;
+
+        /* For frame-driven clients, to be called once per frame while
+         * queued. Returns whether the client is still queued.
+         */
+        bool dispatch(Client& client,
+                      bool update) noexcept;
+
+        inline constexpr unsigned int n_queued() const noexcept { return m_n_queued; }
+        inline constexpr unsigned int total_weight() const noexcept { return m_total_weight; }
+
+private:
+        /* Don't hand out less than this per round; reading tiny
+         * amounts per dispatch is just overhead.
+         */
+        static constexpr gsize const k_min_share = 0x1000;
+
+        enum class State {
+                eIdle,
+                eProcess, /* processing input only */
+                eUpdate,  /* waiting for the first redraw */
+                eRepeat,  /* redrawing at a limited rate */
+        };
+
+        Scheduler() noexcept = default;
+        ~Scheduler() noexcept = default;
+
+        Scheduler(Scheduler const&) = delete;
+        Scheduler(Scheduler&&) = delete;
+        Scheduler& operator= (Scheduler const&) = delete;
+        Scheduler& operator= (Scheduler&&) = delete;
+
+        void enqueue(Client& client) noexcept;
+        bool run_client(Client& client,
+                        bool update) noexcept;
+        void start_timeout(State state) noexcept;
+        void stop_timeout() noexcept;
+        void run_round(bool update) noexcept;
+        gboolean process_timeout() noexcept;
+        gboolean update_timeout() noexcept;
+
+        static gboolean process_timeout_cb(gpointer data) noexcept;
+        static gboolean update_timeout_cb(gpointer data) noexcept;
+
+        /* The run queue */
+        Client* m_head{nullptr};
+        Client* m_tail{nullptr};
+        unsigned int m_n_queued{0};
+        unsigned int m_n_timed{0};  /* queued and not frame-driven */
+        unsigned int m_total_weight{0};
+
+        /* The current round */
+        uint64_t m_round{0};
+        Client* m_current{nullptr};
+        Client* m_next{nullptr};
+
+        State m_state{State::eIdle};
+        guint m_source{0};
+        bool m_dispatching{false};
+};
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,364 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Applies streams of SGR sequences to the attributes, like Terminal::SGR(),
+ * once interpreting each sequence and once through the SGRCache, and
+ * reports the rate of each and the cache's hit rate. Both include parsing
+ * the sequences the way the terminal does, so the difference is what
+ * the cache saves; the rate of parsing alone is given for reference, and
+ * the last columns subtract it to give the cost of applying a sequence.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "parser.hh"
+#include "parser-glue.hh"
+#include "sgr.hh"
+
+/*
+ * SGRCache:
+ *
+ * Remembers the effect of SGR sequences, so that applying a sequence
+ * whose parameters were seen before is one lookup and a masked copy,
+ * instead of interpreting each parameter.
+ *
+ * Each parameter only ever assigns attribute bits or colours, whatever
+ * they were before, so the effect of a whole sequence is which bits it
+ * assigns and to what. That's the same for any attributes it's applied
+ * to, so the cache is keyed by the parameters alone. The hyperlink is
+ * never touched by SGR.
+ *
+ * The terminal doesn't use it: interpreting the parameters costs no
+ * more than the lookup, even when nearly every sequence hits, and a good
+ * deal less when they don't repeat. It lives here so that this can be
+ * measured again when apply_sgr() changes.
+ */
+class SGRCache {
+public:
+        SGRCache() noexcept = default;
+        ~SGRCache() noexcept = default;
+
+        SGRCache(SGRCache const&) = delete;
+        SGRCache(SGRCache&&) = delete;
+        SGRCache& operator=(SGRCache const&) = delete;
+        SGRCache& operator=(SGRCache&&) = delete;
+
+        /* Like apply_sgr() */
+        void apply(vte::parser::Sequence const& seq,
+                   VteCellAttr& attr) noexcept;
+
+        void clear() noexcept;
+
+        inline constexpr uint64_t n_hits() const noexcept { return m_n_hits; }
+        inline constexpr uint64_t n_misses() const noexcept { return m_n_misses; }
+
+private:
+        /* Longer sequences aren't cached; they're rare, and long to compare */
+        static constexpr unsigned int const k_max_params = 8;
+        static constexpr unsigned int const k_n_entries_log2 = 7;
+        static constexpr unsigned int const k_n_entries = 1u << k_n_entries_log2;
+
+        struct Entry {
+                /* Key; n_params is one more than the number of parameters,
+                 * so that 0 means unused
+                 */
+                uint32_t n_params;
+                vte_seq_arg_t params[k_max_params];
+
+                /* Value: the bits the sequence assigns, and their values;
+                 * both masks are 0 until the sequence has been seen twice
+                 */
+                uint32_t attr_mask;
+                uint32_t attr_value;
+                uint64_t colors_mask;
+                uint64_t colors_value;
+        };
+
+        std::array<Entry, k_n_entries> m_entries{};
+        uint64_t m_n_hits{0};
+        uint64_t m_n_misses{0};
+};
+
+void
+SGRCache::apply(vte::parser::Sequence const& seq,
+                VteCellAttr& attr) noexcept
+{
+        auto const n_params = seq.size();
+        if (G_UNLIKELY(n_params > k_max_params)) {
+                vte::terminal::apply_sgr(seq, attr);
+                return;
+        }
+
+        auto hash = n_params;
+        vte_seq_arg_t params[k_max_params];
+        for (unsigned int i = 0; i < n_params; ++i) {
+                params[i] = seq.param_raw(i);
+                hash = (hash ^ uint32_t(params[i])) * 0x9e3779b1u;
+        }
+
+        auto& entry = m_entries[hash >> (32 - k_n_entries_log2)];
+        auto hit = entry.n_params == n_params + 1;
+        for (unsigned int i = 0; hit && i < n_params; ++i)
+                hit = entry.params[i] == params[i];
+        if (G_UNLIKELY(!hit)) {
+                ++m_n_misses;
+
+                /* Only remember the parameters the first time round, since
+                 * most sequences that don't repeat soon don't repeat at all
+                 * (direct colours, for example); working out the effect
+                 * costs two interpretations.
+                 */
+                entry.n_params = n_params + 1;
+                memcpy(entry.params, params, n_params * sizeof(params[0]));
+                entry.attr_mask = 0;
+                entry.colors_mask = 0;
+                vte::terminal::apply_sgr(seq, attr);
+                return;
+        }
+
+        ++m_n_hits;
+        if (G_UNLIKELY(entry.attr_mask == 0 && entry.colors_mask == 0)) {
+                /* Find the bits that the sequence assigns: those that come out
+                 * the same from all bits clear and all bits set.
+                 */
+                auto clear = basic_cell.attr;
+                clear.attr = 0;
+                clear.m_colors = 0;
+                vte::terminal::apply_sgr(seq, clear);
+
+                auto set = basic_cell.attr;
+                set.attr = ~uint32_t{0};
+                set.m_colors = ~uint64_t{0};
+                vte::terminal::apply_sgr(seq, set);
+
+                entry.attr_mask = ~(clear.attr ^ set.attr);
+                entry.attr_value = clear.attr & entry.attr_mask;
+                entry.colors_mask = ~(clear.colors() ^ set.colors());
+                entry.colors_value = clear.colors() & entry.colors_mask;
+        }
+
+        attr.attr = (attr.attr & ~entry.attr_mask) | entry.attr_value;
+        attr.m_colors = (attr.m_colors & ~entry.colors_mask) | entry.colors_value;
+}
+
+void
+SGRCache::clear() noexcept
+{
+        m_entries.fill(Entry{});
+}
+
+static constexpr size_t const k_n_sequences = 1 << 20;
+
+struct Workload {
+        char const* name;
+        std::vector<std::string> sequences;
+};
+
+static std::vector<Workload>
+make_workloads(GRand* rand)
+{
+        std::vector<Workload> workloads;
+
+        /* Like ls --color */
+        workloads.push_back({"ls-color", {"\033[0m", "\033[01;34m", "\033[01;36m", "\033[01;32m",
+                                          "\033[40;33;01m", "\033[01;35m", "\033[00;31m"}});
+
+        /* Like perf/sgr-test.sh */
+        workloads.push_back({"sgr-attributes", {"\033[1m", "\033[22m", "\033[2m", "\033[3m", "\033[23m",
+                                                "\033[4m", "\033[24m", "\033[4:1m", "\033[4:0m",
+                                                "\033[21m", "\033[4:3m", "\033[5m", "\033[25m",
+                                                "\033[7m", "\033[27m", "\033[9m", "\033[29m",
+                                                "\033[32m", "\033[39m", "\033[45m", "\033[49m",
+                                                "\033[58:5:9m", "\033[59m"}});
+
+        /* Like perf/256test.sh */
+        auto colors = Workload{"256colors", {}};
+        for (auto i = 0; i < 256; ++i) {
+                char buf[32];
+                g_snprintf(buf, sizeof(buf), "\033[38;5;%dm", i);
+                colors.sequences.push_back(buf);
+                g_snprintf(buf, sizeof(buf), "\033[38:5:%dm", i);
+                colors.sequences.push_back(buf);
+        }
+        colors.sequences.push_back("\033[0m");
+        colors.sequences.push_back("\033[1;2m");
+        workloads.push_back(std::move(colors));
+
+        /* Truecolour, which hardly ever repeats */
+        auto truecolor = Workload{"truecolor", {}};
+        for (auto i = 0; i < 4096; ++i) {
+                char buf[48];
+                g_snprintf(buf, sizeof(buf), "\033[0;38;2;%d;%d;%dm",
+                           g_rand_int_range(rand, 0, 256),
+                           g_rand_int_range(rand, 0, 256),
+                           g_rand_int_range(rand, 0, 256));
+                truecolor.sequences.push_back(buf);
+        }
+        workloads.push_back(std::move(truecolor));
+
+        /* Truecolour from a syntax highlighting theme, like bat or delta */
+        auto theme = Workload{"truecolor-theme", {}};
+        for (auto i = 0; i < 24; ++i) {
+                char buf[48];
+                g_snprintf(buf, sizeof(buf), "\033[38;2;%d;%d;%dm",
+                           g_rand_int_range(rand, 0, 256),
+                           g_rand_int_range(rand, 0, 256),
+                           g_rand_int_range(rand, 0, 256));
+                theme.sequences.push_back(buf);
+        }
+        theme.sequences.push_back("\033[0m");
+        theme.sequences.push_back("\033[1m");
+        theme.sequences.push_back("\033[3m");
+        workloads.push_back(std::move(theme));
+
+        return workloads;
+}
+
+/* Picks from @workload's sequences in a reproducible order, the same for
+ * all runs; mostly in order, like the output of a program repeating itself.
+ */
+static std::string
+make_input(Workload const& workload,
+           GRand* rand)
+{
+        std::string input;
+        auto const n = workload.sequences.size();
+        size_t idx = 0;
+        for (size_t i = 0; i < k_n_sequences; ++i) {
+                if (g_rand_int_range(rand, 0, 4) == 0)
+                        idx = g_rand_int_range(rand, 0, n);
+                else
+                        idx = (idx + 1) % n;
+                input.append(workload.sequences[idx]);
+        }
+
+        return input;
+}
+
+template<typename F>
+static double
+apply_all(std::string const& input,
+          F&& apply)
+{
+        vte::parser::Parser parser;
+        vte::parser::Sequence seq{parser};
+        auto attr = basic_cell.attr;
+
+        /* Like the terminal does it, see vte_parser_feed_csi() */
+        auto const start = std::chrono::steady_clock::now();
+        auto p = reinterpret_cast<uint8_t const*>(input.data());
+        auto const end = p + input.size();
+        while (p < end) {
+                auto const n = parser.feed_csi(p, end);
+                if (n > 0) {
+                        if (seq.command() == VTE_CMD_SGR)
+                                apply(seq, attr);
+                        p += n;
+                } else if (parser.feed(*p++) == VTE_SEQ_CSI &&
+                           seq.command() == VTE_CMD_SGR) {
+                        apply(seq, attr);
+                }
+        }
+        auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        /* So that the work can't be optimised away */
+        if (attr.attr == 0xffffffffu)
+                g_print(" ");
+
+        return elapsed;
+}
+
+template<typename F>
+static double
+measure(std::string const& input,
+        unsigned int repeat,
+        F&& apply)
+{
+        auto best = G_MAXDOUBLE;
+        for (auto i = 0u; i < repeat; ++i)
+                best = std::min(best, apply_all(input, apply));
+
+        return k_n_sequences / best / 1e6;
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        int repeat = 5;
+        int seed = 42;
+        GOptionEntry const entries[] = {
+                { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+                  "Number of runs, of which the best counts", "N" },
+                { "seed", 0, 0, G_OPTION_ARG_INT, &seed,
+                  "Seed for generating the input", "SEED" },
+                { nullptr }
+        };
+
+        auto context = g_option_context_new("— SGR cache benchmark");
+        g_option_context_add_main_entries(context, entries, nullptr);
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        auto rand = g_rand_new_with_seed(guint32(seed));
+
+        g_print("%-16s %12s %14s %12s %10s %14s %12s\n",
+                "workload", "parse M/s", "uncached M/s", "cached M/s", "hit rate",
+                "uncached ns", "cached ns");
+        for (auto const& workload : make_workloads(rand)) {
+                auto const input = make_input(workload, rand);
+
+                auto const parse_rate = measure(input, repeat, [](auto const& seq, auto& attr) { });
+
+                auto const uncached_rate = measure(input, repeat, [](auto const& seq, auto& attr) {
+                                vte::terminal::apply_sgr(seq, attr);
+                        });
+
+                SGRCache cache;
+                auto const cached_rate = measure(input, repeat, [&](auto const& seq, auto& attr) {
+                                cache.apply(seq, attr);
+                        });
+
+                auto const lookups = cache.n_hits() + cache.n_misses();
+                g_print("%-16s %12.1f %14.1f %12.1f %9.1f%% %14.1f %12.1f\n",
+                        workload.name, parse_rate, uncached_rate, cached_rate,
+                        lookups ? 100. * cache.n_hits() / lookups : 0.,
+                        1e3 / uncached_rate - 1e3 / parse_rate,
+                        1e3 / cached_rate - 1e3 / parse_rate);
+        }
+
+        g_rand_free(rand);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "sgr.hh"
+
+namespace vte {
+
+namespace terminal {
+
+/*
+ * Parse parameters of SGR 38, 48 or 58, starting at @index within @seq.
+ * Returns %true if @seq contained colour parameters at @index, or %false otherwise.
+ * In each case, @idx is set to last consumed parameter,
+ * and the colour is returned in @color.
+ *
+ * The format looks like:
+ * - 256 color indexed palette:
+ *   - ^[[38:5:INDEXm  (de jure standard: ITU-T T.416 / ISO/IEC 8613-6; we also allow and ignore further parameters)
+ *   - ^[[38;5;INDEXm  (de facto standard, understood by probably all terminal emulators that support 256 colors)
+ * - true colors:
+ *   - ^[[38:2:[id]:RED:GREEN:BLUE[:...]m  (de jure standard: ITU-T T.416 / ISO/IEC 8613-6)
+ *   - ^[[38:2:RED:GREEN:BLUEm             (common misinterpretation of the standard, FIXME: stop supporting it at some point)
+ *   - ^[[38;2;RED;GREEN;BLUEm             (de facto standard, understood by probably all terminal emulators that support true colors)
+ * See bugs 685759 and 791456 for details.
+ */
+template<unsigned int redbits, unsigned int greenbits, unsigned int bluebits>
+static bool
+parse_sgr_color(vte::parser::Sequence const& seq,
+                unsigned int &idx,
+                uint32_t& color) noexcept
+{
+        /* Note that we don't have to check if the index is after the end of
+         * the parameters list, since dereferencing is safe and returns -1.
+         */
+
+        if (seq.param_nonfinal(idx)) {
+                /* Colon version */
+                switch (seq.param(++idx)) {
+                case VTE_SGR_COLOR_SPEC_RGB: {
+                        auto const n = seq.next(idx) - idx;
+                        if (n < 4)
+                                return false;
+                        if (n > 4) {
+                                /* Consume a colourspace parameter; it must be default */
+                                if (!seq.param_default(++idx))
+                                        return false;
+                        }
+
+                        int red = seq.param(++idx);
+                        int green = seq.param(++idx);
+                        int blue = seq.param(++idx);
+                        if ((red & 0xff) != red ||
+                            (green & 0xff) != green ||
+                            (blue & 0xff) != blue)
+                                return false;
+
+                        color = VTE_RGB_COLOR(redbits, greenbits, bluebits, red, green, blue);
+                        return true;
+                }
+                case VTE_SGR_COLOR_SPEC_LEGACY: {
+                        auto const n = seq.next(idx) - idx;
+                        if (n < 2)
+                                return false;
+
+                        int v = seq.param(++idx);
+                        if (v < 0 || v >= 256)
+                                return false;
+
+                        color = (uint32_t)v;
+                        return true;
+                }
+                }
+        } else {
+                /* Semicolon version */
+
+                idx = seq.next(idx);
+                switch (seq.param(idx)) {
+                case VTE_SGR_COLOR_SPEC_RGB: {
+                        /* Consume 3 more parameters */
+                        idx = seq.next(idx);
+                        int red = seq.param(idx);
+                        idx = seq.next(idx);
+                        int green = seq.param(idx);
+                        idx = seq.next(idx);
+                        int blue = seq.param(idx);
+
+                        if ((red & 0xff) != red ||
+                            (green & 0xff) != green ||
+                            (blue & 0xff) != blue)
+                                return false;
+
+                        color = VTE_RGB_COLOR(redbits, greenbits, bluebits, red, green, blue);
+                        return true;
+                }
+                case VTE_SGR_COLOR_SPEC_LEGACY: {
+                        /* Consume 1 more parameter */
+                        idx = seq.next(idx);
+                        int v = seq.param(idx);
+
+                        if ((v & 0xff) != v)
+                                return false;
+
+                        color = (uint32_t)v;
+                        return true;
+                }
+                }
+        }
+
+        return false;
+}
+
+
+/* Like Terminal::reset_default_attributes(false) */
+static inline void
+reset_attributes(VteCellAttr& attr) noexcept
+{
+        auto const hyperlink_idx = attr.hyperlink_idx;
+        attr = basic_cell.attr;
+        attr.hyperlink_idx = hyperlink_idx;
+}
+
+/*
+ * apply_sgr:
+ * @seq: a SGR sequence
+ * @attr: the attributes to modify
+ *
+ * Applies the attributes selected by @seq to @attr.
+ */
+void
+apply_sgr(vte::parser::Sequence const& seq,
+          VteCellAttr& attr) noexcept
+{
+        auto const n_params = seq.size();
+
+        /* If we had no parameters, default to the defaults. */
+        if (n_params == 0) {
+                reset_attributes(attr);
+                return;
+        }
+
+        for (unsigned int i = 0; i < n_params; i = seq.next(i)) {
+                auto const param = seq.param(i);
+                switch (param) {
+                case -1:
+                case VTE_SGR_RESET_ALL:
+                        reset_attributes(attr);
+                        break;
+                case VTE_SGR_SET_BOLD:
+                        attr.set_bold(true);
+                        break;
+                case VTE_SGR_SET_DIM:
+                        attr.set_dim(true);
+                        break;
+                case VTE_SGR_SET_ITALIC:
+                        attr.set_italic(true);
+                        break;
+                case VTE_SGR_SET_UNDERLINE: {
+                        unsigned int v = 1;
+                        /* If we have a subparameter, get it */
+                        if (seq.param_nonfinal(i)) {
+                                v = seq.param(i + 1, 1, 0, 3);
+                        }
+                        attr.set_underline(v);
+                        break;
+                }
+                case VTE_SGR_SET_BLINK:
+                        attr.set_blink(true);
+                        break;
+                case VTE_SGR_SET_REVERSE:
+                        attr.set_reverse(true);
+                        break;
+                case VTE_SGR_SET_INVISIBLE:
+                        attr.set_invisible(true);
+                        break;
+                case VTE_SGR_SET_STRIKETHROUGH:
+                        attr.set_strikethrough(true);
+                        break;
+                case VTE_SGR_SET_UNDERLINE_DOUBLE:
+                        attr.set_underline(2);
+                        break;
+                case VTE_SGR_RESET_BOLD_AND_DIM:
+                        attr.unset(VTE_ATTR_BOLD_MASK | VTE_ATTR_DIM_MASK);
+                        break;
+                case VTE_SGR_RESET_ITALIC:
+                        attr.set_italic(false);
+                        break;
+                case VTE_SGR_RESET_UNDERLINE:
+                        attr.set_underline(0);
+                        break;
+                case VTE_SGR_RESET_BLINK:
+                        attr.set_blink(false);
+                        break;
+                case VTE_SGR_RESET_REVERSE:
+                        attr.set_reverse(false);
+                        break;
+                case VTE_SGR_RESET_INVISIBLE:
+                        attr.set_invisible(false);
+                        break;
+                case VTE_SGR_RESET_STRIKETHROUGH:
+                        attr.set_strikethrough(false);
+                        break;
+                case VTE_SGR_SET_FORE_LEGACY_START ... VTE_SGR_SET_FORE_LEGACY_END:
+                        attr.set_fore(VTE_LEGACY_COLORS_OFFSET + (param - 30));
+                        break;
+                case VTE_SGR_SET_FORE_SPEC: {
+                        uint32_t fore;
+                        if (G_LIKELY((parse_sgr_color<8, 8, 8>(seq, i, fore))))
+                                attr.set_fore(fore);
+                        break;
+                }
+                case VTE_SGR_RESET_FORE:
+                        /* default foreground */
+                        attr.set_fore(VTE_DEFAULT_FG);
+                        break;
+                case VTE_SGR_SET_BACK_LEGACY_START ... VTE_SGR_SET_BACK_LEGACY_END:
+                        attr.set_back(VTE_LEGACY_COLORS_OFFSET + (param - 40));
+                        break;
+                case VTE_SGR_SET_BACK_SPEC: {
+                        uint32_t back;
+                        if (G_LIKELY((parse_sgr_color<8, 8, 8>(seq, i, back))))
+                                attr.set_back(back);
+                        break;
+                }
+                case VTE_SGR_RESET_BACK:
+                        /* default background */
+                        attr.set_back(VTE_DEFAULT_BG);
+                        break;
+                case VTE_SGR_SET_OVERLINE:
+                        attr.set_overline(true);
+                        break;
+                case VTE_SGR_RESET_OVERLINE:
+                        attr.set_overline(false);
+                        break;
+                case VTE_SGR_SET_DECO_SPEC: {
+                        uint32_t deco;
+                        if (G_LIKELY((parse_sgr_color<4, 5, 4>(seq, i, deco))))
+                                attr.set_deco(deco);
+                        break;
+                }
+                case VTE_SGR_RESET_DECO:
+                        /* default decoration color, that is, same as the cell's foreground */
+                        attr.set_deco(VTE_DEFAULT_FG);
+                        break;
+                case VTE_SGR_SET_FORE_LEGACY_BRIGHT_START ... VTE_SGR_SET_FORE_LEGACY_BRIGHT_END:
+                        attr.set_fore(VTE_LEGACY_COLORS_OFFSET + (param - 90) +
+                                      VTE_COLOR_BRIGHT_OFFSET);
+                        break;
+                case VTE_SGR_SET_BACK_LEGACY_BRIGHT_START ... VTE_SGR_SET_BACK_LEGACY_BRIGHT_END:
+                        attr.set_back(VTE_LEGACY_COLORS_OFFSET + (param - 100) +
+                                      VTE_COLOR_BRIGHT_OFFSET);
+                        break;
+                }
+        }
+}
+
+} // namespace terminal
+
+} // namespace vte
@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <thread>
+
+#include <glib.h>
+
+#include "spscqueue.hh"
+
+using namespace vte::base;
+
+static void
+test_spscqueue_basic(void)
+{
+        SPSCQueue<unsigned int, 4> q;
+        unsigned int v;
+
+        g_assert_true(q.empty());
+        g_assert_false(q.full());
+        g_assert_false(q.pop(v));
+
+        for (unsigned int i = 0; i < q.capacity(); ++i)
+                g_assert_true(q.push(i));
+        g_assert_true(q.full());
+        g_assert_cmpuint(q.size(), ==, 4);
+        g_assert_false(q.push(42));
+
+        for (unsigned int i = 0; i < q.capacity(); ++i) {
+                g_assert_true(q.pop(v));
+                g_assert_cmpuint(v, ==, i);
+        }
+        g_assert_true(q.empty());
+        g_assert_false(q.pop(v));
+}
+
+static void
+test_spscqueue_wrap(void)
+{
+        SPSCQueue<unsigned int, 4> q;
+        unsigned int v;
+
+        /* Go around the ring a few times with the queue partially filled */
+        unsigned int next_push = 0, next_pop = 0;
+        for (unsigned int round = 0; round < 100; ++round) {
+                while (q.push(next_push))
+                        ++next_push;
+                for (unsigned int i = 0; i < 3; ++i) {
+                        g_assert_true(q.pop(v));
+                        g_assert_cmpuint(v, ==, next_pop++);
+                }
+                g_assert_cmpuint(q.size(), ==, next_push - next_pop);
+        }
+}
+
+static void
+test_spscqueue_threaded(void)
+{
+        SPSCQueue<unsigned int, 16> q;
+        unsigned int const n = 1000000;
+
+        auto producer = std::thread([&q, n] {
+                        for (unsigned int i = 0; i < n; ) {
+                                if (q.push(i))
+                                        ++i;
+                                else
+                                        std::this_thread::yield();
+                        }
+                });
+
+        unsigned int expected = 0;
+        while (expected < n) {
+                unsigned int v;
+                if (!q.pop(v)) {
+                        std::this_thread::yield();
+                        continue;
+                }
+
+                g_assert_cmpuint(v, ==, expected);
+                ++expected;
+        }
+
+        producer.join();
+        g_assert_true(q.empty());
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/spscqueue/basic", test_spscqueue_basic);
+        g_test_add_func("/vte/spscqueue/wrap", test_spscqueue_wrap);
+        g_test_add_func("/vte/spscqueue/threaded", test_spscqueue_threaded);
+
+        return g_test_run();
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace vte {
+
+namespace base {
+
+/*
+ * SPSCQueue:
+ *
+ * A bounded, lock-free queue with exactly one producer thread
+ * and exactly one consumer thread.
+ *
+ * The head index is only written by the consumer, the tail index
+ * only by the producer; each side reads the other's index with
+ * acquire semantics, so that the slot contents written before a
+ * release store are visible to the other side.
+ *
+ * @T must be cheap to copy; in practice this is used with raw pointers.
+ */
+template<typename T, size_t N>
+class SPSCQueue {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+        SPSCQueue() = default;
+        ~SPSCQueue() = default;
+
+        SPSCQueue(SPSCQueue const&) = delete;
+        SPSCQueue(SPSCQueue&&) = delete;
+        SPSCQueue& operator= (SPSCQueue const&) = delete;
+        SPSCQueue& operator= (SPSCQueue&&) = delete;
+
+        inline static constexpr size_t capacity() noexcept { return N; }
+
+        /* Producer side. Returns false if the queue is full. */
+        bool push(T const& value) noexcept
+        {
+                auto const tail = m_tail.load(std::memory_order_relaxed);
+                if (tail - m_head.load(std::memory_order_acquire) == N)
+                        return false;
+
+                m_slots[tail & (N - 1)] = value;
+                m_tail.store(tail + 1, std::memory_order_release);
+                return true;
+        }
+
+        /* Consumer side. Returns false if the queue is empty. */
+        bool pop(T& value) noexcept
+        {
+                auto const head = m_head.load(std::memory_order_relaxed);
+                if (head == m_tail.load(std::memory_order_acquire))
+                        return false;
+
+                value = m_slots[head & (N - 1)];
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+        }
+
+        /* These are only snapshots when called concurrently with the other side. */
+        size_t size() const noexcept
+        {
+                return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        bool empty() const noexcept { return size() == 0; }
+        bool full() const noexcept { return size() == N; }
+
+private:
+        /* Keep the indices on separate cache lines so producer and
+         * consumer don't keep stealing the line from each other.
+         */
+        alignas(64) std::atomic<size_t> m_head{0};
+        alignas(64) std::atomic<size_t> m_tail{0};
+        alignas(64) std::array<T, N> m_slots{};
+};
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,410 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Writes scrollback-like text to a file stream with each of the block
+ * codecs built in, and reads it back, and reports the rate of each and
+ * the compression ratio. Writing includes compressing, encrypting and
+ * writing to the file, on this thread; reading, reading from the file,
+ * decrypting and uncompressing, with the read cache holding only a
+ * single block so that each block is read from the file once.
+ *
+ * With zstd, this compares compressing each block on its own with
+ * compressing it with a dictionary trained on the stream's first blocks;
+ * the last column gives the ratio with the dictionary over that without,
+ * at the same level.
+ *
+ * With --memory, the streams are memory streams, keeping the blocks in
+ * memory instead of the file.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "vtestream.h"
+
+static constexpr size_t const k_chunk_size = 4096;
+
+struct Workload {
+        std::string name;
+        std::string data;
+};
+
+struct Codec {
+        char const* name;
+        VteStreamCodec codec;
+        int level;
+        bool dictionary;
+};
+
+static Codec const codecs[] = {
+        { "zlib", VTE_STREAM_CODEC_ZLIB, 1, false },
+        { "zlib", VTE_STREAM_CODEC_ZLIB, 6, false },
+        { "lz4", VTE_STREAM_CODEC_LZ4, 1, false },
+        { "lz4", VTE_STREAM_CODEC_LZ4, 9, false },
+        { "zstd", VTE_STREAM_CODEC_ZSTD, 1, false },
+        { "zstd", VTE_STREAM_CODEC_ZSTD, 3, false },
+        { "zstd", VTE_STREAM_CODEC_ZSTD, 9, false },
+        { "zstd+d", VTE_STREAM_CODEC_ZSTD, 1, true },
+        { "zstd+d", VTE_STREAM_CODEC_ZSTD, 3, true },
+};
+
+static char const* const words[] = {
+        "buffer", "cell", "row", "column", "stream", "parser", "widget",
+        "value", "index", "count", "offset", "length", "cursor", "region",
+};
+
+static char const*
+pick(GRand* rand,
+     char const* const* strs,
+     size_t n_strs)
+{
+        return strs[g_rand_int_range(rand, 0, n_strs)];
+}
+
+#define PICK(rand, strs) pick(rand, strs, G_N_ELEMENTS(strs))
+
+/* Like the output of make and a C++ compiler */
+static std::string
+make_compiler_log(GRand* rand,
+                  size_t size)
+{
+        static char const* const dirs[] = { "src", "src/vte", "src/app", "bindings/vala", "perf" };
+        static char const* const files[] = { "vte.cc", "vteseq.cc", "ring.cc", "vtestream.cc",
+                                             "parser.cc", "app.cc", "pty.cc", "vtegtk.cc" };
+        static char const* const warnings[] = { "unused variable", "comparison of integer expressions of different signedness",
+                                                "unused parameter", "implicit conversion loses integer precision" };
+        static char const* const flags[] = { "-Wunused-variable", "-Wsign-compare",
+                                             "-Wunused-parameter", "-Wshorten-64-to-32" };
+
+        std::string log;
+        char buf[512];
+        while (log.size() < size) {
+                auto const dir = PICK(rand, dirs);
+                auto const file = PICK(rand, files);
+                switch (g_rand_int_range(rand, 0, 4)) {
+                case 0:
+                        g_snprintf(buf, sizeof(buf), "make[%d]: Entering directory '/home/user/vte/%s'\n",
+                                   g_rand_int_range(rand, 1, 4), dir);
+                        break;
+                case 1: {
+                        auto const w = g_rand_int_range(rand, 0, G_N_ELEMENTS(warnings));
+                        auto const word = PICK(rand, words);
+                        g_snprintf(buf, sizeof(buf),
+                                   "%s/%s:%d:%d: warning: %s '%s' [%s]\n"
+                                   "  %4d |         auto %s = m_%s.size();\n"
+                                   "       |              ^~~~~~\n",
+                                   dir, file, g_rand_int_range(rand, 1, 5000), g_rand_int_range(rand, 1, 80),
+                                   warnings[w], word, flags[w],
+                                   g_rand_int_range(rand, 1, 5000), word, PICK(rand, words));
+                        break;
+                }
+                default:
+                        g_snprintf(buf, sizeof(buf), "  CXX      %s/libvte_2_91_la-%.*s.lo\n",
+                                   dir, int(strlen(file) - 3), file);
+                        break;
+                }
+                log.append(buf);
+        }
+
+        return log;
+}
+
+/* Like structured logs of a web service */
+static std::string
+make_json_log(GRand* rand,
+              size_t size)
+{
+        static char const* const levels[] = { "info", "info", "info", "debug", "warn", "error" };
+        static char const* const methods[] = { "GET", "GET", "POST", "PUT", "DELETE" };
+        static char const* const messages[] = { "request completed", "cache miss", "upstream timeout",
+                                                "connection reset by peer", "retrying request" };
+
+        std::string log;
+        char buf[512];
+        auto ms = guint64{1714566896000};
+        while (log.size() < size) {
+                ms += g_rand_int_range(rand, 0, 50);
+                g_snprintf(buf, sizeof(buf),
+                           "{\"ts\":%" G_GUINT64_FORMAT ",\"level\":\"%s\",\"msg\":\"%s\","
+                           "\"method\":\"%s\",\"path\":\"/api/v1/%s/%d\",\"status\":%d,"
+                           "\"duration_ms\":%.1f,\"request_id\":\"%08x%08x\"}\n",
+                           ms, PICK(rand, levels), PICK(rand, messages), PICK(rand, methods),
+                           PICK(rand, words), g_rand_int_range(rand, 1, 100000),
+                           g_rand_int_range(rand, 0, 8) ? 200 : 500,
+                           g_rand_double_range(rand, 0.1, 900.),
+                           g_rand_int(rand), g_rand_int(rand));
+                log.append(buf);
+        }
+
+        return log;
+}
+
+/* Like the kernel log */
+static std::string
+make_dmesg(GRand* rand,
+           size_t size)
+{
+        std::string log;
+        char buf[512];
+        auto t = 0.;
+        while (log.size() < size) {
+                auto const a = g_rand_int_range(rand, 1, 10);
+                auto const b = g_rand_int_range(rand, 1, 100);
+                t += g_rand_double_range(rand, 0., 2.);
+                switch (g_rand_int_range(rand, 0, 5)) {
+                case 0:
+                        g_snprintf(buf, sizeof(buf), "[%12.6f] usb 1-%d: new high-speed USB device number %d using xhci_hcd\n",
+                                   t, a, b);
+                        break;
+                case 1:
+                        g_snprintf(buf, sizeof(buf), "[%12.6f] EXT4-fs (nvme0n1p%d): mounted filesystem with ordered data mode. Quota mode: none.\n",
+                                   t, a);
+                        break;
+                case 2:
+                        g_snprintf(buf, sizeof(buf), "[%12.6f] audit: type=1400 audit(%d.%03d:%d): apparmor=\"STATUS\" operation=\"profile_load\"\n",
+                                   t, int(t) + 1714566896, b, a);
+                        break;
+                case 3:
+                        g_snprintf(buf, sizeof(buf), "[%12.6f] wlp%ds0: associated, signal -%d dBm\n",
+                                   t, a, b);
+                        break;
+                default:
+                        g_snprintf(buf, sizeof(buf), "[%12.6f] IPv6: ADDRCONF(NETDEV_CHANGE): enp%ds0: link becomes ready\n",
+                                   t, a);
+                        break;
+                }
+                log.append(buf);
+        }
+
+        return log;
+}
+
+/* Like the row stream for the lines of @text: a record of the offsets of
+ * each row's text and attributes, see Ring::RowRecord */
+static std::string
+make_row_records(std::string const& text)
+{
+        struct {
+                size_t text_start_offset;
+                size_t attr_start_offset;
+                int flags;
+        } record{0, 0, 0};
+
+        std::string rows;
+        for (size_t start = 0; start < text.size(); ) {
+                auto end = text.find('\n', start);
+                if (end == std::string::npos)
+                        end = text.size();
+                record.text_start_offset = start;
+                record.flags = (end - start) > 80 ? 2 | 1 : 2; /* is_ascii, soft_wrapped */
+                rows.append(reinterpret_cast<char const*>(&record), sizeof(record));
+                record.attr_start_offset += (end - start) % 3 ? 18 : 0;
+                start = end + 1;
+        }
+
+        return rows;
+}
+
+/* Like the attr stream for coloured output: the offset where each run of
+ * attributes ends, and the attributes, see Ring::CellAttrChange */
+static std::string
+make_attr_changes(GRand* rand,
+                  size_t size)
+{
+        static guint32 const colors[] = { 0x00000001, 0x00000101, 0x00000201, 0x00010001, 0x00030001 };
+
+        struct __attribute__((packed)) {
+                size_t text_end_offset;
+                guint32 attr;
+                guint32 fore, back, deco;
+                guint16 hyperlink_length;
+        } change{0, 1, 0, 0, 0, 0};
+
+        std::string attrs;
+        while (attrs.size() < size) {
+                change.text_end_offset += g_rand_int_range(rand, 1, 40);
+                change.attr = colors[g_rand_int_range(rand, 0, G_N_ELEMENTS(colors))];
+                change.fore = g_rand_int_range(rand, 0, 4) ? 256 : g_rand_int_range(rand, 1, 8);
+                attrs.append(reinterpret_cast<char const*>(&change), sizeof(change));
+        }
+
+        return attrs;
+}
+
+/* Doesn't compress at all, for reference */
+static std::string
+make_random(GRand* rand,
+            size_t size)
+{
+        std::string data;
+        data.reserve(size);
+        while (data.size() < size)
+                data.push_back(char(g_rand_int_range(rand, 0, 256)));
+
+        return data;
+}
+
+struct Result {
+        double write_rate, read_rate, ratio;
+};
+
+static Result
+run(std::string const& data,
+    bool in_memory)
+{
+        auto const stream = in_memory ? _vte_memory_stream_new() : _vte_file_stream_new();
+
+        gsize bytes_before, stored_before;
+        _vte_file_stream_get_write_stats(&bytes_before, &stored_before);
+
+        auto const write_start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < data.size(); offset += k_chunk_size)
+                _vte_stream_append(stream, data.data() + offset,
+                                   std::min(k_chunk_size, data.size() - offset));
+        auto const write_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - write_start).count();
+
+        gsize bytes_after, stored_after;
+        _vte_file_stream_get_write_stats(&bytes_after, &stored_after);
+
+        char buf[k_chunk_size];
+        auto const read_start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < data.size(); offset += k_chunk_size)
+                _vte_stream_read(stream, offset, buf,
+                                 std::min(k_chunk_size, data.size() - offset));
+        auto const read_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - read_start).count();
+
+        g_object_unref(stream);
+
+        return Result{data.size() / write_elapsed / 1e6,
+                      data.size() / read_elapsed / 1e6,
+                      stored_after > stored_before ? double(bytes_after - bytes_before) / (stored_after - stored_before) : 0.};
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        int repeat = 3;
+        int seed = 42;
+        int size = 32;
+        gboolean in_memory = FALSE;
+        char** files = nullptr;
+        GOptionEntry const entries[] = {
+                { "repeat", 'n', 0, G_OPTION_ARG_INT, &repeat,
+                  "Number of runs, of which the best counts", "N" },
+                { "seed", 0, 0, G_OPTION_ARG_INT, &seed,
+                  "Seed for generating the workloads", "SEED" },
+                { "size", 'S', 0, G_OPTION_ARG_INT, &size,
+                  "Size of each generated workload in MiB", "MIB" },
+                { "file", 'f', 0, G_OPTION_ARG_FILENAME_ARRAY, &files,
+                  "Use the contents of FILE as a workload too", "FILE" },
+                { "memory", 'm', 0, G_OPTION_ARG_NONE, &in_memory,
+                  "Use memory streams instead of file streams", nullptr },
+                { nullptr }
+        };
+
+        auto context = g_option_context_new("— scrollback codec benchmark");
+        g_option_context_add_main_entries(context, entries, nullptr);
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        auto const n_bytes = size_t(size) << 20;
+        auto rand = g_rand_new_with_seed(guint32(seed));
+        auto workloads = std::vector<Workload>{};
+        workloads.push_back({"compiler", make_compiler_log(rand, n_bytes)});
+        workloads.push_back({"json", make_json_log(rand, n_bytes)});
+        workloads.push_back({"dmesg", make_dmesg(rand, n_bytes)});
+        workloads.push_back({"compiler-rows", make_row_records(workloads[0].data)});
+        workloads.push_back({"attrs", make_attr_changes(rand, n_bytes)});
+        workloads.push_back({"random", make_random(rand, n_bytes)});
+        g_rand_free(rand);
+
+        for (auto i = 0; files && files[i]; ++i) {
+                char* contents;
+                gsize length;
+                if (!g_file_get_contents(files[i], &contents, &length, &error)) {
+                        g_printerr("%s\n", error->message);
+                        g_error_free(error);
+                        return EXIT_FAILURE;
+                }
+                auto name = g_path_get_basename(files[i]);
+                workloads.push_back({name, std::string(contents, length)});
+                g_free(name);
+                g_free(contents);
+        }
+        g_strfreev(files);
+
+        /* Compress on this thread, and read each block from the file once */
+        _vte_file_stream_set_write_in_background(FALSE);
+        _vte_file_stream_set_cache_size(1, 32 * 1024 * 1024);
+
+        g_print("%-16s %-6s %6s %12s %12s %8s %8s\n",
+                "workload", "codec", "level", "write MB/s", "read MB/s", "ratio", "gain");
+        for (auto const& workload : workloads) {
+                /* The zstd ratios without dictionary, by level */
+                std::vector<std::pair<int, double>> zstd_ratios;
+
+                for (auto const& codec : codecs) {
+                        if (!_vte_file_stream_set_codec(codec.codec, codec.level) ||
+                            (!_vte_file_stream_set_dictionaries(codec.dictionary) && codec.dictionary))
+                                continue;
+
+                        auto best = Result{0., 0., 0.};
+                        for (auto i = 0; i < repeat; ++i) {
+                                auto const result = run(workload.data, in_memory);
+                                best.write_rate = std::max(best.write_rate, result.write_rate);
+                                best.read_rate = std::max(best.read_rate, result.read_rate);
+                                best.ratio = result.ratio;
+                        }
+
+                        auto gain = 0.;
+                        if (codec.codec == VTE_STREAM_CODEC_ZSTD && !codec.dictionary) {
+                                zstd_ratios.emplace_back(codec.level, best.ratio);
+                        } else if (codec.dictionary) {
+                                for (auto const& [level, ratio] : zstd_ratios)
+                                        if (level == codec.level && ratio > 0.)
+                                                gain = best.ratio / ratio;
+                        }
+
+                        if (gain > 0.)
+                                g_print("%-16s %-6s %6d %12.1f %12.1f %8.2f %7.2fx\n",
+                                        workload.name.c_str(), codec.name, codec.level,
+                                        best.write_rate, best.read_rate, best.ratio, gain);
+                        else
+                                g_print("%-16s %-6s %6d %12.1f %12.1f %8.2f\n",
+                                        workload.name.c_str(), codec.name, codec.level,
+                                        best.write_rate, best.read_rate, best.ratio);
+                }
+        }
+
+        return EXIT_SUCCESS;
+}
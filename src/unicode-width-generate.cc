@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generates unicode-width-tables.hh, the tables for unichar_width(),
+ * from GLib's Unicode data. The tables are in git, so that building
+ * doesn't need to run this, nor depend on the build machine's GLib;
+ * run "make update-unicode-width-tables" after updating GLib's Unicode
+ * version.
+ *
+ * The characters are split into blocks of 256; for each ambiguous
+ * width, there's an index with the block to use for each block of
+ * characters, and the blocks are shared between both.
+ */
+
+#include "config.h"
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+static constexpr gunichar const k_n_chars = 0x110000;
+static constexpr unsigned int const k_block_shift = 8;
+static constexpr unsigned int const k_block_size = 1u << k_block_shift;
+static constexpr unsigned int const k_n_char_blocks = k_n_chars >> k_block_shift;
+
+using Block = std::array<uint8_t, k_block_size>;
+
+/* This is how the terminal has always determined the width */
+static int
+unichar_width(gunichar c,
+              int ambiguous_width)
+{
+        if (c < 0x80)
+                return 1;
+        if (g_unichar_iszerowidth(c))
+                return 0;
+        if (g_unichar_iswide(c))
+                return 2;
+        if (ambiguous_width == 1)
+                return 1;
+        if (g_unichar_iswide_cjk(c))
+                return 2;
+        return 1;
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        std::vector<Block> blocks;
+        std::map<Block, unsigned int> block_ids;
+        unsigned int index[2][k_n_char_blocks];
+
+        for (auto ambiguous_width = 1; ambiguous_width <= 2; ++ambiguous_width) {
+                for (auto b = 0u; b < k_n_char_blocks; ++b) {
+                        Block block;
+                        for (auto i = 0u; i < k_block_size; ++i)
+                                block[i] = unichar_width((b << k_block_shift) + i, ambiguous_width);
+
+                        auto const it = block_ids.find(block);
+                        if (it != block_ids.end()) {
+                                index[ambiguous_width - 1][b] = it->second;
+                                continue;
+                        }
+
+                        index[ambiguous_width - 1][b] = blocks.size();
+                        block_ids.emplace(block, blocks.size());
+                        blocks.push_back(block);
+                }
+        }
+
+        /* The index entries are bytes */
+        if (blocks.size() > 256) {
+                g_printerr("Too many distinct blocks: %zu\n", blocks.size());
+                return EXIT_FAILURE;
+        }
+
+        printf("/* Generated by unicode-width-generate from GLib %u.%u.%u's Unicode data; do not edit! */\n"
+               "\n"
+               "#pragma once\n"
+               "\n"
+               "#include <cstdint>\n"
+               "\n"
+               "namespace vte {\n"
+               "\n"
+               "namespace base {\n"
+               "\n"
+               "inline constexpr uint32_t const k_unicode_width_n_chars = 0x%x;\n"
+               "inline constexpr unsigned int const k_unicode_width_block_shift = %u;\n"
+               "inline constexpr unsigned int const k_unicode_width_n_blocks = %zu;\n"
+               "\n",
+               glib_major_version, glib_minor_version, glib_micro_version,
+               k_n_chars, k_block_shift, blocks.size());
+
+        printf("/* For ambiguous width 1 and 2, the block for each %u characters */\n"
+               "alignas(64) inline constexpr uint8_t const k_unicode_width_index[2][%u] = {\n",
+               k_block_size, k_n_char_blocks);
+        for (auto plane = 0; plane < 2; ++plane) {
+                printf("        {");
+                for (auto b = 0u; b < k_n_char_blocks; ++b)
+                        printf("%s%u,", b % 16 ? " " : "\n                ", index[plane][b]);
+                printf("\n        },\n");
+        }
+        printf("};\n\n");
+
+        printf("/* The width of each character in the block */\n"
+               "alignas(64) inline constexpr uint8_t const k_unicode_width_blocks[%zu][%u] = {\n",
+               blocks.size(), k_block_size);
+        for (auto const& block : blocks) {
+                printf("        {");
+                for (auto i = 0u; i < k_block_size; ++i)
+                        printf("%s%u,", i % 32 ? " " : "\n                ", block[i]);
+                printf("\n        },\n");
+        }
+        printf("};\n"
+               "\n"
+               "} // namespace base\n"
+               "\n"
+               "} // namespace vte\n");
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "unicode-width.hh"
+
+#include <vector>
+
+#include <glib.h>
+
+using namespace vte::base;
+
+static int
+glib_unichar_width(gunichar c,
+                   int ambiguous_width)
+{
+        if (c < 0x80)
+                return 1;
+        if (g_unichar_iszerowidth(c))
+                return 0;
+        if (g_unichar_iswide(c))
+                return 2;
+        if (ambiguous_width == 1)
+                return 1;
+        if (g_unichar_iswide_cjk(c))
+                return 2;
+        return 1;
+}
+
+static std::vector<uint32_t> const k_beyond = {
+        0x110000, 0x110001, 0x1fffff, 0x7fffffff, 0x80000000, 0xffffffff,
+};
+
+static void
+test_width(void)
+{
+        for (auto ambiguous_width = 1; ambiguous_width <= 2; ++ambiguous_width) {
+                for (uint32_t c = 0; c < 0x110000; ++c)
+                        g_assert_cmpint(unichar_width(c, ambiguous_width), ==, glib_unichar_width(c, ambiguous_width));
+
+                for (auto c : k_beyond)
+                        g_assert_cmpint(unichar_width(c, ambiguous_width), ==, 1);
+        }
+}
+
+/* Runs of all characters, and of random ones, at various lengths so
+ * that the tail is exercised as well.
+ */
+static void
+test_widths(void)
+{
+        std::vector<uint32_t> chars;
+        for (uint32_t c = 0; c < 0x110000; ++c)
+                chars.push_back(c);
+        chars.insert(chars.end(), k_beyond.begin(), k_beyond.end());
+
+        for (auto i = 0; i < 4096; ++i) {
+                auto const r = g_test_rand_int_range(0, 4);
+                chars.push_back(r == 0 ? g_test_rand_int() : g_test_rand_int_range(0, r == 1 ? 0x3000 : 0x110000));
+        }
+
+        std::vector<uint8_t> widths(chars.size() + 1);
+        for (auto ambiguous_width = 1; ambiguous_width <= 2; ++ambiguous_width) {
+                unichar_widths(chars.data(), chars.size(), ambiguous_width, widths.data());
+                for (size_t i = 0; i < chars.size(); ++i)
+                        g_assert_cmpint(widths[i], ==, unichar_width(chars[i], ambiguous_width));
+
+                for (auto offset = 0u; offset < 8; ++offset) {
+                        for (auto len = 0u; len <= 24; ++len) {
+                                widths[len] = 0xff;
+                                unichar_widths(chars.data() + 0x3000 + offset, len, ambiguous_width, widths.data());
+                                for (auto i = 0u; i < len; ++i)
+                                        g_assert_cmpint(widths[i], ==, unichar_width(chars[0x3000 + offset + i], ambiguous_width));
+                                g_assert_cmpint(widths[len], ==, 0xff);
+                        }
+                }
+        }
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/unicode/width", test_width);
+        g_test_add_func("/vte/unicode/widths", test_widths);
+
+        return g_test_run();
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "unicode-width.hh"
+
+/* The AVX2 path is built whenever the compiler can, and used when the
+ * CPU has it, since distributions build for the baseline x86-64.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define VTE_UNICODE_WIDTH_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace vte {
+
+namespace base {
+
+static_assert(k_unicode_width_block_shift == 8, "unichar_widths() needs updating");
+
+#ifdef VTE_UNICODE_WIDTH_AVX2
+
+/* Loads the bytes at @offsets from @base. Gathers load 32 bits, so load
+ * the aligned ones containing the bytes, so as not to read past the end
+ * of the tables, whose sizes are multiples of 4.
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+gather_bytes(uint8_t const* base,
+             __m256i offsets) noexcept
+{
+        auto const three = _mm256_set1_epi32(3);
+        auto const words = _mm256_i32gather_epi32((int const*)base,
+                                                  _mm256_andnot_si256(three, offsets),
+                                                  1);
+        auto const shifts = _mm256_slli_epi32(_mm256_and_si256(offsets, three), 3);
+        return _mm256_and_si256(_mm256_srlv_epi32(words, shifts),
+                                _mm256_set1_epi32(0xff));
+}
+
+/* Both table lookups, for 8 characters at a time.
+ * Returns: the number of characters done
+ */
+__attribute__((target("avx2")))
+static size_t
+unichar_widths_avx2(uint32_t const* chars,
+                    size_t n_chars,
+                    int ambiguous_width,
+                    uint8_t* widths) noexcept
+{
+        auto const index = k_unicode_width_index[ambiguous_width - 1];
+        auto const blocks = &k_unicode_width_blocks[0][0];
+        auto const last = _mm256_set1_epi32(k_unicode_width_n_chars - 1);
+        auto const low_byte = _mm256_set1_epi32(0xff);
+        size_t i = 0;
+        for ( ; i + 8 <= n_chars; i += 8) {
+                auto c = _mm256_loadu_si256((__m256i const*)(chars + i));
+
+                /* Beyond the tables, the width is 1, same as for U+0000 */
+                c = _mm256_and_si256(c, _mm256_cmpeq_epi32(_mm256_min_epu32(c, last), c));
+
+                auto const block = gather_bytes(index, _mm256_srli_epi32(c, 8));
+                auto const w = gather_bytes(blocks,
+                                            _mm256_or_si256(_mm256_slli_epi32(block, 8),
+                                                            _mm256_and_si256(c, low_byte)));
+
+                auto const w16 = _mm_packus_epi32(_mm256_castsi256_si128(w),
+                                                  _mm256_extracti128_si256(w, 1));
+                _mm_storel_epi64((__m128i*)(widths + i), _mm_packus_epi16(w16, w16));
+        }
+
+        return i;
+}
+
+static bool
+have_avx2() noexcept
+{
+        static bool const have = __builtin_cpu_supports("avx2");
+        return have;
+}
+
+#endif /* VTE_UNICODE_WIDTH_AVX2 */
+
+void
+unichar_widths(uint32_t const* chars,
+               size_t n_chars,
+               int ambiguous_width,
+               uint8_t* widths) noexcept
+{
+        size_t i = 0;
+
+#ifdef VTE_UNICODE_WIDTH_AVX2
+        if (have_avx2())
+                i = unichar_widths_avx2(chars, n_chars, ambiguous_width, widths);
+#endif
+
+        for ( ; i < n_chars; ++i)
+                widths[i] = unichar_width(chars[i], ambiguous_width);
+}
+
+} // namespace base
+
+} // namespace vte
@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "unicode-width-tables.hh"
+
+namespace vte {
+
+namespace base {
+
+/* Returns the number of columns @c takes up: 0 for combining characters,
+ * 2 for wide ones, and @ambiguous_width (1 or 2) for those of ambiguous
+ * East Asian width. Same as GLib's g_unichar_iszerowidth(),
+ * g_unichar_iswide() and g_unichar_iswide_cjk() tell, but by looking it
+ * up in tables generated from them at build time.
+ */
+inline constexpr int
+unichar_width(uint32_t c,
+              int ambiguous_width) noexcept
+{
+        if (c >= k_unicode_width_n_chars)
+                return 1;
+
+        auto const block = k_unicode_width_index[ambiguous_width - 1][c >> k_unicode_width_block_shift];
+        return k_unicode_width_blocks[block][c & ((1u << k_unicode_width_block_shift) - 1)];
+}
+
+/* Stores unichar_width() of each of the @n_chars @chars into @widths */
+void unichar_widths(uint32_t const* chars,
+                    size_t n_chars,
+                    int ambiguous_width,
+                    uint8_t* widths) noexcept;
+
+} // namespace base
+
+} // namespace vte
@@ -51,6 +51,7 @@ public:
         UTF8Decoder& operator= (UTF8Decoder&&) = delete;
 
         inline constexpr uint32_t codepoint() const noexcept { return m_codepoint; }
+        inline constexpr bool in_sequence() const noexcept { return m_state != ACCEPT; }
 
         inline uint32_t decode(uint32_t byte) noexcept {
                 uint32_t type = kTable[byte];
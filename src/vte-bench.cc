@@ -0,0 +1,750 @@
+/*
+ * Copyright © 2018 Christian Persch
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Feeds generated workloads through the emulation, from the bytes to
+ * the ring, without a widget (see emulation.hh), and reports for each the
+ * throughput, the allocations, the damage reported and the peak RSS; as
+ * a table, or as JSON to compare builds with.
+ *
+ * The workloads are generated from a fixed seed, so that each run
+ * processes the same bytes. The input is fed in chunks of the size the
+ * terminal reads from the pty.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include "emulation.hh"
+
+/* Allocation counting
+ *
+ * With glibc, malloc() and friends, including the aligned ones, are
+ * wrapped to count the allocations made by the emulation, by GLib as
+ * well as by operator new.
+ */
+
+static std::atomic<uint64_t> s_n_allocations{0};
+static std::atomic<uint64_t> s_allocated_bytes{0};
+
+#ifdef __GLIBC__
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n,
+                    size_t size);
+void* __libc_realloc(void* ptr,
+                     size_t size);
+void* __libc_memalign(size_t alignment,
+                      size_t size);
+void* __libc_valloc(size_t size);
+
+void*
+malloc(size_t size)
+{
+        s_n_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        return __libc_malloc(size);
+}
+
+void*
+calloc(size_t n,
+       size_t size)
+{
+        s_n_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocated_bytes.fetch_add(n * size, std::memory_order_relaxed);
+        return __libc_calloc(n, size);
+}
+
+void*
+realloc(void* ptr,
+        size_t size)
+{
+        s_n_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        return __libc_realloc(ptr, size);
+}
+
+void*
+memalign(size_t alignment,
+         size_t size)
+{
+        s_n_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+}
+
+void*
+aligned_alloc(size_t alignment,
+              size_t size)
+{
+        return memalign(alignment, size);
+}
+
+int
+posix_memalign(void** ptr,
+               size_t alignment,
+               size_t size)
+{
+        if (alignment % sizeof(void*) != 0 ||
+            (alignment & (alignment - 1)) != 0 ||
+            alignment == 0)
+                return EINVAL;
+
+        auto const p = memalign(alignment, size);
+        if (p == nullptr)
+                return ENOMEM;
+
+        *ptr = p;
+        return 0;
+}
+
+void*
+valloc(size_t size)
+{
+        s_n_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        return __libc_valloc(size);
+}
+
+} // extern "C"
+
+static constexpr bool const k_counting_allocations = true;
+
+#else
+
+static constexpr bool const k_counting_allocations = false;
+
+#endif /* __GLIBC__ */
+
+/* Peak RSS
+ *
+ * On Linux, the peak is reset before each workload, so it's that of the
+ * workload; elsewhere, it's that of the process so far.
+ */
+
+static void
+reset_peak_rss()
+{
+        auto f = fopen("/proc/self/clear_refs", "w");
+        if (f == nullptr)
+                return;
+        fputs("5", f);
+        fclose(f);
+}
+
+/* Returns: the peak RSS in KiB */
+static long
+peak_rss()
+{
+        if (auto f = fopen("/proc/self/status", "r")) {
+                char line[256];
+                long kib = -1;
+                while (fgets(line, sizeof(line), f) != nullptr) {
+                        if (sscanf(line, "VmHWM: %ld kB", &kib) == 1)
+                                break;
+                }
+                fclose(f);
+                if (kib >= 0)
+                        return kib;
+        }
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+                return -1;
+        return usage.ru_maxrss;
+}
+
+/* Workloads */
+
+class Generator {
+public:
+        Generator(guint32 seed) :
+                m_rand{g_rand_new_with_seed(seed)}
+        {
+        }
+
+        ~Generator()
+        {
+                g_rand_free(m_rand);
+        }
+
+        Generator(Generator const&) = delete;
+        Generator& operator=(Generator const&) = delete;
+
+        inline int range(int begin,
+                         int end) noexcept
+        {
+                return g_rand_int_range(m_rand, begin, end);
+        }
+
+        template<typename T, size_t N>
+        inline T const& pick(T const (&array)[N]) noexcept
+        {
+                return array[range(0, N)];
+        }
+
+        void append_printf(std::string& str,
+                           char const* format,
+                           ...) G_GNUC_PRINTF(3, 4)
+        {
+                char buf[256];
+                va_list args;
+                va_start(args, format);
+                auto const len = g_vsnprintf(buf, sizeof(buf), format, args);
+                va_end(args);
+                str.append(buf, std::min(size_t(len), sizeof(buf) - 1));
+        }
+
+private:
+        GRand* m_rand;
+};
+
+static char const* const k_words[] = {
+        "make[2]:", "Entering", "directory", "/home/user/src/vte/src", "CXX",
+        "libvte_2_91_la-vte.lo", "warning:", "unused", "variable", "error:",
+        "systemd[1]:", "Started", "Session", "of", "user", "drwxr-xr-x",
+        "4096", "Jan", "12:00:00", "host", "the", "a", "and", "to", "in",
+};
+
+static char const* const k_cjk[] = {
+        "日本語", "のテキスト", "、", "ひらがな", "カタカナ", "漢字", "。",
+        "中文", "文本测试", "，", "繁體中文", "測試", "한국어", "텍스트", " ",
+};
+
+static char const* const k_combining[] = {
+        "\xcc\x81", "\xcc\x80", "\xcc\x82", "\xcc\x88", "\xcc\xa7", "\xcc\xb6",
+        "\xe2\x83\x9d", "\xef\xb8\x8f", "\xe2\x80\x8d",
+};
+
+static void
+generate_random(Generator& gen,
+                std::string& data,
+                size_t size)
+{
+        while (data.size() < size)
+                data.push_back(char(gen.range(0, 256)));
+}
+
+static void
+generate_ascii(Generator& gen,
+               std::string& data,
+               size_t size)
+{
+        while (data.size() < size) {
+                auto const n_words = gen.range(3, 16);
+                for (auto i = 0; i < n_words; ++i) {
+                        data.append(gen.pick(k_words));
+                        data.push_back(' ');
+                }
+                data.append("\r\n");
+        }
+}
+
+static void
+generate_sgr(Generator& gen,
+             std::string& data,
+             size_t size)
+{
+        while (data.size() < size) {
+                auto const n_words = gen.range(3, 12);
+                for (auto i = 0; i < n_words; ++i) {
+                        switch (gen.range(0, 4)) {
+                        case 0:
+                                gen.append_printf(data, "\033[%d;%dm",
+                                                  gen.range(0, 10), gen.range(30, 38));
+                                break;
+                        case 1:
+                                gen.append_printf(data, "\033[38;5;%dm", gen.range(0, 256));
+                                break;
+                        case 2:
+                                gen.append_printf(data, "\033[48;2;%d;%d;%dm",
+                                                  gen.range(0, 256), gen.range(0, 256), gen.range(0, 256));
+                                break;
+                        default:
+                                data.append("\033[0m");
+                                break;
+                        }
+                        data.append(gen.pick(k_words));
+                        data.push_back(' ');
+                }
+                data.append("\033[0m\r\n");
+        }
+}
+
+/* Like perf/sgr-test.sh: a table of each attribute, set and reset
+ * around words in colours
+ */
+static void
+generate_sgr_attributes(Generator& gen,
+                        std::string& data,
+                        size_t size)
+{
+        static char const* const attributes[][2] = {
+                { "1", "22" }, { "2", "22" }, { "3", "23" }, { "4", "24" },
+                { "4:1", "4:0" }, { "21", "24" }, { "4:2", "4:0" }, { "4:3", "4:0" },
+                { "5", "25" }, { "7", "27" }, { "8", "28" }, { "9", "29" },
+                { "53", "55" },
+        };
+
+        while (data.size() < size) {
+                for (auto const& attribute : attributes) {
+                        gen.append_printf(data, "%-24s", attribute[0]);
+                        for (auto column = 0; column < 2; ++column) {
+                                gen.append_printf(data, "  \033[%sm", attribute[0]);
+                                data.append("Efg \033[32mIjk\033[39m \033[45mPqr\033[49m "
+                                            "\033[58:5:9mXyz\033[59m");
+                                gen.append_printf(data, "\033[%sm", attribute[1]);
+                        }
+                        data.append("\r\n");
+                }
+        }
+}
+
+/* Like perf/256test.sh: rows of each colour, in both the colon and the
+ * semicolon form, plain and with dim and bold
+ */
+static void
+generate_256colors(Generator& gen,
+                   std::string& data,
+                   size_t size)
+{
+        static char const* const prefixes[] = { "\033[2m", "", "\033[1m", "\033[1;2m" };
+
+        while (data.size() < size) {
+                for (auto const sep : { ':', ';' }) {
+                        for (auto from = 0; from < 256; from += 16) {
+                                for (auto const prefix : prefixes) {
+                                        data.append(prefix);
+                                        for (auto i = from; i < from + 16; ++i)
+                                                gen.append_printf(data, "\033[38%c5%c%dm\u254F%02d",
+                                                                  sep, sep, i, i % 100);
+                                        data.append("\033[0m\033[K\r\n");
+                                }
+                        }
+                }
+        }
+}
+
+/* Like ls --color: a few different SGR sequences, each starting with
+ * a reset, repeated very often
+ */
+static void
+generate_ls_color(Generator& gen,
+                  std::string& data,
+                  size_t size)
+{
+        static char const* const colors[] = {
+                "0", "01;34", "01;36", "01;32", "40;33;01", "01;35", "00;31", "01;31",
+        };
+
+        while (data.size() < size) {
+                for (auto i = gen.range(1, 6); i > 0; --i) {
+                        gen.append_printf(data, "\033[0m\033[%sm%s\033[0m  ",
+                                          gen.pick(colors), gen.pick(k_words));
+                }
+                data.append("\r\n");
+        }
+}
+
+static void
+generate_scroll_region(Generator& gen,
+                       std::string& data,
+                       size_t size)
+{
+        while (data.size() < size) {
+                auto const top = gen.range(1, 10);
+                auto const bottom = top + gen.range(2, 12);
+                gen.append_printf(data, "\033[%d;%dr\033[%d;1H", top, bottom, bottom);
+                for (auto i = gen.range(5, 30); i > 0; --i) {
+                        switch (gen.range(0, 5)) {
+                        case 0:
+                                data.append("\033M");
+                                break;
+                        case 1:
+                                gen.append_printf(data, "\033[%dL", gen.range(1, 4));
+                                break;
+                        case 2:
+                                gen.append_printf(data, "\033[%dM", gen.range(1, 4));
+                                break;
+                        default:
+                                data.append(gen.pick(k_words));
+                                data.append("\r\n");
+                                break;
+                        }
+                }
+        }
+        data.append("\033[r");
+}
+
+static void
+generate_cjk(Generator& gen,
+             std::string& data,
+             size_t size)
+{
+        while (data.size() < size) {
+                for (auto i = gen.range(4, 20); i > 0; --i)
+                        data.append(gen.pick(k_cjk));
+                data.append("\r\n");
+        }
+}
+
+static void
+generate_combining(Generator& gen,
+                   std::string& data,
+                   size_t size)
+{
+        while (data.size() < size) {
+                for (auto i = gen.range(10, 60); i > 0; --i) {
+                        data.push_back(char(gen.range('a', 'z' + 1)));
+                        for (auto j = gen.range(0, 3); j > 0; --j)
+                                data.append(gen.pick(k_combining));
+                }
+                data.append("\r\n");
+        }
+}
+
+static void
+generate_hyperlinks(Generator& gen,
+                    std::string& data,
+                    size_t size)
+{
+        while (data.size() < size) {
+                for (auto i = gen.range(2, 8); i > 0; --i) {
+                        gen.append_printf(data,
+                                          "\033]8;id=%d;https://example.com/%s/%d\033\\%s\033]8;;\033\\ ",
+                                          gen.range(0, 1000), gen.pick(k_words), gen.range(0, 100000),
+                                          gen.pick(k_words));
+                }
+                data.append("\r\n");
+        }
+}
+
+/* Like a full-screen application: redraws in the alternate screen,
+ * with cursor positioning, colours and erasing.
+ */
+static void
+generate_altscreen(Generator& gen,
+                   std::string& data,
+                   size_t size)
+{
+        data.append("\033[?1049h");
+        while (data.size() < size) {
+                data.append("\033[H\033[2J");
+                for (auto row = 1; row <= 24; ++row) {
+                        gen.append_printf(data, "\033[%d;1H\033[%d;%dm", row,
+                                          gen.range(30, 38), gen.range(40, 48));
+                        for (auto i = gen.range(1, 8); i > 0; --i) {
+                                data.append(gen.pick(k_words));
+                                data.append(" │ ");
+                        }
+                        data.append("\033[0m\033[K");
+                }
+                gen.append_printf(data, "\033[24;1H\033[7m %s \033[0m\033[%d;%dH",
+                                  gen.pick(k_words), gen.range(1, 24), gen.range(1, 80));
+        }
+        data.append("\033[?1049l");
+}
+
+struct Workload {
+        char const* name;
+        void (*generate)(Generator&, std::string&, size_t);
+};
+
+static Workload const k_workloads[] = {
+        { "random", generate_random },
+        { "ascii", generate_ascii },
+        { "sgr", generate_sgr },
+        { "sgr-attributes", generate_sgr_attributes },
+        { "256colors", generate_256colors },
+        { "ls-color", generate_ls_color },
+        { "scroll-region", generate_scroll_region },
+        { "cjk", generate_cjk },
+        { "combining", generate_combining },
+        { "hyperlinks", generate_hyperlinks },
+        { "altscreen", generate_altscreen },
+};
+
+/* Like the widget's, minus the drawing: counts the damage the
+ * emulation reports, so that the benchmark includes reporting it.
+ */
+class DamageCounter : public vte::terminal::Emulation::Sink {
+public:
+        uint64_t n_invalidations{0};
+
+        void invalidate_rows(vte::grid::row_t start,
+                             vte::grid::row_t end) override { ++n_invalidations; }
+        void invalidate_all() override { ++n_invalidations; }
+        void invalidate_cursor_once(bool periodic) override { ++n_invalidations; }
+};
+
+struct Result {
+        char const* name;
+        size_t bytes;
+        double seconds;
+        uint64_t n_allocations;
+        uint64_t allocated_bytes;
+        uint64_t n_invalidations;
+        long peak_rss_kib;
+
+        inline double mb_per_s() const noexcept { return bytes / (1024. * 1024.) / seconds; }
+        inline double ns_per_byte() const noexcept { return seconds * 1e9 / bytes; }
+};
+
+struct Options {
+        long columns{80};
+        long rows{24};
+        long scrollback{512};
+        size_t size{16 * 1024 * 1024};
+        size_t chunk_size{8192};
+        int repeat{3};
+        bool profile{false};
+};
+
+static Result
+run(Workload const& workload,
+    std::string const& data,
+    Options const& options)
+{
+        Result result{workload.name, data.size(), G_MAXDOUBLE, 0, 0, 0, 0};
+
+        reset_peak_rss();
+
+        /* Accumulated over all runs */
+        auto profiler = std::make_unique<vte::terminal::DispatchProfiler>();
+
+        for (auto i = 0; i < options.repeat; ++i) {
+                DamageCounter sink;
+                vte::terminal::Emulation emulation{&sink};
+                emulation.set_size(options.columns, options.rows);
+                emulation.set_scrollback_lines(options.scrollback);
+                /* Otherwise the hyperlinks workload's OSC 8 is parsed, and ignored */
+                emulation.m_allow_hyperlink = TRUE;
+                if (options.profile)
+                        emulation.m_dispatch_profiler = std::move(profiler);
+
+                sink.n_invalidations = 0;
+                auto const n_allocations = s_n_allocations.load();
+                auto const allocated_bytes = s_allocated_bytes.load();
+                auto const start = std::chrono::steady_clock::now();
+
+                /* Like the widget, processing each chunk as it's read */
+                for (size_t offset = 0; offset < data.size(); offset += options.chunk_size) {
+                        emulation.feed(data.data() + offset,
+                                       std::min(options.chunk_size, data.size() - offset));
+                        emulation.process_incoming();
+                }
+
+                auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                result.seconds = std::min(result.seconds, elapsed);
+
+                /* These are the same each run */
+                result.n_allocations = s_n_allocations.load() - n_allocations;
+                result.allocated_bytes = s_allocated_bytes.load() - allocated_bytes;
+                result.n_invalidations = sink.n_invalidations;
+
+                if (options.profile)
+                        profiler = std::move(emulation.m_dispatch_profiler);
+        }
+
+        result.peak_rss_kib = peak_rss();
+
+        if (options.profile)
+                profiler->dump(workload.name);
+
+        return result;
+}
+
+static void
+print_table(std::vector<Result> const& results)
+{
+        g_print("%-14s %10s %10s %12s %12s %12s %10s\n",
+                "workload", "MB/s", "ns/byte", "allocs", "alloc MB", "damage", "peak KiB");
+        for (auto const& r : results) {
+                if (k_counting_allocations)
+                        g_print("%-14s %10.1f %10.2f %12" G_GUINT64_FORMAT " %12.1f %12" G_GUINT64_FORMAT " %10ld\n",
+                                r.name, r.mb_per_s(), r.ns_per_byte(),
+                                r.n_allocations, r.allocated_bytes / (1024. * 1024.),
+                                r.n_invalidations, r.peak_rss_kib);
+                else
+                        g_print("%-14s %10.1f %10.2f %12s %12s %12" G_GUINT64_FORMAT " %10ld\n",
+                                r.name, r.mb_per_s(), r.ns_per_byte(), "-", "-",
+                                r.n_invalidations, r.peak_rss_kib);
+        }
+}
+
+static void
+print_json(std::vector<Result> const& results,
+           Options const& options,
+           guint32 seed)
+{
+        g_print("{\n"
+                "  \"columns\": %ld,\n"
+                "  \"rows\": %ld,\n"
+                "  \"scrollback\": %ld,\n"
+                "  \"chunk_size\": %zu,\n"
+                "  \"repeat\": %d,\n"
+                "  \"seed\": %u,\n"
+                "  \"workloads\": [\n",
+                options.columns, options.rows, options.scrollback,
+                options.chunk_size, options.repeat, seed);
+
+        for (size_t i = 0; i < results.size(); ++i) {
+                auto const& r = results[i];
+                /* JSON has no infinities, so print null when not counted */
+                char allocs[32] = "null", alloc_bytes[32] = "null";
+                if (k_counting_allocations) {
+                        g_snprintf(allocs, sizeof(allocs), "%" G_GUINT64_FORMAT, r.n_allocations);
+                        g_snprintf(alloc_bytes, sizeof(alloc_bytes), "%" G_GUINT64_FORMAT, r.allocated_bytes);
+                }
+
+                g_print("    {\n"
+                        "      \"name\": \"%s\",\n"
+                        "      \"bytes\": %zu,\n"
+                        "      \"seconds\": %.6f,\n"
+                        "      \"mb_per_s\": %.3f,\n"
+                        "      \"ns_per_byte\": %.4f,\n"
+                        "      \"allocations\": %s,\n"
+                        "      \"allocated_bytes\": %s,\n"
+                        "      \"invalidations\": %" G_GUINT64_FORMAT ",\n"
+                        "      \"peak_rss_kib\": %ld\n"
+                        "    }%s\n",
+                        r.name, r.bytes, r.seconds, r.mb_per_s(), r.ns_per_byte(),
+                        allocs, alloc_bytes, r.n_invalidations, r.peak_rss_kib,
+                        i + 1 < results.size() ? "," : "");
+        }
+
+        g_print("  ]\n"
+                "}\n");
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        Options options;
+        int columns = options.columns;
+        int rows = options.rows;
+        int scrollback = options.scrollback;
+        int size_mb = options.size / (1024 * 1024);
+        int chunk_size = options.chunk_size;
+        int seed = 42;
+        gboolean json = false;
+        gboolean list = false;
+        gboolean profile = false;
+        char** names = nullptr;
+        GOptionEntry const entries[] = {
+                { "columns", 'c', 0, G_OPTION_ARG_INT, &columns,
+                  "Number of columns", "COLUMNS" },
+                { "rows", 'r', 0, G_OPTION_ARG_INT, &rows,
+                  "Number of rows", "ROWS" },
+                { "scrollback", 's', 0, G_OPTION_ARG_INT, &scrollback,
+                  "Number of scrollback lines", "LINES" },
+                { "size", 'S', 0, G_OPTION_ARG_INT, &size_mb,
+                  "Size of each workload in MiB", "MIB" },
+                { "chunk-size", 0, 0, G_OPTION_ARG_INT, &chunk_size,
+                  "Number of bytes to feed at a time", "BYTES" },
+                { "repeat", 'n', 0, G_OPTION_ARG_INT, &options.repeat,
+                  "Number of runs, of which the best counts", "N" },
+                { "seed", 0, 0, G_OPTION_ARG_INT, &seed,
+                  "Seed for generating the workloads", "SEED" },
+                { "workload", 'w', 0, G_OPTION_ARG_STRING_ARRAY, &names,
+                  "Workload to run (default: all)", "NAME" },
+                { "list", 'l', 0, G_OPTION_ARG_NONE, &list,
+                  "List the workloads", nullptr },
+                { "json", 'j', 0, G_OPTION_ARG_NONE, &json,
+                  "Print the results as JSON", nullptr },
+                { "profile", 'p', 0, G_OPTION_ARG_NONE, &profile,
+                  "Print the time spent per sequence handler to stderr; this skews the timings", nullptr },
+                { nullptr }
+        };
+
+        auto context = g_option_context_new("— terminal emulation benchmark");
+        g_option_context_add_main_entries(context, entries, nullptr);
+        GError* error = nullptr;
+        if (!g_option_context_parse(context, &argc, &argv, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
+        g_option_context_free(context);
+
+        if (list) {
+                for (auto const& workload : k_workloads)
+                        g_print("%s\n", workload.name);
+                return EXIT_SUCCESS;
+        }
+
+        options.columns = std::max(columns, 1);
+        options.rows = std::max(rows, 1);
+        options.scrollback = scrollback;
+        options.size = size_t(std::max(size_mb, 1)) * 1024 * 1024;
+        options.chunk_size = std::max(chunk_size, 1);
+        options.repeat = std::max(options.repeat, 1);
+        options.profile = profile;
+
+        std::vector<Workload const*> workloads;
+        if (names != nullptr) {
+                for (auto p = names; *p != nullptr; ++p) {
+                        auto const it = std::find_if(std::begin(k_workloads), std::end(k_workloads),
+                                                     [&](Workload const& w) { return g_str_equal(w.name, *p); });
+                        if (it == std::end(k_workloads)) {
+                                g_printerr("Unknown workload \"%s\"\n", *p);
+                                g_strfreev(names);
+                                return EXIT_FAILURE;
+                        }
+                        workloads.push_back(it);
+                }
+                g_strfreev(names);
+        } else {
+                for (auto const& workload : k_workloads)
+                        workloads.push_back(&workload);
+        }
+
+        std::vector<Result> results;
+        for (auto workload : workloads) {
+                /* Each from the same seed, so that it doesn't matter which are run */
+                Generator gen{guint32(seed)};
+                std::string data;
+                data.reserve(options.size + 4096);
+                workload->generate(gen, data, options.size);
+
+                results.push_back(run(*workload, data, options));
+        }
+
+        if (json)
+                print_json(results, options, seed);
+        else
+                print_table(results);
+
+        return EXIT_SUCCESS;
+}
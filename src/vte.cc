@@ -32,6 +32,7 @@
 #endif
 
 #include <glib.h>
+#include <glib-unix.h>
 #include <glib/gi18n-lib.h>
 
 #include <vte/vte.h>
@@ -42,6 +43,7 @@
 #include "reaper.hh"
 #include "ring.hh"
 #include "caps.hh"
+#include "unicode-width.hh"
 #include "widget.hh"
 
 #ifdef HAVE_WCHAR_H
@@ -84,39 +86,8 @@ static inline double round(double x) {
 namespace vte {
 namespace terminal {
 
-static int _vte_unichar_width(gunichar c, int utf8_ambiguous_width);
-static void stop_processing(vte::terminal::Terminal* that);
-static void add_process_timeout(vte::terminal::Terminal* that);
-static void add_update_timeout(vte::terminal::Terminal* that);
-static void remove_update_timeout(vte::terminal::Terminal* that);
-
-static gboolean process_timeout (gpointer data);
-static gboolean update_timeout (gpointer data);
 static cairo_region_t *vte_cairo_get_clip_region (cairo_t *cr);
 
-/* these static variables are guarded by the GDK mutex */
-static guint process_timeout_tag = 0;
-static gboolean in_process_timeout;
-static guint update_timeout_tag = 0;
-static gboolean in_update_timeout;
-static GList *g_active_terminals;
-
-static int
-_vte_unichar_width(gunichar c, int utf8_ambiguous_width)
-{
-        if (G_LIKELY (c < 0x80))
-                return 1;
-        if (G_UNLIKELY (g_unichar_iszerowidth (c)))
-                return 0;
-        if (G_UNLIKELY (g_unichar_iswide (c)))
-                return 2;
-        if (G_LIKELY (utf8_ambiguous_width == 1))
-                return 1;
-        if (G_UNLIKELY (g_unichar_iswide_cjk (c)))
-                return 2;
-        return 1;
-}
-
 static void
 vte_g_array_fill(GArray *array, gconstpointer item, guint final_size)
 {
@@ -129,50 +100,6 @@ vte_g_array_fill(GArray *array, gconstpointer item, guint final_size)
 	} while (--final_size);
 }
 
-// FIXMEchpe replace this with a method on VteRing
-VteRowData*
-Terminal::ring_insert(vte::grid::row_t position,
-                                bool fill)
-{
-	VteRowData *row;
-	VteRing *ring = m_screen->row_data;
-        bool const not_default_bg = (m_fill_defaults.attr.back() != VTE_DEFAULT_BG);
-
-	while (G_UNLIKELY (_vte_ring_next (ring) < position)) {
-		row = _vte_ring_append (ring);
-                if (not_default_bg)
-                        _vte_row_data_fill (row, &m_fill_defaults, m_column_count);
-	}
-	row = _vte_ring_insert (ring, position);
-        if (fill && not_default_bg)
-                _vte_row_data_fill (row, &m_fill_defaults, m_column_count);
-	return row;
-}
-
-// FIXMEchpe replace this with a method on VteRing
-VteRowData*
-Terminal::ring_append(bool fill)
-{
-	return ring_insert(_vte_ring_next(m_screen->row_data), fill);
-}
-
-// FIXMEchpe replace this with a method on VteRing
-void
-Terminal::ring_remove(vte::grid::row_t position)
-{
-	_vte_ring_remove(m_screen->row_data, position);
-}
-
-/* Reset defaults for character insertion. */
-void
-Terminal::reset_default_attributes(bool reset_hyperlink)
-{
-        auto const hyperlink_idx_save = m_defaults.attr.hyperlink_idx;
-        m_defaults = m_color_defaults = m_fill_defaults = basic_cell;
-        if (!reset_hyperlink)
-                m_defaults.attr.hyperlink_idx = hyperlink_idx_save;
-}
-
 //FIXMEchpe this function is bad
 inline vte::view::coord_t
 Terminal::scroll_delta_pixel() const
@@ -237,6 +164,10 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
 	if (G_UNLIKELY (!widget_realized()))
                 return;
 
+        /* Not shown; update_fast_forward() redraws it all once it is again */
+        if (G_UNLIKELY(m_fast_forward))
+                return;
+
         if (m_invalidated_all)
 		return;
 
@@ -248,8 +179,11 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
                           row_start, row_end);
 	_vte_debug_print (VTE_DEBUG_WORK, "?");
 
-        /* Scrolled back, visible parts didn't change. */
-        if (row_start > last_displayed_row())
+        /* Only the displayed part matters; if scrolled back, the
+         * visible parts may not have changed at all. */
+        row_start = std::max(row_start, first_displayed_row());
+        row_end = std::min(row_end, last_displayed_row());
+        if (row_end < row_start)
                 return;
 
         /* Scrollbar is at default position, all the writable rows changed. */
@@ -277,11 +211,11 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
 			"Invalidating pixels at (%d,%d)x(%d,%d).\n",
 			rect.x, rect.y, rect.width, rect.height);
 
-	if (m_active_terminals_link != nullptr) {
+	if (is_processing()) {
                 g_array_append_val(m_update_rects, rect);
 		/* Wait a bit before doing any invalidation, just in
 		 * case updates are coming in really soon. */
-		add_update_timeout(this);
+		schedule_update();
 	} else {
                 auto allocation = get_allocated_rect();
                 rect.x += allocation.x + m_padding.left;
@@ -294,13 +228,6 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
 	_vte_debug_print (VTE_DEBUG_WORK, "!");
 }
 
-/* Convenience method */
-void
-Terminal::invalidate_row(vte::grid::row_t row)
-{
-        invalidate_rows(row, row);
-}
-
 void
 Terminal::invalidate(vte::grid::span const& s)
 {
@@ -341,6 +268,10 @@ Terminal::invalidate_all()
 	if (G_UNLIKELY (!widget_realized()))
                 return;
 
+        /* See invalidate_rows() */
+        if (G_UNLIKELY(m_fast_forward))
+                return;
+
 	if (m_invalidated_all) {
 		return;
 	}
@@ -352,7 +283,7 @@ Terminal::invalidate_all()
 	reset_update_rects();
 	m_invalidated_all = TRUE;
 
-        if (m_active_terminals_link != nullptr) {
+        if (is_processing()) {
                 auto allocation = get_allocated_rect();
                 cairo_rectangle_int_t rect;
                 rect.x = -m_padding.left;
@@ -363,97 +294,12 @@ Terminal::invalidate_all()
                 g_array_append_val(m_update_rects, rect);
 		/* Wait a bit before doing any invalidation, just in
 		 * case updates are coming in really soon. */
-		add_update_timeout(this);
+		schedule_update();
 	} else {
                 gtk_widget_queue_draw(m_widget);
 	}
 }
 
-/* Find the row in the given position in the backscroll buffer.
- * Note that calling this method may invalidate the return value of
- * a previous find_row_data() call. */
-// FIXMEchpe replace this with a method on VteRing
-VteRowData const*
-Terminal::find_row_data(vte::grid::row_t row) const
-{
-	VteRowData const* rowdata = nullptr;
-
-	if (G_LIKELY(_vte_ring_contains(m_screen->row_data, row))) {
-		rowdata = _vte_ring_index(m_screen->row_data, row);
-	}
-	return rowdata;
-}
-
-/* Find the row in the given position in the backscroll buffer. */
-// FIXMEchpe replace this with a method on VteRing
-VteRowData*
-Terminal::find_row_data_writable(vte::grid::row_t row) const
-{
-	VteRowData *rowdata = nullptr;
-
-	if (G_LIKELY (_vte_ring_contains(m_screen->row_data, row))) {
-		rowdata = _vte_ring_index_writable(m_screen->row_data, row);
-	}
-	return rowdata;
-}
-
-/* Find the character an the given position in the backscroll buffer.
- * Note that calling this method may invalidate the return value of
- * a previous find_row_data() call. */
-// FIXMEchpe replace this with a method on VteRing
-VteCell const*
-Terminal::find_charcell(vte::grid::column_t col,
-                                  vte::grid::row_t row) const
-{
-	VteRowData const* rowdata;
-	VteCell const* ret = nullptr;
-
-	if (_vte_ring_contains(m_screen->row_data, row)) {
-		rowdata = _vte_ring_index(m_screen->row_data, row);
-		ret = _vte_row_data_get (rowdata, col);
-	}
-	return ret;
-}
-
-// FIXMEchpe replace this with a method on VteRing
-vte::grid::column_t
-Terminal::find_start_column(vte::grid::column_t col,
-                                      vte::grid::row_t row) const
-{
-	VteRowData const* row_data = find_row_data(row);
-	if (G_UNLIKELY (col < 0))
-		return col;
-	if (row_data != nullptr) {
-		const VteCell *cell = _vte_row_data_get (row_data, col);
-		while (col > 0 && cell != NULL && cell->attr.fragment()) {
-			cell = _vte_row_data_get (row_data, --col);
-		}
-	}
-	return MAX(col, 0);
-}
-
-// FIXMEchpe replace this with a method on VteRing
-vte::grid::column_t
-Terminal::find_end_column(vte::grid::column_t col,
-                                    vte::grid::row_t row) const
-{
-	VteRowData const* row_data = find_row_data(row);
-	gint columns = 0;
-	if (G_UNLIKELY (col < 0))
-		return col;
-	if (row_data != NULL) {
-		const VteCell *cell = _vte_row_data_get (row_data, col);
-		while (col > 0 && cell != NULL && cell->attr.fragment()) {
-			cell = _vte_row_data_get (row_data, --col);
-		}
-		if (cell) {
-			columns = cell->attr.columns() - 1;
-		}
-	}
-        // FIXMEchp m__column_count - 1 ?
-	return MIN(col + columns, m_column_count);
-}
-
 /* Determine the width of the portion of the preedit string which lies
  * to the left of the cursor, or the entire string, in columns. */
 // FIXMEchpe this is for the view, so use int not gssize
@@ -471,7 +317,7 @@ Terminal::get_preedit_width(bool left_only)
 		     (!left_only || (i < m_im_preedit_cursor));
              i++) {
                 gunichar c = g_utf8_get_char(preedit);
-                ret += _vte_unichar_width(c, m_utf8_ambiguous_width);
+                ret += vte::base::unichar_width(c, m_utf8_ambiguous_width);
                 preedit = g_utf8_next_char(preedit);
         }
 
@@ -505,6 +351,10 @@ Terminal::invalidate_cursor_once(bool periodic)
         if (G_UNLIKELY(!widget_realized()))
                 return;
 
+        /* See invalidate_rows() */
+        if (G_UNLIKELY(m_fast_forward))
+                return;
+
 	if (m_invalidated_all) {
 		return;
 	}
@@ -677,6 +527,20 @@ Terminal::emit_decrease_font_size()
 	g_signal_emit(m_terminal, signals[SIGNAL_DECREASE_FONT_SIZE], 0);
 }
 
+/* While fast-forwarding, the accessible isn't kept up to date change
+ * by change; it gets a single "text-modified" once the widget becomes
+ * visible again. Returns whether to hold back the signal.
+ */
+bool
+Terminal::defer_text_signal() noexcept
+{
+        if (!m_fast_forward)
+                return false;
+
+        m_fast_forward_text_changed = true;
+        return true;
+}
+
 /* Emit a "text-inserted" signal. */
 void
 Terminal::emit_text_inserted()
@@ -684,6 +548,8 @@ Terminal::emit_text_inserted()
 	if (!m_accessible_emit) {
 		return;
 	}
+        if (defer_text_signal())
+                return;
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Emitting `text-inserted'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_TEXT_INSERTED], 0);
@@ -696,6 +562,8 @@ Terminal::emit_text_deleted()
 	if (!m_accessible_emit) {
 		return;
 	}
+        if (defer_text_signal())
+                return;
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Emitting `text-deleted'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_TEXT_DELETED], 0);
@@ -708,6 +576,8 @@ Terminal::emit_text_modified()
 	if (!m_accessible_emit) {
 		return;
 	}
+        if (defer_text_signal())
+                return;
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
                          "Emitting `text-modified'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_TEXT_MODIFIED], 0);
@@ -720,6 +590,8 @@ Terminal::emit_text_scrolled(long delta)
 	if (!m_accessible_emit) {
 		return;
 	}
+        if (defer_text_signal())
+                return;
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Emitting `text-scrolled'(%ld).\n", delta);
         // FIXMEchpe fix signal signature?
@@ -740,6 +612,88 @@ Terminal::emit_paste_clipboard()
 	g_signal_emit(m_terminal, signals[SIGNAL_PASTE_CLIPBOARD], 0);
 }
 
+/* Emit a "bell" signal. */
+void
+Terminal::emit_bell()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `bell'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_BELL], 0);
+}
+
+/* Emit a "deiconify-window" signal. */
+void
+Terminal::emit_deiconify_window()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `deiconify-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_DEICONIFY_WINDOW], 0);
+}
+
+/* Emit a "iconify-window" signal. */
+void
+Terminal::emit_iconify_window()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `iconify-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_ICONIFY_WINDOW], 0);
+}
+
+/* Emit a "raise-window" signal. */
+void
+Terminal::emit_raise_window()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `raise-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_RAISE_WINDOW], 0);
+}
+
+/* Emit a "lower-window" signal. */
+void
+Terminal::emit_lower_window()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `lower-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_LOWER_WINDOW], 0);
+}
+
+/* Emit a "maximize-window" signal. */
+void
+Terminal::emit_maximize_window()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `maximize-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_MAXIMIZE_WINDOW], 0);
+}
+
+/* Emit a "refresh-window" signal. */
+void
+Terminal::emit_refresh_window()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `refresh-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_REFRESH_WINDOW], 0);
+}
+
+/* Emit a "restore-window" signal. */
+void
+Terminal::emit_restore_window()
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `restore-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_RESTORE_WINDOW], 0);
+}
+
+/* Emit a "move-window" signal.  (Pixels.) */
+void
+Terminal::emit_move_window(guint x,
+                                     guint y)
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `move-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_MOVE_WINDOW], 0, x, y);
+}
+
+/* Emit a "resize-window" signal.  (Grid size.) */
+void
+Terminal::emit_resize_window(guint columns,
+                                       guint rows)
+{
+        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `resize-window'.\n");
+        g_signal_emit(m_terminal, signals[SIGNAL_RESIZE_WINDOW], 0, columns, rows);
+}
+
 /* Emit a "hyperlink_hover_uri_changed" signal. */
 void
 Terminal::emit_hyperlink_hover_uri_changed(const GdkRectangle *bbox)
@@ -769,6 +723,24 @@ Terminal::deselect_all()
 	}
 }
 
+/* Deselects the current selection if the text under it has changed */
+void
+Terminal::deselect_if_changed()
+{
+        if (m_selection_resolved.empty())
+                return;
+
+        //FIXMEchpe: this is atrocious
+        auto selection = get_selected_text();
+        if ((selection == nullptr) ||
+            (m_selection[VTE_SELECTION_PRIMARY] == nullptr) ||
+            (strcmp(selection->str, m_selection[VTE_SELECTION_PRIMARY]->str) != 0)) {
+                deselect_all();
+        }
+        if (selection)
+                g_string_free(selection, TRUE);
+}
+
 /* Clear the cache of the screen contents we keep. */
 void
 Terminal::match_contents_clear()
@@ -1839,20 +1811,23 @@ void
 Terminal::queue_adjustment_changed()
 {
 	m_adjustment_changed_pending = true;
-	add_update_timeout(this);
+	schedule_update();
 }
 
 void
 Terminal::queue_adjustment_value_changed(double v)
 {
-	if (!_vte_double_equal(v, m_screen->scroll_delta)) {
-                _vte_debug_print(VTE_DEBUG_ADJ,
-                                 "Adjustment value changed to %f\n",
-                                 v);
-		m_screen->scroll_delta = v;
-		m_adjustment_value_changed_pending = true;
-		add_update_timeout(this);
-	}
+        set_scroll_delta(v);
+}
+
+void
+Terminal::scroll_delta_changed()
+{
+        _vte_debug_print(VTE_DEBUG_ADJ,
+                         "Adjustment value changed to %f\n",
+                         m_screen->scroll_delta);
+        m_adjustment_value_changed_pending = true;
+        schedule_update();
 }
 
 void
@@ -1866,40 +1841,6 @@ Terminal::queue_adjustment_value_changed_clamped(double v)
 	queue_adjustment_value_changed(v);
 }
 
-void
-Terminal::adjust_adjustments()
-{
-	g_assert(m_screen != nullptr);
-	g_assert(m_screen->row_data != nullptr);
-
-	queue_adjustment_changed();
-
-	/* The lower value should be the first row in the buffer. */
-	long delta = _vte_ring_delta(m_screen->row_data);
-	/* Snap the insert delta and the cursor position to be in the visible
-	 * area.  Leave the scrolling delta alone because it will be updated
-	 * when the adjustment changes. */
-	m_screen->insert_delta = MAX(m_screen->insert_delta, delta);
-        m_screen->cursor.row = MAX(m_screen->cursor.row,
-                                   m_screen->insert_delta);
-
-	if (m_screen->scroll_delta > m_screen->insert_delta) {
-		queue_adjustment_value_changed(m_screen->insert_delta);
-	}
-}
-
-/* Update the adjustment field of the widget.  This function should be called
- * whenever we add rows to or remove rows from the history or switch screens. */
-void
-Terminal::adjust_adjustments_full()
-{
-	g_assert(m_screen != NULL);
-	g_assert(m_screen->row_data != NULL);
-
-	adjust_adjustments();
-	queue_adjustment_changed();
-}
-
 /* Scroll a fixed number of lines up or down in the current screen. */
 void
 Terminal::scroll_lines(long lines)
@@ -1954,19 +1895,16 @@ Terminal::set_encoding(char const* codeset)
         bool const using_utf8 = g_str_equal(codeset, "UTF-8");
 
         if (using_utf8) {
-                if (m_incoming_conv != ((GIConv)-1))
-                        g_iconv_close(m_incoming_conv);
+                m_incoming_decoder.close();
                 if (m_outgoing_conv != ((GIConv)-1))
                         g_iconv_close(m_outgoing_conv);
-                m_incoming_conv = (GIConv)-1;
                 m_outgoing_conv = (GIConv)-1;
         } else {
                 auto outconv = g_iconv_open(codeset, "UTF-8");
                 if (outconv == ((GIConv)-1))
                         return false;
 
-                auto inconv = g_iconv_open("UTF-8", codeset);
-                if (inconv == ((GIConv)-1)) {
+                if (!m_incoming_decoder.open(codeset)) {
                         g_iconv_close(outconv);
                         return FALSE;
                 }
@@ -1976,11 +1914,6 @@ Terminal::set_encoding(char const* codeset)
                 }
                 m_outgoing_conv = outconv; /* adopted */
 
-                if (m_incoming_conv != ((GIConv)-1)) {
-                        g_iconv_close(m_incoming_conv);
-                }
-                m_incoming_conv = inconv; /* adopted */
-
                 /* Set the terminal's encoding to the new value. */
                 auto old_codeset = m_encoding ? m_encoding : "UTF-8";
                 m_encoding = g_intern_string(codeset);
@@ -2037,90 +1970,6 @@ Terminal::set_encoding(char const* codeset)
 #endif
 }
 
-bool
-Terminal::set_cjk_ambiguous_width(int width)
-{
-        g_assert(width == 1 || width == 2);
-
-        if (m_utf8_ambiguous_width == width)
-                return false;
-
-        m_utf8_ambiguous_width = width;
-        return true;
-}
-
-// FIXMEchpe replace this with a method on VteRing
-VteRowData *
-Terminal::insert_rows (guint cnt)
-{
-	VteRowData *row;
-	do {
-		row = ring_append(false);
-	} while(--cnt);
-	return row;
-}
-
-/* Make sure we have enough rows and columns to hold data at the current
- * cursor position. */
-VteRowData *
-Terminal::ensure_row()
-{
-	VteRowData *row;
-
-	/* Figure out how many rows we need to add. */
-        //FIXMEchpe use long, not int
-	int delta = m_screen->cursor.row - _vte_ring_next(m_screen->row_data) + 1;
-	if (delta > 0) {
-		row = insert_rows(delta);
-		adjust_adjustments();
-	} else {
-		/* Find the row the cursor is in. */
-		row = _vte_ring_index_writable(m_screen->row_data, m_screen->cursor.row);
-	}
-	g_assert(row != NULL);
-
-	return row;
-}
-
-VteRowData *
-Terminal::ensure_cursor()
-{
-	VteRowData *row = ensure_row();
-        _vte_row_data_fill(row, &basic_cell, m_screen->cursor.col);
-
-	return row;
-}
-
-/* Update the insert delta so that the screen which includes it also
- * includes the end of the buffer. */
-void
-Terminal::update_insert_delta()
-{
-	/* The total number of lines.  Add one to the cursor offset
-	 * because it's zero-based. */
-	auto rows = _vte_ring_next(m_screen->row_data);
-        auto delta = m_screen->cursor.row - rows + 1;
-	if (G_UNLIKELY (delta > 0)) {
-		insert_rows(delta);
-		rows = _vte_ring_next(m_screen->row_data);
-	}
-
-	/* Make sure that the bottom row is visible, and that it's in
-	 * the buffer (even if it's empty).  This usually causes the
-	 * top row to become a history-only row. */
-	delta = m_screen->insert_delta;
-	delta = MIN(delta, rows - m_row_count);
-	delta = MAX(delta,
-                    m_screen->cursor.row - (m_row_count - 1));
-	delta = MAX(delta, _vte_ring_delta(m_screen->row_data));
-
-	/* Adjust the insert delta and scroll if needed. */
-	if (delta != m_screen->insert_delta) {
-		m_screen->insert_delta = delta;
-		adjust_adjustments();
-	}
-}
-
 /* Apply the desired mouse pointer, based on certain member variables. */
 void
 Terminal::apply_mouse_cursor()
@@ -2160,6 +2009,15 @@ Terminal::apply_mouse_cursor()
 	}
 }
 
+void
+Terminal::mouse_protocol_changed()
+{
+        m_mouse_smooth_scroll_delta = 0.0;
+
+        /* Mouse pointer might change */
+        apply_mouse_cursor();
+}
+
 /* Show or hide the pointer if autohiding is enabled. */
 void
 Terminal::set_pointer_autohidden(bool autohidden)
@@ -2176,84 +2034,6 @@ Terminal::set_pointer_autohidden(bool autohidden)
         }
 }
 
-/*
- * Get the actually used color from the palette.
- * The return value can be NULL only if entry is one of VTE_CURSOR_BG,
- * VTE_CURSOR_FG, VTE_HIGHLIGHT_BG or VTE_HIGHLIGHT_FG.
- */
-vte::color::rgb const*
-Terminal::get_color(int entry) const
-{
-	VtePaletteColor const* palette_color = &m_palette[entry];
-	guint source;
-	for (source = 0; source < G_N_ELEMENTS(palette_color->sources); source++)
-		if (palette_color->sources[source].is_set)
-			return &palette_color->sources[source].color;
-	return nullptr;
-}
-
-/* Set up a palette entry with a more-or-less match for the requested color. */
-void
-Terminal::set_color(int entry,
-                              int source,
-                              vte::color::rgb const& proposed)
-{
-        g_assert(entry >= 0 && entry < VTE_PALETTE_SIZE);
-
-	VtePaletteColor *palette_color = &m_palette[entry];
-
-        _vte_debug_print(VTE_DEBUG_MISC,
-                         "Set %s color[%d] to (%04x,%04x,%04x).\n",
-                         source == VTE_COLOR_SOURCE_ESCAPE ? "escape" : "API",
-                         entry, proposed.red, proposed.green, proposed.blue);
-
-        if (palette_color->sources[source].is_set &&
-            palette_color->sources[source].color == proposed) {
-                return;
-        }
-        palette_color->sources[source].is_set = TRUE;
-        palette_color->sources[source].color = proposed;
-
-	/* If we're not realized yet, there's nothing else to do. */
-	if (!widget_realized())
-		return;
-
-	/* and redraw */
-	if (entry == VTE_CURSOR_BG || entry == VTE_CURSOR_FG)
-		invalidate_cursor_once();
-	else
-		invalidate_all();
-}
-
-void
-Terminal::reset_color(int entry,
-                                int source)
-{
-        g_assert(entry >= 0 && entry < VTE_PALETTE_SIZE);
-
-	VtePaletteColor *palette_color = &m_palette[entry];
-
-        _vte_debug_print(VTE_DEBUG_MISC,
-                         "Reset %s color[%d].\n",
-                         source == VTE_COLOR_SOURCE_ESCAPE ? "escape" : "API",
-                         entry);
-
-        if (!palette_color->sources[source].is_set) {
-                return;
-        }
-        palette_color->sources[source].is_set = FALSE;
-
-	/* If we're not realized yet, there's nothing else to do. */
-	if (!widget_realized())
-		return;
-
-	/* and redraw */
-	if (entry == VTE_CURSOR_BG || entry == VTE_CURSOR_FG)
-		invalidate_cursor_once();
-	else
-		invalidate_all();
-}
-
 bool
 Terminal::set_background_alpha(double alpha)
 {
@@ -2271,127 +2051,6 @@ Terminal::set_background_alpha(double alpha)
         return true;
 }
 
-void
-Terminal::set_colors_default()
-{
-        set_colors(nullptr, nullptr, nullptr, 0);
-}
-
-/*
- * Terminal::set_colors:
- * @terminal: a #VteTerminal
- * @foreground: (allow-none): the new foreground color, or %NULL
- * @background: (allow-none): the new background color, or %NULL
- * @palette: (array length=palette_size zero-terminated=0): the color palette
- * @palette_size: the number of entries in @palette
- *
- * @palette specifies the new values for the 256 palette colors: 8 standard colors,
- * their 8 bright counterparts, 6x6x6 color cube, and 24 grayscale colors.
- * Omitted entries will default to a hardcoded value.
- *
- * @palette_size must be 0, 8, 16, 232 or 256.
- *
- * If @foreground is %NULL and @palette_size is greater than 0, the new foreground
- * color is taken from @palette[7].  If @background is %NULL and @palette_size is
- * greater than 0, the new background color is taken from @palette[0].
- */
-void
-Terminal::set_colors(vte::color::rgb const* foreground,
-                               vte::color::rgb const* background,
-                               vte::color::rgb const* new_palette,
-                               gsize palette_size)
-{
-	_vte_debug_print(VTE_DEBUG_MISC,
-			"Set color palette [%" G_GSIZE_FORMAT " elements].\n",
-			palette_size);
-
-	/* Accept NULL as the default foreground and background colors if we
-	 * got a palette. */
-	if ((foreground == NULL) && (palette_size >= 8)) {
-		foreground = &new_palette[7];
-	}
-	if ((background == NULL) && (palette_size >= 8)) {
-		background = &new_palette[0];
-	}
-
-	/* Initialize each item in the palette if we got any entries to work
-	 * with. */
-	for (gsize i = 0; i < G_N_ELEMENTS(m_palette); i++) {
-                vte::color::rgb color;
-		bool unset = false;
-
-		if (i < 16) {
-			color.blue = (i & 4) ? 0xc000 : 0;
-			color.green = (i & 2) ? 0xc000 : 0;
-			color.red = (i & 1) ? 0xc000 : 0;
-			if (i > 7) {
-				color.blue += 0x3fff;
-				color.green += 0x3fff;
-				color.red += 0x3fff;
-			}
-		}
-		else if (i < 232) {
-			int j = i - 16;
-			int r = j / 36, g = (j / 6) % 6, b = j % 6;
-			int red =   (r == 0) ? 0 : r * 40 + 55;
-			int green = (g == 0) ? 0 : g * 40 + 55;
-			int blue =  (b == 0) ? 0 : b * 40 + 55;
-			color.red   = red | red << 8  ;
-			color.green = green | green << 8;
-			color.blue  = blue | blue << 8;
-		} else if (i < 256) {
-			int shade = 8 + (i - 232) * 10;
-			color.red = color.green = color.blue = shade | shade << 8;
-		}
-		else switch (i) {
-			case VTE_DEFAULT_BG:
-				if (background) {
-					color = *background;
-				} else {
-					color.red = 0;
-					color.blue = 0;
-					color.green = 0;
-				}
-				break;
-			case VTE_DEFAULT_FG:
-				if (foreground) {
-					color = *foreground;
-				} else {
-					color.red = 0xc000;
-					color.blue = 0xc000;
-					color.green = 0xc000;
-				}
-				break;
-			case VTE_BOLD_FG:
-                                unset = true;
-                                break;
-			case VTE_HIGHLIGHT_BG:
-				unset = true;
-				break;
-			case VTE_HIGHLIGHT_FG:
-				unset = true;
-				break;
-			case VTE_CURSOR_BG:
-				unset = true;
-				break;
-			case VTE_CURSOR_FG:
-				unset = true;
-				break;
-			}
-
-		/* Override from the supplied palette if there is one. */
-		if (i < palette_size) {
-			color = new_palette[i];
-		}
-
-		/* Set up the color entry. */
-                if (unset)
-                        reset_color(i, VTE_COLOR_SOURCE_API);
-                else
-                        set_color(i, VTE_COLOR_SOURCE_API, color);
-	}
-}
-
 /*
  * Terminal::set_color_bold:
  * @bold: (allow-none): the new bold color or %NULL
@@ -2550,441 +2209,6 @@ Terminal::reset_color_highlight_foreground()
         reset_color(VTE_HIGHLIGHT_FG, VTE_COLOR_SOURCE_API);
 }
 
-/*
- * Terminal::cleanup_fragments:
- * @start: the starting column, inclusive
- * @end: the end column, exclusive
- *
- * Needs to be called before modifying the contents in the cursor's row,
- * between the two given columns.  Cleans up TAB and CJK fragments to the
- * left of @start and to the right of @end.  If a CJK is split in half,
- * the remaining half is replaced by a space.  If a TAB at @start is split,
- * it is replaced by spaces.  If a TAB at @end is split, it is replaced by
- * a shorter TAB.  @start and @end can be equal if characters will be
- * inserted at the location rather than overwritten.
- *
- * The area between @start and @end is not cleaned up, hence the whole row
- * can be left in an inconsistent state.  It is expected that the caller
- * will fill up that range afterwards, resulting in a consistent row again.
- *
- * Invalidates the cells that visually change outside of the range,
- * because the caller can't reasonably be expected to take care of this.
- */
-void
-Terminal::cleanup_fragments(long start,
-                                      long end)
-{
-        VteRowData *row = ensure_row();
-        const VteCell *cell_start;
-        VteCell *cell_end, *cell_col;
-        gboolean cell_start_is_fragment;
-        long col;
-
-        g_assert(end >= start);
-
-        /* Remember whether the cell at start is a fragment.  We'll need to know it when
-         * handling the left hand side, but handling the right hand side first might
-         * overwrite it if start == end (inserting to the middle of a character). */
-        cell_start = _vte_row_data_get (row, start);
-        cell_start_is_fragment = cell_start != NULL && cell_start->attr.fragment();
-
-        /* On the right hand side, try to replace a TAB by a shorter TAB if we can.
-         * This requires that the TAB on the left (which might be the same TAB) is
-         * not yet converted to spaces, so start on the right hand side. */
-        cell_end = _vte_row_data_get_writable (row, end);
-        if (G_UNLIKELY (cell_end != NULL && cell_end->attr.fragment())) {
-                col = end;
-                do {
-                        col--;
-                        g_assert(col >= 0);  /* The first cell can't be a fragment. */
-                        cell_col = _vte_row_data_get_writable (row, col);
-                } while (cell_col->attr.fragment());
-                if (cell_col->c == '\t') {
-                        _vte_debug_print(VTE_DEBUG_MISC,
-                                         "Replacing right part of TAB with a shorter one at %ld (%ld cells) => %ld (%ld cells)\n",
-                                         col, (long) cell_col->attr.columns(), end, (long) cell_col->attr.columns() - (end - col));
-                        cell_end->c = '\t';
-                        cell_end->attr.set_fragment(false);
-                        g_assert(cell_col->attr.columns() > end - col);
-                        cell_end->attr.set_columns(cell_col->attr.columns() - (end - col));
-                } else {
-                        _vte_debug_print(VTE_DEBUG_MISC,
-                                         "Cleaning CJK right half at %ld\n",
-                                         end);
-                        g_assert(end - col == 1 && cell_col->attr.columns() == 2);
-                        cell_end->c = ' ';
-                        cell_end->attr.set_fragment(false);
-                        cell_end->attr.set_columns(1);
-                        invalidate_row(m_screen->cursor.row);
-                }
-        }
-
-        /* Handle the left hand side.  Converting longer TABs to shorter ones probably
-         * wouldn't make that much sense here, so instead convert to spaces. */
-        if (G_UNLIKELY (cell_start_is_fragment)) {
-                gboolean keep_going = TRUE;
-                col = start;
-                do {
-                        col--;
-                        g_assert(col >= 0);  /* The first cell can't be a fragment. */
-                        cell_col = _vte_row_data_get_writable (row, col);
-                        if (!cell_col->attr.fragment()) {
-                                if (cell_col->c == '\t') {
-                                        _vte_debug_print(VTE_DEBUG_MISC,
-                                                         "Replacing left part of TAB with spaces at %ld (%ld => %ld cells)\n",
-                                                         col, (long)cell_col->attr.columns(), start - col);
-                                        /* nothing to do here */
-                                } else {
-                                        _vte_debug_print(VTE_DEBUG_MISC,
-                                                         "Cleaning CJK left half at %ld\n",
-                                                         col);
-                                        g_assert(start - col == 1);
-                                        invalidate_row(m_screen->cursor.row);
-                                }
-                                keep_going = FALSE;
-                        }
-                        cell_col->c = ' ';
-                        cell_col->attr.set_fragment(false);
-                        cell_col->attr.set_columns(1);
-                } while (keep_going);
-        }
-}
-
-/* Cursor down, with scrolling. */
-void
-Terminal::cursor_down(bool explicit_sequence)
-{
-	long start, end;
-
-        if (m_scrolling_restricted) {
-                start = m_screen->insert_delta + m_scrolling_region.start;
-                end = m_screen->insert_delta + m_scrolling_region.end;
-	} else {
-		start = m_screen->insert_delta;
-		end = start + m_row_count - 1;
-	}
-        if (m_screen->cursor.row == end) {
-                if (m_scrolling_restricted) {
-			if (start == m_screen->insert_delta) {
-				/* Scroll this line into the scrollback
-				 * buffer by inserting a line at the next
-				 * line and scrolling the area up. */
-				m_screen->insert_delta++;
-                                m_screen->cursor.row++;
-				/* update start and end, as they are relative
-				 * to insert_delta. */
-				start++;
-				end++;
-                                ring_insert(m_screen->cursor.row, false);
-				/* Force the areas below the region to be
-				 * redrawn -- they've moved. */
-                                invalidate_rows(start, end);
-				/* Force scroll. */
-				adjust_adjustments();
-			} else {
-				/* If we're at the bottom of the scrolling
-				 * region, add a line at the top to scroll the
-				 * bottom off. */
-				ring_remove(start);
-				ring_insert(end, true);
-				/* Update the display. */
-                                invalidate_rows(start, end);
-			}
-		} else {
-			/* Scroll up with history. */
-                        m_screen->cursor.row++;
-			update_insert_delta();
-		}
-
-                /* Handle bce (background color erase), however, diverge from xterm:
-                 * only fill the new row with the background color if scrolling
-                 * happens due to an explicit escape sequence, not due to autowrapping.
-                 * See bug 754596 for details. */
-                bool const not_default_bg = (m_fill_defaults.attr.back() != VTE_DEFAULT_BG);
-
-                if (explicit_sequence && not_default_bg) {
-			VteRowData *rowdata = ensure_row();
-                        _vte_row_data_fill (rowdata, &m_fill_defaults, m_column_count);
-		}
-	} else {
-		/* Otherwise, just move the cursor down. */
-                m_screen->cursor.row++;
-	}
-}
-
-/* Drop the scrollback. */
-void
-Terminal::drop_scrollback()
-{
-        /* Only for normal screen; alternate screen doesn't have a scrollback. */
-        _vte_ring_drop_scrollback (m_normal_screen.row_data,
-                                   m_normal_screen.insert_delta);
-
-        if (m_screen == &m_normal_screen) {
-                queue_adjustment_value_changed(m_normal_screen.insert_delta);
-                adjust_adjustments_full();
-        }
-}
-
-/* Restore cursor on a screen. */
-void
-Terminal::restore_cursor(VteScreen *screen__)
-{
-        screen__->cursor.col = screen__->saved.cursor.col;
-        screen__->cursor.row = screen__->insert_delta + CLAMP(screen__->saved.cursor.row,
-                                                              0, m_row_count - 1);
-
-        m_modes_ecma.set_modes(screen__->saved.modes_ecma);
-
-        m_modes_private.set_DEC_REVERSE_IMAGE(screen__->saved.reverse_mode);
-        m_modes_private.set_DEC_ORIGIN(screen__->saved.origin_mode);
-
-        m_defaults = screen__->saved.defaults;
-        m_color_defaults = screen__->saved.color_defaults;
-        m_fill_defaults = screen__->saved.fill_defaults;
-        m_character_replacements[0] = screen__->saved.character_replacements[0];
-        m_character_replacements[1] = screen__->saved.character_replacements[1];
-        m_character_replacement = screen__->saved.character_replacement;
-}
-
-/* Save cursor on a screen__. */
-void
-Terminal::save_cursor(VteScreen *screen__)
-{
-        screen__->saved.cursor.col = screen__->cursor.col;
-        screen__->saved.cursor.row = screen__->cursor.row - screen__->insert_delta;
-
-        screen__->saved.modes_ecma = m_modes_ecma.get_modes();
-
-        screen__->saved.reverse_mode = m_modes_private.DEC_REVERSE_IMAGE();
-        screen__->saved.origin_mode = m_modes_private.DEC_ORIGIN();
-
-        screen__->saved.defaults = m_defaults;
-        screen__->saved.color_defaults = m_color_defaults;
-        screen__->saved.fill_defaults = m_fill_defaults;
-        screen__->saved.character_replacements[0] = m_character_replacements[0];
-        screen__->saved.character_replacements[1] = m_character_replacements[1];
-        screen__->saved.character_replacement = m_character_replacement;
-}
-
-/* Insert a single character into the stored data array. */
-void
-Terminal::insert_char(gunichar c,
-                                bool insert,
-                                bool invalidate_now)
-{
-	VteCellAttr attr;
-	VteRowData *row;
-	long col;
-	int columns, i;
-	bool line_wrapped = false; /* cursor moved before char inserted */
-        gunichar c_unmapped = c;
-
-        /* DEC Special Character and Line Drawing Set.  VT100 and higher (per XTerm docs). */
-        static const gunichar line_drawing_map[31] = {
-                0x25c6,  /* ` => diamond */
-                0x2592,  /* a => checkerboard */
-                0x2409,  /* b => HT symbol */
-                0x240c,  /* c => FF symbol */
-                0x240d,  /* d => CR symbol */
-                0x240a,  /* e => LF symbol */
-                0x00b0,  /* f => degree */
-                0x00b1,  /* g => plus/minus */
-                0x2424,  /* h => NL symbol */
-                0x240b,  /* i => VT symbol */
-                0x2518,  /* j => downright corner */
-                0x2510,  /* k => upright corner */
-                0x250c,  /* l => upleft corner */
-                0x2514,  /* m => downleft corner */
-                0x253c,  /* n => cross */
-                0x23ba,  /* o => scan line 1/9 */
-                0x23bb,  /* p => scan line 3/9 */
-                0x2500,  /* q => horizontal line (also scan line 5/9) */
-                0x23bc,  /* r => scan line 7/9 */
-                0x23bd,  /* s => scan line 9/9 */
-                0x251c,  /* t => left t */
-                0x2524,  /* u => right t */
-                0x2534,  /* v => bottom t */
-                0x252c,  /* w => top t */
-                0x2502,  /* x => vertical line */
-                0x2264,  /* y => <= */
-                0x2265,  /* z => >= */
-                0x03c0,  /* { => pi */
-                0x2260,  /* | => not equal */
-                0x00a3,  /* } => pound currency sign */
-                0x00b7,  /* ~ => bullet */
-        };
-
-        insert |= m_modes_ecma.IRM();
-	invalidate_now |= insert;
-
-	/* If we've enabled the special drawing set, map the characters to
-	 * Unicode. */
-        if (G_UNLIKELY (*m_character_replacement == VTE_CHARACTER_REPLACEMENT_LINE_DRAWING)) {
-                if (c >= 96 && c <= 126)
-                        c = line_drawing_map[c - 96];
-        } else if (G_UNLIKELY (*m_character_replacement == VTE_CHARACTER_REPLACEMENT_BRITISH)) {
-                if (G_UNLIKELY (c == '#'))
-                        c = 0x00a3;  /* pound sign */
-        }
-
-	/* Figure out how many columns this character should occupy. */
-        columns = _vte_unichar_width(c, m_utf8_ambiguous_width);
-
-	/* If we're autowrapping here, do it. */
-        col = m_screen->cursor.col;
-	if (G_UNLIKELY (columns && col + columns > m_column_count)) {
-		if (m_modes_private.DEC_AUTOWRAP()) {
-			_vte_debug_print(VTE_DEBUG_ADJ,
-					"Autowrapping before character\n");
-			/* Wrap. */
-			/* XXX clear to the end of line */
-                        col = m_screen->cursor.col = 0;
-			/* Mark this line as soft-wrapped. */
-			row = ensure_row();
-			row->attr.soft_wrapped = 1;
-                        cursor_down(false);
-		} else {
-			/* Don't wrap, stay at the rightmost column. */
-                        col = m_screen->cursor.col =
-				m_column_count - columns;
-		}
-		line_wrapped = true;
-	}
-
-	_vte_debug_print(VTE_DEBUG_PARSER,
-			"Inserting U+%04X '%lc' (colors %" G_GUINT64_FORMAT ") (%ld+%d, %ld), delta = %ld; ",
-                         (unsigned int)c, g_unichar_isprint(c) ? c : 0xfffd,
-                         m_color_defaults.attr.colors(),
-                        col, columns, (long)m_screen->cursor.row,
-			(long)m_screen->insert_delta);
-
-        //FIXMEchpe
-        if (G_UNLIKELY(c == 0))
-                goto not_inserted;
-
-	if (G_UNLIKELY (columns == 0)) {
-
-		/* It's a combining mark */
-
-		long row_num;
-		VteCell *cell;
-
-		_vte_debug_print(VTE_DEBUG_PARSER, "combining U+%04X", c);
-
-                row_num = m_screen->cursor.row;
-		row = NULL;
-		if (G_UNLIKELY (col == 0)) {
-			/* We are at first column.  See if the previous line softwrapped.
-			 * If it did, move there.  Otherwise skip inserting. */
-
-			if (G_LIKELY (row_num > 0)) {
-				row_num--;
-				row = find_row_data_writable(row_num);
-
-				if (row) {
-					if (!row->attr.soft_wrapped)
-						row = NULL;
-					else
-						col = _vte_row_data_length (row);
-				}
-			}
-		} else {
-			row = find_row_data_writable(row_num);
-		}
-
-		if (G_UNLIKELY (!row || !col))
-			goto not_inserted;
-
-		/* Combine it on the previous cell */
-
-		col--;
-		cell = _vte_row_data_get_writable (row, col);
-
-		if (G_UNLIKELY (!cell))
-			goto not_inserted;
-
-		/* Find the previous cell */
-		while (cell && cell->attr.fragment() && col > 0)
-			cell = _vte_row_data_get_writable (row, --col);
-		if (G_UNLIKELY (!cell || cell->c == '\t'))
-			goto not_inserted;
-
-		/* Combine the new character on top of the cell string */
-		c = _vte_unistr_append_unichar (cell->c, c);
-
-		/* And set it */
-		columns = cell->attr.columns();
-		for (i = 0; i < columns; i++) {
-			cell = _vte_row_data_get_writable (row, col++);
-			cell->c = c;
-		}
-
-		/* Always invalidate since we put the mark on the *previous* cell
-		 * and the higher level code doesn't know this. */
-                // FIXMEegmont could this be cleaned up now that we invalidate rows?
-                invalidate_row(row_num);
-
-		goto done;
-        } else {
-                m_last_graphic_character = c_unmapped;
-	}
-
-	/* Make sure we have enough rows to hold this data. */
-	row = ensure_cursor();
-	g_assert(row != NULL);
-
-	if (insert) {
-                cleanup_fragments(col, col);
-		for (i = 0; i < columns; i++)
-                        _vte_row_data_insert (row, col + i, &m_color_defaults);
-	} else {
-                cleanup_fragments(col, col + columns);
-		_vte_row_data_fill (row, &basic_cell, col + columns);
-	}
-
-        attr = m_defaults.attr;
-        attr.copy_colors(m_color_defaults.attr);
-	attr.set_columns(columns);
-
-	{
-		VteCell *pcell = _vte_row_data_get_writable (row, col);
-		pcell->c = c;
-		pcell->attr = attr;
-		col++;
-	}
-
-	/* insert wide-char fragments */
-	attr.set_fragment(true);
-	for (i = 1; i < columns; i++) {
-		VteCell *pcell = _vte_row_data_get_writable (row, col);
-		pcell->c = c;
-		pcell->attr = attr;
-		col++;
-	}
-	if (_vte_row_data_length (row) > m_column_count)
-		cleanup_fragments(m_column_count, _vte_row_data_length (row));
-	_vte_row_data_shrink (row, m_column_count);
-
-	/* Signal that this part of the window needs drawing. */
-	if (G_UNLIKELY (invalidate_now)) {
-                invalidate_row(m_screen->cursor.row);
-	}
-
-        m_screen->cursor.col = col;
-
-done:
-	/* We added text, so make a note of it. */
-	m_text_inserted_flag = TRUE;
-
-not_inserted:
-	_vte_debug_print(VTE_DEBUG_ADJ|VTE_DEBUG_PARSER,
-			"insertion delta => %ld.\n",
-			(long)m_screen->insert_delta);
-
-        m_line_wrapped = line_wrapped;
-}
-
 static void
 reaper_child_exited_cb(VteReaper *reaper,
                        int ipid,
@@ -3062,12 +2286,43 @@ io_read_cb(GIOChannel *channel,
         return that->pty_io_read(channel, condition);
 }
 
+/* Collect the data the I/O thread has read from the child. */
+static bool
+pty_reader_cb(void* data)
+{
+        return reinterpret_cast<vte::terminal::Terminal*>(data)->pty_reader_read();
+}
+
 void
 Terminal::connect_pty_read()
 {
 	if (m_pty_channel == NULL)
 		return;
 
+        /* See check_pty_read_throttle() */
+        if (m_input_throttled)
+                return;
+
+        if (m_pty_read_threaded && !m_pty_reader) {
+                auto reader = std::make_unique<vte::base::PtyReader>(g_io_channel_unix_get_fd(m_pty_channel),
+                                                                     pty_reader_cb,
+                                                                     this);
+                if (reader->start()) {
+                        m_pty_reader = std::move(reader);
+                } else {
+                        g_warning("Failed to read from the PTY on the I/O thread; reading on the main thread instead.\n");
+                        m_pty_read_threaded = false;
+                }
+        }
+
+        if (m_pty_reader) {
+                if (!m_pty_reader->is_connected()) {
+                        _vte_debug_print (VTE_DEBUG_IO, "connecting pty_reader_cb\n");
+                        m_pty_reader->connect();
+                }
+                return;
+        }
+
 	if (m_pty_input_source == 0) {
 		_vte_debug_print (VTE_DEBUG_IO, "polling vte_terminal_io_read\n");
 		m_pty_input_source =
@@ -3122,15 +2377,93 @@ Terminal::connect_pty_write()
 	}
 }
 
-void
-Terminal::disconnect_pty_read()
+void
+Terminal::disconnect_pty_read()
+{
+	if (m_pty_input_source != 0) {
+		_vte_debug_print (VTE_DEBUG_IO, "disconnecting poll of vte_terminal_io_read\n");
+		g_source_remove(m_pty_input_source);
+                // FIXMEchpe the destroy notify should already have done this!
+		m_pty_input_source = 0;
+	}
+
+        /* Note that the I/O thread keeps reading; once the reader's
+         * queue is full it stops, which blocks the child.
+         */
+	if (m_pty_reader && m_pty_reader->is_connected()) {
+		_vte_debug_print (VTE_DEBUG_IO, "disconnecting pty_reader_cb\n");
+		m_pty_reader->disconnect();
+	}
+}
+
+/* Stops reading on the I/O thread, and moves all the data read so far
+ * into the incoming queue.
+ */
+void
+Terminal::stop_pty_reader()
+{
+        if (!m_pty_reader)
+                return;
+
+        m_pty_reader->stop();
+        while (auto chunk = m_pty_reader->pop()) {
+                m_input_bytes += chunk->len;
+                m_incoming_bytes += chunk->len;
+                m_incoming_queue.push(std::move(chunk));
+        }
+
+        m_pty_reader.reset();
+}
+
+/* Stops reading from the PTY because the incoming queue has grown
+ * over the input budget, i.e. the child is producing output faster
+ * than we can process it. Once the kernel's buffer is full, the
+ * child blocks on writing.
+ */
+void
+Terminal::throttle_pty_read()
+{
+        if (m_input_throttled)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_IO,
+                         "%" G_GSIZE_FORMAT " bytes queued, over the budget of %u; throttling\n",
+                         m_incoming_bytes, m_input_budget);
+
+        disconnect_pty_read();
+        m_input_throttled = true;
+        m_input_throttle_start = g_get_monotonic_time();
+}
+
+/* Resumes reading from the PTY once the incoming queue has come down
+ * to the low-water mark.
+ */
+void
+Terminal::check_pty_read_throttle()
+{
+        if (!m_input_throttled)
+                return;
+        if (m_input_budget != 0 && m_incoming_bytes > m_input_budget / 2)
+                return;
+
+        m_input_throttled = false;
+        m_input_throttled_time += g_get_monotonic_time() - m_input_throttle_start;
+
+        _vte_debug_print(VTE_DEBUG_IO,
+                         "%" G_GSIZE_FORMAT " bytes queued; resuming reading\n",
+                         m_incoming_bytes);
+
+        connect_pty_read();
+}
+
+gint64
+Terminal::input_throttled_time() const noexcept
 {
-	if (m_pty_input_source != 0) {
-		_vte_debug_print (VTE_DEBUG_IO, "disconnecting poll of vte_terminal_io_read\n");
-		g_source_remove(m_pty_input_source);
-                // FIXMEchpe the destroy notify should already have done this!
-		m_pty_input_source = 0;
-	}
+        auto time = m_input_throttled_time;
+        if (m_input_throttled)
+                time += g_get_monotonic_time() - m_input_throttle_start;
+
+        return time;
 }
 
 void
@@ -3392,105 +2725,6 @@ _vte_conv(GIConv conv,
 	return ret;
 }
 
-void
-Terminal::convert_incoming() noexcept
-{
-        /* This is for legacy applications, so efficiency is not
-         * of any concern. Flatten the chunks into one big buffer,
-         * process that, and put the resulting UTF-8 back into
-         * chunks.
-         */
-        auto buf = _vte_byte_array_new();
-        _vte_byte_array_append(buf, m_incoming_leftover->data, m_incoming_leftover->len);
-        _vte_byte_array_clear(m_incoming_leftover);
-        while (!m_incoming_queue.empty()) {
-                auto chunk = m_incoming_queue.front().get();
-                _vte_byte_array_append(buf, chunk->data, chunk->len);
-                m_incoming_queue.pop();
-        }
-
-        /* Convert the data to UTF-8 */
-        auto inbuf = (char*)buf->data;
-        size_t inbytes = buf->len;
-
-        _VTE_DEBUG_IF(VTE_DEBUG_IO) {
-                _vte_debug_hexdump("Incoming buffer before conversion to UTF-8",
-                                   (uint8_t const*)inbuf, inbytes);
-        }
-
-        auto unibuf = _vte_byte_array_new();
-        _vte_byte_array_set_minimum_size(unibuf, VTE_UTF8_BPC * inbytes);
-        auto outbuf = (char*)unibuf->data;
-        size_t outbytes = unibuf->len;
-
-        bool stop = false;
-        do {
-                auto converted = _vte_conv(m_incoming_conv,
-                                           &inbuf, &inbytes,
-                                           &outbuf, &outbytes);
-                switch (converted) {
-                case ((gsize)-1):
-                        switch (errno) {
-                        case EILSEQ: {
-                                /* Munge the input. */
-                                inbuf++;
-                                inbytes--;
-                                auto l = g_unichar_to_utf8(0xfffdU, (char*)outbuf);
-                                outbuf += l;
-                                outbytes -= l;
-                                break;
-                        }
-                        case EINVAL:
-                                /* Incomplete. Save for later. */
-                                stop = true;
-                                break;
-                        case E2BIG:
-                                /* Should never happen. */
-                                g_assert_not_reached();
-                                break;
-                        default:
-                                /* Should never happen. */
-                                g_assert_not_reached();
-                                break;
-                        }
-                default:
-                        break;
-                }
-        } while ((inbytes > 0) && !stop);
-
-        /* FIXMEchpe this code used to skip NUL bytes,
-         * while the _vte_conv call passes NUL bytes through
-         * specifically. What's goint on!?
-         */
-
-        /* Done. */
-        auto processed = buf->len - inbytes;
-        unibuf->len = unibuf->len - outbytes;
-
-        /* If anything is left unconverted, store it for the next processing round. */
-        if (processed != buf->len) {
-                _vte_byte_array_append(m_incoming_leftover,
-                                       buf->data + processed,
-                                       buf->len - processed);
-        }
-
-        auto outlen = unibuf->len;
-        while (outlen > 0) {
-                outbuf = (char*)unibuf->data;
-                while (outlen > 0) {
-                        m_incoming_queue.push(vte::base::Chunk::get());
-                        auto chunk = m_incoming_queue.back().get();
-                        auto len = std::min(size_t(outlen), chunk->capacity());
-                        memcpy(chunk->data, outbuf, len);
-                        chunk->len = len;
-                        outbuf += len;
-                        outlen -= len;
-                }
-
-                g_assert_cmpuint(outlen, ==, 0);
-        }
-}
-
 #endif /* WITH_ICONV */
 
 void
@@ -3499,245 +2733,26 @@ Terminal::process_incoming()
 	VteVisualPosition saved_cursor;
 	gboolean saved_cursor_visible;
         VteCursorStyle saved_cursor_style;
-        vte::grid::row_t bbox_top, bbox_bottom;
-	gboolean modified, bottom;
-	gboolean invalidated_text;
-	gboolean in_scroll_region;
-
-	_vte_debug_print(VTE_DEBUG_IO,
-                         "Handler processing %" G_GSIZE_FORMAT " bytes over %" G_GSIZE_FORMAT " chunks.\n",
-                         m_input_bytes,
-                         m_incoming_queue.size());
-	_vte_debug_print (VTE_DEBUG_WORK, "(");
 
         auto previous_screen = m_screen;
 
-        bottom = m_screen->insert_delta == (long)m_screen->scroll_delta;
-
-        auto top_row = first_displayed_row();
-        auto bottom_row = last_displayed_row();
-
 	/* Save the current cursor position. */
         saved_cursor = m_screen->cursor;
 	saved_cursor_visible = m_modes_private.DEC_TEXT_CURSOR();
         saved_cursor_style = m_cursor_style;
 
-        in_scroll_region = m_scrolling_restricted
-            && (m_screen->cursor.row >= (m_screen->insert_delta + m_scrolling_region.start))
-            && (m_screen->cursor.row <= (m_screen->insert_delta + m_scrolling_region.end));
-
-	/* We should only be called when there's data to process. */
-	g_assert(!m_incoming_queue.empty());
-
-#ifdef WITH_ICONV
-        /* If we're using a legacy encoding for I/O, we need to
-         * convert the input to UTF-8 now.
-         */
-        if (G_UNLIKELY(!m_using_utf8))
-                convert_incoming();
-#endif
-
-	modified = FALSE;
-	invalidated_text = FALSE;
-
-        bbox_bottom = -G_MAXINT;
-        bbox_top = G_MAXINT;
-
-        vte::parser::Sequence seq{m_parser};
-
-        m_line_wrapped = false;
-
-        size_t bytes_processed = 0;
-
-        while (!m_incoming_queue.empty()) {
-                auto chunk = std::move(m_incoming_queue.front());
-                m_incoming_queue.pop();
-
-                g_assert_nonnull(chunk.get());
-
-                _VTE_DEBUG_IF(VTE_DEBUG_IO) {
-                        _vte_debug_hexdump("Incoming buffer", chunk->data, chunk->len);
-                }
-
-                bytes_processed += chunk->len;
-
-                auto const* ip = chunk->data;
-                auto const* iend = chunk->data + chunk->len;
-
-                for ( ; ip < iend; ++ip) {
-
-                        switch (m_utf8_decoder.decode(*ip)) {
-                        case vte::base::UTF8Decoder::REJECT_REWIND:
-                                /* Rewind the stream.
-                                 * Note that this will never lead to a loop, since in the
-                                 * next round this byte *will* be consumed.
-                                 */
-                                --ip;
-                                [[fallthrough]];
-                        case vte::base::UTF8Decoder::REJECT:
-                                m_utf8_decoder.reset();
-                                /* Fall through to insert the U+FFFD replacement character. */
-                                [[fallthrough]];
-                        case vte::base::UTF8Decoder::ACCEPT: {
-                                auto rv = m_parser.feed(m_utf8_decoder.codepoint());
-                                if (G_UNLIKELY(rv < 0)) {
-                                        uint32_t c = m_utf8_decoder.codepoint();
-                                        char c_buf[7];
-                                        g_snprintf(c_buf, sizeof(c_buf), "%lc", c);
-                                        char const* wp_str = g_unichar_isprint(c) ? c_buf : _vte_debug_sequence_to_string(c_buf, -1);
-                                        _vte_debug_print(VTE_DEBUG_PARSER, "Parser error on U+%04X [%s]!\n",
-                                                         c, wp_str);
-                                        break;
-                                }
-
-#ifdef VTE_DEBUG
-                                if (rv != VTE_SEQ_NONE)
-                                        g_assert((bool)seq);
-#endif
-
-                                _VTE_DEBUG_IF(VTE_DEBUG_PARSER) {
-                                        if (rv != VTE_SEQ_NONE) {
-                                                seq.print();
-                                        }
-                                }
-
-                                // FIXMEchpe this assumes that the only handler inserting
-                                // a character is GRAPHIC, which isn't true (at least ICH, REP, SUB
-                                // also do, and invalidate directly for now)...
-
-                                switch (rv) {
-                                case VTE_SEQ_GRAPHIC: {
-
-                                        bbox_top = std::min(bbox_top,
-                                                            m_screen->cursor.row);
-
-                                        // does insert_char(c, false, false)
-                                        GRAPHIC(seq);
-                                        _vte_debug_print(VTE_DEBUG_PARSER,
-                                                         "Last graphic is now U+%04X %lc\n",
-                                                         m_last_graphic_character,
-                                                         g_unichar_isprint(m_last_graphic_character) ? m_last_graphic_character : 0xfffd);
-
-                                        if (m_line_wrapped) {
-                                                m_line_wrapped = false;
-                                                /* line wrapped, correct bbox */
-                                                if (invalidated_text &&
-                                                    (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
-                                                     m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK)) {
-                                                        /* Clip off any part of the box which isn't already on-screen. */
-                                                        bbox_top = std::max(bbox_top, top_row);
-                                                        bbox_bottom = std::min(bbox_bottom, bottom_row);
-
-                                                        invalidate_rows(bbox_top, bbox_bottom);
-                                                        bbox_bottom = -G_MAXINT;
-                                                        bbox_top = G_MAXINT;
-
-                                                }
-                                                bbox_top = std::min(bbox_top,
-                                                                    m_screen->cursor.row);
-                                        }
-                                        /* Add the cells over which we have moved to the region
-                                         * which we need to refresh for the user. */
-                                        bbox_bottom = std::max(bbox_bottom,
-                                                               m_screen->cursor.row);
-                                        invalidated_text = TRUE;
-
-                                        /* We *don't* emit flush pending signals here. */
-                                        modified = TRUE;
-
-                                        break;
-                                }
-
-                                case VTE_SEQ_NONE:
-                                case VTE_SEQ_IGNORE:
-                                        break;
-
-                                default: {
-                                        switch (seq.command()) {
-#define _VTE_CMD(cmd)   case VTE_CMD_##cmd: cmd(seq); break;
-#define _VTE_NOP(cmd)
-#include "parser-cmd.hh"
-#undef _VTE_CMD
-#undef _VTE_NOP
-                                        default:
-                                                _vte_debug_print(VTE_DEBUG_PARSER,
-                                                                 "Unknown parser command %d\n", seq.command());
-                                                break;
-                                        }
-
-                                        m_last_graphic_character = 0;
-
-                                        modified = TRUE;
-
-                                        // FIXME m_screen may be != previous_screen, check for that!
-
-                                        gboolean new_in_scroll_region = m_scrolling_restricted
-                                                && (m_screen->cursor.row >= (m_screen->insert_delta + m_scrolling_region.start))
-                                                && (m_screen->cursor.row <= (m_screen->insert_delta + m_scrolling_region.end));
-
-                                        /* delta may have changed from sequence. */
-                                        top_row = first_displayed_row();
-                                        bottom_row = last_displayed_row();
-
-                                        /* if we have moved greatly during the sequence handler, or moved
-                                         * into a scroll_region from outside it, restart the bbox.
-                                         */
-                                        if (invalidated_text &&
-                                            ((new_in_scroll_region && !in_scroll_region) ||
-                                             (m_screen->cursor.row > bbox_bottom + VTE_CELL_BBOX_SLACK ||
-                                              m_screen->cursor.row < bbox_top - VTE_CELL_BBOX_SLACK))) {
-                                                /* Clip off any part of the box which isn't already on-screen. */
-                                                bbox_top = std::max(bbox_top, top_row);
-                                                bbox_bottom = std::min(bbox_bottom, bottom_row);
-
-                                                invalidate_rows(bbox_top, bbox_bottom);
-
-                                                invalidated_text = FALSE;
-                                                bbox_bottom = -G_MAXINT;
-                                                bbox_top = G_MAXINT;
-                                        }
-
-                                        in_scroll_region = new_in_scroll_region;
-
-                                        break;
-                                }
-                                }
-                                break;
-                        }
-                        }
-                }
-        }
-
-#ifdef VTE_DEBUG
-		/* Some safety checks: ensure the visible parts of the buffer
-		 * are all in the buffer. */
-		g_assert_cmpint(m_screen->insert_delta, >=, _vte_ring_delta(m_screen->row_data));
+        /* See update_fast_forward() */
+        auto const fast_forward = m_fast_forward;
 
-		/* The cursor shouldn't be above or below the addressable
-		 * part of the display buffer. */
-                g_assert_cmpint(m_screen->cursor.row, >=, m_screen->insert_delta);
-#endif
+        auto const modified = Emulation::process_incoming();
 
-	if (modified) {
-		/* Keep the cursor on-screen if we scroll on output, or if
-		 * we're currently at the bottom of the buffer. */
-		update_insert_delta();
-		if (m_scroll_on_output || bottom) {
-			maybe_scroll_to_bottom();
-		}
-		/* Deselect the current selection if its contents are changed
-		 * by this insertion. */
-                if (!m_selection_resolved.empty()) {
-                        //FIXMEchpe: this is atrocious
-			auto selection = get_selected_text();
-			if ((selection == nullptr) ||
-			    (m_selection[VTE_SELECTION_PRIMARY] == nullptr) ||
-			    (strcmp(selection->str, m_selection[VTE_SELECTION_PRIMARY]->str) != 0)) {
-				deselect_all();
-			}
-                        if (selection)
-                                g_string_free(selection, TRUE);
-		}
+	/* Deselect the current selection if its contents are changed
+	 * by this insertion. */
+	if (modified && !m_selection_resolved.empty()) {
+                if (G_UNLIKELY(fast_forward))
+                        m_fast_forward_check_selection = true;
+                else
+                        deselect_if_changed();
 	}
 
 	if (modified || (m_screen != previous_screen)) {
@@ -3747,40 +2762,47 @@ Terminal::process_incoming()
 
 	emit_pending_signals();
 
-	if (invalidated_text) {
-		/* Clip off any part of the box which isn't already on-screen. */
-                bbox_top = std::max(bbox_top, top_row);
-                bbox_bottom = std::min(bbox_bottom, bottom_row);
-
-                invalidate_rows(bbox_top, bbox_bottom);
-	}
-
-        if ((saved_cursor.col != m_screen->cursor.col) ||
-            (saved_cursor.row != m_screen->cursor.row)) {
-		/* invalidate the old and new cursor positions */
-		if (saved_cursor_visible)
+        if (G_UNLIKELY(fast_forward)) {
+                /* Only the signal; the rest happens when the widget
+                 * becomes visible again.
+                 */
+                if ((saved_cursor.col != m_screen->cursor.col) ||
+                    (saved_cursor.row != m_screen->cursor.row))
+                        queue_cursor_moved();
+        } else {
+                if ((saved_cursor.col != m_screen->cursor.col) ||
+                    (saved_cursor.row != m_screen->cursor.row)) {
+                        /* invalidate the old and new cursor positions */
+                        if (saved_cursor_visible)
+                                invalidate_row(saved_cursor.row);
+                        invalidate_cursor_once();
+                        check_cursor_blink();
+                        /* Signal that the cursor moved. */
+                        queue_cursor_moved();
+                } else if ((saved_cursor_visible != m_modes_private.DEC_TEXT_CURSOR()) ||
+                           (saved_cursor_style != m_cursor_style)) {
                         invalidate_row(saved_cursor.row);
-		invalidate_cursor_once();
-		check_cursor_blink();
-		/* Signal that the cursor moved. */
-		queue_cursor_moved();
-        } else if ((saved_cursor_visible != m_modes_private.DEC_TEXT_CURSOR()) ||
-                   (saved_cursor_style != m_cursor_style)) {
-                invalidate_row(saved_cursor.row);
-		check_cursor_blink();
-	}
-
-	/* Tell the input method where the cursor is. */
-        im_update_cursor();
+                        check_cursor_blink();
+                }
 
-        /* After processing some data, do a hyperlink GC. The multiplier is totally arbitrary, feel free to fine tune. */
-        _vte_ring_hyperlink_maybe_gc(m_screen->row_data, bytes_processed * 8);
+                /* Tell the input method where the cursor is. */
+                im_update_cursor();
+        }
+}
 
-	_vte_debug_print (VTE_DEBUG_WORK, ")");
-	_vte_debug_print (VTE_DEBUG_IO,
-                          "%" G_GSIZE_FORMAT " bytes in %" G_GSIZE_FORMAT " chunks left to process.\n",
-                          m_input_bytes,
-                          m_incoming_queue.size());
+/* Limit the amount read between updates, so as to
+ * 1. maintain fairness between multiple terminals; the scheduler
+ *    hands out shares of the input by weight, see Scheduler::Client;
+ * 2. prevent reading the entire output of a command in one
+ *    pass, i.e. we always try to refresh the terminal ~40Hz.
+ *    See time_process_incoming() where we estimate the
+ *    maximum number of bytes we can read/process in between
+ *    updates.
+ */
+guint
+Terminal::pty_read_budget() const
+{
+        return m_scheduler_client.budget(m_max_input_bytes);
 }
 
 bool
@@ -3802,21 +2824,7 @@ Terminal::pty_io_read(GIOChannel *channel,
 		int rem, len;
 		guint bytes, max_bytes;
 
-		/* Limit the amount read between updates, so as to
-		 * 1. maintain fairness between multiple terminals;
-		 * 2. prevent reading the entire output of a command in one
-		 *    pass, i.e. we always try to refresh the terminal ~40Hz.
-		 *    See time_process_incoming() where we estimate the
-		 *    maximum number of bytes we can read/process in between
-		 *    updates.
-		 */
-		max_bytes = m_active_terminals_link != nullptr ?
-		            g_list_length(g_active_terminals) - 1 : 0;
-		if (max_bytes) {
-			max_bytes = m_max_input_bytes / max_bytes;
-		} else {
-			max_bytes = m_max_input_bytes;
-		}
+		max_bytes = pty_read_budget();
 		bytes = m_input_bytes;
 
                 vte::base::Chunk* chunk = nullptr;
@@ -3885,8 +2893,10 @@ Terminal::pty_io_read(GIOChannel *channel,
 out:
 			chunk->len += len;
 			bytes += len;
+                        m_incoming_bytes += len;
 		} while (bytes < max_bytes &&
-		         chunk->len == chunk->capacity());
+		         chunk->len == chunk->capacity() &&
+                         !input_over_budget());
 
                 /* We may have an empty chunk at the back of the queue, but
                  * that doesn't matter, we'll fill it next time.
@@ -3897,7 +2907,7 @@ out:
 			gdk_threads_enter ();
                         G_GNUC_END_IGNORE_DEPRECATIONS;
 
-			add_process_timeout(this);
+			start_processing();
 
                         G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
 			gdk_threads_leave ();
@@ -3907,6 +2917,11 @@ out:
 		m_input_bytes = bytes;
 		again = bytes < max_bytes;
 
+                if (input_over_budget()) {
+                        throttle_pty_read();
+                        again = FALSE;
+                }
+
 		_vte_debug_print (VTE_DEBUG_IO, "read %d/%d bytes, again? %s, active? %s\n",
 				bytes, max_bytes,
 				again ? "yes" : "no",
@@ -3953,6 +2968,96 @@ out:
 	return again;
 }
 
+/* Like pty_io_read(), but takes the chunks that the I/O thread
+ * has already read from the PTY.
+ */
+bool
+Terminal::pty_reader_read()
+{
+        g_assert(m_pty_reader);
+
+	_vte_debug_print (VTE_DEBUG_WORK, ".");
+
+        auto const max_bytes = pty_read_budget();
+        gsize bytes = m_input_bytes;
+        gsize len = 0;
+        while (bytes < max_bytes && !input_over_budget()) {
+                auto chunk = m_pty_reader->pop();
+                if (!chunk)
+                        break;
+
+                len += chunk->len;
+                bytes += chunk->len;
+                m_incoming_bytes += chunk->len;
+                m_incoming_queue.push(std::move(chunk));
+        }
+        m_pty_reader->refill_free_chunks();
+
+        auto const events = m_pty_reader->take_packet_events();
+        /* See pty_io_read() on why this is only rarely useful */
+        if (events & vte::base::PtyReader::ePacketIoctl)
+                pty_termios_changed();
+        if (events & vte::base::PtyReader::ePacketStop)
+                pty_scroll_lock_changed(true);
+        else if (events & vte::base::PtyReader::ePacketStart)
+                pty_scroll_lock_changed(false);
+
+        if (len != 0 && !is_processing()) {
+                G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+                gdk_threads_enter ();
+                G_GNUC_END_IGNORE_DEPRECATIONS;
+
+                start_processing();
+
+                G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+                gdk_threads_leave ();
+                G_GNUC_END_IGNORE_DEPRECATIONS;
+        }
+        m_pty_input_active = len != 0;
+        m_input_bytes = bytes;
+        bool again = bytes < max_bytes;
+
+        /* The reader keeps reading until its own queue is full */
+        if (input_over_budget()) {
+                throttle_pty_read();
+                again = false;
+        }
+
+        _vte_debug_print (VTE_DEBUG_IO, "took %" G_GSIZE_FORMAT "/%u bytes from reader, again? %s, active? %s\n",
+                          bytes, max_bytes,
+                          again ? "yes" : "no",
+                          m_pty_input_active ? "yes" : "no");
+
+        /* Only signal EOF once all the data has been taken */
+        if (m_pty_reader->eof() && !m_pty_reader->has_data()) {
+                auto const err = m_pty_reader->error();
+                if (err != 0) {
+			/* Translators: %s is replaced with error message returned by strerror(). */
+			g_warning (_("Error reading from child: " "%s."),
+                                   g_strerror (err));
+                }
+
+		/* potential deadlock ... */
+		if (!is_processing()) {
+                        G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+			gdk_threads_enter ();
+                        G_GNUC_END_IGNORE_DEPRECATIONS;
+
+			pty_channel_eof();
+
+                        G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+			gdk_threads_leave ();
+                        G_GNUC_END_IGNORE_DEPRECATIONS;
+		} else {
+			pty_channel_eof();
+		}
+
+		again = FALSE;
+        }
+
+        return again;
+}
+
 /*
  * Terminal::feed:
  * @data: (array length=length) (element-type guint8): a string in the terminal's current encoding
@@ -3967,46 +3072,9 @@ Terminal::feed(char const* data,
                          gssize length_,
                          bool start_processing_)
 {
-        g_assert(length_ == 0 || data != nullptr);
-
-        size_t length;
-	if (length_ == -1)
-		length = strlen(data);
-        else
-                length = size_t(length_);
-
-	if (length == 0)
-                return;
-
-        vte::base::Chunk* chunk = nullptr;
-        if (!m_incoming_queue.empty()) {
-                auto& achunk = m_incoming_queue.back();
-                if (length < achunk->remaining_capacity())
-                        chunk = achunk.get();
-        }
-        if (chunk == nullptr) {
-                m_incoming_queue.push(vte::base::Chunk::get());
-                chunk = m_incoming_queue.back().get();
-        }
-
-        /* Break the incoming data into chunks. */
-        do {
-                auto rem = chunk->remaining_capacity();
-                auto len = std::min(length, rem);
-                memcpy (chunk->data + chunk->len, data, len);
-                chunk->len += len;
-                length -= len;
-                if (length == 0)
-                        break;
-
-                data += len;
-
-                /* Get another chunk for the remaining data */
-                m_incoming_queue.push(vte::base::Chunk::get());
-                chunk = m_incoming_queue.back().get();
-        } while (true);
+        Emulation::feed(data, length_);
 
-        if (start_processing_)
+        if (start_processing_ && !m_incoming_queue.empty())
                 start_processing();
 }
 
@@ -4204,102 +3272,6 @@ Terminal::feed_child_using_modes(char const* data,
 		send_child(data, length, !m_modes_ecma.SRM());
 }
 
-void
-Terminal::send(vte::parser::u8SequenceBuilder const& builder,
-                         bool c1,
-                         vte::parser::u8SequenceBuilder::Introducer introducer,
-                         vte::parser::u8SequenceBuilder::ST st) noexcept
-{
-        std::string str;
-        builder.to_string(str, c1, -1, introducer, st);
-        feed_child(str.data(), str.size());
-}
-
-void
-Terminal::send(vte::parser::Sequence const& seq,
-               vte::parser::u8SequenceBuilder const& builder) noexcept
-{
-        // FIXMEchpe always take c1 & ST from @seq?
-        if (seq.type() == VTE_SEQ_OSC &&
-            builder.type() == VTE_SEQ_OSC) {
-                /* If we reply to a BEL-terminated OSC, reply with BEL-terminated OSC
-                 * as well, see https://bugzilla.gnome.org/show_bug.cgi?id=722446 and
-                 * https://gitlab.gnome.org/GNOME/vte/issues/65 .
-                 */
-                send(builder, false,
-                     vte::parser::u8SequenceBuilder::Introducer::DEFAULT,
-                     seq.terminator() == 0x7 ? vte::parser::u8SequenceBuilder::ST::BEL
-                     : vte::parser::u8SequenceBuilder::ST::DEFAULT);
-        } else {
-                send(builder, false);
-        }
-}
-
-void
-Terminal::send(unsigned int type,
-                         std::initializer_list<int> params) noexcept
-{
-        // FIXMEchpe take c1 & ST from @seq
-        send(vte::parser::ReplyBuilder{type, params}, false);
-}
-
-void
-Terminal::reply(vte::parser::Sequence const& seq,
-                          unsigned int type,
-                          std::initializer_list<int> params) noexcept
-{
-        send(seq, vte::parser::ReplyBuilder{type, params});
-}
-
-#if 0
-void
-Terminal::reply(vte::parser::Sequence const& seq,
-                          unsigned int type,
-                          std::initializer_list<int> params,
-                          std::string const& str) noexcept
-{
-        vte::parser::ReplyBuilder reply_builder{type, params};
-        reply_builder.set_string(str);
-        send(seq, reply_builder);
-}
-#endif
-
-void
-Terminal::reply(vte::parser::Sequence const& seq,
-                          unsigned int type,
-                          std::initializer_list<int> params,
-                          vte::parser::ReplyBuilder const& builder) noexcept
-{
-        std::string str;
-        builder.to_string(str, true, -1,
-                          vte::parser::ReplyBuilder::Introducer::NONE,
-                          vte::parser::ReplyBuilder::ST::NONE);
-
-        vte::parser::ReplyBuilder reply_builder{type, params};
-        reply_builder.set_string(std::move(str));
-        send(seq, reply_builder);
-}
-
-void
-Terminal::reply(vte::parser::Sequence const& seq,
-                          unsigned int type,
-                          std::initializer_list<int> params,
-                          char const* format,
-                          ...) noexcept
-{
-        char buf[128];
-        va_list vargs;
-        va_start(vargs, format);
-        auto len = g_vsnprintf(buf, sizeof(buf), format, vargs);
-        va_end(vargs);
-        g_assert_cmpint(len, <, sizeof(buf));
-
-        vte::parser::ReplyBuilder builder{type, params};
-        builder.set_string(std::string{buf});
-
-        send(seq, builder);
-}
-
 void
 Terminal::im_commit(char const* text)
 {
@@ -5832,6 +4804,15 @@ Terminal::hyperlink_hilite_update()
         emit_hyperlink_hover_uri_changed(m_hyperlink_hover_idx != 0 ? &bbox : NULL);
 }
 
+/* The hovered hyperlink went away with the screen it was on */
+void
+Terminal::hyperlink_hover_cleared()
+{
+        m_hyperlink_hover_idx = 0;
+        m_hyperlink_hover_uri = nullptr;
+        emit_hyperlink_hover_uri_changed(nullptr);  /* FIXME only emit if really changed */
+}
+
 /*
  * Terminal::match_hilite_clear:
  *
@@ -6211,34 +5192,6 @@ Terminal::get_selected_text(GArray *attributes)
                         attributes);
 }
 
-#ifdef VTE_DEBUG
-unsigned int
-Terminal::checksum_area(vte::grid::row_t start_row,
-                                  vte::grid::column_t start_col,
-                                  vte::grid::row_t end_row,
-                                  vte::grid::column_t end_col)
-{
-        unsigned int checksum = 0;
-
-        auto text = get_text(start_row, start_col, end_row, end_col,
-                             true /* block */, false /* wrap */,
-                             nullptr /* not interested in attributes */);
-        if (text == nullptr)
-                return checksum;
-
-        char const* end = (char const*)text->str + text->len;
-        for (char const *p = text->str; p < end; p = g_utf8_next_char(p)) {
-                auto const c = g_utf8_get_char(p);
-                if (c == '\n')
-                        continue;
-                checksum += c;
-        }
-        g_string_free(text, true);
-
-        return checksum & 0xffff;
-}
-#endif /* VTE_DEBUG */
-
 /*
  * Compares the visual attributes of a VteCellAttr for equality, but ignores
  * attributes that tend to change from character to character or are otherwise
@@ -7010,6 +5963,10 @@ Terminal::widget_focus_in(GdkEventFocus *event)
 
 	gtk_widget_grab_focus(m_widget);
 
+        /* Give the input of the focused terminal priority */
+        vte::base::Scheduler::get().set_weight(m_scheduler_client,
+                                               vte::base::Scheduler::Client::k_weight_focused);
+
 	/* Read the keyboard modifiers, though they're probably garbage. */
 	read_modifiers((GdkEvent*)event);
 
@@ -7067,6 +6024,9 @@ Terminal::widget_focus_out(GdkEventFocus *event)
 
 	m_has_focus = false;
 	check_cursor_blink();
+
+        vte::base::Scheduler::get().set_weight(m_scheduler_client,
+                                               vte::base::Scheduler::Client::k_weight_default);
 }
 
 void
@@ -7383,146 +6343,6 @@ Terminal::refresh_size()
         m_tabstops.resize(columns);
 }
 
-/* Resize the given screen (normal or alternate) of the terminal. */
-void
-Terminal::screen_set_size(VteScreen *screen_,
-                                    long old_columns,
-                                    long old_rows,
-                                    bool do_rewrap)
-{
-	VteRing *ring = screen_->row_data;
-	VteVisualPosition cursor_saved_absolute;
-	VteVisualPosition below_viewport;
-	VteVisualPosition below_current_paragraph;
-        VteVisualPosition selection_start, selection_end;
-	VteVisualPosition *markers[7];
-        gboolean was_scrolled_to_top = ((long) ceil(screen_->scroll_delta) == _vte_ring_delta(ring));
-        gboolean was_scrolled_to_bottom = ((long) screen_->scroll_delta == screen_->insert_delta);
-	glong old_top_lines;
-	double new_scroll_delta;
-
-        if (m_selection_block_mode && do_rewrap && old_columns != m_column_count)
-                deselect_all();
-
-	_vte_debug_print(VTE_DEBUG_RESIZE,
-			"Resizing %s screen_\n"
-			"Old  insert_delta=%ld  scroll_delta=%f\n"
-                        "     cursor (absolute)  row=%ld  col=%ld\n"
-			"     cursor_saved (relative to insert_delta)  row=%ld  col=%ld\n",
-			screen_ == &m_normal_screen ? "normal" : "alternate",
-			screen_->insert_delta, screen_->scroll_delta,
-                        screen_->cursor.row, screen_->cursor.col,
-                        screen_->saved.cursor.row, screen_->saved.cursor.col);
-
-        cursor_saved_absolute.row = screen_->saved.cursor.row + screen_->insert_delta;
-        cursor_saved_absolute.col = screen_->saved.cursor.col;
-	below_viewport.row = screen_->scroll_delta + old_rows;
-	below_viewport.col = 0;
-        below_current_paragraph.row = screen_->cursor.row + 1;
-	while (below_current_paragraph.row < _vte_ring_next(ring)
-	    && _vte_ring_index(ring, below_current_paragraph.row - 1)->attr.soft_wrapped) {
-		below_current_paragraph.row++;
-	}
-	below_current_paragraph.col = 0;
-        memset(&markers, 0, sizeof(markers));
-        markers[0] = &cursor_saved_absolute;
-        markers[1] = &below_viewport;
-        markers[2] = &below_current_paragraph;
-        markers[3] = &screen_->cursor;
-        if (!m_selection_resolved.empty()) {
-                selection_start.row = m_selection_resolved.start_row();
-                selection_start.col = m_selection_resolved.start_column();
-                selection_end.row = m_selection_resolved.end_row();
-                selection_end.col = m_selection_resolved.end_column();
-                markers[4] = &selection_start;
-                markers[5] = &selection_end;
-	}
-
-	old_top_lines = below_current_paragraph.row - screen_->insert_delta;
-
-	if (do_rewrap && old_columns != m_column_count)
-		_vte_ring_rewrap(ring, m_column_count, markers);
-
-	if (_vte_ring_length(ring) > m_row_count) {
-		/* The content won't fit without scrollbars. Before figuring out the position, we might need to
-		   drop some lines from the ring if the cursor is not at the bottom, as XTerm does. See bug 708213.
-		   This code is really tricky, see ../doc/rewrap.txt for details! */
-		glong new_top_lines, drop1, drop2, drop3, drop;
-		screen_->insert_delta = _vte_ring_next(ring) - m_row_count;
-		new_top_lines = below_current_paragraph.row - screen_->insert_delta;
-		drop1 = _vte_ring_length(ring) - m_row_count;
-		drop2 = _vte_ring_next(ring) - below_current_paragraph.row;
-		drop3 = old_top_lines - new_top_lines;
-		drop = MIN(MIN(drop1, drop2), drop3);
-		if (drop > 0) {
-			int new_ring_next = screen_->insert_delta + m_row_count - drop;
-			_vte_debug_print(VTE_DEBUG_RESIZE,
-					"Dropping %ld [== MIN(%ld, %ld, %ld)] rows at the bottom\n",
-					drop, drop1, drop2, drop3);
-			_vte_ring_shrink(ring, new_ring_next - _vte_ring_delta(ring));
-		}
-	}
-
-        if (!m_selection_resolved.empty()) {
-                m_selection_resolved.set ({ selection_start.row, selection_start.col },
-                                          { selection_end.row, selection_end.col });
-	}
-
-	/* Figure out new insert and scroll deltas */
-	if (_vte_ring_length(ring) <= m_row_count) {
-		/* Everything fits without scrollbars. Align at top. */
-		screen_->insert_delta = _vte_ring_delta(ring);
-		new_scroll_delta = screen_->insert_delta;
-		_vte_debug_print(VTE_DEBUG_RESIZE,
-				"Everything fits without scrollbars\n");
-	} else {
-		/* Scrollbar required. Can't afford unused lines at bottom. */
-		screen_->insert_delta = _vte_ring_next(ring) - m_row_count;
-		if (was_scrolled_to_bottom) {
-			/* Was scrolled to bottom, keep this way. */
-			new_scroll_delta = screen_->insert_delta;
-			_vte_debug_print(VTE_DEBUG_RESIZE,
-					"Scroll to bottom\n");
-		} else if (was_scrolled_to_top) {
-			/* Was scrolled to top, keep this way. Not sure if this special case is worth it. */
-			new_scroll_delta = _vte_ring_delta(ring);
-			_vte_debug_print(VTE_DEBUG_RESIZE,
-					"Scroll to top\n");
-		} else {
-			/* Try to scroll so that the bottom visible row stays.
-			   More precisely, the character below the bottom left corner stays in that
-			   (invisible) row.
-			   So if the bottom of the screen_ was at a hard line break then that hard
-			   line break will stay there.
-			   TODO: What would be the best behavior if the bottom of the screen_ is a
-			   soft line break, i.e. only a partial line is visible at the bottom? */
-			new_scroll_delta = below_viewport.row - m_row_count;
-			/* Keep the old fractional part. */
-			new_scroll_delta += screen_->scroll_delta - floor(screen_->scroll_delta);
-			_vte_debug_print(VTE_DEBUG_RESIZE,
-					"Scroll so bottom row stays\n");
-		}
-	}
-
-	/* Don't clamp, they'll be clamped when restored. Until then remember off-screen_ values
-	   since they might become on-screen_ again on subsequent resizes. */
-        screen_->saved.cursor.row = cursor_saved_absolute.row - screen_->insert_delta;
-        screen_->saved.cursor.col = cursor_saved_absolute.col;
-
-	_vte_debug_print(VTE_DEBUG_RESIZE,
-			"New  insert_delta=%ld  scroll_delta=%f\n"
-                        "     cursor (absolute)  row=%ld  col=%ld\n"
-			"     cursor_saved (relative to insert_delta)  row=%ld  col=%ld\n\n",
-			screen_->insert_delta, new_scroll_delta,
-                        screen_->cursor.row, screen_->cursor.col,
-                        screen_->saved.cursor.row, screen_->saved.cursor.col);
-
-	if (screen_ == m_screen)
-		queue_adjustment_value_changed(new_scroll_delta);
-	else
-		screen_->scroll_delta = new_scroll_delta;
-}
-
 void
 Terminal::set_size(long columns,
                              long rows)
@@ -7553,27 +6373,11 @@ Terminal::set_size(long columns,
                 m_tabstops.resize(columns);
 	}
 	if (old_rows != m_row_count || old_columns != m_column_count) {
-                m_scrolling_restricted = FALSE;
+                if (m_selection_block_mode && m_rewrap_on_resize && old_columns != m_column_count)
+                        deselect_all();
 
-                _vte_ring_set_visible_rows(m_normal_screen.row_data, m_row_count);
-                _vte_ring_set_visible_rows(m_alternate_screen.row_data, m_row_count);
+                resize_screens(old_columns, old_rows, &m_selection_resolved);
 
-		/* Resize the normal screen and (if rewrapping is enabled) rewrap it even if the alternate screen is visible: bug 415277 */
-		screen_set_size(&m_normal_screen, old_columns, old_rows, m_rewrap_on_resize);
-		/* Resize the alternate screen if it's the current one, but never rewrap it: bug 336238 comment 60 */
-		if (m_screen == &m_alternate_screen)
-			screen_set_size(&m_alternate_screen, old_columns, old_rows, false);
-
-                /* Ensure scrollback buffers cover the screen. */
-                set_scrollback_lines(m_scrollback_lines);
-
-                /* Ensure the cursor is valid */
-                m_screen->cursor.row = CLAMP (m_screen->cursor.row,
-                                              _vte_ring_delta (m_screen->row_data),
-                                              MAX (_vte_ring_delta (m_screen->row_data),
-                                                   _vte_ring_next (m_screen->row_data) - 1));
-
-		adjust_adjustments_full();
 		gtk_widget_queue_resize_no_redraw(m_widget);
 		/* Our visible text changed. */
 		emit_text_modified();
@@ -7587,6 +6391,38 @@ vte_terminal_vadjustment_value_changed_cb(vte::terminal::Terminal* that)
         that->vadjustment_value_changed();
 }
 
+/* After switching screens, the adjustment follows the new screen */
+void
+Terminal::screen_switched()
+{
+        gtk_adjustment_set_value(m_vadjustment,
+                                 m_screen->scroll_delta);
+}
+
+bool
+Terminal::is_mapped() const
+{
+        return gtk_widget_get_mapped(m_widget);
+}
+
+void
+Terminal::get_window_origin(int* x,
+                            int* y)
+{
+        gdk_window_get_origin(gtk_widget_get_window(m_widget), x, y);
+        *x += m_padding.left;
+        *y += m_padding.top;
+}
+
+void
+Terminal::get_screen_size(int* width,
+                          int* height)
+{
+        auto gscreen = gtk_widget_get_screen(m_widget);
+        *width = gdk_screen_get_width(gscreen);
+        *height = gdk_screen_get_height(gscreen);
+}
+
 void
 Terminal::vadjustment_value_changed()
 {
@@ -7657,21 +6493,16 @@ Terminal::widget_set_vadjustment(GtkAdjustment *adjustment)
 
 Terminal::Terminal(vte::platform::Widget* w,
                    VteTerminal *t) :
+        Emulation(this),
         m_real_widget(w),
         m_terminal(t),
-        m_widget(&t->widget),
-        m_row_count(VTE_ROWS),
-        m_column_count(VTE_COLUMNS),
-        m_normal_screen(VTE_SCROLLBACK_INIT, true),
-        m_alternate_screen(VTE_ROWS, false),
-        m_screen(&m_normal_screen)
+        m_widget(&t->widget)
 {
         /* Inits allocation to 1x1 @ -1,-1 */
         cairo_rectangle_int_t allocation;
         gtk_widget_get_allocation(m_widget, &allocation);
         set_allocated_rect(allocation);
 
-	int i;
 	GdkDisplay *display;
 
 	/* NOTE! We allocated zeroed memory, just fill in non-zero stuff. */
@@ -7720,29 +6551,14 @@ Terminal::Terminal(vte::platform::Widget* w,
         m_regex_underline_position = 1;
         m_regex_underline_thickness = 1;
 
-        reset_default_attributes(true);
-
-        /* Initialize charset modes. */
-        m_character_replacements[0] = VTE_CHARACTER_REPLACEMENT_NONE;
-        m_character_replacements[1] = VTE_CHARACTER_REPLACEMENT_NONE;
-        m_character_replacement = &m_character_replacements[0];
-
-	/* Set up the desired palette. */
-	set_colors_default();
-	for (i = 0; i < VTE_PALETTE_SIZE; i++)
-		m_palette[i].sources[VTE_COLOR_SOURCE_ESCAPE].is_set = FALSE;
-
 	/* Set up I/O encodings. */
         g_assert_true(m_using_utf8);
-        m_utf8_ambiguous_width = VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH;
 	m_max_input_bytes = VTE_MAX_INPUT_READ;
 	m_cursor_blink_tag = 0;
         m_text_blink_tag = 0;
 	m_outgoing = _vte_byte_array_new();
-        m_last_graphic_character = 0;
 
 #ifdef WITH_ICONV
-        m_incoming_leftover = _vte_byte_array_new();
 	m_conv_buffer = _vte_byte_array_new();
 #endif
 
@@ -7772,7 +6588,6 @@ Terminal::Terminal(vte::platform::Widget* w,
         m_text_blink_mode = VTE_TEXT_BLINK_ALWAYS;
 	m_allow_bold = TRUE;
         m_bold_is_bright = FALSE;
-        m_rewrap_on_resize = TRUE;
 
         m_input_enabled = TRUE;
 
@@ -7785,14 +6600,6 @@ Terminal::Terminal(vte::platform::Widget* w,
         m_cursor_blinks = FALSE;
         m_cursor_blink_mode = VTE_CURSOR_BLINK_SYSTEM;
 
-        /* DECSCUSR cursor style (shape and blinking possibly overridden
-         * via escape sequence) */
-        m_cursor_style = VTE_CURSOR_STYLE_TERMINAL_DEFAULT;
-
-        /* Initialize the saved cursor. */
-        save_cursor(&m_normal_screen);
-        save_cursor(&m_alternate_screen);
-
 	/* Matching data. */
 	m_match_regexes = g_array_new(FALSE, TRUE,
 					 sizeof(struct vte_match_regex));
@@ -7822,10 +6629,6 @@ Terminal::Terminal(vte::platform::Widget* w,
         m_cell_height_scale = 1.;
 	m_has_fonts = FALSE;
 
-        /* Hyperlink */
-        m_allow_hyperlink = FALSE;
-        m_hyperlink_auto_id = 0;
-
         /* Mouse */
         m_mouse_last_position = vte::view::coords(-1, -1);
 
@@ -7997,7 +6800,7 @@ Terminal::widget_unrealize()
         remove_text_blink_timeout();
 
 	/* Cancel any pending redraws. */
-	remove_update_timeout(this);
+	cancel_updates();
 
 	/* Cancel any pending signals */
 	m_contents_changed_pending = FALSE;
@@ -8010,6 +6813,67 @@ Terminal::widget_unrealize()
 	m_modifiers = 0;
 }
 
+void
+Terminal::widget_map()
+{
+        m_widget_mapped = true;
+        update_fast_forward();
+        update_frame_driven();
+}
+
+void
+Terminal::widget_unmap()
+{
+        m_widget_mapped = false;
+        update_fast_forward();
+        update_frame_driven();
+}
+
+/* Called when the toplevel is iconified or restored */
+void
+Terminal::widget_set_obscured(bool obscured)
+{
+        m_widget_obscured = obscured;
+        update_fast_forward();
+        update_frame_driven();
+}
+
+/* While the widget can't be seen, e.g. in a background tab, the incoming
+ * data is processed at full speed without invalidating anything, resolving
+ * the selection, refreshing the matches or updating the accessible. Once
+ * the widget is visible again, all of that is caught up on in one go.
+ */
+void
+Terminal::update_fast_forward()
+{
+        auto const fast_forward = !m_widget_mapped || m_widget_obscured;
+        if (fast_forward == m_fast_forward)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_UPDATES, "%s fast-forward.\n",
+                         fast_forward ? "Starting" : "Stopping");
+
+        m_fast_forward = fast_forward;
+        if (fast_forward) {
+                remove_cursor_timeout();
+                return;
+        }
+
+        if (m_fast_forward_check_selection) {
+                m_fast_forward_check_selection = false;
+                deselect_if_changed();
+        }
+        if (m_fast_forward_text_changed) {
+                m_fast_forward_text_changed = false;
+                emit_text_modified();
+        }
+
+        invalidate_all();
+        check_cursor_blink();
+        im_update_cursor();
+        emit_pending_signals();
+}
+
 void
 Terminal::set_blink_settings(bool blink,
                              int blink_time,
@@ -8039,10 +6903,19 @@ Terminal::~Terminal()
 
         terminate_child();
         set_pty(nullptr);
-        remove_update_timeout(this);
+        cancel_updates();
 
         /* Stop processing input. */
-        stop_processing(this);
+        stop_processing();
+
+        dump_dispatch_profile();
+
+        _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                         "Spent %" G_GINT64_FORMAT "µs processing %" G_GUINT64_FORMAT " bytes "
+                         "in %" G_GUINT64_FORMAT " dispatches\n",
+                         m_scheduler_client.processing_time(),
+                         m_scheduler_client.n_bytes(),
+                         m_scheduler_client.n_dispatches());
 
 	/* Free the draw structure. */
 	if (m_draw != NULL) {
@@ -8105,15 +6978,11 @@ Terminal::~Terminal()
 
 #ifdef WITH_ICONV
 	/* Free conversion descriptors. */
-	if (m_incoming_conv != ((GIConv)-1)) {
-		g_iconv_close(m_incoming_conv);
-	}
 	if (m_outgoing_conv != ((GIConv)-1)) {
 		g_iconv_close(m_outgoing_conv);
 	}
 
 	_vte_byte_array_free(m_conv_buffer);
-        _vte_byte_array_free(m_incoming_leftover);
 #endif
 
         /* Stop listening for child-exited signals. */
@@ -9164,8 +8033,8 @@ Terminal::paint_im_preedit_string()
 		items = g_new(struct _vte_draw_text_request, len);
 		for (i = columns = 0; i < len; i++) {
 			items[i].c = g_utf8_get_char(preedit);
-                        items[i].columns = _vte_unichar_width(items[i].c,
-                                                              m_utf8_ambiguous_width);
+                        items[i].columns = vte::base::unichar_width(items[i].c,
+                                                                    m_utf8_ambiguous_width);
 			items[i].x = (col + columns) * width;
 			items[i].y = row_to_pixel(m_screen->cursor.row);
 			columns += items[i].columns;
@@ -9228,6 +8097,8 @@ Terminal::widget_draw(cairo_t *cr)
         if (region == NULL)
                 return;
 
+        auto const paint_start = g_get_monotonic_time();
+
         allocated_width = get_allocated_width();
         allocated_height = get_allocated_height();
 
@@ -9334,6 +8205,9 @@ Terminal::widget_draw(cairo_t *cr)
                                                       NULL);
 
         m_invalidated_all = FALSE;
+
+        /* For the frame budget, see frame_tick() */
+        m_paint_time = (m_paint_time + g_get_monotonic_time() - paint_start) / 2;
 }
 
 /* Handle an expose event by painting the exposed area. */
@@ -9562,6 +8436,45 @@ Terminal::set_scroll_on_keystroke(bool scroll)
         return true;
 }
 
+bool
+Terminal::set_threaded_pty_read(bool threaded)
+{
+        if (threaded == m_pty_read_threaded)
+                return false;
+
+        m_pty_read_threaded = threaded;
+
+        /* Switch over right away if we have a PTY */
+        if (m_pty_channel != nullptr) {
+                auto const connected = m_pty_input_source != 0 ||
+                        (m_pty_reader && m_pty_reader->is_connected());
+                disconnect_pty_read();
+                stop_pty_reader();
+                if (!m_incoming_queue.empty())
+                        start_processing();
+                if (connected)
+                        connect_pty_read();
+        }
+
+        return true;
+}
+
+bool
+Terminal::set_input_budget(guint bytes)
+{
+        if (bytes == m_input_budget)
+                return false;
+
+        m_input_budget = bytes;
+
+        /* Raising the budget may end the throttling right away;
+         * lowering it takes effect on the next read.
+         */
+        check_pty_read_throttle();
+
+        return true;
+}
+
 bool
 Terminal::set_rewrap_on_resize(bool rewrap)
 {
@@ -9625,18 +8538,12 @@ Terminal::set_cursor_shape(VteCursorShape shape)
 }
 
 /* DECSCUSR set cursor style */
-bool
-Terminal::set_cursor_style(VteCursorStyle style)
+void
+Terminal::cursor_style_changed()
 {
-        if (m_cursor_style == style)
-                return false;
-
-        m_cursor_style = style;
         update_cursor_blinks();
         /* and this will also make cursor shape match the DECSCUSR style */
         invalidate_cursor_once();
-
-        return true;
 }
 
 /*
@@ -9695,62 +8602,6 @@ Terminal::decscusr_cursor_shape()
         }
 }
 
-bool
-Terminal::set_scrollback_lines(long lines)
-{
-        glong low, high, next;
-        double scroll_delta;
-	VteScreen *scrn;
-
-	if (lines < 0)
-		lines = G_MAXLONG;
-
-#if 0
-        /* FIXME: this breaks the scrollbar range, bug #562511 */
-        if (lines == m_scrollback_lines)
-                return false;
-#endif
-
-	_vte_debug_print (VTE_DEBUG_MISC,
-			"Setting scrollback lines to %ld\n", lines);
-
-	m_scrollback_lines = lines;
-
-        /* The main screen gets the full scrollback buffer. */
-        scrn = &m_normal_screen;
-        lines = MAX (lines, m_row_count);
-        next = MAX (m_screen->cursor.row + 1,
-                    _vte_ring_next (scrn->row_data));
-        _vte_ring_resize (scrn->row_data, lines);
-        low = _vte_ring_delta (scrn->row_data);
-        high = lines + MIN (G_MAXLONG - lines, low - m_row_count + 1);
-        scrn->insert_delta = CLAMP (scrn->insert_delta, low, high);
-        scrn->scroll_delta = CLAMP (scrn->scroll_delta, low, scrn->insert_delta);
-        next = MIN (next, scrn->insert_delta + m_row_count);
-        if (_vte_ring_next (scrn->row_data) > next){
-                _vte_ring_shrink (scrn->row_data, next - low);
-        }
-
-        /* The alternate scrn isn't allowed to scroll at all. */
-        scrn = &m_alternate_screen;
-        _vte_ring_resize (scrn->row_data, m_row_count);
-        scrn->scroll_delta = _vte_ring_delta (scrn->row_data);
-        scrn->insert_delta = _vte_ring_delta (scrn->row_data);
-        if (_vte_ring_next (scrn->row_data) > scrn->insert_delta + m_row_count){
-                _vte_ring_shrink (scrn->row_data, m_row_count);
-        }
-
-	/* Adjust the scrollbar to the new location. */
-	/* Hack: force a change in scroll_delta even if the value remains, so that
-	   vte_term_q_adj_val_changed() doesn't shortcut to no-op, see bug 676075. */
-        scroll_delta = m_screen->scroll_delta;
-	m_screen->scroll_delta = -1;
-	queue_adjustment_value_changed(scroll_delta);
-	adjust_adjustments_full();
-
-        return true;
-}
-
 bool
 Terminal::set_backspace_binding(VteEraseBinding binding)
 {
@@ -9791,12 +8642,10 @@ Terminal::set_mouse_autohide(bool autohide)
  * Terminal::reset:
  * @clear_tabstops: whether to reset tabstops
  * @clear_history: whether to empty the terminal's scrollback buffer
+ * @from_api: whether this comes from the API rather than from the child
  *
- * Resets as much of the terminal's internal state as possible, discarding any
- * unprocessed input data, resetting character attributes, cursor state,
- * national character set state, status line, terminal modes (insert/delete),
- * selection state, and encoding.
- *
+ * Resets the emulation, see Emulation::reset(), and the selection and
+ * input state.
  */
 void
 Terminal::reset(bool clear_tabstops,
@@ -9809,76 +8658,17 @@ Terminal::reset(bool clear_tabstops,
         GObject *object = G_OBJECT(m_terminal);
         g_object_freeze_notify(object);
 
-        m_bell_pending = false;
+        Emulation::reset(clear_tabstops, clear_history);
+
+        g_object_thaw_notify(object);
+}
 
+void
+Terminal::emulation_reset(bool clear_history)
+{
 	/* Clear the output buffer. */
 	_vte_byte_array_clear(m_outgoing);
-	/* Reset charset substitution state. */
-
-        m_utf8_decoder.reset();
-
-#ifdef WITH_ICONV
-        if (m_incoming_conv != ((GIConv)-1)) {
-                /* Reset the converter state */
-                g_iconv(m_incoming_conv, nullptr, nullptr, nullptr, nullptr);
-        }
-        _vte_byte_array_clear(m_incoming_leftover);
-#endif
-
-        /* Reset parser */
-        m_parser.reset();
-        m_last_graphic_character = 0;
-
-        /* Reset modes */
-        m_modes_ecma.reset();
-        m_modes_private.clear_saved();
-        m_modes_private.reset();
-
-        /* Reset tabstops */
-        if (clear_tabstops) {
-                m_tabstops.reset();
-        }
-
-        /* Window title stack */
-        if (clear_history) {
-                m_window_title_stack.clear();
-        }
 
-        update_mouse_protocol();
-
-	/* Reset the color palette. Only the 256 indexed colors, not the special ones, as per xterm. */
-	for (int i = 0; i < 256; i++)
-		m_palette[i].sources[VTE_COLOR_SOURCE_ESCAPE].is_set = FALSE;
-	/* Reset the default attributes.  Reset the alternate attribute because
-	 * it's not a real attribute, but we need to treat it as one here. */
-        reset_default_attributes(true);
-        /* Reset charset modes. */
-        m_character_replacements[0] = VTE_CHARACTER_REPLACEMENT_NONE;
-        m_character_replacements[1] = VTE_CHARACTER_REPLACEMENT_NONE;
-        m_character_replacement = &m_character_replacements[0];
-	/* Clear the scrollback buffers and reset the cursors. Switch to normal screen. */
-	if (clear_history) {
-                m_screen = &m_normal_screen;
-                m_normal_screen.scroll_delta = m_normal_screen.insert_delta =
-                        _vte_ring_reset(m_normal_screen.row_data);
-                m_normal_screen.cursor.row = m_normal_screen.insert_delta;
-                m_normal_screen.cursor.col = 0;
-                m_alternate_screen.scroll_delta = m_alternate_screen.insert_delta =
-                        _vte_ring_reset(m_alternate_screen.row_data);
-                m_alternate_screen.cursor.row = m_alternate_screen.insert_delta;
-                m_alternate_screen.cursor.col = 0;
-                /* Adjust the scrollbar to the new location. */
-                /* Hack: force a change in scroll_delta even if the value remains, so that
-                   vte_term_q_adj_val_changed() doesn't shortcut to no-op, see bug 730599. */
-                m_screen->scroll_delta = -1;
-                queue_adjustment_value_changed(m_screen->insert_delta);
-		adjust_adjustments_full();
-	}
-        /* DECSCUSR cursor style */
-        set_cursor_style(VTE_CURSOR_STYLE_TERMINAL_DEFAULT);
-	/* Reset restricted scrolling regions, leave insert mode, make
-	 * the cursor visible again. */
-        m_scrolling_restricted = FALSE;
         /* Reset the visual bits of selection on hard reset, see bug 789954. */
         if (clear_history) {
                 deselect_all();
@@ -9895,13 +8685,6 @@ Terminal::reset(bool clear_tabstops,
 	m_mouse_smooth_scroll_delta = 0.;
 	/* Clear modifiers. */
 	m_modifiers = 0;
-        /* Reset the saved cursor. */
-        save_cursor(&m_normal_screen);
-        save_cursor(&m_alternate_screen);
-	/* Cause everything to be redrawn (or cleared). */
-	invalidate_all();
-
-        g_object_thaw_notify(object);
 }
 
 bool
@@ -9913,6 +8696,7 @@ Terminal::set_pty(VtePty *new_pty)
         if (m_pty != nullptr) {
                 disconnect_pty_read();
                 disconnect_pty_write();
+                stop_pty_reader();
 
                 if (m_pty_channel != nullptr) {
                         g_io_channel_unref (m_pty_channel);
@@ -9928,8 +8712,10 @@ Terminal::set_pty(VtePty *new_pty)
                                 m_incoming_queue.pop();
 
 			m_input_bytes = 0;
+                        m_incoming_bytes = 0;
 		}
-		stop_processing(this);
+		stop_processing();
+                check_pty_read_throttle();
 
                 m_utf8_decoder.reset(); // FIXMEchpe necessary here?
 
@@ -10020,109 +8806,133 @@ Terminal::select_empty(vte::grid::column_t col,
         select_text(col, row, col, row);
 }
 
-static void
-remove_process_timeout_source(void)
+void
+Terminal::reset_update_rects()
 {
-	if (process_timeout_tag == 0)
-                return;
+        g_array_set_size(m_update_rects, 0);
+	m_invalidated_all = FALSE;
+}
 
-        _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing process timeout\n");
-        g_source_remove (process_timeout_tag);
-        process_timeout_tag = 0;
+void
+Terminal::start_processing()
+{
+        vte::base::Scheduler::get().schedule_process(m_scheduler_client);
+        if (m_scheduler_client.is_frame_driven())
+                add_frame_tick();
 }
 
-static void
-add_update_timeout(vte::terminal::Terminal* that)
-{
-	if (update_timeout_tag == 0) {
-		_vte_debug_print (VTE_DEBUG_TIMEOUT,
-				"Starting update timeout\n");
-		update_timeout_tag =
-			g_timeout_add_full (GDK_PRIORITY_REDRAW,
-					VTE_UPDATE_TIMEOUT,
-					update_timeout, NULL,
-					NULL);
-	}
-	if (!in_process_timeout) {
-                remove_process_timeout_source();
-        }
-	if (that->m_active_terminals_link == nullptr) {
-		_vte_debug_print (VTE_DEBUG_TIMEOUT,
-				"Adding terminal to active list\n");
-		that->m_active_terminals_link = g_active_terminals =
-			g_list_prepend(g_active_terminals, that);
-	}
+void
+Terminal::stop_processing()
+{
+        /* Keep going until the pending redraws are done */
+        if (m_update_rects->len != 0)
+                return;
+
+        vte::base::Scheduler::get().unschedule(m_scheduler_client);
+        remove_frame_tick();
 }
 
 void
-Terminal::reset_update_rects()
+Terminal::schedule_update()
 {
-        g_array_set_size(m_update_rects, 0);
-	m_invalidated_all = FALSE;
+        vte::base::Scheduler::get().schedule_update(m_scheduler_client);
+        if (m_scheduler_client.is_frame_driven())
+                add_frame_tick();
 }
 
-static bool
-remove_from_active_list(vte::terminal::Terminal* that)
+/* While the widget is visible, process and redraw once per frame, as
+ * the frame clock ticks; otherwise there are no frames to sync to, and
+ * the scheduler's timeouts take over.
+ */
+void
+Terminal::update_frame_driven()
 {
-	if (that->m_active_terminals_link == nullptr ||
-            that->m_update_rects->len != 0)
-                return false;
+        auto const frame_driven = m_widget_mapped && !m_fast_forward && widget_realized();
+        if (frame_driven == m_scheduler_client.is_frame_driven())
+                return;
 
-        _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing terminal from active list\n");
-        g_active_terminals = g_list_delete_link(g_active_terminals, that->m_active_terminals_link);
-        that->m_active_terminals_link = nullptr;
-        return true;
+        _vte_debug_print(VTE_DEBUG_TIMEOUT, "%s frame clock driven updates.\n",
+                         frame_driven ? "Starting" : "Stopping");
+
+        vte::base::Scheduler::get().set_frame_driven(m_scheduler_client, frame_driven);
+        if (frame_driven) {
+                if (is_processing())
+                        add_frame_tick();
+        } else {
+                remove_frame_tick();
+                m_max_process_time = VTE_MAX_PROCESS_TIME;
+                if (is_processing())
+                        schedule_update();
+        }
 }
 
-static void
-stop_processing(vte::terminal::Terminal* that)
+void
+Terminal::add_frame_tick()
 {
-        if (!remove_from_active_list(that))
+        if (m_frame_tick != 0)
                 return;
 
-        if (g_active_terminals != nullptr)
+        m_frame_tick = gtk_widget_add_tick_callback(m_widget, frame_tick_cb, this, nullptr);
+}
+
+void
+Terminal::remove_frame_tick()
+{
+        if (m_frame_tick == 0)
                 return;
 
-        if (!in_process_timeout) {
-                remove_process_timeout_source();
-        }
-        if (in_update_timeout == FALSE &&
-            update_timeout_tag != 0) {
-                _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing update timeout\n");
-                g_source_remove (update_timeout_tag);
-                update_timeout_tag = 0;
-        }
+        gtk_widget_remove_tick_callback(m_widget, m_frame_tick);
+        m_frame_tick = 0;
 }
 
-static void
-remove_update_timeout(vte::terminal::Terminal* that)
+/* Runs in the frame clock's update phase, so whatever gets invalidated
+ * here is painted in this same frame.
+ */
+bool
+Terminal::frame_tick(GdkFrameClock* frame_clock)
 {
-	that->reset_update_rects();
-        stop_processing(that);
+        gint64 refresh_interval = 0;
+        gdk_frame_clock_get_refresh_info(frame_clock,
+                                         gdk_frame_clock_get_frame_time(frame_clock),
+                                         &refresh_interval, nullptr);
+        if (refresh_interval <= 0)
+                refresh_interval = VTE_FRAME_INTERVAL_DEFAULT;
+
+        /* Leave room for painting, plus some slack for the rest of the
+         * frame; but always get some processing done.
+         */
+        auto const budget = std::max(refresh_interval * 3 / 4 - m_paint_time,
+                                     refresh_interval / 4);
+        m_frame_deadline = g_get_monotonic_time() + budget;
+        m_max_process_time = budget / 1000.;
+
+        /* Dispatching may stop and restart processing (e.g. a signal
+         * handler calling feed()), replacing this tick callback; only
+         * forget the id if it's still ours.
+         */
+        auto const tick = m_frame_tick;
+        if (vte::base::Scheduler::get().dispatch(m_scheduler_client, true))
+                return true;
+
+        if (m_frame_tick == tick)
+                m_frame_tick = 0;
+        return false;
 }
 
-static void
-add_process_timeout(vte::terminal::Terminal* that)
+gboolean
+Terminal::frame_tick_cb(GtkWidget* widget,
+                        GdkFrameClock* frame_clock,
+                        gpointer data) noexcept
 {
-	_vte_debug_print(VTE_DEBUG_TIMEOUT,
-			"Adding terminal to active list\n");
-	that->m_active_terminals_link = g_active_terminals =
-		g_list_prepend(g_active_terminals, that);
-	if (update_timeout_tag == 0 &&
-			process_timeout_tag == 0) {
-		_vte_debug_print(VTE_DEBUG_TIMEOUT,
-				"Starting process timeout\n");
-		process_timeout_tag =
-			g_timeout_add (VTE_DISPLAY_TIMEOUT,
-					process_timeout, NULL);
-	}
+        auto that = reinterpret_cast<Terminal*>(data);
+        return that->frame_tick(frame_clock) ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
 }
 
 void
-Terminal::start_processing()
+Terminal::cancel_updates()
 {
-	if (!is_processing())
-		add_process_timeout(this);
+	reset_update_rects();
+        stop_processing();
 }
 
 void
@@ -10177,7 +8987,8 @@ Terminal::emit_pending_signals()
 
 	/* Flush any pending "inserted" signals. */
 
-        if (m_cursor_moved_pending) {
+        /* Held back while fast-forwarding, see update_fast_forward() */
+        if (m_cursor_moved_pending && !m_fast_forward) {
                 _vte_debug_print(VTE_DEBUG_SIGNALS,
                                  "Emitting `cursor-moved'.\n");
                 g_signal_emit(object, signals[SIGNAL_CURSOR_MOVED], 0);
@@ -10204,7 +9015,7 @@ Terminal::emit_pending_signals()
 	if (m_contents_changed_pending) {
                 /* Update hyperlink and dingus match set. */
 		match_contents_clear();
-		if (m_mouse_cursor_over_widget) {
+		if (m_mouse_cursor_over_widget && !m_fast_forward) {
                         hyperlink_hilite_update();
                         match_hilite_update();
 		}
@@ -10235,16 +9046,22 @@ Terminal::time_process_incoming()
 	g_timer_reset(process_timer);
 	process_incoming();
 	auto elapsed = g_timer_elapsed(process_timer, NULL) * 1000;
-	gssize target = VTE_MAX_PROCESS_TIME / elapsed * m_input_bytes;
+	gssize target = m_max_process_time / elapsed * m_input_bytes;
 	m_max_input_bytes = (m_max_input_bytes + target) / 2;
 }
 
 bool
 Terminal::process(bool emit_adj_changed)
 {
-        if (m_pty_channel) {
-                if (m_pty_input_active ||
-                    m_pty_input_source == 0) {
+        if (m_pty_channel && !m_input_throttled) {
+                if (m_pty_reader) {
+                        if (m_pty_input_active ||
+                            !m_pty_reader->is_connected()) {
+                                m_pty_input_active = false;
+                                pty_reader_read();
+                        }
+                } else if (m_pty_input_active ||
+                           m_pty_input_source == 0) {
                         m_pty_input_active = false;
                         pty_io_read(m_pty_channel, G_IO_IN);
                 }
@@ -10255,86 +9072,21 @@ Terminal::process(bool emit_adj_changed)
 
         bool is_active = !m_incoming_queue.empty();
         if (is_active) {
+                m_scheduler_client.charge(m_input_bytes, m_max_input_bytes);
+
                 if (VTE_MAX_PROCESS_TIME) {
                         time_process_incoming();
                 } else {
                         process_incoming();
                 }
                 m_input_bytes = 0;
+                check_pty_read_throttle();
         } else
                 emit_pending_signals();
 
         return is_active;
 }
 
-/* This function is called after DISPLAY_TIMEOUT ms.
- * It makes sure initial output is never delayed by more than DISPLAY_TIMEOUT
- */
-static gboolean
-process_timeout (gpointer data)
-{
-	GList *l, *next;
-	gboolean again;
-
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
-	gdk_threads_enter();
-        G_GNUC_END_IGNORE_DEPRECATIONS;
-
-	in_process_timeout = TRUE;
-
-	_vte_debug_print (VTE_DEBUG_WORK, "<");
-	_vte_debug_print (VTE_DEBUG_TIMEOUT,
-                          "Process timeout:  %d active\n",
-                          g_list_length(g_active_terminals));
-
-	for (l = g_active_terminals; l != NULL; l = next) {
-		auto that = reinterpret_cast<vte::terminal::Terminal*>(l->data);
-		bool active;
-
-		next = l->next;
-
-		if (l != g_active_terminals) {
-			_vte_debug_print (VTE_DEBUG_WORK, "T");
-		}
-
-                // FIXMEchpe find out why we don't emit_adjustment_changed() here!!
-                active = that->process(false);
-
-		if (!active) {
-                        remove_from_active_list(that);
-		}
-	}
-
-	_vte_debug_print (VTE_DEBUG_WORK, ">");
-
-	if (g_active_terminals != nullptr && update_timeout_tag == 0) {
-		again = TRUE;
-	} else {
-		_vte_debug_print(VTE_DEBUG_TIMEOUT,
-				"Stopping process timeout\n");
-		process_timeout_tag = 0;
-		again = FALSE;
-	}
-
-	in_process_timeout = FALSE;
-
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
-	gdk_threads_leave();
-        G_GNUC_END_IGNORE_DEPRECATIONS;
-
-	if (again) {
-		/* Force us to relinquish the CPU as the child is running
-		 * at full tilt and making us run to keep up...
-		 */
-		g_usleep (0);
-	} else if (update_timeout_tag == 0) {
-		/* otherwise free up memory used to capture incoming data */
-                vte::base::Chunk::prune();
-	}
-
-	return again;
-}
-
 bool
 Terminal::invalidate_dirty_rects_and_process_updates()
 {
@@ -10365,128 +9117,46 @@ Terminal::invalidate_dirty_rects_and_process_updates()
 	return true;
 }
 
-static gboolean
-update_repeat_timeout (gpointer data)
+/* Called by the scheduler once per round while there's work to do;
+ * see Scheduler::callback_type.
+ */
+bool
+Terminal::dispatch(bool update)
 {
-	GList *l, *next;
-	bool again;
-
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
-	gdk_threads_enter();
-        G_GNUC_END_IGNORE_DEPRECATIONS;
-
-	in_update_timeout = TRUE;
-
-	_vte_debug_print (VTE_DEBUG_WORK, "[");
-	_vte_debug_print (VTE_DEBUG_TIMEOUT,
-                          "Repeat timeout:  %d active\n",
-                          g_list_length(g_active_terminals));
-
-	for (l = g_active_terminals; l != NULL; l = next) {
-		auto that = reinterpret_cast<vte::terminal::Terminal*>(l->data);
-
-                next = l->next;
-
-		if (l != g_active_terminals) {
-			_vte_debug_print (VTE_DEBUG_WORK, "T");
-		}
-
-                that->process(true);
-
-		again = that->invalidate_dirty_rects_and_process_updates();
-		if (!again) {
-                        remove_from_active_list(that);
-		}
-	}
-
-	_vte_debug_print (VTE_DEBUG_WORK, "]");
-
-	/* We only stop the timer if no update request was received in this
-         * past cycle.  Technically, always stop this timer object and maybe
-         * reinstall a new one because we need to delay by the amount of time
-         * it took to repaint the screen: bug 730732.
-	 */
-	if (g_active_terminals == nullptr) {
-		_vte_debug_print(VTE_DEBUG_TIMEOUT,
-				"Stopping update timeout\n");
-		update_timeout_tag = 0;
-		again = false;
-        } else {
-                update_timeout_tag =
-                        g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE,
-                                            VTE_UPDATE_REPEAT_TIMEOUT,
-                                            update_repeat_timeout, NULL,
-                                            NULL);
-                again = true;
-	}
-
-	in_update_timeout = FALSE;
+        if (!update) {
+                // FIXMEchpe find out why we don't emit_adjustment_changed() here!!
+                auto const active = process(false);
+                return active || m_update_rects->len != 0;
+        }
 
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
-	gdk_threads_leave();
-        G_GNUC_END_IGNORE_DEPRECATIONS;
+        process(true);
 
-	if (again) {
-		/* Force us to relinquish the CPU as the child is running
-		 * at full tilt and making us run to keep up...
-		 */
-		g_usleep (0);
-	} else {
-		/* otherwise free up memory used to capture incoming data */
-                vte::base::Chunk::prune();
-	}
+        /* Fill the rest of the frame with processing, if there's more */
+        if (m_scheduler_client.is_frame_driven()) {
+                while (m_pty_input_active &&
+                       g_get_monotonic_time() < m_frame_deadline &&
+                       process(false))
+                        ;
+        }
 
-        return FALSE;  /* If we need to go again, we already have a new timer for that. */
+        return invalidate_dirty_rects_and_process_updates();
 }
 
-static gboolean
-update_timeout (gpointer data)
+bool
+Terminal::scheduler_cb(void* data,
+                       bool update) noexcept
 {
-	GList *l, *next;
-
         G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
 	gdk_threads_enter();
         G_GNUC_END_IGNORE_DEPRECATIONS;
 
-	in_update_timeout = TRUE;
-
-	_vte_debug_print (VTE_DEBUG_WORK, "{");
-	_vte_debug_print (VTE_DEBUG_TIMEOUT,
-                          "Update timeout:  %d active\n",
-                          g_list_length(g_active_terminals));
-
-        remove_process_timeout_source();
-
-	for (l = g_active_terminals; l != NULL; l = next) {
-		auto that = reinterpret_cast<vte::terminal::Terminal*>(l->data);
-
-                next = l->next;
-
-		if (l != g_active_terminals) {
-			_vte_debug_print (VTE_DEBUG_WORK, "T");
-		}
-
-                that->process(true);
-
-                that->invalidate_dirty_rects_and_process_updates();
-	}
-
-	_vte_debug_print (VTE_DEBUG_WORK, "}");
-
-	/* Set a timer such that we do not invalidate for a while. */
-	/* This limits the number of times we draw to ~40fps. */
-	update_timeout_tag =
-		g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE,
-				    VTE_UPDATE_REPEAT_TIMEOUT,
-				    update_repeat_timeout, NULL,
-				    NULL);
-	in_update_timeout = FALSE;
+        auto const again = reinterpret_cast<Terminal*>(data)->dispatch(update);
 
         G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
 	gdk_threads_leave();
         G_GNUC_END_IGNORE_DEPRECATIONS;
 
-	return FALSE;
+        return again;
 }
 
 bool
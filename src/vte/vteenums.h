@@ -171,6 +171,23 @@ typedef enum {
         VTE_FORMAT_HTML = 2
 } VteFormat;
 
+/**
+ * VteScrollbackCodec:
+ * @VTE_SCROLLBACK_CODEC_ZLIB: zlib, always available; the default
+ * @VTE_SCROLLBACK_CODEC_LZ4: LZ4, which is several times faster, but compresses less
+ * @VTE_SCROLLBACK_CODEC_ZSTD: zstd, which compresses better at a similar speed
+ *
+ * An enumerated type for the codecs the scrollback buffer can be
+ * compressed with, see vte_set_scrollback_codec().
+ *
+ * Since: 0.56
+ */
+typedef enum {
+        VTE_SCROLLBACK_CODEC_ZLIB = 0,
+        VTE_SCROLLBACK_CODEC_LZ4  = 1,
+        VTE_SCROLLBACK_CODEC_ZSTD = 2
+} VteScrollbackCodec;
+
 G_END_DECLS
 
 #endif /* __VTE_VTE_ENUMS_H__ */
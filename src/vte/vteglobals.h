@@ -21,6 +21,7 @@
 
 #include <glib.h>
 
+#include "vteenums.h"
 #include "vtemacros.h"
 
 G_BEGIN_DECLS
@@ -37,6 +38,17 @@ const char *vte_get_features (void);
 _VTE_PUBLIC
 void vte_set_test_flags(guint64 flags);
 
+_VTE_PUBLIC
+void vte_set_scrollback_cache_size(guint n_blocks,
+                                   gsize max_bytes);
+
+_VTE_PUBLIC
+gboolean vte_set_scrollback_codec(VteScrollbackCodec codec,
+                                  int level);
+
+_VTE_PUBLIC
+gboolean vte_set_scrollback_dictionaries(gboolean train);
+
 G_END_DECLS
 
 #endif /* __VTE_VTE_GLOBALS_H__ */
@@ -300,6 +300,11 @@ void vte_terminal_set_scrollback_lines(VteTerminal *terminal,
                                        glong lines) _VTE_GNUC_NONNULL(1);
 _VTE_PUBLIC
 glong vte_terminal_get_scrollback_lines(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+void vte_terminal_set_scrollback_in_memory(VteTerminal *terminal,
+                                           gboolean in_memory) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+gboolean vte_terminal_get_scrollback_in_memory(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
 
 /* Set or retrieve the current font. */
 _VTE_PUBLIC
@@ -439,6 +444,20 @@ void vte_terminal_set_pty(VteTerminal *terminal,
 _VTE_PUBLIC
 VtePty *vte_terminal_get_pty(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
 
+_VTE_PUBLIC
+void vte_terminal_set_threaded_pty_read(VteTerminal *terminal,
+                                        gboolean threaded) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+gboolean vte_terminal_get_threaded_pty_read(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_input_budget(VteTerminal *terminal,
+                                   guint bytes) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+guint vte_terminal_get_input_budget(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+gint64 vte_terminal_get_input_throttled_time(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+
 /* Accessors for bindings. */
 _VTE_PUBLIC
 glong vte_terminal_get_char_width(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
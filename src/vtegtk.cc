@@ -57,6 +57,7 @@
 
 #include "vtegtk.hh"
 #include "vteregexinternal.hh"
+#include "vtestream.h"
 
 #if !GLIB_CHECK_VERSION(2, 42, 0)
 #define G_PARAM_EXPLICIT_NOTIFY 0
@@ -110,7 +111,14 @@ _vte_terminal_get_impl(VteTerminal *terminal)
 guint signals[LAST_SIGNAL];
 GParamSpec *pspecs[LAST_PROP];
 GTimer *process_timer;
-uint64_t g_test_flags = 0;
+
+vte::color::rgb::rgb(GdkRGBA const* rgba) {
+        g_assert(rgba);
+        /* FIXME: equal distribution! */
+        red   = rgba->red   * 65535.;
+        green = rgba->green * 65535.;
+        blue  = rgba->blue  * 65535.;
+}
 
 static bool
 valid_color(GdkRGBA const* color)
@@ -505,6 +513,9 @@ vte_terminal_get_property (GObject *object,
                 case PROP_ICON_TITLE:
                         g_value_set_string (value, vte_terminal_get_icon_title (terminal));
                         break;
+                case PROP_INPUT_BUDGET:
+                        g_value_set_uint (value, vte_terminal_get_input_budget (terminal));
+                        break;
                 case PROP_INPUT_ENABLED:
                         g_value_set_boolean (value, vte_terminal_get_input_enabled (terminal));
                         break;
@@ -517,6 +528,9 @@ vte_terminal_get_property (GObject *object,
                 case PROP_REWRAP_ON_RESIZE:
                         g_value_set_boolean (value, vte_terminal_get_rewrap_on_resize (terminal));
                         break;
+                case PROP_SCROLLBACK_IN_MEMORY:
+                        g_value_set_boolean (value, vte_terminal_get_scrollback_in_memory (terminal));
+                        break;
                 case PROP_SCROLLBACK_LINES:
                         g_value_set_uint (value, vte_terminal_get_scrollback_lines(terminal));
                         break;
@@ -529,6 +543,9 @@ vte_terminal_get_property (GObject *object,
                 case PROP_TEXT_BLINK_MODE:
                         g_value_set_enum (value, vte_terminal_get_text_blink_mode (terminal));
                         break;
+                case PROP_THREADED_PTY_READ:
+                        g_value_set_boolean (value, vte_terminal_get_threaded_pty_read (terminal));
+                        break;
                 case PROP_WINDOW_TITLE:
                         g_value_set_string (value, vte_terminal_get_window_title (terminal));
                         break;
@@ -606,6 +623,9 @@ vte_terminal_set_property (GObject *object,
                 case PROP_FONT_SCALE:
                         vte_terminal_set_font_scale (terminal, g_value_get_double (value));
                         break;
+                case PROP_INPUT_BUDGET:
+                        vte_terminal_set_input_budget (terminal, g_value_get_uint (value));
+                        break;
                 case PROP_INPUT_ENABLED:
                         vte_terminal_set_input_enabled (terminal, g_value_get_boolean (value));
                         break;
@@ -618,6 +638,9 @@ vte_terminal_set_property (GObject *object,
                 case PROP_REWRAP_ON_RESIZE:
                         vte_terminal_set_rewrap_on_resize (terminal, g_value_get_boolean (value));
                         break;
+                case PROP_SCROLLBACK_IN_MEMORY:
+                        vte_terminal_set_scrollback_in_memory (terminal, g_value_get_boolean (value));
+                        break;
                 case PROP_SCROLLBACK_LINES:
                         vte_terminal_set_scrollback_lines (terminal, g_value_get_uint (value));
                         break;
@@ -630,6 +653,9 @@ vte_terminal_set_property (GObject *object,
                 case PROP_TEXT_BLINK_MODE:
                         vte_terminal_set_text_blink_mode (terminal, (VteTextBlinkMode)g_value_get_enum (value));
                         break;
+                case PROP_THREADED_PTY_READ:
+                        vte_terminal_set_threaded_pty_read (terminal, g_value_get_boolean (value));
+                        break;
                 case PROP_WORD_CHAR_EXCEPTIONS:
                         vte_terminal_set_word_char_exceptions (terminal, g_value_get_string (value));
                         break;
@@ -656,9 +682,10 @@ vte_terminal_class_init(VteTerminalClass *klass)
 	GtkWidgetClass *widget_class;
 	GtkBindingSet  *binding_set;
 
+        _vte_debug_init();
+
 #ifdef VTE_DEBUG
 	{
-                _vte_debug_init();
 		_vte_debug_print(VTE_DEBUG_LIFECYCLE,
                                  "vte_terminal_class_init()\n");
 		/* print out the legend */
@@ -1498,6 +1525,25 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                      NULL,
                                      (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:input-budget:
+         *
+         * The maximum number of bytes of output from the child that the
+         * terminal queues up for processing. When the child produces output
+         * faster than the terminal can process it, the terminal stops reading
+         * from the PTY once this much is queued, which blocks the child, and
+         * resumes reading once the queue has drained to half of it.
+         *
+         * 0 means no limit.
+         *
+         * Since: 0.56
+         */
+        pspecs[PROP_INPUT_BUDGET] =
+                g_param_spec_uint ("input-budget", NULL, NULL,
+                                   0, G_MAXUINT,
+                                   VTE_INPUT_BUDGET_DEFAULT,
+                                   (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
         /**
          * VteTerminal:input-enabled:
          *
@@ -1543,6 +1589,21 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                       TRUE,
                                       (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:scrollback-in-memory:
+         *
+         * Whether the terminal keeps its scrollback buffer in memory, compressed
+         * (and encrypted, where available) the same way, instead of writing it
+         * to temporary files. With an unlimited #VteTerminal:scrollback-lines,
+         * memory use grows with the scrollback.
+         *
+         * Since: 0.56
+         */
+        pspecs[PROP_SCROLLBACK_IN_MEMORY] =
+                g_param_spec_boolean ("scrollback-in-memory", NULL, NULL,
+                                      FALSE,
+                                      (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
         /**
          * VteTerminal:scrollback-lines:
          *
@@ -1595,6 +1656,19 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                    VTE_TEXT_BLINK_ALWAYS,
                                    (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:threaded-pty-read:
+         *
+         * Controls whether the terminal reads from its PTY on a separate
+         * thread, instead of on the main loop.
+         *
+         * Since: 0.56
+         */
+        pspecs[PROP_THREADED_PTY_READ] =
+                g_param_spec_boolean ("threaded-pty-read", NULL, NULL,
+                                      FALSE,
+                                      (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
         /**
          * VteTerminal:window-title:
          *
@@ -1700,6 +1774,16 @@ vte_get_features (void)
                 "+GNUTLS"
 #else
                 "-GNUTLS"
+#endif
+#ifdef WITH_LZ4
+                " +LZ4"
+#else
+                " -LZ4"
+#endif
+#ifdef WITH_ZSTD
+                " +ZSTD"
+#else
+                " -ZSTD"
 #endif
                 ;
 }
@@ -1796,6 +1880,99 @@ vte_set_test_flags(guint64 flags)
 #endif
 }
 
+/**
+ * vte_set_scrollback_cache_size:
+ * @n_blocks: the number of blocks each stream caches
+ * @max_bytes: the most memory all the streams together may use for caching
+ *
+ * Sets how many decoded blocks of the scrollback buffer each of its streams
+ * keeps around for reading, so that scrolling back and forth across block
+ * boundaries doesn't read, decrypt and uncompress the same blocks over and
+ * over again. The blocks are 64 KiB each, and a terminal has three streams.
+ * @max_bytes caps the memory used for this by all terminals in the process
+ * together; once it's reached, streams reuse their cached blocks instead.
+ *
+ * The defaults are 4 blocks and 32 MiB. @n_blocks is clamped to the range
+ * 1 to 16.
+ *
+ * This setting is process-wide, and should be set before creating any
+ * #VteTerminal.
+ *
+ * Since: 0.56
+ */
+void
+vte_set_scrollback_cache_size(guint n_blocks,
+                              gsize max_bytes)
+{
+        _vte_file_stream_set_cache_size(n_blocks, max_bytes);
+}
+
+/**
+ * vte_set_scrollback_codec:
+ * @codec: a #VteScrollbackCodec
+ * @level: the compression level, or 0 for the codec's default
+ *
+ * Sets the codec, and its level, that the scrollback buffer's blocks are
+ * compressed with from now on. Each block records its codec, so blocks
+ * already written can still be read after a change. Higher levels
+ * compress better, and more slowly; the range depends on the codec.
+ *
+ * LZ4 and zstd are optional at build time; see vte_get_features() for
+ * whether they are available.
+ *
+ * This setting is process-wide.
+ *
+ * Returns: %TRUE if @codec is available, %FALSE otherwise, in which
+ *   case the codec doesn't change
+ *
+ * Since: 0.56
+ */
+gboolean
+vte_set_scrollback_codec(VteScrollbackCodec codec,
+                         int level)
+{
+        VteStreamCodec stream_codec;
+        switch (codec) {
+        case VTE_SCROLLBACK_CODEC_ZLIB: stream_codec = VTE_STREAM_CODEC_ZLIB; break;
+        case VTE_SCROLLBACK_CODEC_LZ4:  stream_codec = VTE_STREAM_CODEC_LZ4;  break;
+        case VTE_SCROLLBACK_CODEC_ZSTD: stream_codec = VTE_STREAM_CODEC_ZSTD; break;
+        default:
+                g_return_val_if_reached(FALSE);
+        }
+
+        return _vte_file_stream_set_codec(stream_codec, MAX(level, 0));
+}
+
+/**
+ * vte_set_scrollback_dictionaries:
+ * @train: whether to train dictionaries
+ *
+ * Sets whether the scrollback buffer's streams, while compressed with
+ * %VTE_SCROLLBACK_CODEC_ZSTD, train a zstd dictionary of their own on their
+ * first few blocks, and compress the blocks after those with it.
+ * Each dictionary is kept in memory, once per stream.
+ *
+ * Each block is already large enough for zstd to find most of the
+ * repetition, so the gain is small. Measured with stream-bench over 8 MiB,
+ * the compression ratio improves by up to about 7% for compiler output and
+ * by under 2% for JSON and logs, and is the same or slightly worse for
+ * terminal rows and attribute runs. Meanwhile the write throughput roughly
+ * halves, mostly from training once per stream. Reading is as fast as
+ * without.
+ *
+ * This is off by default. This setting is process-wide, and affects the
+ * blocks written from now on.
+ *
+ * Returns: %TRUE if dictionaries are available, %FALSE if zstd isn't
+ *
+ * Since: 0.56
+ */
+gboolean
+vte_set_scrollback_dictionaries(gboolean train)
+{
+        return _vte_file_stream_set_dictionaries(train != FALSE);
+}
+
 /* VteTerminal public API */
 
 /**
@@ -4045,6 +4222,107 @@ vte_terminal_get_pty(VteTerminal *terminal)
         return IMPL(terminal)->m_pty;
 }
 
+/**
+ * vte_terminal_set_threaded_pty_read:
+ * @terminal: a #VteTerminal
+ * @threaded: whether to read from the PTY on a separate thread
+ *
+ * Controls whether @terminal reads the output of the child on a
+ * separate thread. The data is still processed on the main thread,
+ * but the reading can continue while the main loop is busy. All
+ * terminals share a single I/O thread, which wakes up the main loop
+ * at most once per batch of reads, no matter how many terminals
+ * had output.
+ *
+ * This can be changed at any time, including while a child is running.
+ *
+ * Since: 0.56
+ */
+void
+vte_terminal_set_threaded_pty_read(VteTerminal *terminal,
+                                   gboolean threaded)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        if (IMPL(terminal)->set_threaded_pty_read(threaded != FALSE))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_THREADED_PTY_READ]);
+}
+
+/**
+ * vte_terminal_get_threaded_pty_read:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: %TRUE if @terminal reads from its PTY on a separate thread
+ *
+ * Since: 0.56
+ */
+gboolean
+vte_terminal_get_threaded_pty_read(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), FALSE);
+        return IMPL(terminal)->m_pty_read_threaded;
+}
+
+/**
+ * vte_terminal_set_input_budget:
+ * @terminal: a #VteTerminal
+ * @bytes: the maximum number of bytes to queue, or 0 for no limit
+ *
+ * Sets the maximum number of bytes of output from the child that
+ * @terminal queues up for processing. Once that much is queued,
+ * @terminal stops reading from the PTY, so that the child blocks
+ * on writing instead of the terminal's memory use growing; reading
+ * resumes once the queue has drained to half of @bytes.
+ *
+ * See vte_terminal_get_input_throttled_time().
+ *
+ * Since: 0.56
+ */
+void
+vte_terminal_set_input_budget(VteTerminal *terminal,
+                              guint bytes)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        if (IMPL(terminal)->set_input_budget(bytes))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_INPUT_BUDGET]);
+}
+
+/**
+ * vte_terminal_get_input_budget:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: the maximum number of bytes of output from the child
+ *   that @terminal queues up, or 0 if there is no limit
+ *
+ * Since: 0.56
+ */
+guint
+vte_terminal_get_input_budget(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+        return IMPL(terminal)->m_input_budget;
+}
+
+/**
+ * vte_terminal_get_input_throttled_time:
+ * @terminal: a #VteTerminal
+ *
+ * Returns the total time @terminal has not been reading from its PTY
+ * because its input budget was used up, including any ongoing throttling.
+ * See vte_terminal_set_input_budget().
+ *
+ * Returns: the time in microseconds
+ *
+ * Since: 0.56
+ */
+gint64
+vte_terminal_get_input_throttled_time(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+        return IMPL(terminal)->input_throttled_time();
+}
+
 /**
  * vte_terminal_get_rewrap_on_resize:
  * @terminal: a #VteTerminal
@@ -4138,6 +4416,47 @@ vte_terminal_get_scrollback_lines(VteTerminal *terminal)
         return IMPL(terminal)->m_scrollback_lines;
 }
 
+/**
+ * vte_terminal_set_scrollback_in_memory:
+ * @terminal: a #VteTerminal
+ * @in_memory: whether to keep the scrollback buffer in memory
+ *
+ * Sets whether @terminal keeps its scrollback buffer in memory, compressed
+ * (and encrypted, where available) the same way, instead of writing it to
+ * temporary files. This avoids the files and their file descriptors, at the
+ * cost of memory; it's best combined with a limited number of scrollback
+ * lines, see vte_terminal_set_scrollback_lines().
+ *
+ * The contents of the scrollback buffer are kept.
+ *
+ * Since: 0.56
+ */
+void
+vte_terminal_set_scrollback_in_memory(VteTerminal *terminal,
+                                      gboolean in_memory)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        if (IMPL(terminal)->set_scrollback_in_memory(in_memory != FALSE))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_SCROLLBACK_IN_MEMORY]);
+}
+
+/**
+ * vte_terminal_get_scrollback_in_memory:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: whether @terminal keeps its scrollback buffer in memory,
+ *   see vte_terminal_set_scrollback_in_memory()
+ *
+ * Since: 0.56
+ */
+gboolean
+vte_terminal_get_scrollback_in_memory(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), FALSE);
+        return IMPL(terminal)->m_scrollback_in_memory;
+}
+
 /**
  * vte_terminal_set_scroll_on_keystroke:
  * @terminal: a #VteTerminal
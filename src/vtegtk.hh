@@ -81,14 +81,17 @@ enum {
         PROP_FONT_SCALE,
         PROP_HYPERLINK_HOVER_URI,
         PROP_ICON_TITLE,
+        PROP_INPUT_BUDGET,
         PROP_INPUT_ENABLED,
         PROP_MOUSE_POINTER_AUTOHIDE,
         PROP_PTY,
         PROP_REWRAP_ON_RESIZE,
+        PROP_SCROLLBACK_IN_MEMORY,
         PROP_SCROLLBACK_LINES,
         PROP_SCROLL_ON_KEYSTROKE,
         PROP_SCROLL_ON_OUTPUT,
         PROP_TEXT_BLINK_MODE,
+        PROP_THREADED_PTY_READ,
         PROP_WINDOW_TITLE,
         PROP_WORD_CHAR_EXCEPTIONS,
         LAST_PROP,
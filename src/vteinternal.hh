@@ -19,26 +19,22 @@
 #pragma once
 
 #include <glib.h>
+#include <vte/vte.h>
 
-#include "vtedefines.hh"
-#include "vtetypes.hh"
+#include "emulation.hh"
 #include "vtedraw.hh"
 #include "reaper.hh"
-#include "ring.hh"
 #include "buffer.h"
-#include "parser.hh"
-#include "parser-glue.hh"
-#include "modes.hh"
-#include "tabstops.hh"
 #include "refptr.hh"
 
 #include "vtepcre2.h"
 #include "vteregexinternal.hh"
 
-#include "chunk.hh"
-#include "utf8.hh"
+#include "ptyreader.hh"
+#include "scheduler.hh"
 
 #include <list>
+#include <memory>
 #include <queue>
 #include <string>
 #include <vector>
@@ -49,79 +45,6 @@ typedef enum {
         VTE_REGEX_CURSOR_NAME
 } VteRegexCursorMode;
 
-/* The order is important */
-typedef enum {
-	MOUSE_TRACKING_NONE,
-	MOUSE_TRACKING_SEND_XY_ON_CLICK,
-	MOUSE_TRACKING_SEND_XY_ON_BUTTON,
-	MOUSE_TRACKING_HILITE_TRACKING,
-	MOUSE_TRACKING_CELL_MOTION_TRACKING,
-	MOUSE_TRACKING_ALL_MOTION_TRACKING
-} MouseTrackingMode;
-
-enum {
-        VTE_XTERM_WM_RESTORE_WINDOW = 1,
-        VTE_XTERM_WM_MINIMIZE_WINDOW = 2,
-        VTE_XTERM_WM_SET_WINDOW_POSITION = 3,
-        VTE_XTERM_WM_SET_WINDOW_SIZE_PIXELS = 4,
-        VTE_XTERM_WM_RAISE_WINDOW = 5,
-        VTE_XTERM_WM_LOWER_WINDOW = 6,
-        VTE_XTERM_WM_REFRESH_WINDOW = 7,
-        VTE_XTERM_WM_SET_WINDOW_SIZE_CELLS = 8,
-        VTE_XTERM_WM_MAXIMIZE_WINDOW = 9,
-        VTE_XTERM_WM_FULLSCREEN_WINDOW = 10,
-        VTE_XTERM_WM_GET_WINDOW_STATE = 11,
-        VTE_XTERM_WM_GET_WINDOW_POSITION = 13,
-        VTE_XTERM_WM_GET_WINDOW_SIZE_PIXELS = 14,
-        VTE_XTERM_WM_GET_WINDOW_SIZE_CELLS = 18,
-        VTE_XTERM_WM_GET_SCREEN_SIZE_CELLS = 19,
-        VTE_XTERM_WM_GET_ICON_TITLE = 20,
-        VTE_XTERM_WM_GET_WINDOW_TITLE = 21,
-        VTE_XTERM_WM_TITLE_STACK_PUSH = 22,
-        VTE_XTERM_WM_TITLE_STACK_POP = 23,
-};
-
-enum {
-        VTE_SGR_SET_BOLD                     =   1,
-        VTE_SGR_SET_DIM                      =   2,
-        VTE_SGR_SET_ITALIC                   =   3,
-        VTE_SGR_SET_UNDERLINE                =   4,
-        VTE_SGR_SET_BLINK                    =   5,
-        VTE_SGR_SET_REVERSE                  =   7,
-        VTE_SGR_SET_INVISIBLE                =   8,
-        VTE_SGR_SET_STRIKETHROUGH            =   9,
-        VTE_SGR_SET_UNDERLINE_DOUBLE         =  21,
-        VTE_SGR_SET_FORE_LEGACY_START        =  30,
-        VTE_SGR_SET_FORE_LEGACY_END          =  37,
-        VTE_SGR_SET_FORE_SPEC                =  38,
-        VTE_SGR_SET_BACK_LEGACY_START        =  40,
-        VTE_SGR_SET_BACK_LEGACY_END          =  47,
-        VTE_SGR_SET_BACK_SPEC                =  48,
-        VTE_SGR_SET_OVERLINE                 =  53,
-        VTE_SGR_SET_DECO_SPEC                =  58,
-        VTE_SGR_SET_FORE_LEGACY_BRIGHT_START =  90,
-        VTE_SGR_SET_FORE_LEGACY_BRIGHT_END   =  97,
-        VTE_SGR_SET_BACK_LEGACY_BRIGHT_START = 100,
-        VTE_SGR_SET_BACK_LEGACY_BRIGHT_END   = 107,
-        VTE_SGR_RESET_ALL                    =   0,
-        VTE_SGR_RESET_BOLD_AND_DIM           =  22,
-        VTE_SGR_RESET_ITALIC                 =  23,
-        VTE_SGR_RESET_UNDERLINE              =  24,
-        VTE_SGR_RESET_BLINK                  =  25,
-        VTE_SGR_RESET_REVERSE                =  27,
-        VTE_SGR_RESET_INVISIBLE              =  28,
-        VTE_SGR_RESET_STRIKETHROUGH          =  29,
-        VTE_SGR_RESET_FORE                   =  39,
-        VTE_SGR_RESET_BACK                   =  49,
-        VTE_SGR_RESET_OVERLINE               =  55,
-        VTE_SGR_RESET_DECO                   =  59,
-};
-
-enum {
-        VTE_SGR_COLOR_SPEC_RGB    = 2,
-        VTE_SGR_COLOR_SPEC_LEGACY = 5
-};
-
 struct vte_regex_and_flags {
         VteRegex *regex;
         guint32 match_flags;
@@ -139,72 +62,6 @@ struct vte_match_regex {
         } cursor;
 };
 
-typedef enum _VteCharacterReplacement {
-        VTE_CHARACTER_REPLACEMENT_NONE,
-        VTE_CHARACTER_REPLACEMENT_LINE_DRAWING,
-        VTE_CHARACTER_REPLACEMENT_BRITISH
-} VteCharacterReplacement;
-
-typedef struct _VtePaletteColor {
-	struct {
-		vte::color::rgb color;
-		gboolean is_set;
-	} sources[2];
-} VtePaletteColor;
-
-/* These correspond to the parameters for DECSCUSR (Set cursor style). */
-typedef enum _VteCursorStyle {
-        /* We treat 0 and 1 differently, assuming that the VT510 does so too.
-         *
-         * See, according to the "VT510 Video Terminal Programmer Information",
-         * from vt100.net, paragraph "2.5.7 Cursor Display", there was a menu
-         * item in the "Terminal Set-Up" to set the cursor's style. It looks
-         * like that defaulted to blinking block. So it makes sense for 0 to
-         * mean "set cursor style to default (set by Set-Up)" and 1 to mean
-         * "set cursor style to blinking block", since that default need not be
-         * blinking block. Access to a VT510 is needed to test this theory,
-         * but it seems plausible. And, anyhow, we can even decide we know
-         * better than the VT510 designers! */
-        VTE_CURSOR_STYLE_TERMINAL_DEFAULT = 0,
-        VTE_CURSOR_STYLE_BLINK_BLOCK      = 1,
-        VTE_CURSOR_STYLE_STEADY_BLOCK     = 2,
-        VTE_CURSOR_STYLE_BLINK_UNDERLINE  = 3,
-        VTE_CURSOR_STYLE_STEADY_UNDERLINE = 4,
-        /* *_IBEAM are xterm extensions */
-        VTE_CURSOR_STYLE_BLINK_IBEAM      = 5,
-        VTE_CURSOR_STYLE_STEADY_IBEAM     = 6
-} VteCursorStyle;
-
-struct VteScreen {
-public:
-        VteScreen(gulong max_rows,
-                  bool has_streams) :
-                m_ring{max_rows, has_streams},
-                row_data(&m_ring),
-                cursor{0,0}
-        {
-        }
-
-        vte::base::Ring m_ring; /* buffer contents */
-        VteRing* row_data;
-        VteVisualPosition cursor;  /* absolute value, from the beginning of the terminal history */
-        double scroll_delta{0.0}; /* scroll offset */
-        long insert_delta{0}; /* insertion offset */
-
-        /* Stuff saved along with the cursor */
-        struct {
-                VteVisualPosition cursor;  /* onscreen coordinate, that is, relative to insert_delta */
-                uint8_t modes_ecma;
-                bool reverse_mode;
-                bool origin_mode;
-                VteCell defaults;
-                VteCell color_defaults;
-                VteCell fill_defaults;
-                VteCharacterReplacement character_replacements[2];
-                VteCharacterReplacement *character_replacement;
-        } saved;
-};
-
 enum vte_selection_type {
         selection_type_char,
         selection_type_word,
@@ -234,10 +91,6 @@ typedef enum {
         LAST_VTE_TARGET
 } VteSelectionTarget;
 
-struct vte_scrolling_region {
-        int start, end;
-};
-
 template <class T>
 class ClipboardTextRequestGtk {
 public:
@@ -332,7 +185,7 @@ class Widget;
 
 namespace terminal {
 
-class Terminal {
+class Terminal : public Emulation, public Emulation::Sink {
 public:
         Terminal(vte::platform::Widget* w,
                  VteTerminal *t);
@@ -343,81 +196,54 @@ public:
         VteTerminal *m_terminal;
         GtkWidget *m_widget;
 
-        /* Metric and sizing data: dimensions of the window */
-        vte::grid::row_t m_row_count{VTE_ROWS};
-        vte::grid::column_t m_column_count{VTE_COLUMNS};
-
-        vte::terminal::Tabstops m_tabstops{};
-
-        vte::parser::Parser m_parser; /* control sequence state machine */
-
-        vte::terminal::modes::ECMA m_modes_ecma{};
-        vte::terminal::modes::Private m_modes_private{};
-
 	/* PTY handling data. */
         VtePty *m_pty;
         GIOChannel *m_pty_channel;      /* master channel */
         guint m_pty_input_source;
         guint m_pty_output_source;
         gboolean m_pty_input_active;
+        /* Reading on the I/O thread; see ptyreader.hh */
+        bool m_pty_read_threaded{false};
+        std::unique_ptr<vte::base::PtyReader> m_pty_reader{};
         pid_t m_pty_pid{-1};           /* pid of child process */
         VteReaper *m_reaper;
 
-	/* Queue of chunks of data read from the PTY.
-         * Chunks are inserted at the back, and processed from the front.
-         */
-        std::queue<vte::base::Chunk::unique_type, std::list<vte::base::Chunk::unique_type>> m_incoming_queue;
-
-        vte::base::UTF8Decoder m_utf8_decoder;
-        bool m_using_utf8{true};
         const char *m_encoding;            /* the pty's encoding */
-        int m_utf8_ambiguous_width;
-        gunichar m_last_graphic_character; /* for REP */
         /* Array of dirty rectangles in view coordinates; need to
          * add allocation origin and padding when passing to gtk.
          */
         GArray *m_update_rects;
         gboolean m_invalidated_all;       /* pending refresh of entire terminal */
-        /* If non-nullptr, contains the GList element for @this in g_active_terminals
-         * and means that this terminal is processing data.
+        /* While queued, this terminal is processing data */
+        vte::base::Scheduler::Client m_scheduler_client{scheduler_cb, this};
+        /* While visible, processing and redrawing is driven by the frame
+         * clock instead, see update_frame_driven().
          */
-        GList *m_active_terminals_link;
+        guint m_frame_tick{0};
+        gint64 m_frame_deadline{0};
+        gint64 m_paint_time{0};                        /* µs, smoothed */
+        double m_max_process_time{VTE_MAX_PROCESS_TIME}; /* ms */
         // FIXMEchpe should these two be g[s]size ?
         size_t m_input_bytes;
         glong m_max_input_bytes;
+        /* Reading from the PTY stops while m_incoming_bytes is over the
+         * budget, and resumes once it has come down to half the budget;
+         * see throttle_pty_read().
+         */
+        guint m_input_budget{VTE_INPUT_BUDGET_DEFAULT};
+        bool m_input_throttled{false};
+        gint64 m_input_throttle_start{0};
+        gint64 m_input_throttled_time{0}; /* µs, not counting the current throttling */
 
 	/* Output data queue. */
         VteByteArray *m_outgoing; /* pending input characters */
 
 #ifdef WITH_ICONV
         /* Legacy charset support */
-        GIConv m_incoming_conv{GIConv(-1)};
-        VteByteArray* m_incoming_leftover;
         GIConv m_outgoing_conv{GIConv(-1)};
         VteByteArray *m_conv_buffer;
-
-        void convert_incoming() noexcept;
 #endif
 
-	/* Screen data.  We support the normal screen, and an alternate
-	 * screen, which seems to be a DEC-specific feature. */
-        VteScreen m_normal_screen;
-        VteScreen m_alternate_screen;
-        VteScreen *m_screen; /* points to either m_normal_screen or m_alternate_screen */
-
-        VteCell m_defaults;       /* default characteristics
-                                     for insertion of any new
-                                     characters */
-        VteCell m_color_defaults; /* original defaults
-                                     plus the current
-                                     fore/back */
-        VteCell m_fill_defaults;  /* original defaults
-                                     plus the current
-                                     fore/back with no
-                                     character data */
-        VteCharacterReplacement m_character_replacements[2];  /* charsets in the G0 and G1 slots */
-        VteCharacterReplacement *m_character_replacement;     /* pointer to the active one */
-
         /* Word chars */
         std::string m_word_char_exceptions_string;
         std::u32string m_word_char_exceptions;
@@ -446,19 +272,9 @@ public:
         gboolean m_audible_bell;
         gboolean m_allow_bold;
         gboolean m_bold_is_bright;
-        gboolean m_text_modified_flag;
-        gboolean m_text_inserted_flag;
-        gboolean m_text_deleted_flag;
-        gboolean m_rewrap_on_resize;
 
 	/* Scrolling options. */
-        gboolean m_scroll_on_output;
         gboolean m_scroll_on_keystroke;
-        vte::grid::row_t m_scrollback_lines;
-
-        /* Restricted scrolling */
-        struct vte_scrolling_region m_scrolling_region;     /* the region we scroll in */
-        gboolean m_scrolling_restricted;
 
 	/* Cursor shape, as set via API */
         VteCursorShape m_cursor_shape;
@@ -481,15 +297,10 @@ public:
         bool m_text_to_blink;     /* drawing signals here if it encounters any cell with blink attribute */
         guint m_text_blink_tag;   /* timeout ID for redrawing due to blinking */
 
-        /* DECSCUSR cursor style (shape and blinking possibly overridden
-         * via escape sequence) */
-        VteCursorStyle m_cursor_style;
-
 	/* Input device options. */
         gboolean m_input_enabled;
         time_t m_last_keypress_time;
 
-        MouseTrackingMode m_mouse_tracking_mode{MOUSE_TRACKING_NONE};
         guint m_mouse_pressed_buttons;      /* bits 0, 1, 2 resp. for buttons 1, 2, 3 */
         guint m_mouse_handled_buttons;      /* similar bitmap for buttons we handled ourselves */
         /* The last known position the mouse pointer from an event. We don't store
@@ -554,8 +365,6 @@ public:
         struct _vte_draw *m_draw;
         bool m_clear_background{true};
 
-        VtePaletteColor m_palette[VTE_PALETTE_SIZE];
-
 	/* Mouse cursors. */
         gboolean m_mouse_cursor_over_widget; /* as per enter and leave events */
         gboolean m_mouse_autohide;           /* the API setting */
@@ -569,30 +378,26 @@ public:
 
         gboolean m_accessible_emit;
 
+        /* Fast-forward: while the widget isn't visible, the incoming data
+         * is processed without any of the work that's only needed for
+         * displaying it; see update_fast_forward().
+         */
+        bool m_widget_mapped{false};
+        bool m_widget_obscured{false};
+        bool m_fast_forward_check_selection{false}; /* contents changed under the selection */
+        bool m_fast_forward_text_changed{false};    /* accessible text signals were held back */
+
         /* Adjustment updates pending. */
         gboolean m_adjustment_changed_pending;
         gboolean m_adjustment_value_changed_pending;
         gboolean m_cursor_moved_pending;
         gboolean m_contents_changed_pending;
 
-        std::string m_window_title{};
-        std::string m_current_directory_uri{};
-        std::string m_current_file_uri{};
-        std::string m_window_title_pending{};
-        std::string m_current_directory_uri_pending{};
-        std::string m_current_file_uri_pending{};
-        bool m_window_title_changed{false};
-        bool m_current_directory_uri_changed{false};
-        bool m_current_file_uri_changed{false};
-
-        std::vector<std::string> m_window_title_stack{};
-
 	/* Background */
         double m_background_alpha;
 
         /* Bell */
         int64_t m_bell_timestamp;
-        bool m_bell_pending{false};
 
 	/* Key modifiers. */
         guint m_modifiers;
@@ -623,71 +428,50 @@ public:
         guint m_vscroll_policy : 1;
 
         /* Hyperlinks */
-        gboolean m_allow_hyperlink;
         vte::base::Ring::hyperlink_idx_t m_hyperlink_hover_idx;
         const char *m_hyperlink_hover_uri; /* data is owned by the ring */
-        long m_hyperlink_auto_id;
 
 public:
 
-        // FIXMEchpe inline!
-        /* inline */ VteRowData* ring_insert(vte::grid::row_t position,
-                                       bool fill);
-        /* inline */ VteRowData* ring_append(bool fill);
-        /* inline */ void ring_remove(vte::grid::row_t position);
-        inline VteRowData const* find_row_data(vte::grid::row_t row) const;
-        inline VteRowData* find_row_data_writable(vte::grid::row_t row) const;
-        inline VteCell const* find_charcell(vte::grid::column_t col,
-                                            vte::grid::row_t row) const;
-        inline vte::grid::column_t find_start_column(vte::grid::column_t col,
-                                                     vte::grid::row_t row) const;
-        inline vte::grid::column_t find_end_column(vte::grid::column_t col,
-                                                   vte::grid::row_t row) const;
-
         inline vte::view::coord_t scroll_delta_pixel() const;
         inline vte::grid::row_t pixel_to_row(vte::view::coord_t y) const;
         inline vte::view::coord_t row_to_pixel(vte::grid::row_t row) const;
         inline vte::grid::row_t first_displayed_row() const;
         inline vte::grid::row_t last_displayed_row() const;
 
-        inline VteRowData *insert_rows (guint cnt);
-        VteRowData *ensure_row();
-        VteRowData *ensure_cursor();
-        void update_insert_delta();
-
-        void cleanup_fragments(long start,
-                               long end);
-
-        void cursor_down(bool explicit_sequence);
-        void drop_scrollback();
-
-        void restore_cursor(VteScreen *screen__);
-        void save_cursor(VteScreen *screen__);
 
-        void insert_char(gunichar c,
-                         bool insert,
-                         bool invalidate_now);
-
-        void invalidate_row(vte::grid::row_t row);
         void invalidate_rows(vte::grid::row_t row_start,
-                             vte::grid::row_t row_end /* inclusive */);
+                             vte::grid::row_t row_end /* inclusive */) override;
         void invalidate(vte::grid::span const& s);
         void invalidate_symmetrical_difference(vte::grid::span const& a, vte::grid::span const& b, bool block);
         void invalidate_match_span();
-        void invalidate_all();
+        void invalidate_all() override;
 
         void reset_update_rects();
         bool invalidate_dirty_rects_and_process_updates();
         void time_process_incoming();
         void process_incoming();
         bool process(bool emit_adj_changed);
-        inline bool is_processing() const { return m_active_terminals_link != nullptr; }
+        inline bool is_processing() const { return m_scheduler_client.is_queued(); }
         void start_processing();
+        void stop_processing();
+        void schedule_update();
+        void cancel_updates();
+        bool dispatch(bool update);
+        static bool scheduler_cb(void* data,
+                                 bool update) noexcept;
+        void update_frame_driven();
+        void add_frame_tick();
+        void remove_frame_tick();
+        bool frame_tick(GdkFrameClock* frame_clock);
+        static gboolean frame_tick_cb(GtkWidget* widget,
+                                      GdkFrameClock* frame_clock,
+                                      gpointer data) noexcept;
 
         gssize get_preedit_width(bool left_only);
         gssize get_preedit_length(bool left_only);
 
-        void invalidate_cursor_once(bool periodic = false);
+        void invalidate_cursor_once(bool periodic = false) override;
         void invalidate_cursor_periodic();
         void check_cursor_blink();
         void add_cursor_timeout();
@@ -751,6 +535,9 @@ public:
         void widget_constructed();
         void widget_realize();
         void widget_unrealize();
+        void widget_map();
+        void widget_unmap();
+        void widget_set_obscured(bool obscured);
         void widget_style_updated();
         void widget_focus_in(GdkEventFocus *event);
         void widget_focus_out(GdkEventFocus *event);
@@ -825,8 +612,17 @@ public:
         void pty_scroll_lock_changed(bool locked);
 
         void pty_channel_eof();
+        guint pty_read_budget() const;
         bool pty_io_read(GIOChannel *channel,
                          GIOCondition condition);
+        bool pty_reader_read();
+        void stop_pty_reader();
+        inline bool input_over_budget() const noexcept {
+                return m_input_budget != 0 && m_incoming_bytes >= m_input_budget;
+        }
+        void throttle_pty_read();
+        void check_pty_read_throttle();
+        gint64 input_throttled_time() const noexcept;
         bool pty_io_write(GIOChannel *channel,
                           GIOCondition condition);
 
@@ -882,12 +678,13 @@ public:
         void reset(bool clear_tabstops,
                    bool clear_history,
                    bool from_api = false);
+        void emulation_reset(bool clear_history) override;
 
         void feed(char const* data,
                   gssize length,
                   bool start_processsing_ = true);
         void feed_child(char const *text,
-                        gssize length);
+                        gssize length) override;
         void feed_child_binary(guint8 const* data,
                                gsize length);
 
@@ -948,6 +745,7 @@ public:
 
         void select_all();
         void deselect_all();
+        void deselect_if_changed();
 
         vte::grid::coords resolve_selection_endpoint(vte::grid::halfcoords const& rowcolhalf, bool after) const;
         void resolve_selection();
@@ -956,8 +754,6 @@ public:
         bool cell_is_selected(vte::grid::column_t col,
                               vte::grid::row_t) const;
 
-        void reset_default_attributes(bool reset_hyperlink);
-
         void ensure_font();
         void update_font();
         void apply_font_metrics(int cell_width,
@@ -967,10 +763,6 @@ public:
                                 GtkBorder char_spacing);
 
         void refresh_size();
-        void screen_set_size(VteScreen *screen_,
-                             long old_columns,
-                             long old_rows,
-                             bool do_rewrap);
 
         void vadjustment_value_changed();
 
@@ -978,6 +770,7 @@ public:
         guint translate_ctrlkey(GdkEventKey *event);
 
         void apply_mouse_cursor();
+        void mouse_protocol_changed() override;
         void set_pointer_autohidden(bool autohidden);
 
         void beep();
@@ -987,11 +780,10 @@ public:
                          gssize length);
         void emit_eof();
         void emit_selection_changed();
-        void queue_adjustment_changed();
+        void queue_adjustment_changed() override;
         void queue_adjustment_value_changed(double v);
+        void scroll_delta_changed() override;
         void queue_adjustment_value_changed_clamped(double v);
-        void adjust_adjustments();
-        void adjust_adjustments_full();
 
         void scroll_lines(long lines);
         void scroll_pages(long pages) { scroll_lines(pages * m_row_count); }
@@ -999,7 +791,7 @@ public:
         void maybe_scroll_to_bottom();
 
         void queue_cursor_moved();
-        void queue_contents_changed();
+        void queue_contents_changed() override;
         void queue_eof();
 
         void emit_text_deleted();
@@ -1007,28 +799,31 @@ public:
         void emit_text_modified();
         void emit_text_scrolled(long delta);
         void emit_pending_signals();
+        void update_fast_forward();
+        bool defer_text_signal() noexcept;
         void emit_char_size_changed(int width,
                                     int height);
         void emit_increase_font_size();
         void emit_decrease_font_size();
         void emit_bell();
-        void emit_deiconify_window();
-        void emit_iconify_window();
-        void emit_raise_window();
-        void emit_lower_window();
-        void emit_maximize_window();
-        void emit_refresh_window();
-        void emit_restore_window();
+        void emit_deiconify_window() override;
+        void emit_iconify_window() override;
+        void emit_raise_window() override;
+        void emit_lower_window() override;
+        void emit_maximize_window() override;
+        void emit_refresh_window() override;
+        void emit_restore_window() override;
         void emit_move_window(guint x,
-                              guint y);
+                              guint y) override;
         void emit_resize_window(guint columns,
-                                guint rows);
+                                guint rows) override;
         void emit_copy_clipboard();
         void emit_paste_clipboard();
         void emit_hyperlink_hover_uri_changed(const GdkRectangle *bbox);
 
         void hyperlink_invalidate_and_get_bbox(vte::base::Ring::hyperlink_idx_t idx, GdkRectangle *bbox);
         void hyperlink_hilite_update();
+        void hyperlink_hover_cleared() override;
 
         void match_contents_clear();
         void match_contents_refresh();
@@ -1105,7 +900,7 @@ public:
                                    GdkEventType event_type);
 
         void feed_focus_event(bool in);
-        void feed_focus_event_initial();
+        void feed_focus_event_initial() override;
         void maybe_feed_focus_event(bool in);
 
         bool search_set_regex (VteRegex *regex,
@@ -1130,15 +925,16 @@ public:
         bool process_word_char_exceptions(char const *str,
                                           std::u32string& array) const noexcept;
 
-        long get_cell_height() { ensure_font(); return m_cell_height; }
-        long get_cell_width()  { ensure_font(); return m_cell_width;  }
+        long get_cell_height() override { ensure_font(); return m_cell_height; }
+        long get_cell_width() override  { ensure_font(); return m_cell_width;  }
 
-        vte::color::rgb const* get_color(int entry) const;
-        void set_color(int entry,
-                       int source,
-                       vte::color::rgb const& proposed);
-        void reset_color(int entry,
-                         int source);
+        bool is_mapped() const override;
+        void get_window_origin(int* x,
+                               int* y) override;
+        void get_screen_size(int* width,
+                             int* height) override;
+        void screen_switched() override;
+        void cursor_style_changed() override;
 
         bool set_audible_bell(bool setting);
         bool set_text_blink_mode(VteTextBlinkMode setting);
@@ -1149,7 +945,6 @@ public:
         bool set_bold_is_bright(bool setting);
         bool set_cell_height_scale(double scale);
         bool set_cell_width_scale(double scale);
-        bool set_cjk_ambiguous_width(int width);
         void set_color_background(vte::color::rgb const &color);
         void set_color_bold(vte::color::rgb const& color);
         void reset_color_bold();
@@ -1162,25 +957,20 @@ public:
         void reset_color_highlight_background();
         void set_color_highlight_foreground(vte::color::rgb const& color);
         void reset_color_highlight_foreground();
-        void set_colors(vte::color::rgb const *foreground,
-                        vte::color::rgb const *background,
-                        vte::color::rgb const *palette,
-                        gsize palette_size);
-        void set_colors_default();
         bool set_cursor_blink_mode(VteCursorBlinkMode mode);
         bool set_cursor_shape(VteCursorShape shape);
-        bool set_cursor_style(VteCursorStyle style);
         bool set_delete_binding(VteEraseBinding binding);
         bool set_encoding(char const* codeset);
         bool set_font_desc(PangoFontDescription const* desc);
         bool set_font_scale(double scale);
+        bool set_input_budget(guint bytes);
         bool set_input_enabled(bool enabled);
         bool set_mouse_autohide(bool autohide);
         bool set_pty(VtePty *pty);
         bool set_rewrap_on_resize(bool rewrap);
-        bool set_scrollback_lines(long lines);
         bool set_scroll_on_keystroke(bool scroll);
         bool set_scroll_on_output(bool scroll);
+        bool set_threaded_pty_read(bool threaded);
         bool set_word_char_exceptions(char const* exceptions);
         void set_clear_background(bool setting);
 
@@ -1189,74 +979,6 @@ public:
                                   GCancellable *cancellable,
                                   GError **error);
 
-        inline void ensure_cursor_is_onscreen();
-        inline void home_cursor();
-        inline void clear_screen();
-        inline void clear_current_line();
-        inline void clear_above_current();
-        inline void scroll_text(vte::grid::row_t scroll_amount);
-        inline void switch_screen(VteScreen *new_screen);
-        inline void switch_normal_screen();
-        inline void switch_alternate_screen();
-        inline void save_cursor();
-        inline void restore_cursor();
-
-        inline void set_mode_ecma(vte::parser::Sequence const& seq,
-                                  bool set) noexcept;
-        inline void set_mode_private(vte::parser::Sequence const& seq,
-                                     bool set) noexcept;
-        inline void set_mode_private(int mode,
-                                     bool set) noexcept;
-        inline void save_mode_private(vte::parser::Sequence const& seq,
-                                      bool save) noexcept;
-        void update_mouse_protocol() noexcept;
-
-        inline void set_character_replacements(unsigned slot,
-                                               VteCharacterReplacement replacement);
-        inline void set_character_replacement(unsigned slot);
-        inline void clear_to_bol();
-        inline void clear_below_current();
-        inline void clear_to_eol();
-        inline void delete_character();
-        inline void set_cursor_column(vte::grid::column_t col);
-        inline void set_cursor_column1(vte::grid::column_t col); /* 1-based */
-        inline int get_cursor_column() const noexcept { return CLAMP(m_screen->cursor.col, 0, m_column_count - 1); }
-        inline int get_cursor_column1() const noexcept { return get_cursor_column() + 1; }
-        inline void set_cursor_row(vte::grid::row_t row /* relative to scrolling region */);
-        inline void set_cursor_row1(vte::grid::row_t row /* relative to scrolling region */); /* 1-based */
-        inline int get_cursor_row() const noexcept { return CLAMP(m_screen->cursor.row, 0, m_row_count - 1); }
-        inline int get_cursor_row1() const noexcept { return get_cursor_row() + 1; }
-        inline void set_cursor_coords(vte::grid::row_t row /* relative to scrolling region */,
-                                      vte::grid::column_t column);
-        inline void set_cursor_coords1(vte::grid::row_t row /* relative to scrolling region */,
-                                       vte::grid::column_t column); /* 1-based */
-        inline vte::grid::row_t get_cursor_row_unclamped() const;
-        inline vte::grid::column_t get_cursor_column_unclamped() const;
-        inline void move_cursor_up(vte::grid::row_t rows);
-        inline void move_cursor_down(vte::grid::row_t rows);
-        inline void erase_characters(long count);
-        inline void insert_blank_character();
-
-        template<unsigned int redbits, unsigned int greenbits, unsigned int bluebits>
-        inline bool seq_parse_sgr_color(vte::parser::Sequence const& seq,
-                                        unsigned int& idx,
-                                        uint32_t& color) const noexcept;
-
-        inline void move_cursor_backward(vte::grid::column_t columns);
-        inline void move_cursor_forward(vte::grid::column_t columns);
-        inline void move_cursor_tab_backward(int count = 1);
-        inline void move_cursor_tab_forward(int count = 1);
-        inline void line_feed();
-        inline void erase_in_display(vte::parser::Sequence const& seq);
-        inline void erase_in_line(vte::parser::Sequence const& seq);
-        inline void insert_lines(vte::grid::row_t param);
-        inline void delete_lines(vte::grid::row_t param);
-
-        unsigned int checksum_area(vte::grid::row_t start_row,
-                                   vte::grid::column_t start_col,
-                                   vte::grid::row_t end_row,
-                                   vte::grid::column_t end_col);
-
         void subscribe_accessible_events();
         void select_text(vte::grid::column_t start_col,
                          vte::grid::row_t start_row,
@@ -1264,80 +986,6 @@ public:
                          vte::grid::row_t end_row);
         void select_empty(vte::grid::column_t col,
                           vte::grid::row_t row);
-
-        void send(vte::parser::u8SequenceBuilder const& builder,
-                  bool c1 = true,
-                  vte::parser::u8SequenceBuilder::Introducer introducer = vte::parser::u8SequenceBuilder::Introducer::DEFAULT,
-                  vte::parser::u8SequenceBuilder::ST st = vte::parser::u8SequenceBuilder::ST::DEFAULT) noexcept;
-        void send(vte::parser::Sequence const& seq,
-                  vte::parser::u8SequenceBuilder const& builder) noexcept;
-        void send(unsigned int type,
-                  std::initializer_list<int> params) noexcept;
-        void reply(vte::parser::Sequence const& seq,
-                   unsigned int type,
-                   std::initializer_list<int> params) noexcept;
-        void reply(vte::parser::Sequence const& seq,
-                   unsigned int type,
-                   std::initializer_list<int> params,
-                   vte::parser::ReplyBuilder const& builder) noexcept;
-        #if 0
-        void reply(vte::parser::Sequence const& seq,
-                   unsigned int type,
-                   std::initializer_list<int> params,
-                   std::string const& str) noexcept;
-        #endif
-        void reply(vte::parser::Sequence const& seq,
-                   unsigned int type,
-                   std::initializer_list<int> params,
-                   char const* format,
-                   ...) noexcept G_GNUC_PRINTF(5, 6);
-
-        /* OSC handler helpers */
-        bool get_osc_color_index(int osc,
-                                 int value,
-                                 int& index) const noexcept;
-        void set_color_index(vte::parser::Sequence const& seq,
-                             vte::parser::StringTokeniser::const_iterator& token,
-                             vte::parser::StringTokeniser::const_iterator const& endtoken,
-                             int number,
-                             int index,
-                             int index_fallback,
-                             int osc) noexcept;
-
-        /* OSC handlers */
-        void set_color(vte::parser::Sequence const& seq,
-                       vte::parser::StringTokeniser::const_iterator& token,
-                       vte::parser::StringTokeniser::const_iterator const& endtoken,
-                       int osc) noexcept;
-        void set_special_color(vte::parser::Sequence const& seq,
-                               vte::parser::StringTokeniser::const_iterator& token,
-                               vte::parser::StringTokeniser::const_iterator const& endtoken,
-                               int index,
-                               int index_fallback,
-                               int osc) noexcept;
-        void reset_color(vte::parser::Sequence const& seq,
-                         vte::parser::StringTokeniser::const_iterator& token,
-                         vte::parser::StringTokeniser::const_iterator const& endtoken,
-                         int osc) noexcept;
-        void set_current_directory_uri(vte::parser::Sequence const& seq,
-                                       vte::parser::StringTokeniser::const_iterator& token,
-                                       vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
-        void set_current_file_uri(vte::parser::Sequence const& seq,
-                                  vte::parser::StringTokeniser::const_iterator& token,
-                                  vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
-        void set_current_hyperlink(vte::parser::Sequence const& seq,
-                                   vte::parser::StringTokeniser::const_iterator& token,
-                                   vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
-
-        /* Sequence handlers */
-        bool m_line_wrapped; // signals line wrapped from character insertion
-        // Note: inlining the handlers seems to worsen the performance, so we don't do that
-#define _VTE_CMD(cmd) \
-	/* inline */ void cmd (vte::parser::Sequence const& seq);
-#define _VTE_NOP(cmd) G_GNUC_UNUSED _VTE_CMD(cmd)
-#include "parser-cmd.hh"
-#undef _VTE_CMD
-#undef _VTE_NOP
 };
 
 } // namespace terminal
@@ -1346,17 +994,3 @@ public:
 extern GTimer *process_timer;
 
 vte::terminal::Terminal* _vte_terminal_get_impl(VteTerminal *terminal);
-
-static inline bool
-_vte_double_equal(double a,
-                  double b)
-{
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wfloat-equal"
-        return a == b;
-#pragma GCC diagnostic pop
-}
-
-#define VTE_TEST_FLAG_DECRQCRA (G_GUINT64_CONSTANT(1) << 0)
-
-extern uint64_t g_test_flags;
@@ -43,6 +43,7 @@ static_assert(std::is_trivially_move_assignable<VteCell>::value, "VteCell is not
 typedef struct _VteCells VteCells;
 struct _VteCells {
 	guint32 alloc_len;
+	guint32 padding[3]; /* so that the cells are 16-byte aligned */
 	VteCell cells[1];
 };
 
@@ -74,6 +75,34 @@ _vte_cells_free (VteCells *cells)
 	g_free (cells);
 }
 
+/* Sets @n cells from @cells on to *@cell.
+ *
+ * Copying a cell at a time reloads *@cell for every store (it could alias
+ * @cells), and a VteCell doesn't fit one store. Four cells fill a whole
+ * number of 16-byte vectors though, so copy the pattern a block of four at
+ * a time, letting memcpy with a constant size use the widest stores; and
+ * since the cell arrays are aligned, up to three single cells first make
+ * those stores aligned too.
+ */
+static inline void
+_vte_cells_fill (VteCell *cells, const VteCell *cell, gulong n)
+{
+	VteCell pattern[4];
+	guchar *p;
+	gsize len, i;
+
+	for (; n > 0 && (GPOINTER_TO_SIZE (cells) & 15) != 0; n--)
+		*cells++ = *cell;
+
+	pattern[0] = pattern[1] = pattern[2] = pattern[3] = *cell;
+	p = (guchar *) cells;
+	len = n * sizeof (VteCell);
+
+	for (i = 0; i + sizeof (pattern) <= len; i += sizeof (pattern))
+		memcpy (p + i, pattern, sizeof (pattern));
+	memcpy (p + i, pattern, len - i);
+}
+
 
 /*
  * VteRowData: A row's data
@@ -131,6 +160,17 @@ _vte_row_data_insert (VteRowData *row, gulong col, const VteCell *cell)
 	row->len++;
 }
 
+void
+_vte_row_data_insert_n (VteRowData *row, gulong col, const VteCell *cell, gulong n)
+{
+	if (G_UNLIKELY (!_vte_row_data_ensure (row, row->len + n)))
+		return;
+
+	memmove (&row->cells[col + n], &row->cells[col], (row->len - col) * sizeof (VteCell));
+	_vte_cells_fill (&row->cells[col], cell, n);
+	row->len += n;
+}
+
 void _vte_row_data_append (VteRowData *row, const VteCell *cell)
 {
 	if (G_UNLIKELY (!_vte_row_data_ensure (row, row->len + 1)))
@@ -154,18 +194,38 @@ void _vte_row_data_remove (VteRowData *row, gulong col)
 void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len)
 {
 	if (row->len < len) {
-		gulong i;
-
 		if (G_UNLIKELY (!_vte_row_data_ensure (row, len)))
 			return;
 
-		for (i = row->len; i < len; i++)
-			row->cells[i] = *cell;
+		_vte_cells_fill (&row->cells[row->len], cell, len - row->len);
 
 		row->len = len;
 	}
 }
 
+/* Sets the cells from @start up to @end to *@cell, extending the row
+ * (with *@cell, also before @start) if it is shorter than @end.
+ */
+void _vte_row_data_fill_range (VteRowData *row, const VteCell *cell, gulong start, gulong end)
+{
+	if (G_UNLIKELY (start >= end))
+		return;
+
+	if (row->len < end) {
+		if (G_LIKELY (_vte_row_data_ensure (row, end))) {
+			start = MIN (start, row->len);
+			row->len = end;
+		} else {
+			/* Too long; just overwrite what's there */
+			end = row->len;
+			if (start >= end)
+				return;
+		}
+	}
+
+	_vte_cells_fill (&row->cells[start], cell, end - start);
+}
+
 void _vte_row_data_shrink (VteRowData *row, gulong max_len)
 {
 	if (max_len < row->len)
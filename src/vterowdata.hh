@@ -75,9 +75,11 @@ void _vte_row_data_init (VteRowData *row);
 void _vte_row_data_clear (VteRowData *row);
 void _vte_row_data_fini (VteRowData *row);
 void _vte_row_data_insert (VteRowData *row, gulong col, const VteCell *cell);
+void _vte_row_data_insert_n (VteRowData *row, gulong col, const VteCell *cell, gulong n);
 void _vte_row_data_append (VteRowData *row, const VteCell *cell);
 void _vte_row_data_remove (VteRowData *row, gulong col);
 void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len);
+void _vte_row_data_fill_range (VteRowData *row, const VteCell *cell, gulong start, gulong end);
 void _vte_row_data_shrink (VteRowData *row, gulong max_len);
 
 G_END_DECLS
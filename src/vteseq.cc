@@ -30,9 +30,8 @@
 
 #include <glib.h>
 
-#include <vte/vte.h>
-#include "vteinternal.hh"
-#include "vtegtk.hh"
+#include "emulation.hh"
+#include "vte/vteversion.h"
 #include "caps.hh"
 #include "debug.h"
 
@@ -40,214 +39,13 @@
 #define ST_C0 _VTE_CAP_ST
 
 #include <algorithm>
+#include <vector>
 
 using namespace std::literals;
 
-void
-vte::parser::Sequence::print() const noexcept
-{
-#ifdef VTE_DEBUG
-        auto c = m_seq != nullptr ? terminator() : 0;
-        char c_buf[7];
-        g_snprintf(c_buf, sizeof(c_buf), "%lc", c);
-        g_printerr("%s:%s [%s]", type_string(), command_string(),
-                   g_unichar_isprint(c) ? c_buf : _vte_debug_sequence_to_string(c_buf, -1));
-        if (m_seq != nullptr && m_seq->n_args > 0) {
-                g_printerr("[ ");
-                for (unsigned int i = 0; i < m_seq->n_args; i++) {
-                        if (i > 0)
-                                g_print(", ");
-                        g_printerr("%d", vte_seq_arg_value(m_seq->args[i]));
-                }
-                g_printerr(" ]");
-        }
-        if (m_seq->type == VTE_SEQ_OSC) {
-                char* str = string_param();
-                g_printerr(" \"%s\"", str);
-                g_free(str);
-        }
-        g_printerr("\n");
-#endif
-}
-
-char const*
-vte::parser::Sequence::type_string() const
-{
-        if (G_UNLIKELY(m_seq == nullptr))
-                return "(nil)";
-
-        switch (type()) {
-        case VTE_SEQ_NONE:    return "NONE";
-        case VTE_SEQ_IGNORE:  return "IGNORE";
-        case VTE_SEQ_GRAPHIC: return "GRAPHIC";
-        case VTE_SEQ_CONTROL: return "CONTROL";
-        case VTE_SEQ_ESCAPE:  return "ESCAPE";
-        case VTE_SEQ_CSI:     return "CSI";
-        case VTE_SEQ_DCS:     return "DCS";
-        case VTE_SEQ_OSC:     return "OSC";
-        default:
-                g_assert(false);
-                return nullptr;
-        }
-}
-
-char const*
-vte::parser::Sequence::command_string() const
-{
-        if (G_UNLIKELY(m_seq == nullptr))
-                return "(nil)";
-
-        switch (command()) {
-#define _VTE_CMD(cmd) case VTE_CMD_##cmd: return #cmd;
-#define _VTE_NOP(cmd)
-#include "parser-cmd.hh"
-#undef _VTE_CMD
-#undef _VTE_NOP
-        default:
-                static char buf[32];
-                snprintf(buf, sizeof(buf), "NOP OR UNKOWN(%u)", command());
-                return buf;
-        }
-}
-
-// FIXMEchpe optimise this
-std::string
-vte::parser::Sequence::string_utf8() const noexcept
-{
-        std::string str;
-
-        size_t len;
-        auto buf = vte_seq_string_get(&m_seq->arg_str, &len);
-
-        char u[6];
-        for (size_t i = 0; i < len; ++i) {
-                auto ulen = g_unichar_to_utf8(buf[i], u);
-                str.append((char const*)u, ulen);
-        }
-
-        return str;
-}
-
-/* A couple are duplicated from vte.c, to keep them static... */
-
-/* Check how long a string of unichars is.  Slow version. */
-static gsize
-vte_unichar_strlen(gunichar const* c)
-{
-	gsize i;
-	for (i = 0; c[i] != 0; i++) ;
-	return i;
-}
-
-/* Convert a wide character string to a multibyte string */
-/* Simplified from glib's g_ucs4_to_utf8() to simply allocate the maximum
- * length instead of walking the input twice.
- */
-char*
-vte::parser::Sequence::ucs4_to_utf8(gunichar const* str,
-                                    ssize_t len) const noexcept
-{
-        if (len < 0)
-                len = vte_unichar_strlen(str);
-        auto outlen = (len * VTE_UTF8_BPC) + 1;
-
-        auto result = (char*)g_try_malloc(outlen);
-        if (result == nullptr)
-                return nullptr;
-
-        auto end = str + len;
-        auto p = result;
-        for (auto i = str; i < end; i++)
-                p += g_unichar_to_utf8(*i, p);
-        *p = '\0';
-
-        return result;
-}
-
 namespace vte {
 namespace terminal {
 
-/* Emit a "bell" signal. */
-void
-Terminal::emit_bell()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `bell'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_BELL], 0);
-}
-
-/* Emit a "deiconify-window" signal. */
-void
-Terminal::emit_deiconify_window()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `deiconify-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_DEICONIFY_WINDOW], 0);
-}
-
-/* Emit a "iconify-window" signal. */
-void
-Terminal::emit_iconify_window()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `iconify-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_ICONIFY_WINDOW], 0);
-}
-
-/* Emit a "raise-window" signal. */
-void
-Terminal::emit_raise_window()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `raise-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_RAISE_WINDOW], 0);
-}
-
-/* Emit a "lower-window" signal. */
-void
-Terminal::emit_lower_window()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `lower-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_LOWER_WINDOW], 0);
-}
-
-/* Emit a "maximize-window" signal. */
-void
-Terminal::emit_maximize_window()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `maximize-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_MAXIMIZE_WINDOW], 0);
-}
-
-/* Emit a "refresh-window" signal. */
-void
-Terminal::emit_refresh_window()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `refresh-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_REFRESH_WINDOW], 0);
-}
-
-/* Emit a "restore-window" signal. */
-void
-Terminal::emit_restore_window()
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `restore-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_RESTORE_WINDOW], 0);
-}
-
-/* Emit a "move-window" signal.  (Pixels.) */
-void
-Terminal::emit_move_window(guint x,
-                                     guint y)
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `move-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_MOVE_WINDOW], 0, x, y);
-}
-
-/* Emit a "resize-window" signal.  (Grid size.) */
-void
-Terminal::emit_resize_window(guint columns,
-                                       guint rows)
-{
-        _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `resize-window'.\n");
-        g_signal_emit(m_terminal, signals[SIGNAL_RESIZE_WINDOW], 0, columns, rows);
-}
 
 /* Some common functions */
 
@@ -267,20 +65,20 @@ Terminal::emit_resize_window(guint columns,
  * sequences that disable the special cased mode in xterm).  (Bug 731155.)
  */
 void
-Terminal::ensure_cursor_is_onscreen()
+Emulation::ensure_cursor_is_onscreen()
 {
         if (G_UNLIKELY (m_screen->cursor.col >= m_column_count))
                 m_screen->cursor.col = m_column_count - 1;
 }
 
 void
-Terminal::home_cursor()
+Emulation::home_cursor()
 {
         set_cursor_coords(0, 0);
 }
 
 void
-Terminal::clear_screen()
+Emulation::clear_screen()
 {
         auto row = m_screen->cursor.row - m_screen->insert_delta;
         auto initial = _vte_ring_next(m_screen->row_data);
@@ -293,14 +91,14 @@ Terminal::clear_screen()
         m_screen->cursor.row = row + m_screen->insert_delta;
         adjust_adjustments();
 	/* Redraw everything. */
-        invalidate_all();
+        m_sink->invalidate_all();
 	/* We've modified the display.  Make a note of it. */
         m_text_deleted_flag = TRUE;
 }
 
 /* Clear the current line. */
 void
-Terminal::clear_current_line()
+Emulation::clear_current_line()
 {
 	VteRowData *rowdata;
 
@@ -316,7 +114,7 @@ Terminal::clear_current_line()
                 _vte_row_data_fill (rowdata, &m_fill_defaults, m_column_count);
 		rowdata->attr.soft_wrapped = 0;
 		/* Repaint this row. */
-                invalidate_row(m_screen->cursor.row);
+                m_sink->invalidate_row(m_screen->cursor.row);
 	}
 
 	/* We've modified the display.  Make a note of it. */
@@ -325,7 +123,7 @@ Terminal::clear_current_line()
 
 /* Clear above the current line. */
 void
-Terminal::clear_above_current()
+Emulation::clear_above_current()
 {
 	/* If the cursor is actually on the screen, clear data in the row
 	 * which corresponds to the cursor. */
@@ -340,7 +138,7 @@ Terminal::clear_above_current()
                         _vte_row_data_fill (rowdata, &m_fill_defaults, m_column_count);
 			rowdata->attr.soft_wrapped = 0;
 			/* Repaint the row. */
-                        invalidate_row(i);
+                        m_sink->invalidate_row(i);
 		}
 	}
 	/* We've modified the display.  Make a note of it. */
@@ -349,7 +147,7 @@ Terminal::clear_above_current()
 
 /* Scroll the text, but don't move the cursor.  Negative = up, positive = down. */
 void
-Terminal::scroll_text(vte::grid::row_t scroll_amount)
+Emulation::scroll_text(vte::grid::row_t scroll_amount)
 {
         vte::grid::row_t start, end;
         if (m_scrolling_restricted) {
@@ -360,23 +158,10 @@ Terminal::scroll_text(vte::grid::row_t scroll_amount)
                 end = start + m_row_count - 1;
 	}
 
-        while (_vte_ring_next(m_screen->row_data) <= end)
-                ring_append(false);
-
-	if (scroll_amount > 0) {
-		for (auto i = 0; i < scroll_amount; i++) {
-                        ring_remove(end);
-                        ring_insert(start, true);
-		}
-	} else {
-		for (auto i = 0; i < -scroll_amount; i++) {
-                        ring_remove(start);
-                        ring_insert(end, true);
-		}
-	}
+        ring_rotate(start, end, scroll_amount);
 
 	/* Update the display. */
-        invalidate_rows(start, end);
+        m_sink->invalidate_rows(start, end);
 
 	/* Adjust the scrollbars if necessary. */
         adjust_adjustments();
@@ -387,27 +172,27 @@ Terminal::scroll_text(vte::grid::row_t scroll_amount)
 }
 
 void
-Terminal::restore_cursor()
+Emulation::restore_cursor()
 {
         restore_cursor(m_screen);
         ensure_cursor_is_onscreen();
 }
 
 void
-Terminal::save_cursor()
+Emulation::save_cursor()
 {
         save_cursor(m_screen);
 }
 
 /* Switch to normal screen. */
 void
-Terminal::switch_normal_screen()
+Emulation::switch_normal_screen()
 {
         switch_screen(&m_normal_screen);
 }
 
 void
-Terminal::switch_screen(VteScreen *new_screen)
+Emulation::switch_screen(VteScreen *new_screen)
 {
         /* if (new_screen == m_screen) return; ? */
 
@@ -415,10 +200,9 @@ Terminal::switch_screen(VteScreen *new_screen)
          * wouldn't make sense and could lead to crashes.
          * Ideally we'd carry the target URI itself, but I'm just lazy.
          * Also, run a GC before we switch away from that screen. */
-        m_hyperlink_hover_idx = _vte_ring_get_hyperlink_at_position(m_screen->row_data, -1, -1, true, NULL);
-        g_assert (m_hyperlink_hover_idx == 0);
-        m_hyperlink_hover_uri = NULL;
-        emit_hyperlink_hover_uri_changed(NULL);  /* FIXME only emit if really changed */
+        auto const hover_idx = _vte_ring_get_hyperlink_at_position(m_screen->row_data, -1, -1, true, NULL);
+        g_assert (hover_idx == 0);
+        m_sink->hyperlink_hover_cleared();
         m_defaults.attr.hyperlink_idx = _vte_ring_get_hyperlink_idx(m_screen->row_data, NULL);
         g_assert (m_defaults.attr.hyperlink_idx == 0);
 
@@ -433,13 +217,13 @@ Terminal::switch_screen(VteScreen *new_screen)
 
 /* Switch to alternate screen. */
 void
-Terminal::switch_alternate_screen()
+Emulation::switch_alternate_screen()
 {
         switch_screen(&m_alternate_screen);
 }
 
 void
-Terminal::set_mode_ecma(vte::parser::Sequence const& seq,
+Emulation::set_mode_ecma(vte::parser::Sequence const& seq,
                                   bool set) noexcept
 {
         auto const n_params = seq.size();
@@ -460,7 +244,7 @@ Terminal::set_mode_ecma(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::update_mouse_protocol() noexcept
+Emulation::update_mouse_protocol() noexcept
 {
         if (m_modes_private.XTERM_MOUSE_ANY_EVENT())
                 m_mouse_tracking_mode = MOUSE_TRACKING_ALL_MOTION_TRACKING;
@@ -475,17 +259,15 @@ Terminal::update_mouse_protocol() noexcept
         else
                 m_mouse_tracking_mode = MOUSE_TRACKING_NONE;
 
-        m_mouse_smooth_scroll_delta = 0.0;
-
         /* Mouse pointer might change */
-        apply_mouse_cursor();
+        m_sink->mouse_protocol_changed();
 
         _vte_debug_print(VTE_DEBUG_MODES,
                          "Mouse protocol is now %d\n", m_mouse_tracking_mode);
 }
 
 void
-Terminal::set_mode_private(int mode,
+Emulation::set_mode_private(int mode,
                                      bool set) noexcept
 {
         /* Pre actions */
@@ -507,14 +289,14 @@ Terminal::set_mode_private(int mode,
                  * the status line if host-writable.
                  */
                 if (m_modes_private.XTERM_DECCOLM()) {
-                        emit_resize_window(set ? 132 : 80, m_row_count);
+                        m_sink->emit_resize_window(set ? 132 : 80, m_row_count);
                         clear_screen();
                         home_cursor();
                 }
                 break;
 
         case vte::terminal::modes::Private::eDEC_REVERSE_IMAGE:
-                invalidate_all();
+                m_sink->invalidate_all();
                 break;
 
         case vte::terminal::modes::Private::eDEC_ORIGIN:
@@ -554,11 +336,10 @@ Terminal::set_mode_private(int mode,
                 }
 
                 /* Reset scrollbars and repaint everything. */
-                gtk_adjustment_set_value(m_vadjustment,
-                                         m_screen->scroll_delta);
+                m_sink->screen_switched();
                 set_scrollback_lines(m_scrollback_lines);
-                queue_contents_changed();
-                invalidate_all();
+                m_sink->queue_contents_changed();
+                m_sink->invalidate_all();
                 break;
 
         case vte::terminal::modes::Private::eXTERM_SAVE_CURSOR:
@@ -581,7 +362,7 @@ Terminal::set_mode_private(int mode,
 
         case vte::terminal::modes::Private::eXTERM_FOCUS:
                 if (set)
-                        feed_focus_event_initial();
+                        m_sink->feed_focus_event_initial();
                 break;
 
         default:
@@ -590,7 +371,7 @@ Terminal::set_mode_private(int mode,
 }
 
 void
-Terminal::set_mode_private(vte::parser::Sequence const& seq,
+Emulation::set_mode_private(vte::parser::Sequence const& seq,
                                      bool set) noexcept
 {
         auto const n_params = seq.size();
@@ -611,7 +392,7 @@ Terminal::set_mode_private(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::save_mode_private(vte::parser::Sequence const& seq,
+Emulation::save_mode_private(vte::parser::Sequence const& seq,
                                       bool save) noexcept
 {
         auto const n_params = seq.size();
@@ -647,7 +428,7 @@ Terminal::save_mode_private(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::set_character_replacement(unsigned slot)
+Emulation::set_character_replacement(unsigned slot)
 {
         g_assert(slot < G_N_ELEMENTS(m_character_replacements));
         m_character_replacement = &m_character_replacements[slot];
@@ -655,7 +436,7 @@ Terminal::set_character_replacement(unsigned slot)
 
 /* Clear from the cursor position (inclusive!) to the beginning of the line. */
 void
-Terminal::clear_to_bol()
+Emulation::clear_to_bol()
 {
         ensure_cursor_is_onscreen();
 
@@ -664,21 +445,10 @@ Terminal::clear_to_bol()
         /* Clean up Tab/CJK fragments. */
         cleanup_fragments(0, m_screen->cursor.col + 1);
 	/* Clear the data up to the current column with the default
-	 * attributes.  If there is no such character cell, we need
-	 * to add one. */
-        vte::grid::column_t i;
-        for (i = 0; i <= m_screen->cursor.col; i++) {
-                if (i < (glong) _vte_row_data_length (rowdata)) {
-			/* Muck with the cell in this location. */
-                        auto pcell = _vte_row_data_get_writable(rowdata, i);
-                        *pcell = m_color_defaults;
-		} else {
-			/* Add new cells until we have one here. */
-                        _vte_row_data_append (rowdata, &m_color_defaults);
-		}
-	}
+	 * attributes, adding cells if the row is shorter. */
+        _vte_row_data_fill_range(rowdata, &m_color_defaults, 0, m_screen->cursor.col + 1);
 	/* Repaint this row. */
-        invalidate_row(m_screen->cursor.row);
+        m_sink->invalidate_row(m_screen->cursor.row);
 
 	/* We've modified the display.  Make a note of it. */
         m_text_deleted_flag = TRUE;
@@ -686,7 +456,7 @@ Terminal::clear_to_bol()
 
 /* Clear to the right of the cursor and below the current line. */
 void
-Terminal::clear_below_current()
+Emulation::clear_below_current()
 {
         ensure_cursor_is_onscreen();
 
@@ -733,7 +503,7 @@ Terminal::clear_below_current()
 		}
 		rowdata->attr.soft_wrapped = 0;
 		/* Repaint this row. */
-                invalidate_row(i);
+                m_sink->invalidate_row(i);
 	}
 
 	/* We've modified the display.  Make a note of it. */
@@ -742,7 +512,7 @@ Terminal::clear_below_current()
 
 /* Clear from the cursor position to the end of the line. */
 void
-Terminal::clear_to_eol()
+Emulation::clear_to_eol()
 {
 	/* If we were to strictly emulate xterm, we'd ensure the cursor is onscreen.
 	 * But due to https://bugzilla.gnome.org/show_bug.cgi?id=740789 we intentionally
@@ -772,17 +542,17 @@ Terminal::clear_to_eol()
 	}
 	rowdata->attr.soft_wrapped = 0;
 	/* Repaint this row. */
-        invalidate_row(m_screen->cursor.row);
+        m_sink->invalidate_row(m_screen->cursor.row);
 }
 
 /*
- * Terminal::set_cursor_column:
+ * Emulation::set_cursor_column:
  * @col: the column. 0-based from 0 to m_column_count - 1
  *
  * Sets the cursor column to @col, clamped to the range 0..m_column_count-1.
  */
 void
-Terminal::set_cursor_column(vte::grid::column_t col)
+Emulation::set_cursor_column(vte::grid::column_t col)
 {
 	_vte_debug_print(VTE_DEBUG_PARSER,
                          "Moving cursor to column %ld.\n", col);
@@ -790,20 +560,20 @@ Terminal::set_cursor_column(vte::grid::column_t col)
 }
 
 void
-Terminal::set_cursor_column1(vte::grid::column_t col)
+Emulation::set_cursor_column1(vte::grid::column_t col)
 {
         set_cursor_column(col - 1);
 }
 
 /*
- * Terminal::set_cursor_row:
+ * Emulation::set_cursor_row:
  * @row: the row. 0-based and relative to the scrolling region
  *
  * Sets the cursor row to @row. @row is relative to the scrolling region
  * (0 if restricted scrolling is off).
  */
 void
-Terminal::set_cursor_row(vte::grid::row_t row)
+Emulation::set_cursor_row(vte::grid::row_t row)
 {
         vte::grid::row_t start_row, end_row;
         if (m_modes_private.DEC_ORIGIN() &&
@@ -821,19 +591,19 @@ Terminal::set_cursor_row(vte::grid::row_t row)
 }
 
 void
-Terminal::set_cursor_row1(vte::grid::row_t row)
+Emulation::set_cursor_row1(vte::grid::row_t row)
 {
         set_cursor_row(row - 1);
 }
 
 /*
- * Terminal::get_cursor_row:
+ * Emulation::get_cursor_row:
  *
  * Returns: the relative cursor row, 0-based and relative to the scrolling region
  * if set (regardless of origin mode).
  */
 vte::grid::row_t
-Terminal::get_cursor_row_unclamped() const
+Emulation::get_cursor_row_unclamped() const
 {
         auto row = m_screen->cursor.row - m_screen->insert_delta;
         /* Note that we do NOT check DEC_ORIGIN mode here! */
@@ -844,13 +614,13 @@ Terminal::get_cursor_row_unclamped() const
 }
 
 vte::grid::column_t
-Terminal::get_cursor_column_unclamped() const
+Emulation::get_cursor_column_unclamped() const
 {
         return m_screen->cursor.col;
 }
 
 /*
- * Terminal::set_cursor_coords:
+ * Emulation::set_cursor_coords:
  * @row: the row. 0-based and relative to the scrolling region
  * @col: the column. 0-based from 0 to m_column_count - 1
  *
@@ -860,7 +630,7 @@ Terminal::get_cursor_column_unclamped() const
  * Sets the cursor column to @col, clamped to the range 0..m_column_count-1.
  */
 void
-Terminal::set_cursor_coords(vte::grid::row_t row,
+Emulation::set_cursor_coords(vte::grid::row_t row,
                                       vte::grid::column_t column)
 {
         set_cursor_column(column);
@@ -868,7 +638,7 @@ Terminal::set_cursor_coords(vte::grid::row_t row,
 }
 
 void
-Terminal::set_cursor_coords1(vte::grid::row_t row,
+Emulation::set_cursor_coords1(vte::grid::row_t row,
                                       vte::grid::column_t column)
 {
         set_cursor_column1(column);
@@ -877,7 +647,7 @@ Terminal::set_cursor_coords1(vte::grid::row_t row,
 
 /* Delete a character at the current cursor position. */
 void
-Terminal::delete_character()
+Emulation::delete_character()
 {
 	VteRowData *rowdata;
 	long col;
@@ -904,7 +674,7 @@ Terminal::delete_character()
 			}
                         rowdata->attr.soft_wrapped = 0;
 			/* Repaint this row. */
-                        invalidate_row(m_screen->cursor.row);
+                        m_sink->invalidate_row(m_screen->cursor.row);
 		}
 	}
 
@@ -913,7 +683,7 @@ Terminal::delete_character()
 }
 
 void
-Terminal::move_cursor_down(vte::grid::row_t rows)
+Emulation::move_cursor_down(vte::grid::row_t rows)
 {
         rows = CLAMP(rows, 1, m_row_count);
 
@@ -932,11 +702,8 @@ Terminal::move_cursor_down(vte::grid::row_t rows)
 }
 
 void
-Terminal::erase_characters(long count)
+Emulation::erase_characters(long count)
 {
-	VteCell *cell;
-	long col, i;
-
         ensure_cursor_is_onscreen();
 
 	/* Clear out the given number of characters. */
@@ -945,43 +712,20 @@ Terminal::erase_characters(long count)
 		g_assert(rowdata != NULL);
                 /* Clean up Tab/CJK fragments. */
                 cleanup_fragments(m_screen->cursor.col, m_screen->cursor.col + count);
-		/* Write over the characters.  (If there aren't enough, we'll
-		 * need to create them.) */
-		for (i = 0; i < count; i++) {
-                        col = m_screen->cursor.col + i;
-			if (col >= 0) {
-				if (col < (glong) _vte_row_data_length (rowdata)) {
-					/* Replace this cell with the current
-					 * defaults. */
-					cell = _vte_row_data_get_writable (rowdata, col);
-                                        *cell = m_color_defaults;
-				} else {
-					/* Add new cells until we have one here. */
-                                        _vte_row_data_fill (rowdata, &m_color_defaults, col + 1);
-				}
-			}
-		}
+		/* Write over the characters with the current defaults.  (If
+		 * there aren't enough, we'll need to create them.) */
+                _vte_row_data_fill_range(rowdata, &m_color_defaults,
+                                         m_screen->cursor.col, m_screen->cursor.col + count);
 		/* Repaint this row. */
-                invalidate_row(m_screen->cursor.row);
+                m_sink->invalidate_row(m_screen->cursor.row);
 	}
 
 	/* We've modified the display.  Make a note of it. */
         m_text_deleted_flag = TRUE;
 }
 
-/* Insert a blank character. */
-void
-Terminal::insert_blank_character()
-{
-        ensure_cursor_is_onscreen();
-
-        auto save = m_screen->cursor;
-        insert_char(' ', true, true);
-        m_screen->cursor = save;
-}
-
 void
-Terminal::move_cursor_backward(vte::grid::column_t columns)
+Emulation::move_cursor_backward(vte::grid::column_t columns)
 {
         ensure_cursor_is_onscreen();
 
@@ -991,7 +735,7 @@ Terminal::move_cursor_backward(vte::grid::column_t columns)
 }
 
 void
-Terminal::move_cursor_forward(vte::grid::column_t columns)
+Emulation::move_cursor_forward(vte::grid::column_t columns)
 {
         columns = CLAMP(columns, 1, m_column_count);
 
@@ -1006,14 +750,14 @@ Terminal::move_cursor_forward(vte::grid::column_t columns)
 }
 
 void
-Terminal::line_feed()
+Emulation::line_feed()
 {
         ensure_cursor_is_onscreen();
         cursor_down(true);
 }
 
 void
-Terminal::move_cursor_tab_backward(int count)
+Emulation::move_cursor_tab_backward(int count)
 {
         if (count == 0)
                 return;
@@ -1023,7 +767,7 @@ Terminal::move_cursor_tab_backward(int count)
 }
 
 void
-Terminal::move_cursor_tab_forward(int count)
+Emulation::move_cursor_tab_forward(int count)
 {
         if (count == 0)
                 return;
@@ -1076,12 +820,12 @@ Terminal::move_cursor_tab_forward(int count)
                 }
         }
 
-        invalidate_row(m_screen->cursor.row);
+        m_sink->invalidate_row(m_screen->cursor.row);
         m_screen->cursor.col = newcol;
 }
 
 void
-Terminal::move_cursor_up(vte::grid::row_t rows)
+Emulation::move_cursor_up(vte::grid::row_t rows)
 {
         // FIXMEchpe allow 0 as no-op?
         rows = CLAMP(rows, 1, m_row_count);
@@ -1100,110 +844,8 @@ Terminal::move_cursor_up(vte::grid::row_t rows)
         m_screen->cursor.row = MAX(m_screen->cursor.row - rows, start);
 }
 
-/*
- * Parse parameters of SGR 38, 48 or 58, starting at @index within @seq.
- * Returns %true if @seq contained colour parameters at @index, or %false otherwise.
- * In each case, @idx is set to last consumed parameter,
- * and the colour is returned in @color.
- *
- * The format looks like:
- * - 256 color indexed palette:
- *   - ^[[38:5:INDEXm  (de jure standard: ITU-T T.416 / ISO/IEC 8613-6; we also allow and ignore further parameters)
- *   - ^[[38;5;INDEXm  (de facto standard, understood by probably all terminal emulators that support 256 colors)
- * - true colors:
- *   - ^[[38:2:[id]:RED:GREEN:BLUE[:...]m  (de jure standard: ITU-T T.416 / ISO/IEC 8613-6)
- *   - ^[[38:2:RED:GREEN:BLUEm             (common misinterpretation of the standard, FIXME: stop supporting it at some point)
- *   - ^[[38;2;RED;GREEN;BLUEm             (de facto standard, understood by probably all terminal emulators that support true colors)
- * See bugs 685759 and 791456 for details.
- */
-template<unsigned int redbits, unsigned int greenbits, unsigned int bluebits>
-bool
-Terminal::seq_parse_sgr_color(vte::parser::Sequence const& seq,
-                                        unsigned int &idx,
-                                        uint32_t& color) const noexcept
-{
-        /* Note that we don't have to check if the index is after the end of
-         * the parameters list, since dereferencing is safe and returns -1.
-         */
-
-        if (seq.param_nonfinal(idx)) {
-                /* Colon version */
-                switch (seq.param(++idx)) {
-                case VTE_SGR_COLOR_SPEC_RGB: {
-                        auto const n = seq.next(idx) - idx;
-                        if (n < 4)
-                                return false;
-                        if (n > 4) {
-                                /* Consume a colourspace parameter; it must be default */
-                                if (!seq.param_default(++idx))
-                                        return false;
-                        }
-
-                        int red = seq.param(++idx);
-                        int green = seq.param(++idx);
-                        int blue = seq.param(++idx);
-                        if ((red & 0xff) != red ||
-                            (green & 0xff) != green ||
-                            (blue & 0xff) != blue)
-                                return false;
-
-                        color = VTE_RGB_COLOR(redbits, greenbits, bluebits, red, green, blue);
-                        return true;
-                }
-                case VTE_SGR_COLOR_SPEC_LEGACY: {
-                        auto const n = seq.next(idx) - idx;
-                        if (n < 2)
-                                return false;
-
-                        int v = seq.param(++idx);
-                        if (v < 0 || v >= 256)
-                                return false;
-
-                        color = (uint32_t)v;
-                        return true;
-                }
-                }
-        } else {
-                /* Semicolon version */
-
-                idx = seq.next(idx);
-                switch (seq.param(idx)) {
-                case VTE_SGR_COLOR_SPEC_RGB: {
-                        /* Consume 3 more parameters */
-                        idx = seq.next(idx);
-                        int red = seq.param(idx);
-                        idx = seq.next(idx);
-                        int green = seq.param(idx);
-                        idx = seq.next(idx);
-                        int blue = seq.param(idx);
-
-                        if ((red & 0xff) != red ||
-                            (green & 0xff) != green ||
-                            (blue & 0xff) != blue)
-                                return false;
-
-                        color = VTE_RGB_COLOR(redbits, greenbits, bluebits, red, green, blue);
-                        return true;
-                }
-                case VTE_SGR_COLOR_SPEC_LEGACY: {
-                        /* Consume 1 more parameter */
-                        idx = seq.next(idx);
-                        int v = seq.param(idx);
-
-                        if ((v & 0xff) != v)
-                                return false;
-
-                        color = (uint32_t)v;
-                        return true;
-                }
-                }
-        }
-
-        return false;
-}
-
 void
-Terminal::erase_in_display(vte::parser::Sequence const& seq)
+Emulation::erase_in_display(vte::parser::Sequence const& seq)
 {
         /* We don't implement the protected attribute, so we can ignore selective:
          * bool selective = (seq.command() == VTE_CMD_DECSED);
@@ -1238,7 +880,7 @@ Terminal::erase_in_display(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::erase_in_line(vte::parser::Sequence const& seq)
+Emulation::erase_in_line(vte::parser::Sequence const& seq)
 {
         /* We don't implement the protected attribute, so we can ignore selective:
          * bool selective = (seq.command() == VTE_CMD_DECSEL);
@@ -1266,9 +908,9 @@ Terminal::erase_in_line(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::insert_lines(vte::grid::row_t param)
+Emulation::insert_lines(vte::grid::row_t param)
 {
-        vte::grid::row_t end, i;
+        vte::grid::row_t end;
 
 	/* Find the region we're messing with. */
         auto row = m_screen->cursor.row;
@@ -1284,15 +926,12 @@ Terminal::insert_lines(vte::grid::row_t param)
         auto limit = end - row + 1;
         param = MIN (param, limit);
 
-	for (i = 0; i < param; i++) {
-		/* Clear a line off the end of the region and add one to the
-		 * top of the region. */
-                ring_remove(end);
-                ring_insert(row, true);
-	}
+	/* Clear lines off the end of the region and add them to the
+	 * top of the region. */
+        ring_rotate(row, end, param);
         m_screen->cursor.col = 0;
 	/* Update the display. */
-        invalidate_rows(row, end);
+        m_sink->invalidate_rows(row, end);
 	/* Adjust the scrollbars if necessary. */
         adjust_adjustments();
 	/* We've modified the display.  Make a note of it. */
@@ -1300,9 +939,9 @@ Terminal::insert_lines(vte::grid::row_t param)
 }
 
 void
-Terminal::delete_lines(vte::grid::row_t param)
+Emulation::delete_lines(vte::grid::row_t param)
 {
-        vte::grid::row_t end, i;
+        vte::grid::row_t end;
 
 	/* Find the region we're messing with. */
         auto row = m_screen->cursor.row;
@@ -1318,16 +957,12 @@ Terminal::delete_lines(vte::grid::row_t param)
         auto limit = end - row + 1;
         param = MIN (param, limit);
 
-	/* Clear them from below the current cursor. */
-	for (i = 0; i < param; i++) {
-		/* Insert a line at the end of the region and remove one from
-		 * the top of the region. */
-                ring_remove(row);
-                ring_insert(end, true);
-	}
+	/* Clear them from below the current cursor, adding lines at the
+	 * end of the region. */
+        ring_rotate(row, end, -param);
         m_screen->cursor.col = 0;
 	/* Update the display. */
-        invalidate_rows(row, end);
+        m_sink->invalidate_rows(row, end);
 	/* Adjust the scrollbars if necessary. */
         adjust_adjustments();
 	/* We've modified the display.  Make a note of it. */
@@ -1335,7 +970,7 @@ Terminal::delete_lines(vte::grid::row_t param)
 }
 
 bool
-Terminal::get_osc_color_index(int osc,
+Emulation::get_osc_color_index(int osc,
                                         int value,
                                         int& index) const noexcept
 {
@@ -1370,7 +1005,7 @@ Terminal::get_osc_color_index(int osc,
 }
 
 void
-Terminal::set_color(vte::parser::Sequence const& seq,
+Emulation::set_color(vte::parser::Sequence const& seq,
                               vte::parser::StringTokeniser::const_iterator& token,
                               vte::parser::StringTokeniser::const_iterator const& endtoken,
                               int osc) noexcept
@@ -1395,7 +1030,7 @@ Terminal::set_color(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::set_color_index(vte::parser::Sequence const& seq,
+Emulation::set_color_index(vte::parser::Sequence const& seq,
                                     vte::parser::StringTokeniser::const_iterator& token,
                                     vte::parser::StringTokeniser::const_iterator const& endtoken,
                                     int number,
@@ -1432,7 +1067,7 @@ Terminal::set_color_index(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::set_special_color(vte::parser::Sequence const& seq,
+Emulation::set_special_color(vte::parser::Sequence const& seq,
                                       vte::parser::StringTokeniser::const_iterator& token,
                                       vte::parser::StringTokeniser::const_iterator const& endtoken,
                                       int index,
@@ -1446,7 +1081,7 @@ Terminal::set_special_color(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::reset_color(vte::parser::Sequence const& seq,
+Emulation::reset_color(vte::parser::Sequence const& seq,
                                 vte::parser::StringTokeniser::const_iterator& token,
                                 vte::parser::StringTokeniser::const_iterator const& endtoken,
                                 int osc) noexcept
@@ -1481,7 +1116,7 @@ Terminal::reset_color(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::set_current_directory_uri(vte::parser::Sequence const& seq,
+Emulation::set_current_directory_uri(vte::parser::Sequence const& seq,
                                               vte::parser::StringTokeniser::const_iterator& token,
                                               vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept
 {
@@ -1503,7 +1138,7 @@ Terminal::set_current_directory_uri(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::set_current_file_uri(vte::parser::Sequence const& seq,
+Emulation::set_current_file_uri(vte::parser::Sequence const& seq,
                                          vte::parser::StringTokeniser::const_iterator& token,
                                          vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept
 
@@ -1526,7 +1161,7 @@ Terminal::set_current_file_uri(vte::parser::Sequence const& seq,
 }
 
 void
-Terminal::set_current_hyperlink(vte::parser::Sequence const& seq,
+Emulation::set_current_hyperlink(vte::parser::Sequence const& seq,
                                           vte::parser::StringTokeniser::const_iterator& token,
                                           vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept
 {
@@ -1608,12 +1243,12 @@ Terminal::set_current_hyperlink(vte::parser::Sequence const& seq,
  */
 
 void
-Terminal::NONE(vte::parser::Sequence const& seq)
+Emulation::NONE(vte::parser::Sequence const& seq)
 {
 }
 
 void
-Terminal::GRAPHIC(vte::parser::Sequence const& seq)
+Emulation::GRAPHIC(vte::parser::Sequence const& seq)
 {
 #if 0
         struct vte_char ch = VTE_CHAR_NULL;
@@ -1649,7 +1284,7 @@ Terminal::GRAPHIC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ACK(vte::parser::Sequence const& seq)
+Emulation::ACK(vte::parser::Sequence const& seq)
 {
         /*
          * ACK - acknowledge
@@ -1661,7 +1296,7 @@ Terminal::ACK(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ACS(vte::parser::Sequence const& seq)
+Emulation::ACS(vte::parser::Sequence const& seq)
 {
         /* ACS - announce-code-structure
          *
@@ -1764,7 +1399,7 @@ Terminal::ACS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::BEL(vte::parser::Sequence const& seq)
+Emulation::BEL(vte::parser::Sequence const& seq)
 {
         /*
          * BEL - sound bell tone
@@ -1777,7 +1412,7 @@ Terminal::BEL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::BPH(vte::parser::Sequence const& seq)
+Emulation::BPH(vte::parser::Sequence const& seq)
 {
         /*
          * BPH - break permitted here
@@ -1789,7 +1424,7 @@ Terminal::BPH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::BS(vte::parser::Sequence const& seq)
+Emulation::BS(vte::parser::Sequence const& seq)
 {
         /*
          * BS - backspace
@@ -1813,7 +1448,7 @@ Terminal::BS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CBT(vte::parser::Sequence const& seq)
+Emulation::CBT(vte::parser::Sequence const& seq)
 {
         /*
          * CBT - cursor-backward-tabulation
@@ -1835,7 +1470,7 @@ Terminal::CBT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CCH(vte::parser::Sequence const& seq)
+Emulation::CCH(vte::parser::Sequence const& seq)
 {
         /*
          * CCH - cancel character
@@ -1851,7 +1486,7 @@ Terminal::CCH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CHA(vte::parser::Sequence const& seq)
+Emulation::CHA(vte::parser::Sequence const& seq)
 {
         /*
          * CHA - cursor-horizontal-absolute
@@ -1884,7 +1519,7 @@ Terminal::CHA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CHT(vte::parser::Sequence const& seq)
+Emulation::CHT(vte::parser::Sequence const& seq)
 {
         /*
          * CHT - cursor-horizontal-forward-tabulation
@@ -1909,7 +1544,7 @@ Terminal::CHT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CMD(vte::parser::Sequence const& seq)
+Emulation::CMD(vte::parser::Sequence const& seq)
 {
         /*
          * CMD - coding method delimiter
@@ -1922,7 +1557,7 @@ Terminal::CMD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CNL(vte::parser::Sequence const& seq)
+Emulation::CNL(vte::parser::Sequence const& seq)
 {
         /*
          * CNL - cursor-next-line
@@ -1955,7 +1590,7 @@ Terminal::CNL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CPL(vte::parser::Sequence const& seq)
+Emulation::CPL(vte::parser::Sequence const& seq)
 {
         /*
          * CPL - cursor-preceding-line
@@ -1986,7 +1621,7 @@ Terminal::CPL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CR(vte::parser::Sequence const& seq)
+Emulation::CR(vte::parser::Sequence const& seq)
 {
         /*
          * CR - carriage-return
@@ -2003,7 +1638,7 @@ Terminal::CR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CTC(vte::parser::Sequence const& seq)
+Emulation::CTC(vte::parser::Sequence const& seq)
 {
         /*
          * CTC - cursor tabulation control
@@ -2052,7 +1687,7 @@ Terminal::CTC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CUB(vte::parser::Sequence const& seq)
+Emulation::CUB(vte::parser::Sequence const& seq)
 {
         /*
          * CUB - cursor-backward
@@ -2082,7 +1717,7 @@ Terminal::CUB(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CUD(vte::parser::Sequence const& seq)
+Emulation::CUD(vte::parser::Sequence const& seq)
 {
         /*
          * CUD - cursor-down
@@ -2113,7 +1748,7 @@ Terminal::CUD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CUF(vte::parser::Sequence const& seq)
+Emulation::CUF(vte::parser::Sequence const& seq)
 {
         /*
          * CUF -cursor-forward
@@ -2143,7 +1778,7 @@ Terminal::CUF(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CUP(vte::parser::Sequence const& seq)
+Emulation::CUP(vte::parser::Sequence const& seq)
 {
         /*
          * CUP - cursor-position
@@ -2180,7 +1815,7 @@ Terminal::CUP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CUU(vte::parser::Sequence const& seq)
+Emulation::CUU(vte::parser::Sequence const& seq)
 {
         /*
          * CUU - cursor-up
@@ -2211,7 +1846,7 @@ Terminal::CUU(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CVT(vte::parser::Sequence const& seq)
+Emulation::CVT(vte::parser::Sequence const& seq)
 {
         /*
          * CVT - cursor line tabulation
@@ -2232,7 +1867,7 @@ Terminal::CVT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::CnD(vte::parser::Sequence const& seq)
+Emulation::CnD(vte::parser::Sequence const& seq)
 {
         /*
          * CnD - Cn-designate
@@ -2247,7 +1882,7 @@ Terminal::CnD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DA1(vte::parser::Sequence const& seq)
+Emulation::DA1(vte::parser::Sequence const& seq)
 {
         /*
          * DA1 - primary-device-attributes
@@ -2334,7 +1969,7 @@ Terminal::DA1(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DA2(vte::parser::Sequence const& seq)
+Emulation::DA2(vte::parser::Sequence const& seq)
 {
         /*
          * DA2 - secondary-device-attributes
@@ -2364,7 +1999,7 @@ Terminal::DA2(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DA3(vte::parser::Sequence const& seq)
+Emulation::DA3(vte::parser::Sequence const& seq)
 {
         /*
          * DA3 - tertiary-device-attributes
@@ -2385,7 +2020,7 @@ Terminal::DA3(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DAQ(vte::parser::Sequence const& seq)
+Emulation::DAQ(vte::parser::Sequence const& seq)
 {
         /*
          * DAQ - define area qualification
@@ -2401,7 +2036,7 @@ Terminal::DAQ(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DC1(vte::parser::Sequence const& seq)
+Emulation::DC1(vte::parser::Sequence const& seq)
 {
         /*
          * DC1 - device-control-1 or XON
@@ -2414,7 +2049,7 @@ Terminal::DC1(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DC2(vte::parser::Sequence const& seq)
+Emulation::DC2(vte::parser::Sequence const& seq)
 {
         /*
          * DC2 - device-control-2
@@ -2426,7 +2061,7 @@ Terminal::DC2(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DC3(vte::parser::Sequence const& seq)
+Emulation::DC3(vte::parser::Sequence const& seq)
 {
         /*
          * DC3 - device-control-3 or XOFF
@@ -2440,7 +2075,7 @@ Terminal::DC3(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DC4(vte::parser::Sequence const& seq)
+Emulation::DC4(vte::parser::Sequence const& seq)
 {
         /*
          * DC4 - device-control-4
@@ -2452,7 +2087,7 @@ Terminal::DC4(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DCH(vte::parser::Sequence const& seq)
+Emulation::DCH(vte::parser::Sequence const& seq)
 {
         /*
          * DCH - delete-character
@@ -2487,7 +2122,7 @@ Terminal::DCH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECAC(vte::parser::Sequence const& seq)
+Emulation::DECAC(vte::parser::Sequence const& seq)
 {
         /*
          * DECAC - assign color
@@ -2506,7 +2141,7 @@ Terminal::DECAC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECALN(vte::parser::Sequence const& seq)
+Emulation::DECALN(vte::parser::Sequence const& seq)
 {
         /*
          * DECALN - screen-alignment-pattern
@@ -2530,23 +2165,23 @@ Terminal::DECALN(vte::parser::Sequence const& seq)
 		/* Clear this row. */
 		_vte_row_data_shrink (rowdata, 0);
 
-                emit_text_deleted();
+                m_text_deleted_flag = TRUE;
 		/* Fill this row. */
                 VteCell cell;
 		cell.c = 'E';
 		cell.attr = basic_cell.attr;
 		cell.attr.set_columns(1);
                 _vte_row_data_fill(rowdata, &cell, m_column_count);
-                emit_text_inserted();
+                m_text_inserted_flag = TRUE;
 	}
-        invalidate_all();
+        m_sink->invalidate_all();
 
 	/* We modified the display, so make a note of it for completeness. */
         m_text_modified_flag = TRUE;
 }
 
 void
-Terminal::DECARR(vte::parser::Sequence const& seq)
+Emulation::DECARR(vte::parser::Sequence const& seq)
 {
         /*
          * DECARR - auto repeat rate
@@ -2561,7 +2196,7 @@ Terminal::DECARR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECATC(vte::parser::Sequence const& seq)
+Emulation::DECATC(vte::parser::Sequence const& seq)
 {
         /*
          * DECATC - alternate text color
@@ -2583,7 +2218,7 @@ Terminal::DECATC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECAUPSS(vte::parser::Sequence const& seq)
+Emulation::DECAUPSS(vte::parser::Sequence const& seq)
 {
         /*
          * DECAUPSS - assign user preferred supplemental sets
@@ -2605,7 +2240,7 @@ Terminal::DECAUPSS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECBI(vte::parser::Sequence const& seq)
+Emulation::DECBI(vte::parser::Sequence const& seq)
 {
         /*
          * DECBI - back-index
@@ -2622,7 +2257,7 @@ Terminal::DECBI(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECCARA(vte::parser::Sequence const& seq)
+Emulation::DECCARA(vte::parser::Sequence const& seq)
 {
         /*
          * DECCARA - change-attributes-in-rectangular-area
@@ -2658,7 +2293,7 @@ Terminal::DECCARA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECCKD(vte::parser::Sequence const& seq)
+Emulation::DECCKD(vte::parser::Sequence const& seq)
 {
         /*
          * DECCKD - copy key default
@@ -2671,7 +2306,7 @@ Terminal::DECCKD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECCRA(vte::parser::Sequence const& seq)
+Emulation::DECCRA(vte::parser::Sequence const& seq)
 {
         /*
          * DECCRA - copy-rectangular-area
@@ -2710,7 +2345,7 @@ Terminal::DECCRA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECCRTST(vte::parser::Sequence const& seq)
+Emulation::DECCRTST(vte::parser::Sequence const& seq)
 {
         /*
          * DECCRTST - CRT saver time
@@ -2730,7 +2365,7 @@ Terminal::DECCRTST(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECDC(vte::parser::Sequence const& seq)
+Emulation::DECDC(vte::parser::Sequence const& seq)
 {
         /*
          * DECDC - delete-column
@@ -2742,7 +2377,7 @@ Terminal::DECDC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECDHL_BH(vte::parser::Sequence const& seq)
+Emulation::DECDHL_BH(vte::parser::Sequence const& seq)
 {
         /*
          * DECDHL_BH - double-width-double-height-line: bottom half
@@ -2754,7 +2389,7 @@ Terminal::DECDHL_BH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECDHL_TH(vte::parser::Sequence const& seq)
+Emulation::DECDHL_TH(vte::parser::Sequence const& seq)
 {
         /*
          * DECDHL_TH - double-width-double-height-line: top half
@@ -2766,7 +2401,7 @@ Terminal::DECDHL_TH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECDLD(vte::parser::Sequence const& seq)
+Emulation::DECDLD(vte::parser::Sequence const& seq)
 {
         /*
          * DECDLD - dynamically redefinable character sets extension
@@ -2779,7 +2414,7 @@ Terminal::DECDLD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECDLDA(vte::parser::Sequence const& seq)
+Emulation::DECDLDA(vte::parser::Sequence const& seq)
 {
         /*
          * DECDLD - down line load allocation
@@ -2793,7 +2428,7 @@ Terminal::DECDLDA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECDMAC(vte::parser::Sequence const& seq)
+Emulation::DECDMAC(vte::parser::Sequence const& seq)
 {
         /*
          * DECDMAC - define-macro
@@ -2806,7 +2441,7 @@ Terminal::DECDMAC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECDWL(vte::parser::Sequence const& seq)
+Emulation::DECDWL(vte::parser::Sequence const& seq)
 {
         /*
          * DECDWL - double-width-single-height-line
@@ -2818,7 +2453,7 @@ Terminal::DECDWL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECEFR(vte::parser::Sequence const& seq)
+Emulation::DECEFR(vte::parser::Sequence const& seq)
 {
         /*
          * DECEFR - enable-filter-rectangle
@@ -2842,7 +2477,7 @@ Terminal::DECEFR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECELF(vte::parser::Sequence const& seq)
+Emulation::DECELF(vte::parser::Sequence const& seq)
 {
         /*
          * DECELF - enable-local-functions
@@ -2856,7 +2491,7 @@ Terminal::DECELF(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECELR(vte::parser::Sequence const& seq)
+Emulation::DECELR(vte::parser::Sequence const& seq)
 {
         /*
          * DECELR - enable-locator-reporting
@@ -2877,7 +2512,7 @@ Terminal::DECELR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECERA(vte::parser::Sequence const& seq)
+Emulation::DECERA(vte::parser::Sequence const& seq)
 {
         /*
          * DECERA - erase-rectangular-area
@@ -2911,7 +2546,7 @@ Terminal::DECERA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECES(vte::parser::Sequence const& seq)
+Emulation::DECES(vte::parser::Sequence const& seq)
 {
         /*
          * DECES - enable session
@@ -2926,7 +2561,7 @@ Terminal::DECES(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECFI(vte::parser::Sequence const& seq)
+Emulation::DECFI(vte::parser::Sequence const& seq)
 {
         /*
          * DECFI - forward-index
@@ -2946,7 +2581,7 @@ Terminal::DECFI(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECFRA(vte::parser::Sequence const& seq)
+Emulation::DECFRA(vte::parser::Sequence const& seq)
 {
         /*
          * DECFRA - fill-rectangular-area
@@ -2989,7 +2624,7 @@ Terminal::DECFRA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECIC(vte::parser::Sequence const& seq)
+Emulation::DECIC(vte::parser::Sequence const& seq)
 {
         /*
          * DECIC - insert-column
@@ -3004,7 +2639,7 @@ Terminal::DECIC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECINVM(vte::parser::Sequence const& seq)
+Emulation::DECINVM(vte::parser::Sequence const& seq)
 {
         /*
          * DECINVM - invoke-macro
@@ -3017,7 +2652,7 @@ Terminal::DECINVM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECKBD(vte::parser::Sequence const& seq)
+Emulation::DECKBD(vte::parser::Sequence const& seq)
 {
         /*
          * DECKBD - keyboard-language-selection
@@ -3030,7 +2665,7 @@ Terminal::DECKBD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECKPAM(vte::parser::Sequence const& seq)
+Emulation::DECKPAM(vte::parser::Sequence const& seq)
 {
         /*
          * DECKPAM - keypad-application-mode
@@ -3047,7 +2682,7 @@ Terminal::DECKPAM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECKPNM(vte::parser::Sequence const& seq)
+Emulation::DECKPNM(vte::parser::Sequence const& seq)
 {
         /*
          * DECKPNM - keypad-numeric-mode
@@ -3062,7 +2697,7 @@ Terminal::DECKPNM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECLANS(vte::parser::Sequence const& seq)
+Emulation::DECLANS(vte::parser::Sequence const& seq)
 {
         /*
          * DECLANS - load answerback message
@@ -3074,7 +2709,7 @@ Terminal::DECLANS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECLBAN(vte::parser::Sequence const& seq)
+Emulation::DECLBAN(vte::parser::Sequence const& seq)
 {
         /*
          * DECLBAN - load banner message
@@ -3088,7 +2723,7 @@ Terminal::DECLBAN(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECLBD(vte::parser::Sequence const& seq)
+Emulation::DECLBD(vte::parser::Sequence const& seq)
 {
         /*
          * DECLBD - locator button define
@@ -3098,7 +2733,7 @@ Terminal::DECLBD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECLFKC(vte::parser::Sequence const& seq)
+Emulation::DECLFKC(vte::parser::Sequence const& seq)
 {
         /*
          * DECLFKC - local-function-key-control
@@ -3111,7 +2746,7 @@ Terminal::DECLFKC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECLL(vte::parser::Sequence const& seq)
+Emulation::DECLL(vte::parser::Sequence const& seq)
 {
         /*
          * DECLL - load-leds
@@ -3131,7 +2766,7 @@ Terminal::DECLL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECLTOD(vte::parser::Sequence const& seq)
+Emulation::DECLTOD(vte::parser::Sequence const& seq)
 {
         /*
          * DECLTOD - load-time-of-day
@@ -3144,7 +2779,7 @@ Terminal::DECLTOD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECPAK(vte::parser::Sequence const& seq)
+Emulation::DECPAK(vte::parser::Sequence const& seq)
 {
         /*
          * DECPAK - program alphanumeric key
@@ -3157,7 +2792,7 @@ Terminal::DECPAK(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECPCTERM(vte::parser::Sequence const& seq)
+Emulation::DECPCTERM(vte::parser::Sequence const& seq)
 {
         /*
          * DECPCTERM - pcterm-mode
@@ -3171,7 +2806,7 @@ Terminal::DECPCTERM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECPCTERM_OR_XTERM_RPM(vte::parser::Sequence const& seq)
+Emulation::DECPCTERM_OR_XTERM_RPM(vte::parser::Sequence const& seq)
 {
         /*
          * There's a conflict between DECPCTERM and XTERM_RPM.
@@ -3188,7 +2823,7 @@ Terminal::DECPCTERM_OR_XTERM_RPM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECPFK(vte::parser::Sequence const& seq)
+Emulation::DECPFK(vte::parser::Sequence const& seq)
 {
         /*
          * DECPFK - program function key
@@ -3201,7 +2836,7 @@ Terminal::DECPFK(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECPKA(vte::parser::Sequence const& seq)
+Emulation::DECPKA(vte::parser::Sequence const& seq)
 {
         /*
          * DECPKA - program-key-action
@@ -3220,7 +2855,7 @@ Terminal::DECPKA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECPKFMR(vte::parser::Sequence const& seq)
+Emulation::DECPKFMR(vte::parser::Sequence const& seq)
 {
         /*
          * DECPKFMR - program-key-free-memory-report
@@ -3232,7 +2867,7 @@ Terminal::DECPKFMR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECPS(vte::parser::Sequence const& seq)
+Emulation::DECPS(vte::parser::Sequence const& seq)
 {
         /*
          * DECPS - play sound
@@ -3255,7 +2890,7 @@ Terminal::DECPS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRARA(vte::parser::Sequence const& seq)
+Emulation::DECRARA(vte::parser::Sequence const& seq)
 {
         /*
          * DECRARA - reverse-attributes-in-rectangular-area
@@ -3294,7 +2929,7 @@ Terminal::DECRARA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRC(vte::parser::Sequence const& seq)
+Emulation::DECRC(vte::parser::Sequence const& seq)
 {
         /*
          * DECRC - restore-cursor
@@ -3317,7 +2952,7 @@ Terminal::DECRC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECREGIS(vte::parser::Sequence const& seq)
+Emulation::DECREGIS(vte::parser::Sequence const& seq)
 {
         /*
          * DECREGIS - ReGIS graphics
@@ -3327,7 +2962,7 @@ Terminal::DECREGIS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECREQTPARM(vte::parser::Sequence const& seq)
+Emulation::DECREQTPARM(vte::parser::Sequence const& seq)
 {
         /*
          * DECREQTPARM - request-terminal-parameters
@@ -3396,7 +3031,7 @@ Terminal::DECREQTPARM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQCRA(vte::parser::Sequence const& seq)
+Emulation::DECRQCRA(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQCRA - request checksum of rectangular area
@@ -3480,7 +3115,7 @@ Terminal::DECRQCRA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQDE(vte::parser::Sequence const& seq)
+Emulation::DECRQDE(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQDE - request-display-extent
@@ -3493,7 +3128,7 @@ Terminal::DECRQDE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQKT(vte::parser::Sequence const& seq)
+Emulation::DECRQKT(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQKT - request-key-type
@@ -3505,7 +3140,7 @@ Terminal::DECRQKT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQLP(vte::parser::Sequence const& seq)
+Emulation::DECRQLP(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQLP - request-locator-position
@@ -3518,7 +3153,7 @@ Terminal::DECRQLP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQM_ECMA(vte::parser::Sequence const& seq)
+Emulation::DECRQM_ECMA(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQM_ECMA - request-mode-ecma
@@ -3556,7 +3191,7 @@ Terminal::DECRQM_ECMA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQM_DEC(vte::parser::Sequence const& seq)
+Emulation::DECRQM_DEC(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQM_DEC - request-mode-dec
@@ -3585,7 +3220,7 @@ Terminal::DECRQM_DEC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQPKFM(vte::parser::Sequence const& seq)
+Emulation::DECRQPKFM(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQPKFM - request-program-key-free-memory
@@ -3597,7 +3232,7 @@ Terminal::DECRQPKFM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQPSR(vte::parser::Sequence const& seq)
+Emulation::DECRQPSR(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQPSR - request-presentation-state-report
@@ -3639,7 +3274,7 @@ Terminal::DECRQPSR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQSS(vte::parser::Sequence const& seq)
+Emulation::DECRQSS(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQSS - request selection or setting
@@ -3671,10 +3306,10 @@ Terminal::DECRQSS(vte::parser::Sequence const& seq)
          * requested; if there were more than one, the parser would
          * parse them as GRAPHIC and thus we reply 'invalid'.
          */
-        auto const str = seq.string();
+        auto const str = seq.string_utf8_view();
         size_t i;
         for (i = 0; i < str.size(); ++i) {
-                auto const c = str[i];
+                auto const c = uint8_t(str[i]);
                 if (c < 0x20 || c >= 0x7f)
                         break;
                 rv = parser.feed(c);
@@ -3743,7 +3378,7 @@ Terminal::DECRQSS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQTSR(vte::parser::Sequence const& seq)
+Emulation::DECRQTSR(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQTSR - request-terminal-state-report
@@ -3789,7 +3424,7 @@ Terminal::DECRQTSR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRQUPSS(vte::parser::Sequence const& seq)
+Emulation::DECRQUPSS(vte::parser::Sequence const& seq)
 {
         /*
          * DECRQUPSS - request-user-preferred-supplemental-set
@@ -3806,7 +3441,7 @@ Terminal::DECRQUPSS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRSPS(vte::parser::Sequence const& seq)
+Emulation::DECRSPS(vte::parser::Sequence const& seq)
 {
         /*
          * DECRSPS - restore presentation state
@@ -3835,7 +3470,7 @@ Terminal::DECRSPS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECRSTS(vte::parser::Sequence const& seq)
+Emulation::DECRSTS(vte::parser::Sequence const& seq)
 {
         /*
          * DECRSTS - restore terminal state
@@ -3864,7 +3499,7 @@ Terminal::DECRSTS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSACE(vte::parser::Sequence const& seq)
+Emulation::DECSACE(vte::parser::Sequence const& seq)
 {
         /*
          * DECSACE - select-attribute-change-extent
@@ -3889,7 +3524,7 @@ Terminal::DECSACE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSASD(vte::parser::Sequence const& seq)
+Emulation::DECSASD(vte::parser::Sequence const& seq)
 {
         /*
          * DECSASD - select-active-status-display
@@ -3910,7 +3545,7 @@ Terminal::DECSASD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSC(vte::parser::Sequence const& seq)
+Emulation::DECSC(vte::parser::Sequence const& seq)
 {
         /*
          * DECSC - save-cursor
@@ -3934,7 +3569,7 @@ Terminal::DECSC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSCA(vte::parser::Sequence const& seq)
+Emulation::DECSCA(vte::parser::Sequence const& seq)
 {
         /*
          * DECSCA - select character protection attribute
@@ -3971,7 +3606,7 @@ Terminal::DECSCA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSCL(vte::parser::Sequence const& seq)
+Emulation::DECSCL(vte::parser::Sequence const& seq)
 {
         /*
          * DECSCL - select-conformance-level
@@ -4027,7 +3662,7 @@ Terminal::DECSCL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSCP(vte::parser::Sequence const& seq)
+Emulation::DECSCP(vte::parser::Sequence const& seq)
 {
         /*
          * DECSCP - select-communication-port
@@ -4039,7 +3674,7 @@ Terminal::DECSCP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSCPP(vte::parser::Sequence const& seq)
+Emulation::DECSCPP(vte::parser::Sequence const& seq)
 {
         /*
          * DECSCPP - select-columns-per-page
@@ -4061,7 +3696,7 @@ Terminal::DECSCPP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSCS(vte::parser::Sequence const& seq)
+Emulation::DECSCS(vte::parser::Sequence const& seq)
 {
         /*
          * DECSCS - select-communication-speed
@@ -4073,7 +3708,7 @@ Terminal::DECSCS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSCUSR(vte::parser::Sequence const& seq)
+Emulation::DECSCUSR(vte::parser::Sequence const& seq)
 {
         /*
          * DECSCUSR - set-cursor-style
@@ -4105,7 +3740,7 @@ Terminal::DECSCUSR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSDDT(vte::parser::Sequence const& seq)
+Emulation::DECSDDT(vte::parser::Sequence const& seq)
 {
         /*
          * DECSDDT - select-disconnect-delay-time
@@ -4117,7 +3752,7 @@ Terminal::DECSDDT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSDPT(vte::parser::Sequence const& seq)
+Emulation::DECSDPT(vte::parser::Sequence const& seq)
 {
         /*
          * DECSDPT - select-digital-printed-data-type
@@ -4129,7 +3764,7 @@ Terminal::DECSDPT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSED(vte::parser::Sequence const& seq)
+Emulation::DECSED(vte::parser::Sequence const& seq)
 {
         /*
          * DECSED - selective-erase-in-display
@@ -4151,7 +3786,7 @@ Terminal::DECSED(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSEL(vte::parser::Sequence const& seq)
+Emulation::DECSEL(vte::parser::Sequence const& seq)
 {
         /*
          * DECSEL - selective-erase-in-line
@@ -4173,7 +3808,7 @@ Terminal::DECSEL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSERA(vte::parser::Sequence const& seq)
+Emulation::DECSERA(vte::parser::Sequence const& seq)
 {
         /*
          * DECSERA - selective-erase-rectangular-area
@@ -4208,7 +3843,7 @@ Terminal::DECSERA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSEST(vte::parser::Sequence const& seq)
+Emulation::DECSEST(vte::parser::Sequence const& seq)
 {
         /*
          * DECSEST - energy saver time
@@ -4229,7 +3864,7 @@ Terminal::DECSEST(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSFC(vte::parser::Sequence const& seq)
+Emulation::DECSFC(vte::parser::Sequence const& seq)
 {
         /*
          * DECSFC - select-flow-control
@@ -4241,7 +3876,7 @@ Terminal::DECSFC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSGR(vte::parser::Sequence const& seq)
+Emulation::DECSGR(vte::parser::Sequence const& seq)
 {
         /*
          * DECSGR - DEC select graphics rendition
@@ -4269,7 +3904,7 @@ Terminal::DECSGR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSIXEL(vte::parser::Sequence const& seq)
+Emulation::DECSIXEL(vte::parser::Sequence const& seq)
 {
         /*
          * DECSIXEL - SIXEL graphics
@@ -4279,7 +3914,7 @@ Terminal::DECSIXEL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSKCV(vte::parser::Sequence const& seq)
+Emulation::DECSKCV(vte::parser::Sequence const& seq)
 {
         /*
          * DECSKCV - set-key-click-volume
@@ -4301,7 +3936,7 @@ Terminal::DECSKCV(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSLCK(vte::parser::Sequence const& seq)
+Emulation::DECSLCK(vte::parser::Sequence const& seq)
 {
         /*
          * DECSLCK - set-lock-key-style
@@ -4314,7 +3949,7 @@ Terminal::DECSLCK(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSLE(vte::parser::Sequence const& seq)
+Emulation::DECSLE(vte::parser::Sequence const& seq)
 {
         /*
          * DECSLE - select-locator-events
@@ -4326,7 +3961,7 @@ Terminal::DECSLE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSLPP(vte::parser::Sequence const& seq)
+Emulation::DECSLPP(vte::parser::Sequence const& seq)
 {
         /*
          * DECSLPP - set-lines-per-page
@@ -4357,11 +3992,11 @@ Terminal::DECSLPP(vte::parser::Sequence const& seq)
 
         _vte_debug_print(VTE_DEBUG_EMULATION, "Resizing to %d rows.\n", param);
 
-        emit_resize_window(m_column_count, param);
+        m_sink->emit_resize_window(m_column_count, param);
 }
 
 void
-Terminal::DECSLRM(vte::parser::Sequence const& seq)
+Emulation::DECSLRM(vte::parser::Sequence const& seq)
 {
         /*
          * DECSLRM - set left and right margins
@@ -4390,7 +4025,7 @@ Terminal::DECSLRM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSLRM_OR_SCOSC(vte::parser::Sequence const& seq)
+Emulation::DECSLRM_OR_SCOSC(vte::parser::Sequence const& seq)
 {
         /*
          * set left and right margins or SCO restore cursor - DECSLRM or SCOSC
@@ -4418,7 +4053,7 @@ Terminal::DECSLRM_OR_SCOSC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSMBV(vte::parser::Sequence const& seq)
+Emulation::DECSMBV(vte::parser::Sequence const& seq)
 {
         /*
          * DECSMBV - set-margin-bell-volume
@@ -4440,7 +4075,7 @@ Terminal::DECSMBV(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSMKR(vte::parser::Sequence const& seq)
+Emulation::DECSMKR(vte::parser::Sequence const& seq)
 {
         /*
          * DECSMKR - select-modifier-key-reporting
@@ -4455,7 +4090,7 @@ Terminal::DECSMKR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSNLS(vte::parser::Sequence const& seq)
+Emulation::DECSNLS(vte::parser::Sequence const& seq)
 {
         /*
          * DECSNLS - set-lines-per-screen
@@ -4476,7 +4111,7 @@ Terminal::DECSNLS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSPMA(vte::parser::Sequence const& seq)
+Emulation::DECSPMA(vte::parser::Sequence const& seq)
 {
         /*
          * DECSPMA - session page memory allocation
@@ -4489,7 +4124,7 @@ Terminal::DECSPMA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSPP(vte::parser::Sequence const& seq)
+Emulation::DECSPP(vte::parser::Sequence const& seq)
 {
         /*
          * DECSPP - set-port-parameter
@@ -4503,7 +4138,7 @@ Terminal::DECSPP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSPPCS(vte::parser::Sequence const& seq)
+Emulation::DECSPPCS(vte::parser::Sequence const& seq)
 {
         /*
          * DECSPPCS - select-pro-printer-character-set
@@ -4516,7 +4151,7 @@ Terminal::DECSPPCS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSPRTT(vte::parser::Sequence const& seq)
+Emulation::DECSPRTT(vte::parser::Sequence const& seq)
 {
         /*
          * DECSPRTT - select-printer-type
@@ -4529,7 +4164,7 @@ Terminal::DECSPRTT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSR(vte::parser::Sequence const& seq)
+Emulation::DECSR(vte::parser::Sequence const& seq)
 {
         /*
          * DECSR - secure-reset
@@ -4558,7 +4193,7 @@ Terminal::DECSR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSRFR(vte::parser::Sequence const& seq)
+Emulation::DECSRFR(vte::parser::Sequence const& seq)
 {
         /*
          * DECSRFR - select-refresh-rate
@@ -4571,7 +4206,7 @@ Terminal::DECSRFR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSSCLS(vte::parser::Sequence const& seq)
+Emulation::DECSSCLS(vte::parser::Sequence const& seq)
 {
         /*
          * DECSSCLS - set-scroll-speed
@@ -4584,7 +4219,7 @@ Terminal::DECSSCLS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSSDT(vte::parser::Sequence const& seq)
+Emulation::DECSSDT(vte::parser::Sequence const& seq)
 {
         /*
          * DECSSDT - select-status-display-line-type
@@ -4606,7 +4241,7 @@ Terminal::DECSSDT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSSL(vte::parser::Sequence const& seq)
+Emulation::DECSSL(vte::parser::Sequence const& seq)
 {
         /*
          * DECSSL - select-setup-language
@@ -4626,7 +4261,7 @@ Terminal::DECSSL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECST8C(vte::parser::Sequence const& seq)
+Emulation::DECST8C(vte::parser::Sequence const& seq)
 {
         /*
          * DECST8C - set-tab-at-every-8-columns
@@ -4645,7 +4280,7 @@ Terminal::DECST8C(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSTBM(vte::parser::Sequence const& seq)
+Emulation::DECSTBM(vte::parser::Sequence const& seq)
 {
         /*
          * DECSTBM - set-top-and-bottom-margins
@@ -4729,7 +4364,7 @@ Terminal::DECSTBM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSTGLT(vte::parser::Sequence const& seq)
+Emulation::DECSTGLT(vte::parser::Sequence const& seq)
 {
         /*
          * DECSTGLT - select color lookup table
@@ -4757,7 +4392,7 @@ Terminal::DECSTGLT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSTR(vte::parser::Sequence const& seq)
+Emulation::DECSTR(vte::parser::Sequence const& seq)
 {
         /*
          * DECSTR - soft-terminal-reset
@@ -4771,7 +4406,7 @@ Terminal::DECSTR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSTRL(vte::parser::Sequence const& seq)
+Emulation::DECSTRL(vte::parser::Sequence const& seq)
 {
         /*
          * DECSTRL - set-transmit-rate-limit
@@ -4783,7 +4418,7 @@ Terminal::DECSTRL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSTUI(vte::parser::Sequence const& seq)
+Emulation::DECSTUI(vte::parser::Sequence const& seq)
 {
         /*
          * DECSTUI - set terminal unit ID
@@ -4796,7 +4431,7 @@ Terminal::DECSTUI(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSWBV(vte::parser::Sequence const& seq)
+Emulation::DECSWBV(vte::parser::Sequence const& seq)
 {
         /*
          * DECSWBV - set-warning-bell-volume
@@ -4818,7 +4453,7 @@ Terminal::DECSWBV(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSWL(vte::parser::Sequence const& seq)
+Emulation::DECSWL(vte::parser::Sequence const& seq)
 {
         /*
          * DECSWL - single-width-single-height-line
@@ -4830,7 +4465,7 @@ Terminal::DECSWL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECSZS(vte::parser::Sequence const& seq)
+Emulation::DECSZS(vte::parser::Sequence const& seq)
 {
         /*
          * DECSZS - select zero symbol
@@ -4853,7 +4488,7 @@ Terminal::DECSZS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECTID(vte::parser::Sequence const& seq)
+Emulation::DECTID(vte::parser::Sequence const& seq)
 {
         /*
          * DECTID - select-terminal-id
@@ -4867,7 +4502,7 @@ Terminal::DECTID(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECTME(vte::parser::Sequence const& seq)
+Emulation::DECTME(vte::parser::Sequence const& seq)
 {
         /*
          * DECTME - terminal-mode-emulation
@@ -4883,7 +4518,7 @@ Terminal::DECTME(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECTST(vte::parser::Sequence const& seq)
+Emulation::DECTST(vte::parser::Sequence const& seq)
 {
         /*
          * DECTST - invoke-confidence-test
@@ -4900,7 +4535,7 @@ Terminal::DECTST(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECUDK(vte::parser::Sequence const& seq)
+Emulation::DECUDK(vte::parser::Sequence const& seq)
 {
         /*
          * DECUDK - user define keys
@@ -4913,7 +4548,7 @@ Terminal::DECUDK(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DECUS(vte::parser::Sequence const& seq)
+Emulation::DECUS(vte::parser::Sequence const& seq)
 {
         /*
          * DECUS - update session
@@ -4925,7 +4560,7 @@ Terminal::DECUS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DL(vte::parser::Sequence const& seq)
+Emulation::DL(vte::parser::Sequence const& seq)
 {
         /*
          * DL - delete-line
@@ -4960,7 +4595,7 @@ Terminal::DL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DLE(vte::parser::Sequence const& seq)
+Emulation::DLE(vte::parser::Sequence const& seq)
 {
         /*
          * DLE - data link escape
@@ -4974,7 +4609,7 @@ Terminal::DLE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DMI(vte::parser::Sequence const& seq)
+Emulation::DMI(vte::parser::Sequence const& seq)
 {
         /*
          * DMI - disable manual input
@@ -4986,7 +4621,7 @@ Terminal::DMI(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DOCS(vte::parser::Sequence const& seq)
+Emulation::DOCS(vte::parser::Sequence const& seq)
 {
         /*
          * DOCS - designate other coding systyem
@@ -4999,7 +4634,7 @@ Terminal::DOCS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DSR_ECMA(vte::parser::Sequence const& seq)
+Emulation::DSR_ECMA(vte::parser::Sequence const& seq)
 {
         /*
          * DSR_ECMA - Device Status Report
@@ -5064,7 +4699,7 @@ Terminal::DSR_ECMA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DSR_DEC(vte::parser::Sequence const& seq)
+Emulation::DSR_DEC(vte::parser::Sequence const& seq)
 {
         /*
          * DSR_DEC - device-status-report-dec
@@ -5227,7 +4862,7 @@ Terminal::DSR_DEC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::DTA(vte::parser::Sequence const& seq)
+Emulation::DTA(vte::parser::Sequence const& seq)
 {
         /*
          * DTA - dimension text area
@@ -5246,7 +4881,7 @@ Terminal::DTA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::EA(vte::parser::Sequence const& seq)
+Emulation::EA(vte::parser::Sequence const& seq)
 {
         /*
          * EA - erase in area
@@ -5280,7 +4915,7 @@ Terminal::EA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ECH(vte::parser::Sequence const& seq)
+Emulation::ECH(vte::parser::Sequence const& seq)
 {
         /*
          * ECH - erase-character
@@ -5319,13 +4954,17 @@ Terminal::ECH(vte::parser::Sequence const& seq)
         /* Erase characters starting at the cursor position (overwriting N with
          * spaces, but not moving the cursor). */
 
-        // FIXMEchpe limit to column_count - cursor.x ?
-        auto const count = seq.collect1(0, 1, 1, int(65535));
+        ensure_cursor_is_onscreen();
+
+        /* Erasing past the right margin has no effect, and would make
+         * the row too long to extend.
+         */
+        auto const count = seq.collect1(0, 1, 1, int(m_column_count - m_screen->cursor.col));
         erase_characters(count);
 }
 
 void
-Terminal::ED(vte::parser::Sequence const& seq)
+Emulation::ED(vte::parser::Sequence const& seq)
 {
         /*
          * ED - erase-in-display
@@ -5361,7 +5000,7 @@ Terminal::ED(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::EF(vte::parser::Sequence const& seq)
+Emulation::EF(vte::parser::Sequence const& seq)
 {
         /*
          * EF - erase in field
@@ -5389,7 +5028,7 @@ Terminal::EF(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::EL(vte::parser::Sequence const& seq)
+Emulation::EL(vte::parser::Sequence const& seq)
 {
         /*
          * EL - erase-in-line
@@ -5421,7 +5060,7 @@ Terminal::EL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::EM(vte::parser::Sequence const& seq)
+Emulation::EM(vte::parser::Sequence const& seq)
 {
         /*
          * EM - end of medium
@@ -5431,7 +5070,7 @@ Terminal::EM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::EMI(vte::parser::Sequence const& seq)
+Emulation::EMI(vte::parser::Sequence const& seq)
 {
         /*
          * DMI - enable manual input
@@ -5443,7 +5082,7 @@ Terminal::EMI(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ENQ(vte::parser::Sequence const& seq)
+Emulation::ENQ(vte::parser::Sequence const& seq)
 {
         /*
          * ENQ - enquiry
@@ -5457,7 +5096,7 @@ Terminal::ENQ(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::EOT(vte::parser::Sequence const& seq)
+Emulation::EOT(vte::parser::Sequence const& seq)
 {
         /*
          * EOT - end of transmission
@@ -5470,7 +5109,7 @@ Terminal::EOT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::EPA(vte::parser::Sequence const& seq)
+Emulation::EPA(vte::parser::Sequence const& seq)
 {
         /*
          * EPA - end of guarded area
@@ -5487,7 +5126,7 @@ Terminal::EPA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ESA(vte::parser::Sequence const& seq)
+Emulation::ESA(vte::parser::Sequence const& seq)
 {
         /*
          * ESA - end of selected area
@@ -5500,7 +5139,7 @@ Terminal::ESA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ETB(vte::parser::Sequence const& seq)
+Emulation::ETB(vte::parser::Sequence const& seq)
 {
         /*
          * ETB - end of transmission block
@@ -5513,7 +5152,7 @@ Terminal::ETB(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ETX(vte::parser::Sequence const& seq)
+Emulation::ETX(vte::parser::Sequence const& seq)
 {
         /*
          * ETX - end of text
@@ -5526,7 +5165,7 @@ Terminal::ETX(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::FF(vte::parser::Sequence const& seq)
+Emulation::FF(vte::parser::Sequence const& seq)
 {
         /*
          * FF - form-feed
@@ -5539,7 +5178,7 @@ Terminal::FF(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::FNK(vte::parser::Sequence const& seq)
+Emulation::FNK(vte::parser::Sequence const& seq)
 {
         /*
          * FNK - function key
@@ -5557,7 +5196,7 @@ Terminal::FNK(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::FNT(vte::parser::Sequence const& seq)
+Emulation::FNT(vte::parser::Sequence const& seq)
 {
         /*
          * FNT - font selection
@@ -5578,7 +5217,7 @@ Terminal::FNT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::GCC(vte::parser::Sequence const& seq)
+Emulation::GCC(vte::parser::Sequence const& seq)
 {
         /*
          * GCC - graphic character combination
@@ -5600,7 +5239,7 @@ Terminal::GCC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::GSM(vte::parser::Sequence const& seq)
+Emulation::GSM(vte::parser::Sequence const& seq)
 {
         /*
          * GSM - graphic size modification
@@ -5620,7 +5259,7 @@ Terminal::GSM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::GSS(vte::parser::Sequence const& seq)
+Emulation::GSS(vte::parser::Sequence const& seq)
 {
         /*
          * GSM - graphic size selection
@@ -5638,7 +5277,7 @@ Terminal::GSS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::GnDm(vte::parser::Sequence const& seq)
+Emulation::GnDm(vte::parser::Sequence const& seq)
 {
         /*
          * GnDm - Gn-designate 9m-charset
@@ -5680,7 +5319,7 @@ Terminal::GnDm(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::GnDMm(vte::parser::Sequence const& seq)
+Emulation::GnDMm(vte::parser::Sequence const& seq)
 {
         /*
          * GnDm - Gn-designate multibyte 9m-charset
@@ -5695,7 +5334,7 @@ Terminal::GnDMm(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::HPA(vte::parser::Sequence const& seq)
+Emulation::HPA(vte::parser::Sequence const& seq)
 {
         /*
          * HPA - horizontal position absolute
@@ -5727,7 +5366,7 @@ Terminal::HPA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::HPB(vte::parser::Sequence const& seq)
+Emulation::HPB(vte::parser::Sequence const& seq)
 {
         /*
          * HPA - horizontal position backward
@@ -5745,7 +5384,7 @@ Terminal::HPB(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::HPR(vte::parser::Sequence const& seq)
+Emulation::HPR(vte::parser::Sequence const& seq)
 {
         /*
          * HPR - horizontal-position-relative
@@ -5773,7 +5412,7 @@ Terminal::HPR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::HT(vte::parser::Sequence const& seq)
+Emulation::HT(vte::parser::Sequence const& seq)
 {
         /*
          * HT - character tabulation
@@ -5796,7 +5435,7 @@ Terminal::HT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::HTJ(vte::parser::Sequence const& seq)
+Emulation::HTJ(vte::parser::Sequence const& seq)
 {
         /*
          * HTJ - character tabulation with justification
@@ -5812,7 +5451,7 @@ Terminal::HTJ(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::HTS(vte::parser::Sequence const& seq)
+Emulation::HTS(vte::parser::Sequence const& seq)
 {
         /*
          * HTS - horizontal-tab-set
@@ -5828,7 +5467,7 @@ Terminal::HTS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::HVP(vte::parser::Sequence const& seq)
+Emulation::HVP(vte::parser::Sequence const& seq)
 {
         /*
          * HVP - horizontal-and-vertical-position
@@ -5853,7 +5492,7 @@ Terminal::HVP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ICH(vte::parser::Sequence const& seq)
+Emulation::ICH(vte::parser::Sequence const& seq)
 {
         /*
          * ICH - insert-character
@@ -5888,15 +5527,21 @@ Terminal::ICH(vte::parser::Sequence const& seq)
                                  screen->age);
 #endif
 
+        ensure_cursor_is_onscreen();
+
         auto const count = seq.collect1(0, 1, 1, int(m_column_count - m_screen->cursor.col));
 
-        /* TODOegmont: Insert them in a single run, so that we call cleanup_fragments only once. */
-        for (auto i = 0; i < count; i++)
-                insert_blank_character();
+        /* Insert them in runs, so that we call cleanup_fragments only once per run. */
+        uint8_t blanks[k_insert_chars_max];
+        memset(blanks, ' ', sizeof(blanks));
+        auto const save = m_screen->cursor;
+        for (size_t i = 0; i < size_t(count); )
+                i += insert_chars(blanks, std::min(size_t(count) - i, k_insert_chars_max), true, true);
+        m_screen->cursor = save;
 }
 
 void
-Terminal::IDCS(vte::parser::Sequence const& seq)
+Emulation::IDCS(vte::parser::Sequence const& seq)
 {
         /*
          * IDCS - identify device control string
@@ -5914,7 +5559,7 @@ Terminal::IDCS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IGS(vte::parser::Sequence const& seq)
+Emulation::IGS(vte::parser::Sequence const& seq)
 {
         /*
          * IGS - identify graphic subrepertoire
@@ -5936,7 +5581,7 @@ Terminal::IGS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IL(vte::parser::Sequence const& seq)
+Emulation::IL(vte::parser::Sequence const& seq)
 {
         /*
          * IL - insert-line
@@ -5975,7 +5620,7 @@ Terminal::IL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IND(vte::parser::Sequence const& seq)
+Emulation::IND(vte::parser::Sequence const& seq)
 {
         /*
          * IND - index - DEPRECATED
@@ -5987,7 +5632,7 @@ Terminal::IND(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::INT(vte::parser::Sequence const& seq)
+Emulation::INT(vte::parser::Sequence const& seq)
 {
         /*
          * INT - interrupt
@@ -5997,7 +5642,7 @@ Terminal::INT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IRR(vte::parser::Sequence const& seq)
+Emulation::IRR(vte::parser::Sequence const& seq)
 {
         /*
          * IRR - identify-revised-registration
@@ -6011,7 +5656,7 @@ Terminal::IRR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IS1(vte::parser::Sequence const& seq)
+Emulation::IS1(vte::parser::Sequence const& seq)
 {
         /*
          * IS1 - information separator 1 / unit separator (US)
@@ -6021,7 +5666,7 @@ Terminal::IS1(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IS2(vte::parser::Sequence const& seq)
+Emulation::IS2(vte::parser::Sequence const& seq)
 {
         /*
          * IS2 - information separator 2 / record separator (RS)
@@ -6031,7 +5676,7 @@ Terminal::IS2(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IS3(vte::parser::Sequence const& seq)
+Emulation::IS3(vte::parser::Sequence const& seq)
 {
         /*
          * IS3 - information separator 3 / group separator (GS)
@@ -6041,7 +5686,7 @@ Terminal::IS3(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::IS4(vte::parser::Sequence const& seq)
+Emulation::IS4(vte::parser::Sequence const& seq)
 {
         /*
          * IS4 - information separator 4 / file separator (FS)
@@ -6051,7 +5696,7 @@ Terminal::IS4(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::JFY(vte::parser::Sequence const& seq)
+Emulation::JFY(vte::parser::Sequence const& seq)
 {
         /*
          * JFY - justify
@@ -6063,7 +5708,7 @@ Terminal::JFY(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LF(vte::parser::Sequence const& seq)
+Emulation::LF(vte::parser::Sequence const& seq)
 {
         /*
          * LF - line-feed
@@ -6082,7 +5727,7 @@ Terminal::LF(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LS0(vte::parser::Sequence const& seq)
+Emulation::LS0(vte::parser::Sequence const& seq)
 {
         /*
          * LS0 -locking shift 0 (8 bit)
@@ -6101,7 +5746,7 @@ Terminal::LS0(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LS1(vte::parser::Sequence const& seq)
+Emulation::LS1(vte::parser::Sequence const& seq)
 {
         /*
          * LS1 -locking shift 1 (8 bit)
@@ -6120,7 +5765,7 @@ Terminal::LS1(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LS1R(vte::parser::Sequence const& seq)
+Emulation::LS1R(vte::parser::Sequence const& seq)
 {
         /*
          * LS1R - locking-shift-1-right
@@ -6135,7 +5780,7 @@ Terminal::LS1R(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LS2(vte::parser::Sequence const& seq)
+Emulation::LS2(vte::parser::Sequence const& seq)
 {
         /*
          * LS2 - locking-shift-2
@@ -6150,7 +5795,7 @@ Terminal::LS2(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LS2R(vte::parser::Sequence const& seq)
+Emulation::LS2R(vte::parser::Sequence const& seq)
 {
         /*
          * LS2R - locking-shift-2-right
@@ -6165,7 +5810,7 @@ Terminal::LS2R(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LS3(vte::parser::Sequence const& seq)
+Emulation::LS3(vte::parser::Sequence const& seq)
 {
         /*
          * LS3 - locking-shift-3
@@ -6181,7 +5826,7 @@ Terminal::LS3(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::LS3R(vte::parser::Sequence const& seq)
+Emulation::LS3R(vte::parser::Sequence const& seq)
 {
         /*
          * LS3R - locking-shift-3-right
@@ -6196,7 +5841,7 @@ Terminal::LS3R(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::MC_ECMA(vte::parser::Sequence const& seq)
+Emulation::MC_ECMA(vte::parser::Sequence const& seq)
 {
         /*
          * MC_ECMA - media-copy-ecma
@@ -6209,7 +5854,7 @@ Terminal::MC_ECMA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::MC_DEC(vte::parser::Sequence const& seq)
+Emulation::MC_DEC(vte::parser::Sequence const& seq)
 {
         /*
          * MC_DEC - media-copy-dec
@@ -6221,7 +5866,7 @@ Terminal::MC_DEC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::MW(vte::parser::Sequence const& seq)
+Emulation::MW(vte::parser::Sequence const& seq)
 {
         /*
          * MW - message waiting
@@ -6233,7 +5878,7 @@ Terminal::MW(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::NAK(vte::parser::Sequence const& seq)
+Emulation::NAK(vte::parser::Sequence const& seq)
 {
         /*
          * NAK - negative acknowledge
@@ -6246,7 +5891,7 @@ Terminal::NAK(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::NBH(vte::parser::Sequence const& seq)
+Emulation::NBH(vte::parser::Sequence const& seq)
 {
         /*
          * BPH - no break permitted here
@@ -6258,7 +5903,7 @@ Terminal::NBH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::NEL(vte::parser::Sequence const& seq)
+Emulation::NEL(vte::parser::Sequence const& seq)
 {
         /*
          * NEL - next-line
@@ -6278,7 +5923,7 @@ Terminal::NEL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::NP(vte::parser::Sequence const& seq)
+Emulation::NP(vte::parser::Sequence const& seq)
 {
         /*
          * NP - next-page
@@ -6299,7 +5944,7 @@ Terminal::NP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::NUL(vte::parser::Sequence const& seq)
+Emulation::NUL(vte::parser::Sequence const& seq)
 {
         /*
          * NUL - nothing
@@ -6309,7 +5954,7 @@ Terminal::NUL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::OSC(vte::parser::Sequence const& seq)
+Emulation::OSC(vte::parser::Sequence const& seq)
 {
         /*
          * OSC - operating system command
@@ -6325,8 +5970,8 @@ Terminal::OSC(vte::parser::Sequence const& seq)
          * First, extract the number.
          */
 
-        auto str = seq.string_utf8();
-        vte::parser::StringTokeniser tokeniser{str, ';'};
+        /* The string stays in the parser's buffer; only the tokens are copied */
+        vte::parser::StringTokeniser tokeniser{seq.string_utf8_view(), ';'};
         auto it = tokeniser.cbegin();
         int osc;
         if (!it.number(osc))
@@ -6459,7 +6104,7 @@ Terminal::OSC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PEC(vte::parser::Sequence const& seq)
+Emulation::PEC(vte::parser::Sequence const& seq)
 {
         /*
          * PEC - presentation expand or contract
@@ -6471,7 +6116,7 @@ Terminal::PEC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PFS(vte::parser::Sequence const& seq)
+Emulation::PFS(vte::parser::Sequence const& seq)
 {
         /*
          * PFS - page format selection
@@ -6483,7 +6128,7 @@ Terminal::PFS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PLD(vte::parser::Sequence const& seq)
+Emulation::PLD(vte::parser::Sequence const& seq)
 {
         /*
          * PLD - partial line forward
@@ -6495,7 +6140,7 @@ Terminal::PLD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PLU(vte::parser::Sequence const& seq)
+Emulation::PLU(vte::parser::Sequence const& seq)
 {
         /*
          * PLU - partial line backward
@@ -6507,7 +6152,7 @@ Terminal::PLU(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PP(vte::parser::Sequence const& seq)
+Emulation::PP(vte::parser::Sequence const& seq)
 {
         /*
          * PP - preceding page
@@ -6528,7 +6173,7 @@ Terminal::PP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PPA(vte::parser::Sequence const& seq)
+Emulation::PPA(vte::parser::Sequence const& seq)
 {
         /*
          * PPA - page position absolute
@@ -6550,7 +6195,7 @@ Terminal::PPA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PPB(vte::parser::Sequence const& seq)
+Emulation::PPB(vte::parser::Sequence const& seq)
 {
         /*
          * PPB - page position backward
@@ -6571,7 +6216,7 @@ Terminal::PPB(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PPR(vte::parser::Sequence const& seq)
+Emulation::PPR(vte::parser::Sequence const& seq)
 {
         /*
          * PPR - page position foward
@@ -6592,7 +6237,7 @@ Terminal::PPR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PTX(vte::parser::Sequence const& seq)
+Emulation::PTX(vte::parser::Sequence const& seq)
 {
         /*
          * PTX - parallel texts
@@ -6620,7 +6265,7 @@ Terminal::PTX(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PU1(vte::parser::Sequence const& seq)
+Emulation::PU1(vte::parser::Sequence const& seq)
 {
         /*
          * PU1 - private use 1
@@ -6632,7 +6277,7 @@ Terminal::PU1(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::PU2(vte::parser::Sequence const& seq)
+Emulation::PU2(vte::parser::Sequence const& seq)
 {
         /*
          * PU1 - private use 2
@@ -6644,7 +6289,7 @@ Terminal::PU2(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::QUAD(vte::parser::Sequence const& seq)
+Emulation::QUAD(vte::parser::Sequence const& seq)
 {
         /*
          * QUAD - quad
@@ -6656,7 +6301,7 @@ Terminal::QUAD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::REP(vte::parser::Sequence const& seq)
+Emulation::REP(vte::parser::Sequence const& seq)
 {
         /*
          * REP - repeat
@@ -6674,13 +6319,15 @@ Terminal::REP(vte::parser::Sequence const& seq)
 
         auto const count = seq.collect1(0, 1, 1, int(m_column_count - m_screen->cursor.col));
 
-        // FIXMEchpe insert in one run so we only clean up fragments once
-        for (auto i = 0; i < count; i++)
-                insert_char(m_last_graphic_character, false, true);
+        /* Insert them in runs so we only clean up fragments once per run */
+        gunichar chars[k_insert_chars_max];
+        std::fill_n(chars, std::min(size_t(count), k_insert_chars_max), m_last_graphic_character);
+        for (size_t i = 0; i < size_t(count); )
+                i += insert_chars(chars, std::min(size_t(count) - i, k_insert_chars_max), false, true);
 }
 
 void
-Terminal::RI(vte::parser::Sequence const& seq)
+Emulation::RI(vte::parser::Sequence const& seq)
 {
         /*
          * RI - reverse-index
@@ -6707,10 +6354,9 @@ Terminal::RI(vte::parser::Sequence const& seq)
         if (m_screen->cursor.row == start) {
 		/* If we're at the top of the scrolling region, add a
 		 * line at the top to scroll the bottom off. */
-		ring_remove(end);
-		ring_insert(start, true);
+		ring_rotate(start, end, 1);
 		/* Update the display. */
-                invalidate_rows(start, end);
+                m_sink->invalidate_rows(start, end);
 	} else {
 		/* Otherwise, just move the cursor up. */
                 m_screen->cursor.row--;
@@ -6722,7 +6368,7 @@ Terminal::RI(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::RIS(vte::parser::Sequence const& seq)
+Emulation::RIS(vte::parser::Sequence const& seq)
 {
         /*
          * RIS - reset-to-initial-state
@@ -6732,11 +6378,17 @@ Terminal::RIS(vte::parser::Sequence const& seq)
          * References: ECMA-48 § 8.3.105
          */
 
+        /* Ends the dispatch profile so far, see dump_dispatch_profile() */
+        if (G_UNLIKELY(m_dispatch_profiler)) {
+                m_dispatch_profiler->dump("the terminal until RIS");
+                m_dispatch_profiler->reset();
+        }
+
 	reset(true, true);
 }
 
 void
-Terminal::RLOGIN_MML(vte::parser::Sequence const& seq)
+Emulation::RLOGIN_MML(vte::parser::Sequence const& seq)
 {
         /*
          * RLOGIN_MML - RLogin music markup language
@@ -6748,7 +6400,7 @@ Terminal::RLOGIN_MML(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::RM_ECMA(vte::parser::Sequence const& seq)
+Emulation::RM_ECMA(vte::parser::Sequence const& seq)
 {
         /*
          * RM_ECMA - reset-mode-ecma
@@ -6762,7 +6414,7 @@ Terminal::RM_ECMA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::RM_DEC(vte::parser::Sequence const& seq)
+Emulation::RM_DEC(vte::parser::Sequence const& seq)
 {
         /*
          * RM_DEC - reset-mode-dec
@@ -6777,7 +6429,7 @@ Terminal::RM_DEC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SCORC(vte::parser::Sequence const& seq)
+Emulation::SCORC(vte::parser::Sequence const& seq)
 {
         /*
          * SCORC - SCO restore cursor
@@ -6796,7 +6448,7 @@ Terminal::SCORC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SCOSC(vte::parser::Sequence const& seq)
+Emulation::SCOSC(vte::parser::Sequence const& seq)
 {
         /*
          * SCORC - SCO save cursor
@@ -6812,7 +6464,7 @@ Terminal::SCOSC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SACS(vte::parser::Sequence const& seq)
+Emulation::SACS(vte::parser::Sequence const& seq)
 {
         /*
          * SACS - set additional character separation
@@ -6830,7 +6482,7 @@ Terminal::SACS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SAPV(vte::parser::Sequence const& seq)
+Emulation::SAPV(vte::parser::Sequence const& seq)
 {
         /*
          * SAPV - select alternative presentation variants
@@ -6849,7 +6501,7 @@ Terminal::SAPV(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SCO(vte::parser::Sequence const& seq)
+Emulation::SCO(vte::parser::Sequence const& seq)
 {
         /*
          * SCO - select character orientation
@@ -6867,7 +6519,7 @@ Terminal::SCO(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SCP(vte::parser::Sequence const& seq)
+Emulation::SCP(vte::parser::Sequence const& seq)
 {
         /*
          * SCP - select character path
@@ -6892,7 +6544,7 @@ Terminal::SCP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SCS(vte::parser::Sequence const& seq)
+Emulation::SCS(vte::parser::Sequence const& seq)
 {
         /*
          * SCS - set character spacing
@@ -6908,7 +6560,7 @@ Terminal::SCS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SD(vte::parser::Sequence const& seq)
+Emulation::SD(vte::parser::Sequence const& seq)
 {
         /*
          * SD - scroll down / pan up
@@ -6942,7 +6594,7 @@ Terminal::SD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SD_OR_XTERM_IHMT(vte::parser::Sequence const& seq)
+Emulation::SD_OR_XTERM_IHMT(vte::parser::Sequence const& seq)
 {
         /*
          * There's a conflict between SD and XTERM IHMT that we
@@ -6958,7 +6610,7 @@ Terminal::SD_OR_XTERM_IHMT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SDS(vte::parser::Sequence const& seq)
+Emulation::SDS(vte::parser::Sequence const& seq)
 {
         /*
          * SDS - start directed string
@@ -6977,7 +6629,7 @@ Terminal::SDS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SEE(vte::parser::Sequence const& seq)
+Emulation::SEE(vte::parser::Sequence const& seq)
 {
         /*
          * SEE - select editing extent
@@ -6998,7 +6650,7 @@ Terminal::SEE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SEF(vte::parser::Sequence const& seq)
+Emulation::SEF(vte::parser::Sequence const& seq)
 {
         /*
          * SEF - sheet eject and feed
@@ -7018,7 +6670,7 @@ Terminal::SEF(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SGR(vte::parser::Sequence const& seq)
+Emulation::SGR(vte::parser::Sequence const& seq)
 {
         /*
          * SGR - select-graphics-rendition
@@ -7035,127 +6687,7 @@ Terminal::SGR(vte::parser::Sequence const& seq)
          * References: ECMA-48 § 8.3.117
          *             VT525
          */
-        auto const n_params = seq.size();
-
-	/* If we had no parameters, default to the defaults. */
-	if (n_params == 0) {
-                reset_default_attributes(false);
-                return;
-	}
-
-        for (unsigned int i = 0; i < n_params; i = seq.next(i)) {
-                auto const param = seq.param(i);
-                switch (param) {
-                case -1:
-                case VTE_SGR_RESET_ALL:
-                        reset_default_attributes(false);
-                        break;
-                case VTE_SGR_SET_BOLD:
-                        m_defaults.attr.set_bold(true);
-                        break;
-                case VTE_SGR_SET_DIM:
-                        m_defaults.attr.set_dim(true);
-                        break;
-                case VTE_SGR_SET_ITALIC:
-                        m_defaults.attr.set_italic(true);
-                        break;
-                case VTE_SGR_SET_UNDERLINE: {
-                        unsigned int v = 1;
-                        /* If we have a subparameter, get it */
-                        if (seq.param_nonfinal(i)) {
-                                v = seq.param(i + 1, 1, 0, 3);
-                        }
-                        m_defaults.attr.set_underline(v);
-                        break;
-                }
-                case VTE_SGR_SET_BLINK:
-                        m_defaults.attr.set_blink(true);
-                        break;
-                case VTE_SGR_SET_REVERSE:
-                        m_defaults.attr.set_reverse(true);
-                        break;
-                case VTE_SGR_SET_INVISIBLE:
-                        m_defaults.attr.set_invisible(true);
-                        break;
-                case VTE_SGR_SET_STRIKETHROUGH:
-                        m_defaults.attr.set_strikethrough(true);
-                        break;
-                case VTE_SGR_SET_UNDERLINE_DOUBLE:
-                        m_defaults.attr.set_underline(2);
-                        break;
-                case VTE_SGR_RESET_BOLD_AND_DIM:
-                        m_defaults.attr.unset(VTE_ATTR_BOLD_MASK | VTE_ATTR_DIM_MASK);
-                        break;
-                case VTE_SGR_RESET_ITALIC:
-                        m_defaults.attr.set_italic(false);
-                        break;
-                case VTE_SGR_RESET_UNDERLINE:
-                        m_defaults.attr.set_underline(0);
-                        break;
-                case VTE_SGR_RESET_BLINK:
-                        m_defaults.attr.set_blink(false);
-                        break;
-                case VTE_SGR_RESET_REVERSE:
-                        m_defaults.attr.set_reverse(false);
-                        break;
-                case VTE_SGR_RESET_INVISIBLE:
-                        m_defaults.attr.set_invisible(false);
-                        break;
-                case VTE_SGR_RESET_STRIKETHROUGH:
-                        m_defaults.attr.set_strikethrough(false);
-                        break;
-                case VTE_SGR_SET_FORE_LEGACY_START ... VTE_SGR_SET_FORE_LEGACY_END:
-                        m_defaults.attr.set_fore(VTE_LEGACY_COLORS_OFFSET + (param - 30));
-                        break;
-                case VTE_SGR_SET_FORE_SPEC: {
-                        uint32_t fore;
-                        if (G_LIKELY((seq_parse_sgr_color<8, 8, 8>(seq, i, fore))))
-                                m_defaults.attr.set_fore(fore);
-                        break;
-                }
-                case VTE_SGR_RESET_FORE:
-                        /* default foreground */
-                        m_defaults.attr.set_fore(VTE_DEFAULT_FG);
-                        break;
-                case VTE_SGR_SET_BACK_LEGACY_START ... VTE_SGR_SET_BACK_LEGACY_END:
-                        m_defaults.attr.set_back(VTE_LEGACY_COLORS_OFFSET + (param - 40));
-                        break;
-                case VTE_SGR_SET_BACK_SPEC: {
-                        uint32_t back;
-                        if (G_LIKELY((seq_parse_sgr_color<8, 8, 8>(seq, i, back))))
-                                m_defaults.attr.set_back(back);
-                        break;
-                }
-                case VTE_SGR_RESET_BACK:
-                        /* default background */
-                        m_defaults.attr.set_back(VTE_DEFAULT_BG);
-                        break;
-                case VTE_SGR_SET_OVERLINE:
-                        m_defaults.attr.set_overline(true);
-                        break;
-                case VTE_SGR_RESET_OVERLINE:
-                        m_defaults.attr.set_overline(false);
-                        break;
-                case VTE_SGR_SET_DECO_SPEC: {
-                        uint32_t deco;
-                        if (G_LIKELY((seq_parse_sgr_color<4, 5, 4>(seq, i, deco))))
-                                m_defaults.attr.set_deco(deco);
-                        break;
-                }
-                case VTE_SGR_RESET_DECO:
-                        /* default decoration color, that is, same as the cell's foreground */
-                        m_defaults.attr.set_deco(VTE_DEFAULT_FG);
-                        break;
-                case VTE_SGR_SET_FORE_LEGACY_BRIGHT_START ... VTE_SGR_SET_FORE_LEGACY_BRIGHT_END:
-                        m_defaults.attr.set_fore(VTE_LEGACY_COLORS_OFFSET + (param - 90) +
-                                                 VTE_COLOR_BRIGHT_OFFSET);
-                        break;
-                case VTE_SGR_SET_BACK_LEGACY_BRIGHT_START ... VTE_SGR_SET_BACK_LEGACY_BRIGHT_END:
-                        m_defaults.attr.set_back(VTE_LEGACY_COLORS_OFFSET + (param - 100) +
-                                                 VTE_COLOR_BRIGHT_OFFSET);
-                        break;
-                }
-        }
+        vte::terminal::apply_sgr(seq, m_defaults.attr);
 
 	/* Save the new colors. */
         m_color_defaults.attr.copy_colors(m_defaults.attr);
@@ -7163,7 +6695,7 @@ Terminal::SGR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SHS(vte::parser::Sequence const& seq)
+Emulation::SHS(vte::parser::Sequence const& seq)
 {
         /*
          * SHS - select character spacing
@@ -7181,7 +6713,7 @@ Terminal::SHS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SIMD(vte::parser::Sequence const& seq)
+Emulation::SIMD(vte::parser::Sequence const& seq)
 {
         /*
          * SIMD - select implicit movement direction
@@ -7199,7 +6731,7 @@ Terminal::SIMD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SL(vte::parser::Sequence const& seq)
+Emulation::SL(vte::parser::Sequence const& seq)
 {
         /*
          * SL - scroll left
@@ -7217,7 +6749,7 @@ Terminal::SL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SLH(vte::parser::Sequence const& seq)
+Emulation::SLH(vte::parser::Sequence const& seq)
 {
         /*
          * SLH - set line home
@@ -7236,7 +6768,7 @@ Terminal::SLH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SLL(vte::parser::Sequence const& seq)
+Emulation::SLL(vte::parser::Sequence const& seq)
 {
         /*
          * SLL - set line limit
@@ -7255,7 +6787,7 @@ Terminal::SLL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SLS(vte::parser::Sequence const& seq)
+Emulation::SLS(vte::parser::Sequence const& seq)
 {
         /*
          * SLS - set line spacing
@@ -7273,7 +6805,7 @@ Terminal::SLS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SM_ECMA(vte::parser::Sequence const& seq)
+Emulation::SM_ECMA(vte::parser::Sequence const& seq)
 {
         /*
          * SM_ECMA - set-mode-ecma
@@ -7287,7 +6819,7 @@ Terminal::SM_ECMA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SM_DEC(vte::parser::Sequence const& seq)
+Emulation::SM_DEC(vte::parser::Sequence const& seq)
 {
         /*
          * SM_DEC - set-mode-dec
@@ -7302,7 +6834,7 @@ Terminal::SM_DEC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SOH(vte::parser::Sequence const& seq)
+Emulation::SOH(vte::parser::Sequence const& seq)
 {
         /*
          * SOH - start of heading
@@ -7312,7 +6844,7 @@ Terminal::SOH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SPA(vte::parser::Sequence const& seq)
+Emulation::SPA(vte::parser::Sequence const& seq)
 {
         /*
          * SPA - start of protected area
@@ -7329,7 +6861,7 @@ Terminal::SPA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SPD(vte::parser::Sequence const& seq)
+Emulation::SPD(vte::parser::Sequence const& seq)
 {
         /*
          * SPD - select presentation directions
@@ -7359,7 +6891,7 @@ Terminal::SPD(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SPH(vte::parser::Sequence const& seq)
+Emulation::SPH(vte::parser::Sequence const& seq)
 {
         /*
          * SPH - set page home
@@ -7378,7 +6910,7 @@ Terminal::SPH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SPI(vte::parser::Sequence const& seq)
+Emulation::SPI(vte::parser::Sequence const& seq)
 {
         /*
          * SPI - spacing increment
@@ -7397,7 +6929,7 @@ Terminal::SPI(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SPL(vte::parser::Sequence const& seq)
+Emulation::SPL(vte::parser::Sequence const& seq)
 {
         /*
          * SPL - set page limit
@@ -7416,7 +6948,7 @@ Terminal::SPL(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SPQR(vte::parser::Sequence const& seq)
+Emulation::SPQR(vte::parser::Sequence const& seq)
 {
         /*
          * SPQR - select print quality and rapidity
@@ -7432,7 +6964,7 @@ Terminal::SPQR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SR(vte::parser::Sequence const& seq)
+Emulation::SR(vte::parser::Sequence const& seq)
 {
         /*
          * SL - scroll right
@@ -7450,7 +6982,7 @@ Terminal::SR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SRCS(vte::parser::Sequence const& seq)
+Emulation::SRCS(vte::parser::Sequence const& seq)
 {
         /*
          * SRCS - set reduced character separation
@@ -7468,7 +7000,7 @@ Terminal::SRCS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SRS(vte::parser::Sequence const& seq)
+Emulation::SRS(vte::parser::Sequence const& seq)
 {
         /*
          * SRS - start reversed string
@@ -7486,7 +7018,7 @@ Terminal::SRS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SSA(vte::parser::Sequence const& seq)
+Emulation::SSA(vte::parser::Sequence const& seq)
 {
         /*
          * SSA - start of selected area
@@ -7503,7 +7035,7 @@ Terminal::SSA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SSU(vte::parser::Sequence const& seq)
+Emulation::SSU(vte::parser::Sequence const& seq)
 {
         /*
          * SSU - set size unit
@@ -7519,7 +7051,7 @@ Terminal::SSU(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SSW(vte::parser::Sequence const& seq)
+Emulation::SSW(vte::parser::Sequence const& seq)
 {
         /*
          * SSW - set space width
@@ -7535,7 +7067,7 @@ Terminal::SSW(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SS2(vte::parser::Sequence const& seq)
+Emulation::SS2(vte::parser::Sequence const& seq)
 {
         /*
          * SS2 - single-shift-2
@@ -7551,7 +7083,7 @@ Terminal::SS2(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SS3(vte::parser::Sequence const& seq)
+Emulation::SS3(vte::parser::Sequence const& seq)
 {
         /*
          * SS3 - single-shift-3
@@ -7567,7 +7099,7 @@ Terminal::SS3(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::ST(vte::parser::Sequence const& seq)
+Emulation::ST(vte::parser::Sequence const& seq)
 {
         /*
          * ST - string-terminator
@@ -7580,7 +7112,7 @@ Terminal::ST(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::STAB(vte::parser::Sequence const& seq)
+Emulation::STAB(vte::parser::Sequence const& seq)
 {
         /*
          * STAB - selective tabulation
@@ -7597,7 +7129,7 @@ Terminal::STAB(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::STS(vte::parser::Sequence const& seq)
+Emulation::STS(vte::parser::Sequence const& seq)
 {
         /*
          * STS - set transmit state
@@ -7609,7 +7141,7 @@ Terminal::STS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::STX(vte::parser::Sequence const& seq)
+Emulation::STX(vte::parser::Sequence const& seq)
 {
         /*
          * STX - start of text
@@ -7622,7 +7154,7 @@ Terminal::STX(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SU(vte::parser::Sequence const& seq)
+Emulation::SU(vte::parser::Sequence const& seq)
 {
         /*
          * SU - scroll-up / pan down
@@ -7655,7 +7187,7 @@ Terminal::SU(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SUB(vte::parser::Sequence const& seq)
+Emulation::SUB(vte::parser::Sequence const& seq)
 {
         /*
          * SUB - substitute
@@ -7670,7 +7202,7 @@ Terminal::SUB(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SVS(vte::parser::Sequence const& seq)
+Emulation::SVS(vte::parser::Sequence const& seq)
 {
         /*
          * SVS - select line spacing
@@ -7689,7 +7221,7 @@ Terminal::SVS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::SYN(vte::parser::Sequence const& seq)
+Emulation::SYN(vte::parser::Sequence const& seq)
 {
         /*
          * SYN - synchronous idle
@@ -7702,7 +7234,7 @@ Terminal::SYN(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::TAC(vte::parser::Sequence const& seq)
+Emulation::TAC(vte::parser::Sequence const& seq)
 {
         /*
          * TAC - tabulation aligned centre
@@ -7715,7 +7247,7 @@ Terminal::TAC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::TALE(vte::parser::Sequence const& seq)
+Emulation::TALE(vte::parser::Sequence const& seq)
 {
         /*
          * TALE - tabulation aligned leading edge
@@ -7728,7 +7260,7 @@ Terminal::TALE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::TATE(vte::parser::Sequence const& seq)
+Emulation::TATE(vte::parser::Sequence const& seq)
 {
         /*
          * TATE - tabulation aligned trailing edge
@@ -7741,7 +7273,7 @@ Terminal::TATE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::TBC(vte::parser::Sequence const& seq)
+Emulation::TBC(vte::parser::Sequence const& seq)
 {
         /*
          * TBC - tab-clear
@@ -7788,7 +7320,7 @@ Terminal::TBC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::TCC(vte::parser::Sequence const& seq)
+Emulation::TCC(vte::parser::Sequence const& seq)
 {
         /*
          * TCC - tabulation centred on character
@@ -7802,7 +7334,7 @@ Terminal::TCC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::TSR(vte::parser::Sequence const& seq)
+Emulation::TSR(vte::parser::Sequence const& seq)
 {
         /*
          * TSR - tabulation stop remove
@@ -7823,7 +7355,7 @@ Terminal::TSR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::TSS(vte::parser::Sequence const& seq)
+Emulation::TSS(vte::parser::Sequence const& seq)
 {
         /*
          * TSS - thin space specification
@@ -7841,7 +7373,7 @@ Terminal::TSS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::VPA(vte::parser::Sequence const& seq)
+Emulation::VPA(vte::parser::Sequence const& seq)
 {
         /*
          * VPA - vertical line position absolute
@@ -7874,7 +7406,7 @@ Terminal::VPA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::VPB(vte::parser::Sequence const& seq)
+Emulation::VPB(vte::parser::Sequence const& seq)
 {
         /*
          * VPB - line position backward
@@ -7902,7 +7434,7 @@ Terminal::VPB(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::VPR(vte::parser::Sequence const& seq)
+Emulation::VPR(vte::parser::Sequence const& seq)
 {
         /*
          * VPR - vertical line position relative
@@ -7930,7 +7462,7 @@ Terminal::VPR(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::VT(vte::parser::Sequence const& seq)
+Emulation::VT(vte::parser::Sequence const& seq)
 {
         /*
          * VT - vertical-tab
@@ -7944,7 +7476,7 @@ Terminal::VT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::VTS(vte::parser::Sequence const& seq)
+Emulation::VTS(vte::parser::Sequence const& seq)
 {
         /*
          * VTS - line tabulation set
@@ -7957,7 +7489,7 @@ Terminal::VTS(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::WYCAA(vte::parser::Sequence const& seq)
+Emulation::WYCAA(vte::parser::Sequence const& seq)
 {
         /*
          * WYCAA - redefine character display attribute association
@@ -8117,7 +7649,7 @@ Terminal::WYCAA(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::WYDHL_BH(vte::parser::Sequence const& seq)
+Emulation::WYDHL_BH(vte::parser::Sequence const& seq)
 {
         /*
          * WYDHL_BH - single width double height line: bottom half
@@ -8129,7 +7661,7 @@ Terminal::WYDHL_BH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::WYDHL_TH(vte::parser::Sequence const& seq)
+Emulation::WYDHL_TH(vte::parser::Sequence const& seq)
 {
         /*
          * WYDHL_TH - single width double height line: top half
@@ -8141,7 +7673,7 @@ Terminal::WYDHL_TH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::WYSCRATE(vte::parser::Sequence const& seq)
+Emulation::WYSCRATE(vte::parser::Sequence const& seq)
 {
         /*
          * WYSCRATE - set smooth scroll rate
@@ -8154,7 +7686,7 @@ Terminal::WYSCRATE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::WYLSFNT(vte::parser::Sequence const& seq)
+Emulation::WYLSFNT(vte::parser::Sequence const& seq)
 {
         /*
          * WYLSFNT - load soft font
@@ -8166,7 +7698,7 @@ Terminal::WYLSFNT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XDGSYNC(vte::parser::Sequence const& seq)
+Emulation::XDGSYNC(vte::parser::Sequence const& seq)
 {
         /*
          * XDGSYNC - synchronous update
@@ -8192,7 +7724,7 @@ Terminal::XDGSYNC(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_CHECKSUM_MODE(vte::parser::Sequence const& seq)
+Emulation::XTERM_CHECKSUM_MODE(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_CHECKSUM_MODE - xterm DECRQCRA checksum mode
@@ -8217,7 +7749,7 @@ Terminal::XTERM_CHECKSUM_MODE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_IHMT(vte::parser::Sequence const& seq)
+Emulation::XTERM_IHMT(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_IHMT - xterm-initiate-highlight-mouse-tracking
@@ -8227,7 +7759,7 @@ Terminal::XTERM_IHMT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_MLHP(vte::parser::Sequence const& seq)
+Emulation::XTERM_MLHP(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_MLHP - xterm-memory-lock-hp-bugfix
@@ -8237,7 +7769,7 @@ Terminal::XTERM_MLHP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_MUHP(vte::parser::Sequence const& seq)
+Emulation::XTERM_MUHP(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_MUHP - xterm-memory-unlock-hp-bugfix
@@ -8247,7 +7779,7 @@ Terminal::XTERM_MUHP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_RPM(vte::parser::Sequence const& seq)
+Emulation::XTERM_RPM(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_RPM - xterm restore DEC private mode
@@ -8261,7 +7793,7 @@ Terminal::XTERM_RPM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_RQTCAP(vte::parser::Sequence const& seq)
+Emulation::XTERM_RQTCAP(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_TQTCAP - xterm request termcap/terminfo
@@ -8271,7 +7803,7 @@ Terminal::XTERM_RQTCAP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_RRV(vte::parser::Sequence const& seq)
+Emulation::XTERM_RRV(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_RRV - xterm-reset-resource-value
@@ -8281,7 +7813,7 @@ Terminal::XTERM_RRV(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_RTM(vte::parser::Sequence const& seq)
+Emulation::XTERM_RTM(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_RTM - xterm-reset-title-mode
@@ -8291,7 +7823,7 @@ Terminal::XTERM_RTM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_SGFX(vte::parser::Sequence const& seq)
+Emulation::XTERM_SGFX(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_SGFX - xterm-sixel-graphics
@@ -8301,7 +7833,7 @@ Terminal::XTERM_SGFX(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_SGR_REPORT(vte::parser::Sequence const& seq)
+Emulation::XTERM_SGR_REPORT(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_SGR_REPORT: report SGR attributes in rectangular area
@@ -8333,7 +7865,7 @@ Terminal::XTERM_SGR_REPORT(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_SGR_STACK_POP(vte::parser::Sequence const& seq)
+Emulation::XTERM_SGR_STACK_POP(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_SGR_STACK_POP: pop SGR stack
@@ -8349,7 +7881,7 @@ Terminal::XTERM_SGR_STACK_POP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_SGR_STACK_PUSH(vte::parser::Sequence const& seq)
+Emulation::XTERM_SGR_STACK_PUSH(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_SGR_STACK_PUSH: push SGR stack
@@ -8374,7 +7906,7 @@ Terminal::XTERM_SGR_STACK_PUSH(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_SPM(vte::parser::Sequence const& seq)
+Emulation::XTERM_SPM(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_SPM - xterm save DEC private mode
@@ -8388,7 +7920,7 @@ Terminal::XTERM_SPM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_PTRMODE(vte::parser::Sequence const& seq)
+Emulation::XTERM_PTRMODE(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_PTRMODE - xterm set pointer mode
@@ -8402,7 +7934,7 @@ Terminal::XTERM_PTRMODE(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_SRV(vte::parser::Sequence const& seq)
+Emulation::XTERM_SRV(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_SRV - xterm-set-resource-value
@@ -8412,7 +7944,7 @@ Terminal::XTERM_SRV(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_STM(vte::parser::Sequence const& seq)
+Emulation::XTERM_STM(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_STM - xterm-set-title-mode
@@ -8422,7 +7954,7 @@ Terminal::XTERM_STM(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_STCAP(vte::parser::Sequence const& seq)
+Emulation::XTERM_STCAP(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_STCAP - xterm set termcap/terminfo
@@ -8432,7 +7964,7 @@ Terminal::XTERM_STCAP(vte::parser::Sequence const& seq)
 }
 
 void
-Terminal::XTERM_WM(vte::parser::Sequence const& seq)
+Emulation::XTERM_WM(vte::parser::Sequence const& seq)
 {
         /*
          * XTERM_WM - xterm-window-management
@@ -8460,12 +7992,12 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
 
         case VTE_XTERM_WM_RESTORE_WINDOW:
                 _vte_debug_print(VTE_DEBUG_EMULATION, "Deiconifying window.\n");
-                emit_deiconify_window();
+                m_sink->emit_deiconify_window();
                 break;
 
         case VTE_XTERM_WM_MINIMIZE_WINDOW:
                 _vte_debug_print(VTE_DEBUG_EMULATION, "Iconifying window.\n");
-                emit_iconify_window();
+                m_sink->emit_iconify_window();
                 break;
 
         case VTE_XTERM_WM_SET_WINDOW_POSITION: {
@@ -8474,7 +8006,7 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
 
                 _vte_debug_print(VTE_DEBUG_EMULATION,
                                  "Moving window to %d,%d.\n", pos_x, pos_y);
-                emit_move_window(pos_x, pos_y);
+                m_sink->emit_move_window(pos_x, pos_y);
                 break;
         }
 
@@ -8483,29 +8015,31 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                 seq.collect(1, {&height, &width});
 
                 if (width != -1 && height != -1) {
+                        auto const cell_width = int(m_sink->get_cell_width());
+                        auto const cell_height = int(m_sink->get_cell_height());
                         _vte_debug_print(VTE_DEBUG_EMULATION,
                                          "Resizing window to %dx%d pixels, grid size %dx%d.\n",
                                          width, height,
-                                         width / int(m_cell_height), height / int(m_cell_width));
-                        emit_resize_window(width / int(m_cell_height), height / int(m_cell_width));
+                                         width / cell_height, height / cell_width);
+                        m_sink->emit_resize_window(width / cell_height, height / cell_width);
                 }
                 break;
         }
 
         case VTE_XTERM_WM_RAISE_WINDOW:
                 _vte_debug_print(VTE_DEBUG_EMULATION, "Raising window.\n");
-                emit_raise_window();
+                m_sink->emit_raise_window();
                 break;
 
         case VTE_XTERM_WM_LOWER_WINDOW:
                 _vte_debug_print(VTE_DEBUG_EMULATION, "Lowering window.\n");
-                emit_lower_window();
+                m_sink->emit_lower_window();
                 break;
 
         case VTE_XTERM_WM_REFRESH_WINDOW:
                 _vte_debug_print(VTE_DEBUG_EMULATION, "Refreshing window.\n");
-                invalidate_all();
-                emit_refresh_window();
+                m_sink->invalidate_all();
+                m_sink->emit_refresh_window();
                 break;
 
         case VTE_XTERM_WM_SET_WINDOW_SIZE_CELLS: {
@@ -8516,7 +8050,7 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                         _vte_debug_print(VTE_DEBUG_EMULATION,
                                          "Resizing window to %d columns, %d rows.\n",
                                          width, height);
-                        emit_resize_window(width, height);
+                        m_sink->emit_resize_window(width, height);
                 }
                 break;
         }
@@ -8527,12 +8061,12 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                 case 0:
                         /* Restore */
                         _vte_debug_print(VTE_DEBUG_EMULATION, "Restoring window.\n");
-                        emit_restore_window();
+                        m_sink->emit_restore_window();
                         break;
                 case 1:
                         /* Maximise */
                         _vte_debug_print(VTE_DEBUG_EMULATION, "Maximizing window.\n");
-                        emit_maximize_window();
+                        m_sink->emit_maximize_window();
                         break;
                 case 2:
                         /* Maximise Vertically */
@@ -8552,10 +8086,10 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                 /* If we're unmapped, then we're iconified. */
                 _vte_debug_print(VTE_DEBUG_EMULATION,
                                  "Reporting window state %siconified.\n",
-                                 gtk_widget_get_mapped(m_widget) ? "non-" : "");
+                                 m_sink->is_mapped() ? "non-" : "");
 
                 reply(seq, VTE_REPLY_XTERM_WM,
-                      {gtk_widget_get_mapped(m_widget) ? 1 : 2});
+                      {m_sink->is_mapped() ? 1 : 2});
                 break;
 
         case VTE_XTERM_WM_GET_WINDOW_POSITION: {
@@ -8564,19 +8098,19 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                  * it to a fixed return always.
                  */
                 int x0, y0;
-                gdk_window_get_origin(gtk_widget_get_window(m_widget), &x0, &y0);
+                m_sink->get_window_origin(&x0, &y0);
                 _vte_debug_print(VTE_DEBUG_EMULATION,
                                  "Reporting window location (%d,%d).\n", x0, y0);
 
                 reply(seq, VTE_REPLY_XTERM_WM,
-                      {3, x0 + m_padding.left, y0 + m_padding.top});
+                      {3, x0, y0});
                 break;
         }
 
         case VTE_XTERM_WM_GET_WINDOW_SIZE_PIXELS: {
                 /* Send window size, in pixels. */
-                int width = m_row_count * m_cell_height;
-                int height = m_column_count * m_cell_width;
+                int width = m_row_count * m_sink->get_cell_height();
+                int height = m_column_count * m_sink->get_cell_width();
                 _vte_debug_print(VTE_DEBUG_EMULATION,
                                  "Reporting window size (%dx%d)\n",
                                  width, height);
@@ -8599,15 +8133,16 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                 /* FIMXE: this should really report the monitor's workarea,
                  * or even just a fixed value.
                  */
-                auto gdkscreen = gtk_widget_get_screen(m_widget);
-                int height = gdk_screen_get_height(gdkscreen);
-                int width = gdk_screen_get_width(gdkscreen);
+                int width, height;
+                m_sink->get_screen_size(&width, &height);
+                auto const cell_width = int(m_sink->get_cell_width());
+                auto const cell_height = int(m_sink->get_cell_height());
                 _vte_debug_print(VTE_DEBUG_EMULATION,
                                  "Reporting screen size as %dx%d cells.\n",
-                                 height / int(m_cell_height), width / int(m_cell_width));
+                                 height / cell_height, width / cell_width);
 
                 reply(seq, VTE_REPLY_XTERM_WM,
-                      {9, height / int(m_cell_height), width / int(m_cell_width)});
+                      {9, height / cell_height, width / cell_width});
                 break;
         }
 
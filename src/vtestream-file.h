@@ -48,6 +48,9 @@
  *   the tail is kinda like a snake, and the mapping to file offsets reminds
  *   me of the well-known game on old mobile phones.
  *
+ *   For a memory stream, the snake keeps the blocks in a VteArena instead of
+ *   the file, and the layers above are the same.
+ *
  * o The middle layer is called VteBoa. It does compression and encryption
  *   along with integrity check. It has (almost) the same API as the snake,
  *   but the blocksize is a bit smaller to leave room for the required
@@ -58,6 +61,11 @@
  *   counter is incremented each time the data at a certain logical offset is
  *   overwritten, this is used in constructing a unique IV.
  *
+ *   When compressing with zstd, the boa can train a dictionary on its first
+ *   few blocks, and compress the rest with it. Like the encryption key, the
+ *   dictionary is kept in memory only, once per stream, since the file never
+ *   outlives the boa.
+ *
  *   The name was chosen because the world of encryption is full of three
  *   letter abbreviations. At this moment we use GNU TLS's method for doing
  *   AES GCM. Also, because grown-ups might think it's a hat, when actually
@@ -67,10 +75,10 @@
  *   to the previous layers, this one provides methods on arbitrary amount of
  *   data. It doesn't offer random-access-writes, instead, it offers appending
  *   data, and truncating the head (undoing the latest appends). Write
- *   requests are batched up until there's a complete block to be compressed,
- *   encrypted and written to disk. Read requests are answered by reading,
- *   decrypting and uncompressing possibly more underlying blocks, and sped up
- *   by caching the result.
+ *   requests are batched up until there's a complete block to be
+ *   compressed, encrypted and written to disk, which a separate thread does.
+ *   Read requests are answered by reading, decrypting and uncompressing
+ *   possibly more underlying blocks, and sped up by caching the result.
  *
  * Design discussions: https://bugzilla.gnome.org/show_bug.cgi?id=738601
  */
@@ -84,6 +92,16 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#ifdef WITH_LZ4
+# include <lz4.h>
+# include <lz4hc.h>
+#endif
+
+#ifdef WITH_ZSTD
+# include <zstd.h>
+# include <zdict.h>
+#endif
+
 #ifdef WITH_GNUTLS
 # include <gnutls/gnutls.h>
 # include <gnutls/crypto.h>
@@ -118,6 +136,12 @@ typedef guint8 _vte_overwrite_counter_t;
 #endif
 
 #define VTE_BLOCK_DATALENGTH_SIZE  sizeof(_vte_block_datalength_t)
+#ifndef VTESTREAM_MAIN
+# define VTE_BLOCK_CODEC_SHIFT 24
+#else
+# define VTE_BLOCK_CODEC_SHIFT 5
+#endif
+#define VTE_BLOCK_DATALENGTH_MASK ((1u << VTE_BLOCK_CODEC_SHIFT) - 1)
 #define VTE_OVERWRITE_COUNTER_SIZE sizeof(_vte_overwrite_counter_t)
 #define VTE_BOA_BLOCKSIZE (VTE_SNAKE_BLOCKSIZE - VTE_BLOCK_DATALENGTH_SIZE - VTE_OVERWRITE_COUNTER_SIZE - VTE_CIPHER_TAG_SIZE)
 
@@ -273,6 +297,236 @@ _file_write (int fd, const char *data, gsize len, gsize offset)
 
 /******************************************************************************************/
 
+/*
+ * VteArena: The file, in memory.
+ *
+ * A memory stream's snake keeps its blocks in an arena instead of a file.
+ * The arena has the same operations as the file above, but it holds each
+ * block only up to the length written, so a block takes as much memory as
+ * its compressed data. The blocks that holes are punched into or that are
+ * truncated go back to a pool shared by all the arenas. New blocks are taken
+ * from there, by size rounded up to VTE_ARENA_GRANULE, rather than from
+ * malloc.
+ */
+
+#ifndef VTESTREAM_MAIN
+# define VTE_ARENA_GRANULE 4096
+# define VTE_ARENA_POOL_MAX (8 * 1024 * 1024)
+#else
+/* Smaller sizes for unit testing */
+# define VTE_ARENA_GRANULE 2
+# define VTE_ARENA_POOL_MAX 8
+#endif
+#define VTE_ARENA_CLASSES ((VTE_SNAKE_BLOCKSIZE + VTE_ARENA_GRANULE - 1) / VTE_ARENA_GRANULE)
+
+typedef struct _VteArenaBlock {
+        char *data;             /* NULL for a hole */
+        gsize len;
+} VteArenaBlock;
+
+typedef struct _VteArena {
+        VteArenaBlock *blocks;  /* The file's blocks, NULL past n_blocks */
+        gsize n_blocks, n_blocks_allocated;
+} VteArena;
+
+/* The lock protects the pool, and the counters; the arenas themselves are
+ * only used by their snake. The free buffers in _vte_arena_pool[i] are
+ * i + 1 granules large. */
+static GMutex _vte_arena_pool_lock;
+static GPtrArray *_vte_arena_pool[VTE_ARENA_CLASSES];
+static gsize _vte_arena_pool_bytes;
+static gsize _vte_arena_bytes;
+static guint _vte_arena_n_arenas;
+
+static inline gsize
+_arena_class (gsize len)
+{
+        return (len - 1) / VTE_ARENA_GRANULE;
+}
+
+static char *
+_arena_alloc (gsize len)
+{
+        gsize class_ = _arena_class (len);
+        gsize size = (class_ + 1) * VTE_ARENA_GRANULE;
+        char *data = NULL;
+
+        g_mutex_lock (&_vte_arena_pool_lock);
+        if (_vte_arena_pool[class_] != NULL && _vte_arena_pool[class_]->len > 0) {
+                data = (char *) g_ptr_array_remove_index_fast (_vte_arena_pool[class_],
+                                                               _vte_arena_pool[class_]->len - 1);
+                _vte_arena_pool_bytes -= size;
+        }
+        _vte_arena_bytes += size;
+        g_mutex_unlock (&_vte_arena_pool_lock);
+
+        if (data == NULL)
+                data = (char *) g_malloc (size);
+        return data;
+}
+
+/* Frees the block's data, or keeps it in the pool if there's room */
+static void
+_arena_free_block (VteArenaBlock *block)
+{
+        gsize size;
+
+        if (block->data == NULL)
+                return;
+
+        size = (_arena_class (block->len) + 1) * VTE_ARENA_GRANULE;
+
+        g_mutex_lock (&_vte_arena_pool_lock);
+        _vte_arena_bytes -= size;
+        if (_vte_arena_pool_bytes + size <= VTE_ARENA_POOL_MAX) {
+                gsize class_ = _arena_class (block->len);
+
+                if (_vte_arena_pool[class_] == NULL)
+                        _vte_arena_pool[class_] = g_ptr_array_new ();
+                g_ptr_array_add (_vte_arena_pool[class_], block->data);
+                _vte_arena_pool_bytes += size;
+                block->data = NULL;
+        }
+        g_mutex_unlock (&_vte_arena_pool_lock);
+
+        g_free (block->data);
+        block->data = NULL;
+        block->len = 0;
+}
+
+static VteArena *
+_arena_new (void)
+{
+        g_mutex_lock (&_vte_arena_pool_lock);
+        _vte_arena_n_arenas++;
+        g_mutex_unlock (&_vte_arena_pool_lock);
+
+        return g_new0 (VteArena, 1);
+}
+
+static gboolean _arena_try_truncate (VteArena *arena, gsize offset);
+static void
+_arena_free (VteArena *arena)
+{
+        guint i;
+
+        if (arena == NULL)
+                return;
+
+        _arena_try_truncate (arena, 0);
+        g_free (arena->blocks);
+        g_free (arena);
+
+        /* Don't keep the pool around without any arena to use it */
+        g_mutex_lock (&_vte_arena_pool_lock);
+        if (--_vte_arena_n_arenas == 0) {
+                for (i = 0; i < VTE_ARENA_CLASSES; i++) {
+                        if (_vte_arena_pool[i] == NULL)
+                                continue;
+                        g_ptr_array_set_free_func (_vte_arena_pool[i], g_free);
+                        g_ptr_array_unref (_vte_arena_pool[i]);
+                        _vte_arena_pool[i] = NULL;
+                }
+                _vte_arena_pool_bytes = 0;
+        }
+        g_mutex_unlock (&_vte_arena_pool_lock);
+}
+
+/* Like the file, the arena grows when truncated to a larger size, with holes */
+static gboolean
+_arena_try_truncate (VteArena *arena, gsize offset)
+{
+        gsize i, n_blocks;
+
+        g_assert_cmpuint (offset % VTE_SNAKE_BLOCKSIZE, ==, 0);
+        n_blocks = offset / VTE_SNAKE_BLOCKSIZE;
+
+        for (i = n_blocks; i < arena->n_blocks; i++)
+                _arena_free_block (&arena->blocks[i]);
+
+        if (n_blocks > arena->n_blocks_allocated) {
+                arena->n_blocks_allocated = MAX(n_blocks, 2 * arena->n_blocks_allocated);
+                arena->blocks = g_renew (VteArenaBlock, arena->blocks, arena->n_blocks_allocated);
+        }
+        if (n_blocks > arena->n_blocks)
+                memset (arena->blocks + arena->n_blocks, 0, (n_blocks - arena->n_blocks) * sizeof (VteArenaBlock));
+        arena->n_blocks = n_blocks;
+
+        return TRUE;
+}
+
+static void
+_arena_reset (VteArena *arena)
+{
+        _arena_try_truncate (arena, 0);
+}
+
+static gboolean
+_arena_try_punch_hole (VteArena *arena, gsize offset, gsize len)
+{
+        gsize i;
+
+        g_assert_cmpuint (offset % VTE_SNAKE_BLOCKSIZE, ==, 0);
+        g_assert_cmpuint (len % VTE_SNAKE_BLOCKSIZE, ==, 0);
+
+        for (i = offset / VTE_SNAKE_BLOCKSIZE; i < (offset + len) / VTE_SNAKE_BLOCKSIZE && i < arena->n_blocks; i++)
+                _arena_free_block (&arena->blocks[i]);
+
+        return TRUE;
+}
+
+/* Reads a whole block. Past the length written, the data is left as it was,
+ * except that a hole reads as zeros; for unit testing, both are filled with
+ * dots, as in the file. */
+static gsize
+_arena_read (VteArena *arena, char *data, gsize len, gsize offset)
+{
+        VteArenaBlock *block;
+
+        g_assert_cmpuint (offset % VTE_SNAKE_BLOCKSIZE, ==, 0);
+        g_assert_cmpuint (len, ==, VTE_SNAKE_BLOCKSIZE);
+
+        if (G_UNLIKELY (offset / VTE_SNAKE_BLOCKSIZE >= arena->n_blocks))
+                return 0;
+
+        block = &arena->blocks[offset / VTE_SNAKE_BLOCKSIZE];
+#ifndef VTESTREAM_MAIN
+        if (G_UNLIKELY (block->data == NULL))
+                memset (data, 0, len);
+        else
+                memcpy (data, block->data, block->len);
+#else
+        if (block->data != NULL)
+                memcpy (data, block->data, block->len);
+        memset (data + block->len, '.', len - block->len);
+#endif
+        return len;
+}
+
+/* Writes a whole block, replacing what was there */
+static void
+_arena_write (VteArena *arena, const char *data, gsize len, gsize offset)
+{
+        VteArenaBlock *block;
+
+        g_assert_cmpuint (offset % VTE_SNAKE_BLOCKSIZE, ==, 0);
+        g_assert_cmpuint (len, <=, VTE_SNAKE_BLOCKSIZE);
+
+        if (offset / VTE_SNAKE_BLOCKSIZE >= arena->n_blocks)
+                _arena_try_truncate (arena, offset + VTE_SNAKE_BLOCKSIZE);
+
+        block = &arena->blocks[offset / VTE_SNAKE_BLOCKSIZE];
+        _arena_free_block (block);
+        if (len == 0)
+                return;
+
+        block->data = _arena_alloc (len);
+        block->len = len;
+        memcpy (block->data, data, len);
+}
+
+/******************************************************************************************/
+
 /*
  * VteSnake:
  *
@@ -339,6 +593,7 @@ _file_write (int fd, const char *data, gsize len, gsize offset)
 typedef struct _VteSnake {
         GObject parent;
         int fd;
+        VteArena *arena;        /* Instead of the file, for a memory stream */
         int state;
         struct {
                 gsize st_tail;  /* Stream's logical tail offset. */
@@ -380,6 +635,7 @@ _vte_snake_finalize (GObject *object)
         VteSnake *snake = (VteSnake *) object;
 
         _file_close (snake->fd);
+        _arena_free (snake->arena);
 
         G_OBJECT_CLASS (_vte_snake_parent_class)->finalize(object);
 }
@@ -387,12 +643,65 @@ _vte_snake_finalize (GObject *object)
 static inline void
 _vte_snake_ensure_file (VteSnake *snake)
 {
-        if (G_LIKELY (snake->fd != -1))
+        if (G_LIKELY (snake->fd != -1 || snake->arena != NULL))
                 return;
 
         snake->fd = _vte_mkstemp ();
 }
 
+/* Keep the blocks in memory rather than in a file; before the first write */
+static void
+_vte_snake_set_in_memory (VteSnake *snake)
+{
+        g_assert (snake->fd == -1 && snake->arena == NULL);
+
+        snake->arena = _arena_new ();
+}
+
+/* The file operations, on the arena instead for a memory stream */
+
+static inline void
+_vte_snake_file_reset (VteSnake *snake)
+{
+        if (snake->arena != NULL)
+                _arena_reset (snake->arena);
+        else
+                _file_reset (snake->fd);
+}
+
+static inline gboolean
+_vte_snake_file_try_truncate (VteSnake *snake, gsize offset)
+{
+        if (snake->arena != NULL)
+                return _arena_try_truncate (snake->arena, offset);
+        return _file_try_truncate (snake->fd, offset);
+}
+
+static inline gboolean
+_vte_snake_file_try_punch_hole (VteSnake *snake, gsize offset, gsize len)
+{
+        if (snake->arena != NULL)
+                return _arena_try_punch_hole (snake->arena, offset, len);
+        return _file_try_punch_hole (snake->fd, offset, len);
+}
+
+static inline gsize
+_vte_snake_file_read (VteSnake *snake, char *data, gsize len, gsize offset)
+{
+        if (snake->arena != NULL)
+                return _arena_read (snake->arena, data, len, offset);
+        return _file_read (snake->fd, data, len, offset);
+}
+
+static inline void
+_vte_snake_file_write (VteSnake *snake, const char *data, gsize len, gsize offset)
+{
+        if (snake->arena != NULL)
+                _arena_write (snake->arena, data, len, offset);
+        else
+                _file_write (snake->fd, data, len, offset);
+}
+
 static void _vte_snake_advance_tail (VteSnake *snake, gsize offset);
 static void
 _vte_snake_reset (VteSnake *snake, gsize offset)
@@ -403,7 +712,7 @@ _vte_snake_reset (VteSnake *snake, gsize offset)
         g_assert_cmpuint (offset, >=, snake->tail);
 
         if (G_LIKELY (offset >= snake->head)) {
-                _file_reset (snake->fd);
+                _vte_snake_file_reset (snake);
                 snake->segment[0].st_tail = snake->segment[0].st_head = snake->tail = snake->head = offset;
                 snake->segment[0].fd_tail = snake->segment[0].fd_head = 0;
                 snake->state = 1;
@@ -445,7 +754,7 @@ _vte_snake_read (VteSnake *snake, gsize offset, char *data)
 
         fd_offset = _vte_snake_offset_map(snake, offset);
 
-        return (_file_read (snake->fd, data, VTE_SNAKE_BLOCKSIZE, fd_offset) == VTE_SNAKE_BLOCKSIZE);
+        return (_vte_snake_file_read (snake, data, VTE_SNAKE_BLOCKSIZE, fd_offset) == VTE_SNAKE_BLOCKSIZE);
 }
 
 /*
@@ -494,10 +803,10 @@ _vte_snake_write (VteSnake *snake, gsize offset, const char *data, gsize len)
                 if (snake->state != 2) {
                         /* Grow the file with sparse blocks to make sure that later pread() can
                          * read back a whole block, even if we are about to write a shorter one. */
-                        _file_try_truncate (snake->fd, fd_offset + VTE_SNAKE_BLOCKSIZE);
+                        _vte_snake_file_try_truncate (snake, fd_offset + VTE_SNAKE_BLOCKSIZE);
 #ifdef VTESTREAM_MAIN
                         /* For convenient unit testing only: fill with dots. */
-                        _file_try_punch_hole (snake->fd, fd_offset, VTE_SNAKE_BLOCKSIZE);
+                        _vte_snake_file_try_punch_hole (snake, fd_offset, VTE_SNAKE_BLOCKSIZE);
 #endif
                 }
                 snake->head = offset + VTE_SNAKE_BLOCKSIZE;
@@ -505,9 +814,9 @@ _vte_snake_write (VteSnake *snake, gsize offset, const char *data, gsize len)
                 /* Overwriting an existing block. The new block might be shorter than the old one,
                  * punch a hole to potentially free up disk space (and for easier unit testing). */
                 fd_offset = _vte_snake_offset_map(snake, offset);
-                _file_try_punch_hole (snake->fd, fd_offset, VTE_SNAKE_BLOCKSIZE);
+                _vte_snake_file_try_punch_hole (snake, fd_offset, VTE_SNAKE_BLOCKSIZE);
         }
-        _file_write (snake->fd, data, len, fd_offset);
+        _vte_snake_file_write (snake, data, len, fd_offset);
 }
 
 /*
@@ -530,7 +839,7 @@ _vte_snake_advance_tail (VteSnake *snake, gsize offset)
         while (offset > snake->segment[0].st_tail) {
                 if (offset < snake->segment[0].st_head) {
                         /* Drop some (but not all) bytes from the first segment. */
-                        _file_try_punch_hole (snake->fd, snake->segment[0].fd_tail, offset - snake->tail);
+                        _vte_snake_file_try_punch_hole (snake, snake->segment[0].fd_tail, offset - snake->tail);
                         snake->segment[0].fd_tail += offset - snake->tail;
                         snake->segment[0].st_tail = snake->tail = offset;
                         return;
@@ -542,17 +851,17 @@ _vte_snake_advance_tail (VteSnake *snake, gsize offset)
                                 break;
                         case 2:
                                 snake->segment[0] = snake->segment[1];
-                                _file_try_truncate (snake->fd, snake->segment[0].fd_head);
+                                _vte_snake_file_try_truncate (snake, snake->segment[0].fd_head);
                                 snake->state = 1;
                                 break;
                         case 3:
-                                _file_try_punch_hole (snake->fd, snake->segment[0].fd_tail, snake->segment[0].fd_head - snake->segment[0].fd_tail);
+                                _vte_snake_file_try_punch_hole (snake, snake->segment[0].fd_tail, snake->segment[0].fd_head - snake->segment[0].fd_tail);
                                 snake->segment[0] = snake->segment[1];
                                 snake->segment[1] = snake->segment[2];
                                 snake->state = 4;
                                 break;
                         case 4:
-                                _file_try_punch_hole (snake->fd, snake->segment[0].fd_tail, snake->segment[0].fd_head - snake->segment[0].fd_tail);
+                                _vte_snake_file_try_punch_hole (snake, snake->segment[0].fd_tail, snake->segment[0].fd_head - snake->segment[0].fd_tail);
                                 snake->segment[0] = snake->segment[1];
                                 snake->state = 1;
                                 break;
@@ -622,7 +931,8 @@ _vte_snake_class_init (VteSnakeClass *klass)
  *                       boa block 65512(7)
  *
  * Structure of the block that we give to the snake:
- * - 0..4 (0..1): The length of the compressed and encrypted Data, that is D-8 (D-2) [VTE_BLOCK_DATALENGTH_SIZE bytes]
+ * - 0..4 (0..1): The length of the compressed and encrypted Data, that is D-8 (D-2), in the low 24 (5) bits,
+ *   and the VteStreamCodec it's compressed with in the high 8 (3) bits [VTE_BLOCK_DATALENGTH_SIZE bytes]
  * - 4..8 (1..2): Overwrite counter [VTE_OVERWRITE_COUNTER_SIZE bytes]
  * - 8..D (2..D): The compressed and encrypted Data [<= VTE_BOA_BLOCKSIZE bytes]
  * - D..T: Encryption verification Tag [VTE_CIPHER_TAG_SIZE bytes]
@@ -649,6 +959,22 @@ typedef struct _VteBoa {
 #if !defined VTESTREAM_MAIN && defined WITH_GNUTLS
         gnutls_cipher_hd_t cipher_hd;
         VteIv iv;
+#endif
+#if !defined VTESTREAM_MAIN && defined WITH_ZSTD
+        ZSTD_CCtx *zstd_cctx;
+        ZSTD_DCtx *zstd_dctx;
+
+        /* The samples collected from the first blocks, until the dictionary
+         * is trained on them */
+        char *zstd_samples;
+        guint n_zstd_samples;
+        gboolean zstd_training_failed;
+        char *zstd_dict;
+        gsize zstd_dict_len;
+        /* The dictionary digested for the current level, and for decompressing */
+        ZSTD_CDict *zstd_cdict;
+        int zstd_cdict_level;
+        ZSTD_DDict *zstd_ddict;
 #endif
         int compressBound;
 } VteBoa;
@@ -670,6 +996,46 @@ static GType _vte_boa_get_type (void);
 
 G_DEFINE_TYPE (VteBoa, _vte_boa, VTE_TYPE_SNAKE)
 
+/* The codec and level that the blocks are written with from now on. As each
+ * block records its codec, a change doesn't affect reading those already
+ * written. These are used from the writer thread too. */
+static int _vte_boa_codec = VTE_STREAM_CODEC_ZLIB;
+static int _vte_boa_level = 0;
+
+/* The bytes given to all the boas to write, and what they took up in the file */
+static gsize _vte_boa_bytes_written;
+static gsize _vte_boa_bytes_stored;
+
+#if !defined VTESTREAM_MAIN && defined WITH_ZSTD
+/* The block codec for zstd with the boa's own dictionary */
+# define VTE_BLOCK_CODEC_ZSTD_DICTIONARY 3
+/* Train the dictionary on the first few blocks, cut into samples */
+# define VTE_ZSTD_DICTIONARY_TRAINING_BLOCKS 4
+# define VTE_ZSTD_DICTIONARY_SAMPLE_SIZE 1024
+# define VTE_ZSTD_DICTIONARY_SIZE (16 * 1024)
+
+static int _vte_boa_train_dictionaries = FALSE;
+#endif
+
+static gboolean
+_vte_boa_codec_available (int codec)
+{
+        switch (codec) {
+        case VTE_STREAM_CODEC_ZLIB:
+                return TRUE;
+#if defined WITH_LZ4 || defined VTESTREAM_MAIN
+        case VTE_STREAM_CODEC_LZ4:
+                return TRUE;
+#endif
+#if defined WITH_ZSTD || defined VTESTREAM_MAIN
+        case VTE_STREAM_CODEC_ZSTD:
+                return TRUE;
+#endif
+        default:
+                return FALSE;
+        }
+}
+
 /*----------------------------------------------------------------------------------------*/
 
 /* Thin wrapper layers above the compression and encryption routines, for unit testing. */
@@ -738,23 +1104,72 @@ static int
 _vte_boa_compressBound (unsigned int len)
 {
 #ifndef VTESTREAM_MAIN
-        return compressBound(len);
+        int bound = compressBound(len);
+# ifdef WITH_LZ4
+        bound = MAX(bound, LZ4_compressBound(len));
+# endif
+# ifdef WITH_ZSTD
+        bound = MAX(bound, (int) ZSTD_compressBound(len));
+# endif
+        return bound;
 #else
         return 2 * len;
 #endif
 }
 
-/* Compress; returns the compressed size which might be bigger than the original. */
+/* Compress with an available codec, at level or the codec's default if 0;
+ * returns the compressed size which might be bigger than the original. */
 static unsigned int
-_vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+_vte_boa_compress (VteBoa *boa, int codec, int level, char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
 {
 #ifndef VTESTREAM_MAIN
-        uLongf dstlen_ulongf = dstlen;
-        unsigned int z_ret;
+        switch (codec) {
+# ifdef WITH_LZ4
+        case VTE_STREAM_CODEC_LZ4: {
+                int len;
+
+                if (level > 1)
+                        len = LZ4_compress_HC (src, dst, srclen, dstlen, level);
+                else
+                        len = LZ4_compress_default (src, dst, srclen, dstlen);
+                g_assert_cmpint (len, >, 0);
+                return len;
+        }
+# endif
+# ifdef WITH_ZSTD
+        case VTE_STREAM_CODEC_ZSTD: {
+                size_t len;
+
+                if (boa->zstd_cctx == NULL)
+                        boa->zstd_cctx = ZSTD_createCCtx ();
+                len = ZSTD_compressCCtx (boa->zstd_cctx, dst, dstlen, src, srclen, level > 0 ? level : 1);
+                g_assert (!ZSTD_isError (len));
+                return len;
+        }
+        case VTE_BLOCK_CODEC_ZSTD_DICTIONARY: {
+                size_t len;
+
+                if (boa->zstd_cctx == NULL)
+                        boa->zstd_cctx = ZSTD_createCCtx ();
+                if (boa->zstd_cdict == NULL || boa->zstd_cdict_level != level) {
+                        ZSTD_freeCDict (boa->zstd_cdict);
+                        boa->zstd_cdict = ZSTD_createCDict (boa->zstd_dict, boa->zstd_dict_len, level > 0 ? level : 1);
+                        boa->zstd_cdict_level = level;
+                }
+                len = ZSTD_compress_usingCDict (boa->zstd_cctx, dst, dstlen, src, srclen, boa->zstd_cdict);
+                g_assert (!ZSTD_isError (len));
+                return len;
+        }
+# endif
+        default: {
+                uLongf dstlen_ulongf = dstlen;
+                unsigned int z_ret;
 
-        z_ret = compress2 ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen, 1);
-        g_assert_cmpuint (z_ret, ==, Z_OK);
-        return dstlen_ulongf;
+                z_ret = compress2 ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen, level > 0 ? level : 1);
+                g_assert_cmpuint (z_ret, ==, Z_OK);
+                return dstlen_ulongf;
+        }
+        }
 #else
         /* Fake compression for unit testing:
          * Each char gets prefixed by a repetition count. This prefix is omitted if it would be the
@@ -764,8 +1179,11 @@ _vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int
          *      Mississippi <-> 1Mi2s1i2s1i2p1i
          *      bookkeeper <-> 1b2oke1per
          * The uncompressed string shouldn't contain digits, or more than 9 consecutive identical chars.
+         * Codecs with odd numbers reverse the result, so that they're told apart:
+         *      abcdef <-> fedcba1
          */
-        unsigned int len = 0, prevrepeat = 0;
+        unsigned int len = 0, prevrepeat = 0, i;
+        char *start = dst;
         while (srclen) {
                 unsigned int repeat = 1;
                 while (repeat < srclen && src[repeat] == src[0]) repeat++;
@@ -778,24 +1196,71 @@ _vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int
                 src += repeat, srclen -= repeat;
                 len++;
         }
+        if (codec & 1) {
+                for (i = 0; i < len / 2; i++) {
+                        char c = start[i];
+                        start[i] = start[len - 1 - i];
+                        start[len - 1 - i] = c;
+                }
+        }
         return len;
 #endif
 }
 
-/* Uncompress; returns the uncompressed size. */
+/* Uncompress with an available codec; returns the uncompressed size. */
 static unsigned int
-_vte_boa_uncompress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+_vte_boa_uncompress (VteBoa *boa, int codec, char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
 {
 #ifndef VTESTREAM_MAIN
-        uLongf dstlen_ulongf = dstlen;
-        unsigned int z_ret;
+        switch (codec) {
+# ifdef WITH_LZ4
+        case VTE_STREAM_CODEC_LZ4: {
+                int len;
+
+                len = LZ4_decompress_safe (src, dst, srclen, dstlen);
+                g_assert_cmpint (len, >=, 0);
+                return len;
+        }
+# endif
+# ifdef WITH_ZSTD
+        case VTE_STREAM_CODEC_ZSTD: {
+                size_t len;
+
+                if (boa->zstd_dctx == NULL)
+                        boa->zstd_dctx = ZSTD_createDCtx ();
+                len = ZSTD_decompressDCtx (boa->zstd_dctx, dst, dstlen, src, srclen);
+                g_assert (!ZSTD_isError (len));
+                return len;
+        }
+        case VTE_BLOCK_CODEC_ZSTD_DICTIONARY: {
+                size_t len;
+
+                if (boa->zstd_dctx == NULL)
+                        boa->zstd_dctx = ZSTD_createDCtx ();
+                if (boa->zstd_ddict == NULL)
+                        boa->zstd_ddict = ZSTD_createDDict (boa->zstd_dict, boa->zstd_dict_len);
+                len = ZSTD_decompress_usingDDict (boa->zstd_dctx, dst, dstlen, src, srclen, boa->zstd_ddict);
+                g_assert (!ZSTD_isError (len));
+                return len;
+        }
+# endif
+        default: {
+                uLongf dstlen_ulongf = dstlen;
+                unsigned int z_ret;
 
-        z_ret = uncompress ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen);
-        g_assert_cmpuint (z_ret, ==, Z_OK);
-        return dstlen_ulongf;
+                z_ret = uncompress ((Bytef *) dst, &dstlen_ulongf, (const Bytef *) src, srclen);
+                g_assert_cmpuint (z_ret, ==, Z_OK);
+                return dstlen_ulongf;
+        }
+        }
 #else
         /* Fake decompression for unit testing; see above. */
         unsigned int len = 0, repeat = 0;
+        int step = 1;
+        if (codec & 1) {
+                src += srclen - 1;
+                step = -1;
+        }
         while (srclen) {
                 unsigned char c = *src;
                 if (c >= '0' && c <= '9') {
@@ -804,12 +1269,67 @@ _vte_boa_uncompress (char *dst, unsigned int dstlen, const char *src, unsigned i
                         memset (dst, c, repeat);
                         dst += repeat, len += repeat;
                 }
-                src++; srclen--;
+                src += step; srclen--;
         }
         return len;
 #endif
 }
 
+/* Whether the blocks written with codec can be read back */
+static gboolean
+_vte_boa_can_uncompress (VteBoa *boa, int codec)
+{
+#if !defined VTESTREAM_MAIN && defined WITH_ZSTD
+        if (codec == VTE_BLOCK_CODEC_ZSTD_DICTIONARY)
+                return boa->zstd_dict != NULL;
+#endif
+        return _vte_boa_codec_available (codec);
+}
+
+#if !defined VTESTREAM_MAIN && defined WITH_ZSTD
+/* Collects samples from the first blocks written with zstd, and then trains
+ * the dictionary on them. Returns whether there's a dictionary to use. */
+static gboolean
+_vte_boa_train_dictionary (VteBoa *boa, const char *data)
+{
+        size_t sample_sizes[VTE_ZSTD_DICTIONARY_TRAINING_BLOCKS * VTE_BOA_BLOCKSIZE / VTE_ZSTD_DICTIONARY_SAMPLE_SIZE + 1];
+        gsize samples_len, len;
+        guint i, n_samples;
+
+        if (G_LIKELY (boa->zstd_dict != NULL))
+                return TRUE;
+        if (boa->zstd_training_failed)
+                return FALSE;
+
+        boa->zstd_samples = (char *) g_realloc (boa->zstd_samples, (boa->n_zstd_samples + 1) * VTE_BOA_BLOCKSIZE);
+        memcpy (boa->zstd_samples + boa->n_zstd_samples * VTE_BOA_BLOCKSIZE, data, VTE_BOA_BLOCKSIZE);
+        if (++boa->n_zstd_samples < VTE_ZSTD_DICTIONARY_TRAINING_BLOCKS)
+                return FALSE;
+
+        samples_len = boa->n_zstd_samples * VTE_BOA_BLOCKSIZE;
+        n_samples = (samples_len + VTE_ZSTD_DICTIONARY_SAMPLE_SIZE - 1) / VTE_ZSTD_DICTIONARY_SAMPLE_SIZE;
+        for (i = 0; i < n_samples; i++)
+                sample_sizes[i] = MIN(VTE_ZSTD_DICTIONARY_SAMPLE_SIZE, samples_len - i * VTE_ZSTD_DICTIONARY_SAMPLE_SIZE);
+
+        boa->zstd_dict = (char *) g_malloc (VTE_ZSTD_DICTIONARY_SIZE);
+        len = ZDICT_trainFromBuffer (boa->zstd_dict, VTE_ZSTD_DICTIONARY_SIZE,
+                                     boa->zstd_samples, sample_sizes, n_samples);
+        g_free (boa->zstd_samples);
+        boa->zstd_samples = NULL;
+
+        /* Fails if there isn't enough to learn from, like when the blocks are all blanks */
+        if (ZDICT_isError (len)) {
+                g_free (boa->zstd_dict);
+                boa->zstd_dict = NULL;
+                boa->zstd_training_failed = TRUE;
+                return FALSE;
+        }
+
+        boa->zstd_dict_len = len;
+        return TRUE;
+}
+#endif
+
 /*----------------------------------------------------------------------------------------*/
 
 static void
@@ -854,6 +1374,14 @@ _vte_boa_finalize (GObject *object)
         gnutls_cipher_deinit (boa->cipher_hd);
         gnutls_global_deinit ();
 #endif
+#if !defined VTESTREAM_MAIN && defined WITH_ZSTD
+        ZSTD_freeCCtx (((VteBoa *) object)->zstd_cctx);
+        ZSTD_freeDCtx (((VteBoa *) object)->zstd_dctx);
+        g_free (((VteBoa *) object)->zstd_samples);
+        ZSTD_freeCDict (((VteBoa *) object)->zstd_cdict);
+        ZSTD_freeDDict (((VteBoa *) object)->zstd_ddict);
+        g_free (((VteBoa *) object)->zstd_dict);
+#endif
 
         G_OBJECT_CLASS (_vte_boa_parent_class)->finalize(object);
 }
@@ -885,6 +1413,7 @@ static gboolean
 _vte_boa_read_with_overwrite_counter (VteBoa *boa, gsize offset, char *data, _vte_overwrite_counter_t *overwrite_counter)
 {
         _vte_block_datalength_t compressed_len;
+        int codec;
         char *buf = g_newa(char, VTE_SNAKE_BLOCKSIZE);
 
         g_assert_cmpuint (offset % VTE_BOA_BLOCKSIZE, ==, 0);
@@ -894,10 +1423,13 @@ _vte_boa_read_with_overwrite_counter (VteBoa *boa, gsize offset, char *data, _vt
                 return FALSE;
 
         compressed_len = *((_vte_block_datalength_t *) buf);
+        codec = compressed_len >> VTE_BLOCK_CODEC_SHIFT;
+        compressed_len &= VTE_BLOCK_DATALENGTH_MASK;
         *overwrite_counter = *((_vte_overwrite_counter_t *) (buf + VTE_BLOCK_DATALENGTH_SIZE));
 
         /* We could have read an empty block due to a previous disk full. Treat that as an error too. Perform other sanity checks. */
-        if (G_UNLIKELY (compressed_len <= 0 || compressed_len > VTE_BOA_BLOCKSIZE || *overwrite_counter <= 0))
+        if (G_UNLIKELY (compressed_len <= 0 || compressed_len > VTE_BOA_BLOCKSIZE || *overwrite_counter <= 0 ||
+                        !_vte_boa_can_uncompress (boa, codec)))
                 return FALSE;
 
         /* Decrypt, bail out on tag mismatch */
@@ -910,7 +1442,7 @@ _vte_boa_read_with_overwrite_counter (VteBoa *boa, gsize offset, char *data, _vt
                         memcpy (data, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, VTE_BOA_BLOCKSIZE);
                 } else {
                         unsigned int uncompressed_len;
-                        uncompressed_len = _vte_boa_uncompress(data, VTE_BOA_BLOCKSIZE, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
+                        uncompressed_len = _vte_boa_uncompress(boa, codec, data, VTE_BOA_BLOCKSIZE, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
                         g_assert_cmpuint (uncompressed_len, ==, VTE_BOA_BLOCKSIZE);
                 }
         }
@@ -935,6 +1467,8 @@ _vte_boa_write (VteBoa *boa, gsize offset, const char *data)
            to make sure that an empty block (e.g. after a previous write failure) is always invalid,
            and to make unit testing easier */
         _vte_overwrite_counter_t overwrite_counter = 1;
+        int codec = g_atomic_int_get (&_vte_boa_codec);
+        int level = g_atomic_int_get (&_vte_boa_level);
 
         /* The helper buffer should be large enough to contain a whole snake block,
          * and also large enough to compress data that actually grows bigger during compression. */
@@ -966,15 +1500,23 @@ _vte_boa_write (VteBoa *boa, gsize offset, const char *data)
 
         _vte_block_datalength_t compressed_len;
 
+#if !defined VTESTREAM_MAIN && defined WITH_ZSTD
+        if (codec == VTE_STREAM_CODEC_ZSTD && g_atomic_int_get (&_vte_boa_train_dictionaries) &&
+            _vte_boa_train_dictionary (boa, data))
+                codec = VTE_BLOCK_CODEC_ZSTD_DICTIONARY;
+#endif
+
         /* Compress, or copy if uncompressable */
-        compressed_len = _vte_boa_compress (buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, boa->compressBound,
+        compressed_len = _vte_boa_compress (boa, codec, level,
+                                            buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, boa->compressBound,
                                             data, VTE_BOA_BLOCKSIZE);
         if (G_UNLIKELY (compressed_len >= VTE_BOA_BLOCKSIZE)) {
                 memcpy (buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, data, VTE_BOA_BLOCKSIZE);
                 compressed_len = VTE_BOA_BLOCKSIZE;
+                codec = VTE_STREAM_CODEC_ZLIB;
         }
 
-        *((_vte_block_datalength_t *) buf) = (_vte_block_datalength_t) compressed_len;
+        *((_vte_block_datalength_t *) buf) = (_vte_block_datalength_t) (compressed_len | (codec << VTE_BLOCK_CODEC_SHIFT));
         *((_vte_overwrite_counter_t *) (buf + VTE_BLOCK_DATALENGTH_SIZE)) = (_vte_overwrite_counter_t) overwrite_counter;
 
         /* Encrypt */
@@ -982,6 +1524,8 @@ _vte_boa_write (VteBoa *boa, gsize offset, const char *data)
 
         /* Write */
         _vte_snake_write (&boa->parent, OFFSET_BOA_TO_SNAKE(offset), buf, VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE + compressed_len + VTE_CIPHER_TAG_SIZE);
+        g_atomic_pointer_add (&_vte_boa_bytes_written, VTE_BOA_BLOCKSIZE);
+        g_atomic_pointer_add (&_vte_boa_bytes_stored, VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE + compressed_len + VTE_CIPHER_TAG_SIZE);
 
         if (G_LIKELY (offset == boa->head)) {
                 boa->head += VTE_BOA_BLOCKSIZE;
@@ -1031,18 +1575,82 @@ _vte_boa_class_init (VteBoaClass *klass)
 
 /*
  * VteFileStream: Implement buffering/caching on top of VteBoa.
+ *
+ * Reading keeps the last few blocks read, decoded, so that reading the
+ * row, text and attr streams together or scrolling back and forth over
+ * a block boundary doesn't decrypt and uncompress the same blocks again
+ * and again. A stream caches up to _vte_file_stream_cache_blocks blocks,
+ * evicting the least recently used one; but all the streams of the process
+ * together allocate no more than _vte_file_stream_cache_max_bytes, past
+ * which a stream reuses its own least recently used block rather than
+ * allocating another one. A stream can always cache one block.
+ *
+ * Writing hands each full block over to a thread shared by all the streams,
+ * which compresses, encrypts and writes it, so that appending costs the main
+ * thread little more than copying into the write buffer. Until written, the
+ * blocks stay queued on their stream, where reads find them. A stream has at
+ * most VTE_FILE_STREAM_PENDING_MAX blocks queued, beyond which appending waits
+ * for the writer; and the other operations that need the boa wait until the
+ * blocks they need are written. As the writer uses the boa concurrently, the
+ * boa is only ever used with the stream's boa_lock held.
  */
 
+#define VTE_FILE_STREAM_CACHE_BLOCKS_MAX 16
+#define VTE_FILE_STREAM_PENDING_MAX 8
+
+typedef struct _VteCachedBlock {
+        char *data;
+        /* Offset of the cached block, always a multiple of block size.
+         * Use a value of 1 (or anything that's not a multiple of block size)
+         * to denote if no block is cached. */
+        gsize offset;
+        /* The stream's rcache_clock when this was last read, 0 if unused */
+        guint64 last_used;
+} VteCachedBlock;
+
+static guint _vte_file_stream_cache_blocks = 4;
+static gsize _vte_file_stream_cache_max_bytes = 32 * 1024 * 1024;
+static gsize _vte_file_stream_cache_bytes;
+static guint64 _vte_file_stream_cache_hits;
+static guint64 _vte_file_stream_cache_misses;
+
+/* A full block on its way to the boa */
+typedef struct _VtePendingBlock {
+        struct _VteFileStream *stream;
+        gsize offset;
+        char *data;
+} VtePendingBlock;
+
+#ifndef VTESTREAM_MAIN
+static gboolean _vte_file_stream_write_in_background = TRUE;
+#else
+/* Most unit tests check the file right after appending */
+static gboolean _vte_file_stream_write_in_background = FALSE;
+#endif
+static guint _vte_file_stream_n_streams;
+static GThread *_vte_file_stream_writer;
+
+/* The lock protects the rest, and the streams' pending queues */
+static GMutex _vte_file_stream_writer_lock;
+static GCond _vte_file_stream_writer_cond;  /* There's more to write, or stop */
+static GCond _vte_file_stream_written_cond; /* A block was written */
+static GQueue _vte_file_stream_writer_queue = G_QUEUE_INIT;
+static gboolean _vte_file_stream_writer_stop;
+
 typedef struct _VteFileStream {
         GObject parent;
 
         VteBoa *boa;
+        GMutex boa_lock;
 
-        char *rbuf;
-        /* Offset of the cached record, always a multiple of block size.
-         * Use a value of 1 (or anything that's not a multiple of block size)
-         * to denote if no record is cached. */
-        gsize rbuf_offset;
+        /* The blocks handed over to the writer but not written yet, oldest first */
+        GQueue pending;
+
+        /* The read cache, of which the first rcache_len entries are allocated */
+        VteCachedBlock rcache[VTE_FILE_STREAM_CACHE_BLOCKS_MAX];
+        guint rcache_len;
+        guint64 rcache_clock;
+        guint64 rcache_hits, rcache_misses;
 
         char *wbuf;
         gsize wbuf_len;
@@ -1060,42 +1668,316 @@ G_DEFINE_TYPE (VteFileStream, _vte_file_stream, VTE_TYPE_STREAM)
 VteStream *
 _vte_file_stream_new (void)
 {
+        g_mutex_lock (&_vte_file_stream_writer_lock);
+        _vte_file_stream_n_streams++;
+        g_mutex_unlock (&_vte_file_stream_writer_lock);
+
 	return (VteStream *) g_object_new (VTE_TYPE_FILE_STREAM, NULL);
 }
 
+VteStream *
+_vte_memory_stream_new (void)
+{
+        VteFileStream *stream = (VteFileStream *) _vte_file_stream_new ();
+
+        _vte_snake_set_in_memory ((VteSnake *) stream->boa);
+        return (VteStream *) stream;
+}
+
+void
+_vte_memory_stream_get_stats (gsize *bytes, gsize *pooled_bytes)
+{
+        g_mutex_lock (&_vte_arena_pool_lock);
+        if (bytes)
+                *bytes = _vte_arena_bytes;
+        if (pooled_bytes)
+                *pooled_bytes = _vte_arena_pool_bytes;
+        g_mutex_unlock (&_vte_arena_pool_lock);
+}
+
+void
+_vte_file_stream_set_cache_size (guint n_blocks, gsize max_bytes)
+{
+        _vte_file_stream_cache_blocks = CLAMP(n_blocks, 1, VTE_FILE_STREAM_CACHE_BLOCKS_MAX);
+        _vte_file_stream_cache_max_bytes = max_bytes;
+}
+
+void
+_vte_file_stream_get_cache_stats (guint64 *hits, guint64 *misses, gsize *bytes)
+{
+        if (hits)
+                *hits = _vte_file_stream_cache_hits;
+        if (misses)
+                *misses = _vte_file_stream_cache_misses;
+        if (bytes)
+                *bytes = _vte_file_stream_cache_bytes;
+}
+
+gboolean
+_vte_file_stream_set_codec (VteStreamCodec codec, int level)
+{
+        if (!_vte_boa_codec_available (codec))
+                return FALSE;
+
+        g_atomic_int_set (&_vte_boa_codec, codec);
+        g_atomic_int_set (&_vte_boa_level, level);
+        return TRUE;
+}
+
+gboolean
+_vte_file_stream_set_dictionaries (gboolean train)
+{
+#if !defined VTESTREAM_MAIN && defined WITH_ZSTD
+        g_atomic_int_set (&_vte_boa_train_dictionaries, train);
+        return TRUE;
+#else
+        return FALSE;
+#endif
+}
+
+void
+_vte_file_stream_set_write_in_background (gboolean background)
+{
+        _vte_file_stream_write_in_background = background;
+}
+
+void
+_vte_file_stream_get_write_stats (gsize *bytes, gsize *stored_bytes)
+{
+        if (bytes)
+                *bytes = (gsize) g_atomic_pointer_get (&_vte_boa_bytes_written);
+        if (stored_bytes)
+                *stored_bytes = (gsize) g_atomic_pointer_get (&_vte_boa_bytes_stored);
+}
+
 static void
 _vte_file_stream_init (VteFileStream *stream)
 {
         stream->boa = (VteBoa *)g_object_new (VTE_TYPE_BOA, NULL);
+        g_mutex_init (&stream->boa_lock);
+        g_queue_init (&stream->pending);
 
-        stream->rbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
         stream->wbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
-        stream->rbuf_offset = 1;  /* Invalidate */
+}
+
+static gpointer
+_vte_file_stream_writer_run (gpointer data)
+{
+        g_mutex_lock (&_vte_file_stream_writer_lock);
+        for (;;) {
+                VtePendingBlock *block;
+                VteFileStream *stream;
+
+                block = (VtePendingBlock *) g_queue_pop_head (&_vte_file_stream_writer_queue);
+                if (block == NULL) {
+                        if (_vte_file_stream_writer_stop)
+                                break;
+                        g_cond_wait (&_vte_file_stream_writer_cond, &_vte_file_stream_writer_lock);
+                        continue;
+                }
+                stream = block->stream;
+                g_mutex_unlock (&_vte_file_stream_writer_lock);
+
+                g_mutex_lock (&stream->boa_lock);
+                _vte_boa_write (stream->boa, block->offset, block->data);
+                g_mutex_unlock (&stream->boa_lock);
+
+                g_mutex_lock (&_vte_file_stream_writer_lock);
+                g_queue_remove (&stream->pending, block);
+                g_cond_broadcast (&_vte_file_stream_written_cond);
+                g_free (block->data);
+                g_free (block);
+        }
+        g_mutex_unlock (&_vte_file_stream_writer_lock);
+
+        return NULL;
+}
+
+/* Hands the block at offset over to the writer, which takes data */
+static void
+_vte_file_stream_queue_write (VteFileStream *stream, gsize offset, char *data)
+{
+        VtePendingBlock *block = g_new (VtePendingBlock, 1);
+
+        block->stream = stream;
+        block->offset = offset;
+        block->data = data;
+
+        g_mutex_lock (&_vte_file_stream_writer_lock);
+        while (stream->pending.length >= VTE_FILE_STREAM_PENDING_MAX)
+                g_cond_wait (&_vte_file_stream_written_cond, &_vte_file_stream_writer_lock);
+
+        g_queue_push_tail (&stream->pending, block);
+        g_queue_push_tail (&_vte_file_stream_writer_queue, block);
+
+        if (G_UNLIKELY (_vte_file_stream_writer == NULL)) {
+                _vte_file_stream_writer_stop = FALSE;
+                _vte_file_stream_writer = g_thread_new ("vte-stream-writer", _vte_file_stream_writer_run, NULL);
+        }
+        g_cond_signal (&_vte_file_stream_writer_cond);
+        g_mutex_unlock (&_vte_file_stream_writer_lock);
+}
+
+/* Waits until the writer has written the stream's blocks before offset */
+static void
+_vte_file_stream_wait_written (VteFileStream *stream, gsize offset)
+{
+        VtePendingBlock *block;
+
+        g_mutex_lock (&_vte_file_stream_writer_lock);
+        while ((block = (VtePendingBlock *) g_queue_peek_head (&stream->pending)) != NULL &&
+               block->offset < offset)
+                g_cond_wait (&_vte_file_stream_written_cond, &_vte_file_stream_writer_lock);
+        g_mutex_unlock (&_vte_file_stream_writer_lock);
+}
+
+/* Place VTE_BOA_BLOCKSIZE bytes at data, from the pending blocks or the boa */
+static gboolean
+_vte_file_stream_read_boa (VteFileStream *stream, gsize offset_aligned, char *data)
+{
+        gboolean ret = FALSE;
+        GList *l;
+
+        g_mutex_lock (&_vte_file_stream_writer_lock);
+        for (l = stream->pending.head; l != NULL; l = l->next) {
+                VtePendingBlock *block = (VtePendingBlock *) l->data;
+                if (block->offset == offset_aligned) {
+                        memcpy (data, block->data, VTE_BOA_BLOCKSIZE);
+                        ret = TRUE;
+                        break;
+                }
+        }
+        g_mutex_unlock (&_vte_file_stream_writer_lock);
+        if (ret)
+                return TRUE;
+
+        /* Not pending, so it's been written */
+        g_mutex_lock (&stream->boa_lock);
+        ret = _vte_boa_read (stream->boa, offset_aligned, data);
+        g_mutex_unlock (&stream->boa_lock);
+        return ret;
 }
 
 static void
 _vte_file_stream_finalize (GObject *object)
 {
         VteFileStream *stream = (VteFileStream *) object;
+        GThread *writer = NULL;
+        GList *l, *next;
+        guint i;
+
+        /* Drop the blocks the writer hasn't started on, and wait for the one it has */
+        g_mutex_lock (&_vte_file_stream_writer_lock);
+        for (l = stream->pending.head; l != NULL; l = next) {
+                VtePendingBlock *block = (VtePendingBlock *) l->data;
+                next = l->next;
+                if (g_queue_remove (&_vte_file_stream_writer_queue, block)) {
+                        g_queue_delete_link (&stream->pending, l);
+                        g_free (block->data);
+                        g_free (block);
+                }
+        }
+        while (!g_queue_is_empty (&stream->pending))
+                g_cond_wait (&_vte_file_stream_written_cond, &_vte_file_stream_writer_lock);
+
+        /* Stop the writer with the last stream */
+        if (--_vte_file_stream_n_streams == 0 && _vte_file_stream_writer != NULL) {
+                writer = _vte_file_stream_writer;
+                _vte_file_stream_writer = NULL;
+                _vte_file_stream_writer_stop = TRUE;
+                g_cond_signal (&_vte_file_stream_writer_cond);
+        }
+        g_mutex_unlock (&_vte_file_stream_writer_lock);
+        if (writer != NULL)
+                g_thread_join (writer);
+
+#ifndef VTESTREAM_MAIN
+        _vte_debug_print (VTE_DEBUG_RING,
+                          "Stream %p read cache: %u blocks, %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses\n",
+                          (void *) stream, stream->rcache_len, stream->rcache_hits, stream->rcache_misses);
+#endif
 
-        g_free(stream->rbuf);
+        for (i = 0; i < stream->rcache_len; i++)
+                g_free(stream->rcache[i].data);
+        _vte_file_stream_cache_bytes -= stream->rcache_len * VTE_BOA_BLOCKSIZE;
         g_free(stream->wbuf);
+        g_mutex_clear (&stream->boa_lock);
         g_object_unref (stream->boa);
 
         G_OBJECT_CLASS (_vte_file_stream_parent_class)->finalize(object);
 }
 
+/* Invalidate the cached blocks from offset onwards */
+static void
+_vte_file_stream_invalidate_cache (VteFileStream *stream, gsize offset)
+{
+        guint i;
+
+        for (i = 0; i < stream->rcache_len; i++) {
+                if (stream->rcache[i].offset >= offset) {
+                        stream->rcache[i].offset = 1;  /* Invalidate */
+                        stream->rcache[i].last_used = 0;
+                }
+        }
+}
+
+/* Returns the block at offset_aligned, decoded, or NULL */
+static const char *
+_vte_file_stream_read_block (VteFileStream *stream, gsize offset_aligned)
+{
+        VteCachedBlock *block;
+        guint i;
+
+        for (i = 0; i < stream->rcache_len; i++) {
+                block = &stream->rcache[i];
+                if (block->offset == offset_aligned) {
+                        block->last_used = ++stream->rcache_clock;
+                        stream->rcache_hits++;
+                        _vte_file_stream_cache_hits++;
+                        return block->data;
+                }
+        }
+
+        stream->rcache_misses++;
+        _vte_file_stream_cache_misses++;
+
+        if (stream->rcache_len < _vte_file_stream_cache_blocks &&
+            (stream->rcache_len == 0 ||
+             _vte_file_stream_cache_bytes + VTE_BOA_BLOCKSIZE <= _vte_file_stream_cache_max_bytes)) {
+                block = &stream->rcache[stream->rcache_len++];
+                block->data = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+                _vte_file_stream_cache_bytes += VTE_BOA_BLOCKSIZE;
+        } else {
+                block = &stream->rcache[0];
+                for (i = 1; i < stream->rcache_len; i++) {
+                        if (stream->rcache[i].last_used < block->last_used)
+                                block = &stream->rcache[i];
+                }
+        }
+
+        if (G_UNLIKELY (!_vte_file_stream_read_boa (stream, offset_aligned, block->data))) {
+                block->offset = 1;  /* Invalidate */
+                block->last_used = 0;
+                return NULL;
+        }
+        block->offset = offset_aligned;
+        block->last_used = ++stream->rcache_clock;
+        return block->data;
+}
+
 static void
 _vte_file_stream_reset (VteStream *astream, gsize offset)
 {
 	VteFileStream *stream = (VteFileStream *) astream;
-        gsize offset_aligned = ALIGN_BOA(offset);
 
         /* This is the same assertion as in boa, repeated here for the buffering layer
          * to catch if this expectation is broken within a block. */
         g_assert_cmpuint (offset, >=, stream->head);
 
-        _vte_boa_reset (stream->boa, offset_aligned);
+        _vte_file_stream_wait_written (stream, G_MAXSIZE);
+        g_mutex_lock (&stream->boa_lock);
+        _vte_boa_reset (stream->boa, ALIGN_BOA(offset));
+        g_mutex_unlock (&stream->boa_lock);
         stream->tail = stream->head = offset;
 
         /* When resetting at a non-aligned offset, initial bytes of the write buffer
@@ -1109,7 +1991,7 @@ _vte_file_stream_reset (VteStream *astream, gsize offset)
 #endif
 
         stream->wbuf_len = MOD_BOA(offset);
-        stream->rbuf_offset = 1;  /* Invalidate */
+        _vte_file_stream_invalidate_cache (stream, 0);
 }
 
 static gboolean
@@ -1134,13 +2016,10 @@ _vte_file_stream_read (VteStream *astream, gsize offset, char *data, gsize len)
 
         while (len && offset < ALIGN_BOA(stream->head)) {
                 gsize l = MIN(VTE_BOA_BLOCKSIZE - MOD_BOA(offset), len);
-                gsize offset_aligned = ALIGN_BOA(offset);
-                if (offset_aligned != stream->rbuf_offset) {
-                        if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->rbuf)))
-                                return FALSE;
-                        stream->rbuf_offset = offset_aligned;
-                }
-                memcpy(data, stream->rbuf + MOD_BOA(offset), l);
+                const char *block = _vte_file_stream_read_block (stream, ALIGN_BOA(offset));
+                if (G_UNLIKELY (block == NULL))
+                        return FALSE;
+                memcpy(data, block + MOD_BOA(offset), l);
                 offset += l; data += l; len -= l;
         }
         if (len) {
@@ -1160,7 +2039,15 @@ _vte_file_stream_append (VteStream *astream, const char *data, gsize len)
                 memcpy(stream->wbuf + stream->wbuf_len, data, l);
                 stream->wbuf_len += l; data += l; len -= l;
                 if (stream->wbuf_len == VTE_BOA_BLOCKSIZE) {
-                        _vte_boa_write (stream->boa, ALIGN_BOA(stream->head), stream->wbuf);
+                        if (_vte_file_stream_write_in_background) {
+                                _vte_file_stream_queue_write (stream, ALIGN_BOA(stream->head), stream->wbuf);
+                                stream->wbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+                        } else {
+                                _vte_file_stream_wait_written (stream, G_MAXSIZE);
+                                g_mutex_lock (&stream->boa_lock);
+                                _vte_boa_write (stream->boa, ALIGN_BOA(stream->head), stream->wbuf);
+                                g_mutex_unlock (&stream->boa_lock);
+                        }
                         stream->wbuf_len = 0;
                 }
                 stream->head += l;
@@ -1183,14 +2070,15 @@ _vte_file_stream_truncate (VteStream *astream, gsize offset)
                  * intact, that is, read back the new partial last block to
                  * the write cache. */
                 gsize offset_aligned = ALIGN_BOA(offset);
+                _vte_file_stream_wait_written (stream, G_MAXSIZE);
+                g_mutex_lock (&stream->boa_lock);
                 if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->wbuf))) {
                         /* what now? */
                         memset(stream->wbuf, 0, VTE_BOA_BLOCKSIZE);
                 }
+                g_mutex_unlock (&stream->boa_lock);
 
-                if (stream->rbuf_offset >= offset_aligned) {
-                        stream->rbuf_offset = 1;  /* Invalidate */
-                }
+                _vte_file_stream_invalidate_cache (stream, offset_aligned);
         }
         stream->wbuf_len = MOD_BOA(offset);
 	stream->head = offset;
@@ -1204,8 +2092,12 @@ _vte_file_stream_advance_tail (VteStream *astream, gsize offset)
         g_assert_cmpuint (offset, >=, stream->tail);
         g_assert_cmpuint (offset, <=, stream->head);
 
-        if (ALIGN_BOA(offset) > ALIGN_BOA(stream->tail))
+        if (ALIGN_BOA(offset) > ALIGN_BOA(stream->tail)) {
+                _vte_file_stream_wait_written (stream, ALIGN_BOA(offset));
+                g_mutex_lock (&stream->boa_lock);
                 _vte_boa_advance_tail (stream->boa, ALIGN_BOA(offset));
+                g_mutex_unlock (&stream->boa_lock);
+        }
 
         stream->tail = offset;
 }
@@ -1262,6 +2154,24 @@ G_END_DECLS
         g_assert (memcmp(__buf, __contents, strlen(__contents)) == 0); \
 } while (0)
 
+/* Check for the arena's exact contents, reading the holes and the rest of the blocks as dots */
+#define assert_arena(__arena, __contents) do { \
+        char __buf[100]; \
+        gsize __i; \
+        g_assert_cmpuint (__arena->n_blocks * VTE_SNAKE_BLOCKSIZE, ==, strlen(__contents)); \
+        for (__i = 0; __i < __arena->n_blocks; __i++) \
+                g_assert_cmpuint (_arena_read (__arena, __buf + __i * VTE_SNAKE_BLOCKSIZE, VTE_SNAKE_BLOCKSIZE, __i * VTE_SNAKE_BLOCKSIZE), ==, VTE_SNAKE_BLOCKSIZE); \
+        g_assert (memcmp(__buf, __contents, strlen(__contents)) == 0); \
+} while (0)
+
+/* Check for the exact contents of the snake's file, or of its arena instead */
+#define assert_snake_file(__snake, __contents) do { \
+        if (__snake->arena != NULL) \
+                assert_arena (__snake->arena, __contents); \
+        else \
+                assert_file (__snake->fd, __contents); \
+} while (0)
+
 /* Check for the snake's state, tail, head and contents */
 #define assert_snake(__snake, __state, __tail, __head, __contents) do { \
         char __buf[VTE_SNAKE_BLOCKSIZE]; \
@@ -1327,38 +2237,45 @@ test_fakes (void)
 
         /* Compress, but becomes bigger */
         strcpy(buf, "abcdef");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 6), ==, 7);
+        g_assert_cmpuint(_vte_boa_compress (boa, VTE_STREAM_CODEC_ZLIB, 0, buf2, 100, buf, 6), ==, 7);
         g_assert(strncmp (buf2, "1abcdef", 7) == 0);
 
         /* Uncompress */
         strcpy(buf, "1abcdef");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 6);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_STREAM_CODEC_ZLIB, buf2, 100, buf, 7), ==, 6);
         g_assert(strncmp (buf2, "abcdef", 6) == 0);
 
         /* Compress, becomes smaller */
         strcpy(buf, "www");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 3), ==, 2);
+        g_assert_cmpuint(_vte_boa_compress (boa, VTE_STREAM_CODEC_ZLIB, 0, buf2, 100, buf, 3), ==, 2);
         g_assert(strncmp (buf2, "3w", 2) == 0);
 
         /* Uncompress */
         strcpy(buf, "3w");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 2), ==, 3);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_STREAM_CODEC_ZLIB, buf2, 100, buf, 2), ==, 3);
         g_assert(strncmp (buf2, "www", 3) == 0);
 
         /* Compress, remains the same size */
         strcpy(buf, "zebraaa");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 7), ==, 7);
+        g_assert_cmpuint(_vte_boa_compress (boa, VTE_STREAM_CODEC_ZLIB, 0, buf2, 100, buf, 7), ==, 7);
         g_assert(strncmp (buf2, "1zebr3a", 7) == 0);
 
         /* Uncompress */
         strcpy(buf, "1zebr3a");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 7);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_STREAM_CODEC_ZLIB, buf2, 100, buf, 7), ==, 7);
         g_assert(strncmp (buf2, "zebraaa", 7) == 0);
 
         /* Trying to uncompress the original does *not* give back the same contents.
          * This will be important below. */
         strcpy(buf, "zebraaa");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 0);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_STREAM_CODEC_ZLIB, buf2, 100, buf, 7), ==, 0);
+
+        /* Compress and uncompress with an odd codec, reversed */
+        strcpy(buf, "abccc");
+        g_assert_cmpuint(_vte_boa_compress (boa, VTE_STREAM_CODEC_LZ4, 0, buf2, 100, buf, 5), ==, 5);
+        g_assert(strncmp (buf2, "c3ba1", 5) == 0);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_STREAM_CODEC_LZ4, buf, 100, buf2, 5), ==, 5);
+        g_assert(strncmp (buf, "abccc", 5) == 0);
 
         g_object_unref (boa);
 }
@@ -1366,84 +2283,88 @@ test_fakes (void)
 #define snake_write(snake, offset, str) _vte_snake_write((snake), (offset), (str), strlen(str))
 
 static void
-test_snake (void)
+test_snake (gboolean in_memory)
 {
         VteSnake *snake = (VteSnake *)g_object_new (VTE_TYPE_SNAKE, NULL);
+        if (in_memory)
+                _vte_snake_set_in_memory (snake);
 
         /* Test overwriting data */
         snake_write (snake, 0, "Armadillo");
         assert_snake (snake, 1, 0, 10, "Armadillo.");
 
         snake_write (snake, 10, "Bobcat");
-        assert_file (snake->fd, "Armadillo.Bobcat....");
+        assert_snake_file (snake, "Armadillo.Bobcat....");
         assert_snake (snake, 1, 0, 20, "Armadillo.Bobcat....");
 
         snake_write (snake, 10, "Chinchilla");
-        assert_file (snake->fd, "Armadillo.Chinchilla");
+        assert_snake_file (snake, "Armadillo.Chinchilla");
         assert_snake (snake, 1, 0, 20, "Armadillo.Chinchilla");
 
         snake_write (snake, 0, "Duck");
-        assert_file (snake->fd, "Duck......Chinchilla");
+        assert_snake_file (snake, "Duck......Chinchilla");
         assert_snake (snake, 1, 0, 20, "Duck......Chinchilla");
 
         snake_write (snake, 20, "");
-        assert_file (snake->fd, "Duck......Chinchilla..........");
+        assert_snake_file (snake, "Duck......Chinchilla..........");
         assert_snake (snake, 1, 0, 30, "Duck......Chinchilla..........");
 
         snake_write (snake, 30, "Ferret");
-        assert_file (snake->fd, "Duck......Chinchilla..........Ferret....");
+        assert_snake_file (snake, "Duck......Chinchilla..........Ferret....");
         assert_snake (snake, 1, 0, 40, "Duck......Chinchilla..........Ferret....");
 
         /* Start over */
         g_object_unref (snake);
         snake = (VteSnake *)g_object_new (VTE_TYPE_SNAKE, NULL);
+        if (in_memory)
+                _vte_snake_set_in_memory (snake);
 
         /* State 1 */
         snake_write (snake, 0, "Armadillo");
         snake_write (snake, 10, "Bobcat");
-        assert_file (snake->fd, "Armadillo.Bobcat....");
+        assert_snake_file (snake, "Armadillo.Bobcat....");
         assert_snake (snake, 1, 0, 20, "Armadillo.Bobcat....");
 
         /* Stay in state 1 */
         _vte_snake_advance_tail (snake, 10);
         snake_write (snake, 20, "Chinchilla");
-        assert_file (snake->fd, "..........Bobcat....Chinchilla");
+        assert_snake_file (snake, "..........Bobcat....Chinchilla");
         assert_snake (snake, 1, 10, 30, "Bobcat....Chinchilla");
 
         /* State 1 -> 2 */
         _vte_snake_advance_tail (snake, 20);
         snake_write (snake, 30, "Duck");
-        assert_file (snake->fd, "Duck................Chinchilla");
+        assert_snake_file (snake, "Duck................Chinchilla");
         assert_snake (snake, 2, 20, 40, "ChinchillaDuck......");
 
         /* Stay in state 2 */
         snake_write (snake, 40, "Elephant");
-        assert_file (snake->fd, "Duck......Elephant..Chinchilla");
+        assert_snake_file (snake, "Duck......Elephant..Chinchilla");
         assert_snake (snake, 2, 20, 50, "ChinchillaDuck......Elephant..");
 
         /* State 2 -> 3 */
         snake_write (snake, 50, "Ferret");
-        assert_file (snake->fd, "Duck......Elephant..ChinchillaFerret....");
+        assert_snake_file (snake, "Duck......Elephant..ChinchillaFerret....");
         assert_snake (snake, 3, 20, 60, "ChinchillaDuck......Elephant..Ferret....");
 
         /* State 3 -> 4 */
         _vte_snake_advance_tail (snake, 30);
-        assert_file (snake->fd, "Duck......Elephant............Ferret....");
+        assert_snake_file (snake, "Duck......Elephant............Ferret....");
         assert_snake (snake, 4, 30, 60, "Duck......Elephant..Ferret....");
 
         /* Stay in state 4 */
         _vte_snake_advance_tail (snake, 40);
-        assert_file (snake->fd, "..........Elephant............Ferret....");
+        assert_snake_file (snake, "..........Elephant............Ferret....");
         assert_snake (snake, 4, 40, 60, "Elephant..Ferret....");
 
         /* State 4 -> 1 */
         _vte_snake_advance_tail (snake, 50);
-        assert_file (snake->fd, "..............................Ferret....");
+        assert_snake_file (snake, "..............................Ferret....");
         assert_snake (snake, 1, 50, 60, "Ferret....");
 
         /* State 1 -> 2 */
         snake_write (snake, 60, "Giraffe");
-        assert_file (snake->fd, "Giraffe.......................Ferret....");
+        assert_snake_file (snake, "Giraffe.......................Ferret....");
         assert_snake (snake, 2, 50, 70, "Ferret....Giraffe...");
 
         /* Reset, back to state 1 */
@@ -1452,7 +2373,7 @@ test_snake (void)
 
         /* Stay in state 1 */
         snake_write (snake, 250, "Zebra");
-        assert_file (snake->fd, "Zebra.....");
+        assert_snake_file (snake, "Zebra.....");
         assert_snake (snake, 1, 250, 260, "Zebra.....");
 
         g_object_unref (snake);
@@ -1469,45 +2390,48 @@ test_snake (void)
  */
 
 static void
-test_boa (void)
+test_boa (gboolean in_memory)
 {
         VteBoa *boa = (VteBoa *)g_object_new (VTE_TYPE_BOA, NULL);
         VteSnake *snake = (VteSnake *) &boa->parent;
 
+        if (in_memory)
+                _vte_snake_set_in_memory (snake);
+
         /* State 1 */
         _vte_boa_write (boa, 0, "axolotl");
         _vte_boa_write (boa, 7, "beeeeee");
-        assert_file (snake->fd, "\007\001AXOLOTL\001" "\004\0011B6E\011...");
+        assert_snake_file (snake, "\007\001AXOLOTL\001" "\004\0011B6E\011...");
         assert_snake (snake, 1, 0, 20, "\007\001AXOLOTL\001" "\004\0011B6E\011...");
         assert_boa (boa, 0, 14, "axolotl" "beeeeee");
 
         /* Test overwrites: overwrite counter increases separately for each block */
         _vte_boa_write (boa, 7, "buffalo");
-        assert_file (snake->fd, "\007\001AXOLOTL\001" "\007\002BUFFALO\012");
+        assert_snake_file (snake, "\007\001AXOLOTL\001" "\007\002BUFFALO\012");
         assert_snake (snake, 1, 0, 20, "\007\001AXOLOTL\001" "\007\002BUFFALO\012");
         assert_boa (boa, 0, 14, "axolotl" "buffalo");
 
         _vte_boa_write (boa, 7, "beeeeee");
-        assert_file (snake->fd, "\007\001AXOLOTL\001" "\004\0031B6E\013...");
+        assert_snake_file (snake, "\007\001AXOLOTL\001" "\004\0031B6E\013...");
         assert_snake (snake, 1, 0, 20, "\007\001AXOLOTL\001" "\004\0031B6E\013...");
         assert_boa (boa, 0, 14, "axolotl" "beeeeee");
 
         _vte_boa_write (boa, 0, "axolotl");
-        assert_file (snake->fd, "\007\002AXOLOTL\002" "\004\0031B6E\013...");
+        assert_snake_file (snake, "\007\002AXOLOTL\002" "\004\0031B6E\013...");
         assert_snake (snake, 1, 0, 20, "\007\002AXOLOTL\002" "\004\0031B6E\013...");
         assert_boa (boa, 0, 14, "axolotl" "beeeeee");
 
         /* Stay in state 1 */
         _vte_boa_advance_tail (boa, 7);
         _vte_boa_write (boa, 14, "cheetah");
-        assert_file (snake->fd, ".........." "\004\0031B6E\013..." "\007\001CHEETAH\021");
+        assert_snake_file (snake, ".........." "\004\0031B6E\013..." "\007\001CHEETAH\021");
         assert_snake (snake, 1, 10, 30, "\004\0031B6E\013..." "\007\001CHEETAH\021");
         assert_boa (boa, 7, 21, "beeeeee" "cheetah");
 
         /* State 1 -> 2 */
         _vte_boa_advance_tail (boa, 14);
         _vte_boa_write (boa, 21, "deeeeer");
-        assert_file (snake->fd, "\006\0011D5E1R\031." ".........." "\007\001CHEETAH\021");
+        assert_snake_file (snake, "\006\0011D5E1R\031." ".........." "\007\001CHEETAH\021");
         assert_snake (snake, 2, 20, 40, "\007\001CHEETAH\021" "\006\0011D5E1R\031.");
         assert_boa (boa, 14, 28, "cheetah" "deeeeer");
 
@@ -1526,15 +2450,53 @@ test_boa (void)
          * don't try to decompress.
          */
         _vte_boa_write (boa, 175, "zebraaa");
-        assert_file (snake->fd, "\007\001ZEBRAAA\311");
+        assert_snake_file (snake, "\007\001ZEBRAAA\311");
         assert_snake (snake, 1, 250, 260, "\007\001ZEBRAAA\311");
         assert_boa (boa, 175, 182, "zebraaa");
 
         g_object_unref (boa);
 }
 
+static void
+test_boa_codecs (void)
+{
+        VteBoa *boa = (VteBoa *)g_object_new (VTE_TYPE_BOA, NULL);
+        VteSnake *snake = (VteSnake *) &boa->parent;
+
+        /* Each block records its codec, and is read back with that */
+        g_assert (_vte_file_stream_set_codec (VTE_STREAM_CODEC_LZ4, 0));
+        _vte_boa_write (boa, 0, "beeeeee");
+        g_assert (_vte_file_stream_set_codec (VTE_STREAM_CODEC_ZLIB, 0));
+        _vte_boa_write (boa, 7, "ccccccc");
+        assert_file (snake->fd, "\044\001E6B1\001..." "\002\0017C\011.....");
+        assert_snake (snake, 1, 0, 20, "\044\001E6B1\001..." "\002\0017C\011.....");
+        assert_boa (boa, 0, 14, "beeeeee" "ccccccc");
+
+        /* Blocks stored uncompressed don't need a codec */
+        g_assert (_vte_file_stream_set_codec (VTE_STREAM_CODEC_LZ4, 0));
+        _vte_boa_write (boa, 14, "axolotl");
+        g_assert (_vte_file_stream_set_codec (VTE_STREAM_CODEC_ZLIB, 0));
+        assert_file (snake->fd, "\044\001E6B1\001..." "\002\0017C\011....." "\007\001AXOLOTL\021");
+        assert_boa (boa, 0, 21, "beeeeee" "ccccccc" "axolotl");
+
+        g_assert (!_vte_file_stream_set_codec ((VteStreamCodec) 7, 0));
+
+        g_object_unref (boa);
+}
+
 #define stream_append(as, str) _vte_stream_append((as), (str), strlen(str))
 
+static gboolean
+stream_is_cached (VteFileStream *stream, gsize offset)
+{
+        guint i;
+
+        for (i = 0; i < stream->rcache_len; i++)
+                if (stream->rcache[i].offset == offset)
+                        return TRUE;
+        return FALSE;
+}
+
 static void
 test_stream (void)
 {
@@ -1594,12 +2556,12 @@ test_stream (void)
 
         /* Test that the read cache is invalidated on truncate */
         _vte_stream_read (astream, 12, buf, 2);
-        g_assert_cmpuint (stream->rbuf_offset, ==, 7);
+        g_assert (stream_is_cached (stream, 7));
         _vte_stream_truncate (astream, 13);
-        g_assert_cmpuint (stream->rbuf_offset, ==, 1);
+        g_assert (!stream_is_cached (stream, 7));
         stream_append (astream, "z" "cat");
         _vte_stream_read (astream, 12, buf, 2);
-        g_assert_cmpuint (stream->rbuf_offset, ==, 7);
+        g_assert (stream_is_cached (stream, 7));
         buf[2] = '\0';
         g_assert_cmpstr (buf, ==, "ez");
         assert_file (snake->fd, "\007\001AXOLOTL\001" "\006\0031B5E1Z\013.");
@@ -1758,14 +2720,158 @@ test_stream (void)
         g_object_unref (astream);
 }
 
+static void
+test_stream_cache (void)
+{
+        VteStream *astream = _vte_file_stream_new();
+        VteStream *astream2 = _vte_file_stream_new();
+        VteFileStream *stream = (VteFileStream *) astream;
+        VteFileStream *stream2 = (VteFileStream *) astream2;
+        char buf[8];
+        int i;
+
+        stream_append (astream, "axolotl" "beeeeee" "catfish" "dolphin");
+        stream_append (astream2, "axolotl" "beeeeee" "catfish" "dolphin");
+
+        /* Alternating between blocks only reads each block once */
+        _vte_file_stream_set_cache_size (4, 1024);
+        for (i = 0; i < 4; i++) {
+                _vte_stream_read (astream, 2, buf, 2);
+                _vte_stream_read (astream, 16, buf, 2);
+                _vte_stream_read (astream, 24, buf, 2);
+        }
+        g_assert_cmpuint (stream->rcache_len, ==, 3);
+        g_assert_cmpuint (stream->rcache_hits, ==, 9);
+        g_assert_cmpuint (stream->rcache_misses, ==, 3);
+
+        /* Reading a block more than the cache holds evicts the least recently used one */
+        _vte_file_stream_set_cache_size (3, 1024);
+        _vte_stream_read (astream, 9, buf, 2);
+        buf[2] = '\0';
+        g_assert_cmpstr (buf, ==, "ee");
+        g_assert_cmpuint (stream->rcache_len, ==, 3);
+        g_assert (!stream_is_cached (stream, 0));
+        g_assert (stream_is_cached (stream, 7));
+        g_assert (stream_is_cached (stream, 14));
+        g_assert (stream_is_cached (stream, 21));
+
+        /* Past the global limit, a stream gets one block only */
+        _vte_file_stream_set_cache_size (4, 3 * VTE_BOA_BLOCKSIZE);
+        _vte_stream_read (astream2, 2, buf, 2);
+        _vte_stream_read (astream2, 9, buf, 2);
+        g_assert_cmpuint (stream2->rcache_len, ==, 1);
+        g_assert_cmpuint (stream2->rcache_misses, ==, 2);
+        g_assert (stream_is_cached (stream2, 7));
+
+        /* Reset drops the cached blocks, but keeps the memory */
+        _vte_stream_reset (astream, _vte_stream_head (astream));
+        g_assert_cmpuint (stream->rcache_len, ==, 3);
+        g_assert (!stream_is_cached (stream, 7));
+
+        _vte_file_stream_set_cache_size (4, 32 * 1024 * 1024);
+        g_object_unref (astream2);
+        g_object_unref (astream);
+}
+
+static void
+test_stream_background (void)
+{
+        VteStream *astream;
+        VteFileStream *stream;
+        VteBoa *boa;
+        char buf[32];
+        int i;
+
+        _vte_file_stream_set_write_in_background (TRUE);
+
+        /* Reads find the blocks whether or not they're written yet */
+        astream = _vte_file_stream_new();
+        stream = (VteFileStream *) astream;
+        boa = stream->boa;
+        for (i = 0; i < 3; i++) {
+                stream_append (astream, "axolotl" "beeeeee" "catfish");
+                _vte_stream_read (astream, 21 * i + 7, buf, 14);
+                buf[14] = '\0';
+                g_assert_cmpstr (buf, ==, "beeeeee" "catfish");
+        }
+        _vte_file_stream_wait_written (stream, G_MAXSIZE);
+        g_assert (g_queue_is_empty (&stream->pending));
+        assert_boa (boa, 0, 63, "axolotlbeeeeeecatfish" "axolotlbeeeeeecatfish" "axolotlbeeeeeecatfish");
+
+        /* Advancing the tail or truncating wait for the writer */
+        stream_append (astream, "dolphin" "echidna" "f");
+        _vte_stream_advance_tail (astream, 70);
+        _vte_file_stream_wait_written (stream, G_MAXSIZE);
+        assert_boa (boa, 70, 77, "echidna");
+        _vte_stream_truncate (astream, 72);
+        assert_stream (astream, 70, 72, "ec");
+        stream_append (astream, "xxxxx" "gerbil");
+        assert_stream (astream, 70, 83, "ecxxxxx" "gerbil");
+
+        /* Finalizing drops what's still pending */
+        for (i = 0; i < 20; i++)
+                stream_append (astream, "hamster");
+        g_object_unref (astream);
+        g_assert_null (_vte_file_stream_writer);
+
+        _vte_file_stream_set_write_in_background (FALSE);
+}
+
+static void
+test_memory_stream (void)
+{
+        VteStream *astream = _vte_memory_stream_new();
+        VteFileStream *stream = (VteFileStream *) astream;
+        VteSnake *snake = (VteSnake *) stream->boa;
+        gsize bytes, pooled_bytes;
+
+        /* The blocks take up what they were compressed to, rounded up to granules */
+        stream_append (astream, "axolotl" "beeeeee" "catfish");
+        g_assert (snake->fd == -1);
+        assert_snake_file (snake, "\007\001AXOLOTL\001" "\004\0011B6E\011..." "\007\001CATFISH\021");
+        assert_stream (astream, 0, 21, "axolotl" "beeeeee" "catfish");
+        _vte_memory_stream_get_stats (&bytes, &pooled_bytes);
+        g_assert_cmpuint (bytes, ==, 10 + 8 + 10);
+        g_assert_cmpuint (pooled_bytes, ==, 0);
+
+        /* Dropped blocks go to the pool, as long as it has room */
+        _vte_stream_advance_tail (astream, 14);
+        _vte_memory_stream_get_stats (&bytes, &pooled_bytes);
+        g_assert_cmpuint (bytes, ==, 10);
+        g_assert_cmpuint (pooled_bytes, ==, 8);
+
+        /* and new blocks of the same size come from there */
+        stream_append (astream, "deeeeee");
+        assert_snake_file (snake, "\004\0011D6E\031..." ".........." "\007\001CATFISH\021");
+        assert_stream (astream, 14, 28, "catfish" "deeeeee");
+        _vte_memory_stream_get_stats (&bytes, &pooled_bytes);
+        g_assert_cmpuint (bytes, ==, 8 + 10);
+        g_assert_cmpuint (pooled_bytes, ==, 0);
+
+        /* The last memory stream takes the pool along */
+        _vte_stream_reset (astream, 28);
+        _vte_memory_stream_get_stats (&bytes, &pooled_bytes);
+        g_assert_cmpuint (bytes, ==, 0);
+        g_assert_cmpuint (pooled_bytes, ==, 8);
+        g_object_unref (astream);
+        _vte_memory_stream_get_stats (&bytes, &pooled_bytes);
+        g_assert_cmpuint (pooled_bytes, ==, 0);
+}
+
 int
 main (int argc, char **argv)
 {
         test_fakes();
 
-        test_snake();
-        test_boa();
+        test_snake(FALSE);
+        test_snake(TRUE);
+        test_boa(FALSE);
+        test_boa(TRUE);
+        test_boa_codecs();
         test_stream();
+        test_stream_cache();
+        test_stream_background();
+        test_memory_stream();
 
         printf("vtestream-file tests passed :)\n");
         return 0;
@@ -41,6 +41,54 @@ gsize _vte_stream_head (VteStream *stream);
 VteStream *
 _vte_file_stream_new (void);
 
+/* Sets how many blocks each file stream caches for reading, and the most
+ * memory all of them together may use for that; defaults to 4 and 32 MiB.
+ * See vte_set_scrollback_cache_size(). */
+void
+_vte_file_stream_set_cache_size (guint n_blocks, gsize max_bytes);
+
+/* Returns the reads from the file streams' caches so far, and their memory */
+void
+_vte_file_stream_get_cache_stats (guint64 *hits, guint64 *misses, gsize *bytes);
+
+typedef enum {
+        VTE_STREAM_CODEC_ZLIB,
+        VTE_STREAM_CODEC_LZ4,
+        VTE_STREAM_CODEC_ZSTD,
+} VteStreamCodec;
+
+/* Sets the codec the file streams compress the blocks written from now on
+ * with, and its level, 0 for the codec's default. Returns %FALSE if the
+ * codec isn't built in. See vte_set_scrollback_codec(). */
+gboolean
+_vte_file_stream_set_codec (VteStreamCodec codec, int level);
+
+/* Whether the file streams compressing with zstd train a dictionary of their
+ * own on their first blocks, and compress the rest with it; off by default.
+ * Returns %FALSE if zstd isn't built in. See vte_set_scrollback_dictionaries(). */
+gboolean
+_vte_file_stream_set_dictionaries (gboolean train);
+
+/* Whether the file streams compress and write full blocks on a thread of
+ * their own, which is the default; or right away, on the appending thread */
+void
+_vte_file_stream_set_write_in_background (gboolean background);
+
+/* Returns the bytes the file streams have written so far, and the size
+ * they took up in the files, compressed */
+void
+_vte_file_stream_get_write_stats (gsize *bytes, gsize *stored_bytes);
+
+/* A file stream that keeps its blocks, compressed and encrypted the same way,
+ * in memory instead of a temporary file; the file stream settings apply */
+VteStream *
+_vte_memory_stream_new (void);
+
+/* Returns the memory the memory streams' blocks take up, and that of the
+ * freed blocks kept around for reuse */
+void
+_vte_memory_stream_get_stats (gsize *bytes, gsize *pooled_bytes);
+
 G_END_DECLS
 
 #endif
@@ -35,14 +35,6 @@ static_assert(sizeof(vte::color::rgb) == sizeof(PangoColor), "vte::color::rgb si
 
 static_assert(sizeof(vte::util::smart_fd) == sizeof(int), "vte::util::smart_fd size wrong");
 
-vte::color::rgb::rgb(GdkRGBA const* rgba) {
-        g_assert(rgba);
-        /* FIXME: equal distribution! */
-        red   = rgba->red   * 65535.;
-        green = rgba->green * 65535.;
-        blue  = rgba->blue  * 65535.;
-}
-
 bool
 vte::color::rgb::parse(char const* spec)
 {
@@ -18,12 +18,15 @@
 #pragma once
 
 #include <pango/pango.h>
-#include <gdk/gdk.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include <cstdint>
 #include <memory>
 
+/* Not including gdk.h, so the emulation can do without; see vtegtk.cc */
+typedef struct _GdkRGBA GdkRGBA;
+
 #ifdef VTE_DEBUG
 #define IFDEF_DEBUG(str) str
 #else
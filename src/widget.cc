@@ -34,6 +34,15 @@ namespace vte {
 
 namespace platform {
 
+static gboolean
+toplevel_window_state_event_cb(GtkWidget* toplevel,
+                               GdkEventWindowState* event,
+                               Widget* that)
+{
+        that->toplevel_window_state_changed(event->new_window_state);
+        return false;
+}
+
 static void
 im_commit_cb(GtkIMContext* im_context,
              char const* text,
@@ -184,6 +193,18 @@ Widget::map() noexcept
 {
         if (m_event_window)
                 gdk_window_show_unraised(m_event_window);
+
+        /* Iconifying the toplevel doesn't unmap its children */
+        auto toplevel = gtk_widget_get_toplevel(m_widget);
+        if (gtk_widget_is_toplevel(toplevel)) {
+                m_toplevel = toplevel;
+                g_signal_connect(toplevel, "window-state-event",
+                                 G_CALLBACK(toplevel_window_state_event_cb), this);
+                if (auto window = gtk_widget_get_window(toplevel))
+                        toplevel_window_state_changed(gdk_window_get_state(window));
+        }
+
+        m_terminal->widget_map();
 }
 
 void
@@ -326,9 +347,24 @@ Widget::size_allocate(GtkAllocation* allocation) noexcept
                                        allocation->height);
 }
 
+void
+Widget::toplevel_window_state_changed(GdkWindowState state) noexcept
+{
+        m_terminal->widget_set_obscured((state & GDK_WINDOW_STATE_ICONIFIED) != 0);
+}
+
 void
 Widget::unmap() noexcept
 {
+        if (m_toplevel != nullptr) {
+                g_signal_handlers_disconnect_by_func(m_toplevel,
+                                                     (void*)toplevel_window_state_event_cb,
+                                                     this);
+                m_toplevel = nullptr;
+        }
+
+        m_terminal->widget_unmap();
+
         if (m_event_window)
                 gdk_window_hide(m_event_window);
 }
@@ -86,6 +86,7 @@ public:
 
         void screen_changed (GdkScreen *previous_screen) noexcept;
         void settings_changed() noexcept;
+        void toplevel_window_state_changed(GdkWindowState state) noexcept;
 
         void beep() noexcept;
 
@@ -153,6 +154,9 @@ private:
         /* Event window */
         GdkWindow *m_event_window;
 
+        /* The toplevel while mapped, for its window state */
+        GtkWidget* m_toplevel{nullptr};
+
         /* Cursors */
         vte::glib::RefPtr<GdkCursor> m_default_cursor;
         vte::glib::RefPtr<GdkCursor> m_invisible_cursor;